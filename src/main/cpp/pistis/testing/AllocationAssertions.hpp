@@ -0,0 +1,112 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONASSERTIONS_HPP__
+#define __PISTIS__TESTING__ALLOCATIONASSERTIONS_HPP__
+
+/** @file AllocationAssertions.hpp
+ *
+ *  Google Test assertions that limit the allocations a block of code
+ *  may perform.
+ *
+ *  The statement may be a braced block.  The macros count every
+ *  allocation the process makes while the statement runs, including
+ *  those made by other threads, e.g.
+ *
+ *  @code
+ *  EXPECT_NO_ALLOCATIONS(handler.handle(request));
+ *  EXPECT_ALLOCATIONS_AT_MOST(1, {
+ *    v.reserve(n);
+ *    for (int i = 0; i < n; ++i) v.push_back(i);
+ *  });
+ *  @endcode
+ */
+#include <pistis/testing/AllocationScope.hpp>
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Verify the scope has seen at most maxAllocations
+     *         allocations.
+     */
+    inline ::testing::AssertionResult checkAllocationsAtMost(
+	const AllocationScope& scope, uint64_t maxAllocations
+    ) {
+      const uint64_t n = scope.allocations();
+      const uint64_t bytes = scope.bytesAllocated();
+      if (n <= maxAllocations) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << n << " allocations (" << bytes
+	  << " bytes) exceeds the budget of " << maxAllocations
+	  << " allocations";
+    }
+
+    /** @brief Verify the allocations the scope has seen requested at
+     *         most maxBytes bytes in total.
+     */
+    inline ::testing::AssertionResult checkAllocatedBytesAtMost(
+	const AllocationScope& scope, uint64_t maxBytes
+    ) {
+      const uint64_t n = scope.bytesAllocated();
+      const uint64_t allocations = scope.allocations();
+      if (n <= maxBytes) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << n << " bytes allocated (in " << allocations
+	  << " allocations) exceeds the budget of " << maxBytes << " bytes";
+    }
+
+  }
+}
+
+#define PISTIS_TESTING_ALLOCATION_BUDGET_(check, limit, fail, ...)	\
+  do {									\
+    ::testing::AssertionResult pistisBudgetResult_ =			\
+	::testing::AssertionSuccess();					\
+    {									\
+      ::pistis::testing::AllocationScope pistisBudgetScope_;		\
+      __VA_ARGS__;							\
+      pistisBudgetResult_ = check(pistisBudgetScope_, (limit));		\
+    }									\
+    if (!pistisBudgetResult_) {						\
+      fail(pistisBudgetResult_.message());				\
+    }									\
+  } while (false)
+
+#define PISTIS_TESTING_EXPECT_FAILURE_(message) ADD_FAILURE() << message
+#define PISTIS_TESTING_ASSERT_FAILURE_(message) FAIL() << message
+
+/** @brief Expect statement to perform at most n allocations */
+#define EXPECT_ALLOCATIONS_AT_MOST(n, ...)				\
+  PISTIS_TESTING_ALLOCATION_BUDGET_(					\
+      ::pistis::testing::checkAllocationsAtMost, n,			\
+      PISTIS_TESTING_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement performs at most n allocations */
+#define ASSERT_ALLOCATIONS_AT_MOST(n, ...)				\
+  PISTIS_TESTING_ALLOCATION_BUDGET_(					\
+      ::pistis::testing::checkAllocationsAtMost, n,			\
+      PISTIS_TESTING_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Expect statement to allocate at most n bytes */
+#define EXPECT_ALLOCATED_BYTES_AT_MOST(n, ...)				\
+  PISTIS_TESTING_ALLOCATION_BUDGET_(					\
+      ::pistis::testing::checkAllocatedBytesAtMost, n,			\
+      PISTIS_TESTING_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement allocates at most n bytes */
+#define ASSERT_ALLOCATED_BYTES_AT_MOST(n, ...)				\
+  PISTIS_TESTING_ALLOCATION_BUDGET_(					\
+      ::pistis::testing::checkAllocatedBytesAtMost, n,			\
+      PISTIS_TESTING_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Expect statement not to allocate */
+#define EXPECT_NO_ALLOCATIONS(...)					\
+  EXPECT_ALLOCATIONS_AT_MOST(0, __VA_ARGS__)
+
+/** @brief Assert statement does not allocate */
+#define ASSERT_NO_ALLOCATIONS(...)					\
+  ASSERT_ALLOCATIONS_AT_MOST(0, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,391 @@
+#include "AllocationHooks.hpp"
+#include "Generators.hpp"
+#include "Sharding.hpp"
+
+#include <atomic>
+#include <new>
+
+#include <errno.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::hooks;
+
+// The C library's own allocator.  glibc exports these so that
+// programs that replace malloc() can forward to the original.
+extern "C" {
+  void* __libc_malloc(size_t);
+  void* __libc_calloc(size_t, size_t);
+  void* __libc_realloc(void*, size_t);
+  void __libc_free(void*);
+  void* __libc_memalign(size_t, size_t);
+  void* __libc_valloc(size_t);
+  void* __libc_pvalloc(size_t);
+}
+
+namespace {
+  struct CountShard {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> deallocations;
+    std::atomic<uint64_t> bytesAllocated;
+
+    // Observer callbacks running on the shard's threads
+    std::atomic<uint64_t> callbacksRunning;
+  };
+
+  static const size_t NUM_SHARDS = 64;
+
+  // All of these are zero- or constant-initialized, so the replacement
+  // functions can be called before any static constructor runs.  The
+  // counts are sharded per thread so concurrent tests do not contend
+  // for a single cache line.
+  static std::atomic<int> countingEnabled(0);
+  static CacheLinePadded<CountShard> countShards[NUM_SHARDS];
+
+  inline bool counting() {
+    return countingEnabled.load(std::memory_order_relaxed) > 0;
+  }
+
+  inline CountShard& localShard() {
+    return countShards[currentThreadShard() & (NUM_SHARDS - 1)].value;
+  }
+
+  // The observer, and whether the calling thread is inside one of its
+  // callbacks.  Allocations the observer makes are not reported to it.
+  static std::atomic<AllocationObserver*> observer(nullptr);
+  static __thread bool observing
+      __attribute__((tls_model("initial-exec"))) = false;
+
+  // Calls f with the observer, if one is installed.  Each callback is
+  // counted in the calling thread's shard while it runs, and the count
+  // is raised before the observer is loaded, so setAllocationObserver()
+  // can wait for the callbacks to the observer it replaced to return.
+  template <typename F>
+  inline void notify(F f) {
+    if (observing || !observer.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    std::atomic<uint64_t>& running = localShard().callbacksRunning;
+    running.fetch_add(1, std::memory_order_seq_cst);
+    AllocationObserver* o = observer.load(std::memory_order_seq_cst);
+    if (o) {
+      observing = true;
+      f(o);
+      observing = false;
+    }
+    running.fetch_sub(1, std::memory_order_release);
+  }
+
+  inline void notifyAllocated(void* p, size_t bytes, size_t alignment,
+			      void* caller) {
+    notify([=](AllocationObserver* o) {
+      o->allocated(p, bytes, alignment, caller);
+    });
+  }
+
+  // Called before the memory is released, so the observer sees the
+  // release before the address can be reused
+  inline void notifyDeallocating(void* p, void* caller) {
+    if (p) {
+      notify([=](AllocationObserver* o) { o->deallocating(p, caller); });
+    }
+  }
+
+  inline void notifyReallocationFailed(void* p, void* caller) {
+    notify([=](AllocationObserver* o) {
+      o->reallocationFailed(p, caller);
+    });
+  }
+
+  // Waits until no callback that may have loaded an observer before
+  // the last change to it is still running
+  static void waitForCallbacks() {
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+      const std::atomic<uint64_t>& running =
+	  countShards[i].value.callbacksRunning;
+      while (running.load(std::memory_order_seq_cst)) {
+	sched_yield();
+      }
+    }
+  }
+
+  inline void countDeallocation(void* p) {
+    if (p && counting()) {
+      localShard().deallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  inline void recordAllocation(void* p, size_t bytes, size_t alignment,
+			       void* caller) {
+    if (counting()) {
+      CountShard& shard = localShard();
+      shard.allocations.fetch_add(1, std::memory_order_relaxed);
+      shard.bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    notifyAllocated(p, bytes, alignment, caller);
+  }
+
+  inline void recordDeallocation(void* p, void* caller) {
+    countDeallocation(p);
+    notifyDeallocating(p, caller);
+  }
+
+  // Layout randomization state, zero-initialized like the counts
+  static const size_t NUM_SPACERS = 256;
+  static const size_t MAX_SPACER_SIZE = 4096;
+  static const size_t MAX_PADDING = 256;
+
+  static std::atomic<bool> randomizingLayout(false);
+  static std::atomic<uint64_t> layoutSeed(0);
+  static std::atomic<uint64_t> layoutCounter(0);
+  static std::atomic<void*> spacers[NUM_SPACERS];
+
+  // Perturbs the heap if layout randomization is enabled, and returns
+  // the padding to add to an allocation of the given size
+  inline size_t perturbLayout(size_t bytes) {
+    if (!randomizingLayout.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    const uint64_t r = generators::randomBits(
+	layoutSeed.load(std::memory_order_relaxed),
+	layoutCounter.fetch_add(1, std::memory_order_relaxed)
+    );
+    if (!(r & 3)) {
+      void* spacer = __libc_malloc(1 + ((r >> 8) % MAX_SPACER_SIZE));
+      __libc_free(spacers[(r >> 32) % NUM_SPACERS].exchange(spacer));
+    }
+
+    const size_t padding = ((r >> 2) % (MAX_PADDING / 16 + 1)) * 16;
+    return (bytes <= (SIZE_MAX - padding)) ? padding : 0;
+  }
+
+  inline bool isValidAlignment(size_t alignment) {
+    return alignment && !(alignment & (alignment - 1));
+  }
+
+  static const size_t DEFAULT_ALIGNMENT = alignof(max_align_t);
+
+  static void* allocateOrThrow(size_t bytes, void* caller) {
+    const size_t n = (bytes ? bytes : 1) + perturbLayout(bytes);
+    for (;;) {
+      void* p = __libc_malloc(n);
+      if (p) {
+	recordAllocation(p, bytes, DEFAULT_ALIGNMENT, caller);
+	return p;
+      }
+
+      std::new_handler handler = std::get_new_handler();
+      if (!handler) {
+	throw std::bad_alloc();
+      }
+      handler();
+    }
+  }
+
+  static void* allocateOrNull(size_t bytes, void* caller) noexcept {
+    try {
+      return allocateOrThrow(bytes, caller);
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  static void release(void* p, void* caller) noexcept {
+    recordDeallocation(p, caller);
+    __libc_free(p);
+  }
+}
+
+GlobalAllocationCounts pistis::testing::hooks::globalAllocationCounts() {
+  GlobalAllocationCounts counts = { 0, 0, 0 };
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    const CountShard& shard = countShards[i].value;
+    counts.allocations += shard.allocations.load(std::memory_order_relaxed);
+    counts.deallocations +=
+	shard.deallocations.load(std::memory_order_relaxed);
+    counts.bytesAllocated +=
+	shard.bytesAllocated.load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+void pistis::testing::hooks::enableGlobalAllocationCounting() {
+  countingEnabled.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pistis::testing::hooks::disableGlobalAllocationCounting() {
+  countingEnabled.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool pistis::testing::hooks::globalAllocationCountingEnabled() {
+  return counting();
+}
+
+void pistis::testing::hooks::enableLayoutRandomization(uint64_t seed) {
+  layoutSeed.store(seed, std::memory_order_relaxed);
+  layoutCounter.store(0, std::memory_order_relaxed);
+  randomizingLayout.store(true, std::memory_order_relaxed);
+}
+
+void pistis::testing::hooks::disableLayoutRandomization() {
+  randomizingLayout.store(false, std::memory_order_relaxed);
+}
+
+AllocationObserver* pistis::testing::hooks::setAllocationObserver(
+    AllocationObserver* newObserver
+) {
+  AllocationObserver* previous =
+      observer.exchange(newObserver, std::memory_order_seq_cst);
+  if (previous && (previous != newObserver)) {
+    waitForCallbacks();
+  }
+  return previous;
+}
+
+bool pistis::testing::hooks::layoutRandomizationEnabled() {
+  return randomizingLayout.load(std::memory_order_relaxed);
+}
+
+void pistis::testing::hooks::releaseLayoutSpacers() {
+  for (size_t i = 0; i < NUM_SPACERS; ++i) {
+    __libc_free(spacers[i].exchange(nullptr));
+  }
+}
+
+extern "C" {
+
+  void* malloc(size_t bytes) {
+    void* p = __libc_malloc(bytes + perturbLayout(bytes));
+    if (p) {
+      recordAllocation(p, bytes, DEFAULT_ALIGNMENT,
+		       __builtin_return_address(0));
+    }
+    return p;
+  }
+
+  void* calloc(size_t n, size_t size) {
+    perturbLayout(0);
+    void* p = __libc_calloc(n, size);
+    if (p) {
+      recordAllocation(p, n * size, DEFAULT_ALIGNMENT,
+		       __builtin_return_address(0));
+    }
+    return p;
+  }
+
+  void* realloc(void* p, size_t bytes) {
+    // The observer sees the old block released first, since realloc()
+    // may free it, and is told if realloc() fails and keeps it
+    void* const caller = __builtin_return_address(0);
+    notifyDeallocating(p, caller);
+    void* q = __libc_realloc(p, bytes);
+    if (p && !bytes) {
+      // realloc(p, 0) frees p
+      countDeallocation(p);
+    } else if (q) {
+      recordAllocation(q, bytes, DEFAULT_ALIGNMENT, caller);
+      countDeallocation(p);
+    } else if (p) {
+      notifyReallocationFailed(p, caller);
+    }
+    return q;
+  }
+
+  void free(void* p) {
+    release(p, __builtin_return_address(0));
+  }
+
+  int posix_memalign(void** result, size_t alignment, size_t bytes) {
+    if (!isValidAlignment(alignment) || (alignment % sizeof(void*))) {
+      return EINVAL;
+    }
+    void* p = __libc_memalign(alignment, bytes + perturbLayout(bytes));
+    if (!p) {
+      return ENOMEM;
+    }
+    recordAllocation(p, bytes, alignment, __builtin_return_address(0));
+    *result = p;
+    return 0;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t bytes) {
+    if (!isValidAlignment(alignment)) {
+      errno = EINVAL;
+      return nullptr;
+    }
+    void* p = __libc_memalign(alignment, bytes + perturbLayout(bytes));
+    if (p) {
+      recordAllocation(p, bytes, alignment, __builtin_return_address(0));
+    }
+    return p;
+  }
+
+  void* memalign(size_t alignment, size_t bytes) {
+    void* p = __libc_memalign(alignment, bytes + perturbLayout(bytes));
+    if (p) {
+      recordAllocation(p, bytes, alignment, __builtin_return_address(0));
+    }
+    return p;
+  }
+
+  void* valloc(size_t bytes) {
+    void* p = __libc_valloc(bytes);
+    if (p) {
+      recordAllocation(p, bytes, 4096, __builtin_return_address(0));
+    }
+    return p;
+  }
+
+  void* pvalloc(size_t bytes) {
+    void* p = __libc_pvalloc(bytes);
+    if (p) {
+      recordAllocation(p, bytes, 4096, __builtin_return_address(0));
+    }
+    return p;
+  }
+
+}
+
+void* operator new(std::size_t bytes) {
+  return allocateOrThrow(bytes, __builtin_return_address(0));
+}
+
+void* operator new[](std::size_t bytes) {
+  return allocateOrThrow(bytes, __builtin_return_address(0));
+}
+
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept {
+  return allocateOrNull(bytes, __builtin_return_address(0));
+}
+
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept {
+  return allocateOrNull(bytes, __builtin_return_address(0));
+}
+
+void operator delete(void* p) noexcept {
+  release(p, __builtin_return_address(0));
+}
+
+void operator delete[](void* p) noexcept {
+  release(p, __builtin_return_address(0));
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  release(p, __builtin_return_address(0));
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  release(p, __builtin_return_address(0));
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  release(p, __builtin_return_address(0));
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  release(p, __builtin_return_address(0));
+}
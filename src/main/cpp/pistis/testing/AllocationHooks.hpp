@@ -0,0 +1,133 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONHOOKS_HPP__
+#define __PISTIS__TESTING__ALLOCATIONHOOKS_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file AllocationHooks.hpp
+ *
+ *  Control over the global allocation functions the pistis_testing
+ *  library replaces.
+ *
+ *  The library defines malloc(), calloc(), realloc(), free(),
+ *  posix_memalign(), aligned_alloc(), memalign(), valloc() and the
+ *  global operator new and operator delete.  The replacements forward
+ *  to the C library's allocator and, while counting is enabled, count
+ *  every call.  Most tests should use AllocationScope instead of
+ *  calling these functions directly.
+ *
+ *  The replacements can also randomize the layout of the heap, so
+ *  benchmarks can tell real speedups from lucky placement; see
+ *  enableLayoutRandomization().
+ */
+namespace pistis {
+  namespace testing {
+    namespace hooks {
+
+      /** @brief Totals recorded by the replacement allocation functions */
+      struct GlobalAllocationCounts {
+	uint64_t allocations;
+	uint64_t deallocations;
+	uint64_t bytesAllocated;
+      };
+
+      /** @brief Returns the totals recorded while counting was enabled */
+      GlobalAllocationCounts globalAllocationCounts();
+
+      /** @brief Enable counting.
+       *
+       *  Calls nest:  counting stays enabled until
+       *  disableGlobalAllocationCounting() has been called once for
+       *  every call to enableGlobalAllocationCounting().
+       */
+      void enableGlobalAllocationCounting();
+
+      /** @brief Undo one call to enableGlobalAllocationCounting() */
+      void disableGlobalAllocationCounting();
+
+      /** @brief Returns true if counting is enabled */
+      bool globalAllocationCountingEnabled();
+
+      /** @brief Receives every allocation and deallocation made
+       *         through the replacement functions while it is
+       *         installed with setAllocationObserver().
+       *
+       *  Callbacks run inside malloc() and free(), on the thread that
+       *  called them, so they must be thread-safe.  Allocations the
+       *  observer itself makes are not reported to it.
+       */
+      class AllocationObserver {
+      public:
+	virtual ~AllocationObserver() { }
+
+	/** @brief Called after p was allocated.
+	 *
+	 *  @param p          The new block
+	 *  @param bytes      Number of bytes requested
+	 *  @param alignment  Alignment requested, or the default
+	 *                    alignment of malloc()
+	 *  @param caller     Return address of the allocation function,
+	 *                    i.e. the call site
+	 */
+	virtual void allocated(void* p, size_t bytes, size_t alignment,
+			       void* caller) = 0;
+
+	/** @brief Called before p is released.  realloc() reports the
+	 *         old block released, then the new block allocated.
+	 */
+	virtual void deallocating(void* p, void* caller) = 0;
+
+	/** @brief Called when realloc() fails after reporting p
+	 *         released.  p is still allocated, with the size and
+	 *         alignment it had before.
+	 */
+	virtual void reallocationFailed(void* p, void* caller) = 0;
+      };
+
+      /** @brief Install an observer, or remove it if observer is null.
+       *
+       *  When it replaces an observer, waits for the callbacks already
+       *  running on the old one to return, so the old observer can be
+       *  destroyed as soon as this function returns.  Do not call it
+       *  from a callback.
+       *
+       *  @returns  The previous observer
+       */
+      AllocationObserver* setAllocationObserver(AllocationObserver* observer);
+
+      /** @brief Start randomizing where allocations are placed.
+       *
+       *  While randomization is enabled, malloc(), operator new and
+       *  the aligned allocation functions add between 0 and 256 bytes
+       *  of padding to each block, and every fourth allocation also
+       *  allocates a "spacer" block of up to 4 KiB that is held in a
+       *  small table and replaces an earlier spacer, so blocks land at
+       *  different addresses, in different size classes and next to
+       *  different neighbors.  The padding and spacers are derived
+       *  from the seed and the order of the allocations, so a
+       *  single-threaded program lays out its heap the same way every
+       *  time it uses the same seed.
+       *
+       *  Calls do not nest.  Enabling randomization again restarts it
+       *  with the new seed.
+       */
+      void enableLayoutRandomization(uint64_t seed);
+
+      /** @brief Stop randomizing the heap layout.
+       *
+       *  The spacers stay allocated, so blocks allocated while
+       *  randomization was enabled keep their neighbors.  Release them
+       *  with releaseLayoutSpacers().
+       */
+      void disableLayoutRandomization();
+
+      /** @brief Returns true if layout randomization is enabled */
+      bool layoutRandomizationEnabled();
+
+      /** @brief Free the spacers allocated by layout randomization */
+      void releaseLayoutSpacers();
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,46 @@
+#include "AllocationScope.hpp"
+#include "AllocationHooks.hpp"
+
+#include <stdlib.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::hooks;
+
+AllocationScope::AllocationScope() {
+  enableGlobalAllocationCounting();
+  reset();
+}
+
+AllocationScope::~AllocationScope() {
+  disableGlobalAllocationCounting();
+}
+
+uint64_t AllocationScope::allocations() const {
+  return globalAllocationCounts().allocations - allocationsAtStart_;
+}
+
+uint64_t AllocationScope::deallocations() const {
+  return globalAllocationCounts().deallocations - deallocationsAtStart_;
+}
+
+uint64_t AllocationScope::bytesAllocated() const {
+  return globalAllocationCounts().bytesAllocated - bytesAllocatedAtStart_;
+}
+
+void AllocationScope::reset() {
+  const GlobalAllocationCounts counts = globalAllocationCounts();
+  allocationsAtStart_ = counts.allocations;
+  deallocationsAtStart_ = counts.deallocations;
+  bytesAllocatedAtStart_ = counts.bytesAllocated;
+}
+
+bool AllocationScope::hooksInstalled() {
+  // Call malloc() and free() through volatile pointers so the compiler
+  // cannot elide the allocation
+  void* (* volatile allocate)(size_t) = &::malloc;
+  void (* volatile release)(void*) = &::free;
+  AllocationScope scope;
+
+  release(allocate(1));
+  return scope.allocations() > 0;
+}
@@ -0,0 +1,74 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONSCOPE_HPP__
+#define __PISTIS__TESTING__ALLOCATIONSCOPE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file AllocationScope.hpp
+ *
+ *  Process-wide allocation counting for unit tests
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Counts the allocations made by the entire process while
+     *         it is in scope.
+     *
+     *  The pistis_testing library replaces the global operator new and
+     *  operator delete and the malloc() family of functions with
+     *  versions that forward to the C library and count calls while
+     *  at least one AllocationScope exists.  Allocations made by code
+     *  that never sees a custom allocator -- std::string,
+     *  std::function, the control block of a std::shared_ptr -- are
+     *  counted along with everything else.
+     *
+     *  Counts are process-wide:  allocations made by other threads
+     *  while the scope exists are included.  The counts are kept in
+     *  per-thread shards that are only added up when read, so counting
+     *  does not serialize allocations made by concurrent threads.
+     *  When no AllocationScope exists, the replacement functions do
+     *  not count anything and cost one extra load per call.
+     *
+     *  See AllocationAssertions.hpp for Google Test macros built on
+     *  AllocationScope.
+     */
+    class AllocationScope {
+    public:
+      AllocationScope();
+      AllocationScope(const AllocationScope&) = delete;
+      ~AllocationScope();
+
+      /** @brief Number of allocations since the scope was created */
+      uint64_t allocations() const;
+
+      /** @brief Number of deallocations since the scope was created */
+      uint64_t deallocations() const;
+
+      /** @brief Number of bytes requested by allocations since the
+       *         scope was created
+       */
+      uint64_t bytesAllocated() const;
+
+      /** @brief Restart counting from zero */
+      void reset();
+
+      AllocationScope& operator=(const AllocationScope&) = delete;
+
+      /** @brief Returns true if the replacement allocation functions
+       *         are in effect.
+       *
+       *  The replacements are not in effect when the executable or
+       *  one of the libraries loaded before pistis_testing defines
+       *  its own malloc() or operator new.
+       */
+      static bool hooksInstalled();
+
+    private:
+      uint64_t allocationsAtStart_;
+      uint64_t deallocationsAtStart_;
+      uint64_t bytesAllocatedAtStart_;
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,138 @@
+#include "AllocationStats.hpp"
+
+using namespace pistis::testing;
+
+const size_t AllocationStats::NUM_SIZE_CLASSES;
+const size_t AllocationStats::NUM_SHARDS;
+
+AllocationStats::AllocationStats(bool exactPeak):
+    shards_(), exactPeak_(exactPeak), currentBytes_(0), peakBytes_(0) {
+}
+
+template <typename Field>
+uint64_t AllocationStats::sum(Field field) const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    total += (shards_[i].*field).load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t AllocationStats::allocations() const {
+  return sum(&Shard::allocations);
+}
+
+uint64_t AllocationStats::deallocations() const {
+  return sum(&Shard::deallocations);
+}
+
+uint64_t AllocationStats::bytesAllocated() const {
+  return sum(&Shard::bytesAllocated);
+}
+
+uint64_t AllocationStats::bytesDeallocated() const {
+  return sum(&Shard::bytesDeallocated);
+}
+
+uint64_t AllocationStats::currentBytes() const {
+  if (exactPeak_) {
+    return currentBytes_.load(std::memory_order_relaxed);
+  }
+
+  // Shards go negative when their threads free memory other threads
+  // allocated, but the sum does not
+  int64_t total = 0;
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    total += shards_[i].currentBytes.load(std::memory_order_relaxed);
+  }
+  raisePeak(total);
+  return total;
+}
+
+uint64_t AllocationStats::peakBytes() const {
+  if (!exactPeak_) {
+    currentBytes();
+  }
+  return peakBytes_.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationStats::allocationsInSizeClass(size_t sizeClass) const {
+  if (sizeClass >= NUM_SIZE_CLASSES) {
+    return 0;
+  }
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    total += shards_[i].sizeHistogram[sizeClass].load(
+	std::memory_order_relaxed
+    );
+  }
+  return total;
+}
+
+std::vector<uint64_t> AllocationStats::sizeHistogram() const {
+  std::vector<uint64_t> histogram(NUM_SIZE_CLASSES, 0);
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    for (size_t j = 0; j < NUM_SIZE_CLASSES; ++j) {
+      histogram[j] +=
+	  shards_[i].sizeHistogram[j].load(std::memory_order_relaxed);
+    }
+  }
+  return histogram;
+}
+
+void AllocationStats::recordAllocation(size_t bytes) {
+  Shard& shard = shards_.local();
+  shard.allocations.fetch_add(1, std::memory_order_relaxed);
+  shard.bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+  shard.sizeHistogram[sizeClass(bytes)].fetch_add(1,
+						  std::memory_order_relaxed);
+
+  if (exactPeak_) {
+    raisePeak(
+	currentBytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes
+    );
+  } else {
+    shard.currentBytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+void AllocationStats::recordDeallocation(size_t bytes) {
+  Shard& shard = shards_.local();
+  shard.deallocations.fetch_add(1, std::memory_order_relaxed);
+  shard.bytesDeallocated.fetch_add(bytes, std::memory_order_relaxed);
+  if (exactPeak_) {
+    currentBytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  } else {
+    shard.currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+}
+
+void AllocationStats::reset() {
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    Shard& shard = shards_[i];
+    shard.allocations.store(0, std::memory_order_relaxed);
+    shard.deallocations.store(0, std::memory_order_relaxed);
+    shard.bytesAllocated.store(0, std::memory_order_relaxed);
+    shard.bytesDeallocated.store(0, std::memory_order_relaxed);
+    shard.currentBytes.store(0, std::memory_order_relaxed);
+    for (size_t j = 0; j < NUM_SIZE_CLASSES; ++j) {
+      shard.sizeHistogram[j].store(0, std::memory_order_relaxed);
+    }
+  }
+  currentBytes_.store(0, std::memory_order_relaxed);
+  peakBytes_.store(0, std::memory_order_relaxed);
+}
+
+void AllocationStats::raisePeak(int64_t current) const {
+  int64_t peak = peakBytes_.load(std::memory_order_relaxed);
+  while ((current > peak) &&
+	 !peakBytes_.compare_exchange_weak(peak, current,
+					   std::memory_order_relaxed)) {
+    // compare_exchange_weak reloaded peak -- try again
+  }
+}
+
+size_t AllocationStats::sizeClass(size_t bytes) {
+  return bytes > 1 ? (63 - __builtin_clzll(bytes)) : 0;
+}
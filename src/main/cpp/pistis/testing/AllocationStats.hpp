@@ -0,0 +1,153 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONSTATS_HPP__
+#define __PISTIS__TESTING__ALLOCATIONSTATS_HPP__
+
+#include <pistis/testing/Sharding.hpp>
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file AllocationStats.hpp
+ *
+ *  Allocation counters shared by instances of pistis::testing::Allocator
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Records the allocations made through one or more allocators.
+     *
+     *  An AllocationStats instance is shared between an Allocator, all
+     *  of its copies and all of its rebinds, so every allocation a
+     *  container makes -- for its element buffer, its nodes or its
+     *  bookkeeping structures -- is recorded in the same place.
+     *
+     *  Allocation sizes are also recorded in a histogram with one
+     *  bucket per power of two.  Bucket i counts allocations whose
+     *  size in bytes lies in [2^i, 2^(i+1)), except for bucket 0, which
+     *  also counts zero-byte allocations.
+     *
+     *  The counters are sharded per thread:  each thread updates its
+     *  own cache-line-padded slot, and the accessors add up the slots
+     *  when they are called.  The price is that reading the statistics
+     *  costs time proportional to NUM_SHARDS, and values read while
+     *  other threads are allocating may not be a consistent snapshot.
+     *
+     *  The current byte count is sharded too, so the peak cannot be
+     *  tracked on every allocation without a shared counter.  By
+     *  default, peakBytes() is the largest current byte count seen by
+     *  a call to currentBytes() or peakBytes(), which is a lower bound
+     *  on the true peak.  Pass exactPeak = true to the constructor to
+     *  track the exact peak instead, at the cost of updating a cache
+     *  line shared by all threads on every allocation and
+     *  deallocation.
+     */
+    class AllocationStats {
+    public:
+      /** @brief Number of buckets in the allocation size histogram */
+      static const size_t NUM_SIZE_CLASSES = 64;
+
+      /** @brief Number of per-thread slots */
+      static const size_t NUM_SHARDS = 64;
+
+    public:
+      /** @brief Create statistics with all counters set to zero
+       *
+       *  @param exactPeak  Whether to track the exact peak byte count,
+       *                    which all threads update on every
+       *                    allocation, rather than sampling it when
+       *                    the statistics are read
+       */
+      explicit AllocationStats(bool exactPeak = false);
+      AllocationStats(const AllocationStats&) = delete;
+
+      /** @brief Whether peakBytes() is exact */
+      bool exactPeak() const { return exactPeak_; }
+
+      /** @brief Number of calls to allocate() */
+      uint64_t allocations() const;
+
+      /** @brief Number of calls to deallocate() */
+      uint64_t deallocations() const;
+
+      /** @brief Total number of bytes requested by calls to allocate() */
+      uint64_t bytesAllocated() const;
+
+      /** @brief Total number of bytes released by calls to deallocate() */
+      uint64_t bytesDeallocated() const;
+
+      /** @brief Number of bytes allocated but not yet deallocated */
+      uint64_t currentBytes() const;
+
+      /** @brief Largest value currentBytes() has reached since the
+       *         statistics were created or last reset
+       *
+       *  Exact if the statistics were created with exactPeak = true.
+       *  Otherwise, the largest value currentBytes() was seen to have
+       *  when currentBytes() or peakBytes() was called.
+       */
+      uint64_t peakBytes() const;
+
+      /** @brief Number of allocations in the given size class */
+      uint64_t allocationsInSizeClass(size_t sizeClass) const;
+
+      /** @brief Returns the allocation size histogram.
+       *
+       *  The returned vector has NUM_SIZE_CLASSES entries.  Entry i
+       *  is the number of allocations in size class i.
+       */
+      std::vector<uint64_t> sizeHistogram() const;
+
+      /** @brief Record a call to allocate() for the given number of bytes */
+      void recordAllocation(size_t bytes);
+
+      /** @brief Record a call to deallocate() for the given number of
+       *         bytes
+       */
+      void recordDeallocation(size_t bytes);
+
+      /** @brief Set all counters to zero.
+       *
+       *  Call reset() just before the code under test to count only
+       *  the allocations that code performs.  Do not call reset()
+       *  while other threads are allocating.  The current byte count
+       *  is zeroed as well, so memory allocated before the reset and
+       *  released afterwards can make currentBytes() wrap around.
+       */
+      void reset();
+
+      AllocationStats& operator=(const AllocationStats&) = delete;
+
+      /** @brief Returns the size class for an allocation of the given
+       *         size.
+       */
+      static size_t sizeClass(size_t bytes);
+
+    private:
+      struct Shard {
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> deallocations;
+	std::atomic<uint64_t> bytesAllocated;
+	std::atomic<uint64_t> bytesDeallocated;
+	std::atomic<int64_t> currentBytes;
+	std::atomic<uint64_t> sizeHistogram[NUM_SIZE_CLASSES];
+      };
+
+      ShardedSlots<Shard, NUM_SHARDS> shards_;
+      const bool exactPeak_;
+
+      // Only used when exactPeak_ is true
+      std::atomic<int64_t> currentBytes_;
+
+      // Raised on every allocation when exactPeak_ is true, and when
+      // the current byte count is read otherwise
+      mutable std::atomic<int64_t> peakBytes_;
+
+      void raisePeak(int64_t current) const;
+
+      template <typename Field>
+      uint64_t sum(Field field) const;
+    };
+
+  }
+}
+#endif
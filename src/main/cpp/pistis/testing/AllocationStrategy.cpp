@@ -0,0 +1,201 @@
+#include "AllocationStrategy.hpp"
+#include "Generators.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static bool isPowerOfTwo(size_t n) {
+    return n && !(n & (n - 1));
+  }
+
+  static size_t roundUp(size_t n, size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+  }
+
+  static void* alignedAllocate(size_t bytes, size_t alignment) {
+    void* p = nullptr;
+    if (posix_memalign(&p, std::max(alignment, sizeof(void*)),
+		       std::max(bytes, size_t(1)))) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+}
+
+const size_t AlignedAllocation::CACHE_LINE;
+const size_t AlignedAllocation::PAGE;
+const size_t HugePageAllocation::HUGE_PAGE;
+
+void* SystemAllocation::allocate(size_t bytes, size_t alignment) {
+  if (alignment > alignof(max_align_t)) {
+    return alignedAllocate(bytes, alignment);
+  }
+
+  void* p = malloc(std::max(bytes, size_t(1)));
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void SystemAllocation::deallocate(void* p, size_t, size_t) {
+  free(p);
+}
+
+ArenaAllocation::ArenaAllocation(const std::shared_ptr<Arena>& arena):
+    arena_(arena) {
+}
+
+void* ArenaAllocation::allocate(size_t bytes, size_t alignment) {
+  return arena_->allocate(bytes, alignment);
+}
+
+void ArenaAllocation::deallocate(void* p, size_t bytes, size_t) {
+  arena_->deallocate(p, bytes);
+}
+
+AlignedAllocation::AlignedAllocation(size_t boundary): boundary_(boundary) {
+  if (!isPowerOfTwo(boundary)) {
+    throw std::invalid_argument("Alignment boundary must be a power of two");
+  }
+}
+
+void* AlignedAllocation::allocate(size_t bytes, size_t alignment) {
+  return alignedAllocate(bytes, std::max(boundary_, alignment));
+}
+
+void AlignedAllocation::deallocate(void* p, size_t, size_t) {
+  free(p);
+}
+
+MisalignedAllocation::MisalignedAllocation(size_t boundary):
+    boundary_(boundary) {
+  if (!isPowerOfTwo(boundary)) {
+    throw std::invalid_argument("Alignment boundary must be a power of two");
+  }
+}
+
+void* MisalignedAllocation::allocate(size_t bytes, size_t alignment) {
+  // Allocate on a boundary, then step alignment bytes past it
+  const size_t boundary = std::max(boundary_, 2 * alignment);
+  if (bytes > (SIZE_MAX - alignment)) {
+    throw std::bad_alloc();
+  }
+  char* p = static_cast<char*>(alignedAllocate(bytes + alignment, boundary));
+  return p + alignment;
+}
+
+void MisalignedAllocation::deallocate(void* p, size_t, size_t alignment) {
+  free(static_cast<char*>(p) - alignment);
+}
+
+HugePageAllocation::HugePageAllocation() {
+}
+
+void* HugePageAllocation::allocate(size_t bytes, size_t alignment) {
+  // Rounding up and mapping an extra huge page must not wrap
+  if ((alignment > HUGE_PAGE) || (bytes > (SIZE_MAX - 2 * HUGE_PAGE))) {
+    throw std::bad_alloc();
+  }
+  const size_t size = roundUp(std::max(bytes, size_t(1)), HUGE_PAGE);
+
+  // Map an extra huge page, then trim the ends so the mapping starts
+  // on a huge page boundary
+  const size_t mapped = size + HUGE_PAGE;
+  void* m = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  char* const start = static_cast<char*>(m);
+  char* const aligned = reinterpret_cast<char*>(
+      roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE)
+  );
+  if (aligned > start) {
+    munmap(start, aligned - start);
+  }
+  if ((start + mapped) > (aligned + size)) {
+    munmap(aligned + size, (start + mapped) - (aligned + size));
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+void HugePageAllocation::deallocate(void* p, size_t bytes, size_t) {
+  munmap(p, roundUp(std::max(bytes, size_t(1)), HUGE_PAGE));
+}
+
+bool HugePageAllocation::available() {
+  std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string setting;
+
+  // The current setting is in brackets, e.g. "always [madvise] never"
+  std::getline(in, setting);
+  return (setting.find("[always]") != std::string::npos) ||
+	 (setting.find("[madvise]") != std::string::npos);
+}
+
+size_t HugePageAllocation::hugePageBytes(const void* p) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(p);
+  std::ifstream in("/proc/self/smaps");
+  std::string line;
+  bool inMapping = false;
+
+  while (std::getline(in, line)) {
+    // Mappings start with "<start>-<end> <permissions> ..."
+    char* end = nullptr;
+    const uintptr_t low = strtoull(line.c_str(), &end, 16);
+    if (end && (*end == '-') && (end != line.c_str())) {
+      const uintptr_t high = strtoull(end + 1, nullptr, 16);
+      inMapping = (low <= address) && (address < high);
+    } else if (inMapping && !line.compare(0, 14, "AnonHugePages:")) {
+      return strtoull(line.c_str() + 14, nullptr, 10) * 1024;
+    }
+  }
+  return 0;
+}
+
+RandomizedAllocation::RandomizedAllocation(uint64_t seed, size_t maxPadding):
+    seed_(seed), maxPadding_(maxPadding), counter_(0) {
+}
+
+void* RandomizedAllocation::allocate(size_t bytes, size_t alignment) {
+  // The block is preceded by a header big enough to hold the address
+  // of the underlying allocation, followed by the random padding
+  const size_t align = std::max(alignment, sizeof(void*));
+  const size_t header = roundUp(sizeof(void*), align);
+  const uint64_t r = generators::randomBits(
+      seed_, counter_.fetch_add(1, std::memory_order_relaxed)
+  );
+  const size_t padding = (r % (maxPadding_ / align + 1)) * align;
+  if (bytes > (SIZE_MAX - header - padding)) {
+    throw std::bad_alloc();
+  }
+
+  char* base = static_cast<char*>(
+      alignedAllocate(header + padding + bytes, align)
+  );
+  char* p = base + header + padding;
+  memcpy(p - sizeof(void*), &base, sizeof(void*));
+  return p;
+}
+
+void RandomizedAllocation::deallocate(void* p, size_t, size_t) {
+  void* base;
+  memcpy(&base, static_cast<char*>(p) - sizeof(void*), sizeof(void*));
+  free(base);
+}
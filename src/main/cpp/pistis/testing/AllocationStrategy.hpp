@@ -0,0 +1,216 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONSTRATEGY_HPP__
+#define __PISTIS__TESTING__ALLOCATIONSTRATEGY_HPP__
+
+#include <pistis/testing/Arena.hpp>
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file AllocationStrategy.hpp
+ *
+ *  Strategies that control where pistis::testing::Allocator places
+ *  memory, so tests and benchmarks can see how code behaves under
+ *  different alignments and TLB conditions
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Obtains and releases memory for an Allocator.
+     *
+     *  An Allocator with a strategy passes every allocation and
+     *  deallocation to it, with the size in bytes and the alignment
+     *  of the element type.  Copies and rebinds of the allocator share
+     *  the strategy.  Implementations must be thread-safe unless they
+     *  say otherwise, as ArenaAllocation does; allocators with such a
+     *  strategy must be used by one thread at a time.
+     *
+     *  Memory must be released through the strategy that allocated
+     *  it, so allocators with different strategies must not free each
+     *  other's memory.
+     */
+    class AllocationStrategy {
+    public:
+      virtual ~AllocationStrategy() { }
+
+      /** @brief Allocate bytes aligned to at least alignment.
+       *
+       *  @throws std::bad_alloc if the memory cannot be allocated
+       */
+      virtual void* allocate(size_t bytes, size_t alignment) = 0;
+
+      /** @brief Release memory returned by allocate() with the same
+       *         size and alignment
+       */
+      virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+    };
+
+    /** @brief Allocates from the system's malloc(), or from
+     *         posix_memalign() if the element type needs more
+     *         alignment than malloc() provides
+     */
+    class SystemAllocation : public AllocationStrategy {
+    public:
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+    };
+
+    /** @brief Allocates from an Arena.
+     *
+     *  Like Arena itself, this strategy is not thread-safe, so the
+     *  allocators that share it must be used by one thread at a time.
+     *  The arena is shared with whoever else holds it, and its memory
+     *  is reclaimed when it is released.
+     */
+    class ArenaAllocation : public AllocationStrategy {
+    public:
+      explicit ArenaAllocation(
+	  const std::shared_ptr<Arena>& arena = std::make_shared<Arena>()
+      );
+
+      /** @brief The arena memory comes from */
+      const std::shared_ptr<Arena>& arena() const { return arena_; }
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+    private:
+      std::shared_ptr<Arena> arena_;
+    };
+
+    /** @brief Aligns every allocation to a fixed boundary, e.g. a
+     *         64-byte cache line or a 4 KiB page.
+     *
+     *  Allocations whose element type needs stricter alignment than
+     *  the boundary are aligned to the element type instead.
+     */
+    class AlignedAllocation : public AllocationStrategy {
+    public:
+      /** @brief Size of a cache line on most processors */
+      static const size_t CACHE_LINE = 64;
+
+      /** @brief Size of a small page on most processors */
+      static const size_t PAGE = 4096;
+
+    public:
+      /** @throws std::invalid_argument if the boundary is not a power
+       *          of two
+       */
+      explicit AlignedAllocation(size_t boundary = CACHE_LINE);
+
+      /** @brief Boundary allocations are aligned to */
+      size_t boundary() const { return boundary_; }
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+    private:
+      size_t boundary_;
+    };
+
+    /** @brief Aligns allocations to the element type, but deliberately
+     *         not to anything larger.
+     *
+     *  The address of every allocation is alignof(T) bytes past a
+     *  multiple of the boundary (or of 2 * alignof(T), if that is
+     *  larger), so it is aligned to alignof(T) and to nothing more.
+     *  Code that assumes malloc's 16-byte alignment, or uses aligned
+     *  SIMD loads on unaligned data, then fails or slows down in tests
+     *  instead of in production.
+     */
+    class MisalignedAllocation : public AllocationStrategy {
+    public:
+      /** @throws std::invalid_argument if the boundary is not a power
+       *          of two
+       */
+      explicit MisalignedAllocation(
+	  size_t boundary = AlignedAllocation::CACHE_LINE
+      );
+
+      /** @brief Boundary allocations are misaligned relative to */
+      size_t boundary() const { return boundary_; }
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+    private:
+      size_t boundary_;
+    };
+
+    /** @brief Backs every allocation with 2 MiB transparent huge pages.
+     *
+     *  Each allocation gets its own anonymous mapping, rounded up to a
+     *  multiple of 2 MiB and aligned to 2 MiB, and the kernel is
+     *  advised with MADV_HUGEPAGE to back it with huge pages.  Whether
+     *  it does depends on the system's transparent huge page setting
+     *  and on available memory; see hugePageBytes().  Even small
+     *  allocations use 2 MiB of address space, so use this strategy
+     *  for large buffers rather than node-based containers.
+     */
+    class HugePageAllocation : public AllocationStrategy {
+    public:
+      /** @brief Size of a huge page */
+      static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+    public:
+      HugePageAllocation();
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+      /** @brief Returns true if the system may back memory advised with
+       *         MADV_HUGEPAGE with transparent huge pages
+       */
+      static bool available();
+
+      /** @brief Number of bytes of the mapping that contains p which
+       *         are currently backed by huge pages, according to
+       *         /proc/self/smaps.
+       *
+       *  The kernel may merge adjacent mappings, so the count can
+       *  include other allocations next to p.  Returns zero if no
+       *  mapping contains p.
+       */
+      static size_t hugePageBytes(const void* p);
+    };
+
+    /** @brief Places every allocation at a pseudo-random offset.
+     *
+     *  Each block is preceded by a random amount of padding, up to
+     *  maxPadding bytes in steps of the element type's alignment, so
+     *  the blocks land at different addresses, cache sets and malloc
+     *  size classes than they would otherwise.  The offsets are
+     *  derived from the seed and the order of the allocations, so a
+     *  single-threaded test gets the same offsets every time it uses
+     *  the same seed.  Running a benchmark under several seeds shows
+     *  how much of its time depends on where its data happens to
+     *  land; see bench::runAcrossLayouts() in Benchmark.hpp.
+     */
+    class RandomizedAllocation : public AllocationStrategy {
+    public:
+      explicit RandomizedAllocation(uint64_t seed, size_t maxPadding = 4096);
+
+      /** @brief Seed the offsets are derived from */
+      uint64_t seed() const { return seed_; }
+
+      /** @brief Largest amount of padding before a block */
+      size_t maxPadding() const { return maxPadding_; }
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+    private:
+      uint64_t seed_;
+      size_t maxPadding_;
+      std::atomic<uint64_t> counter_;
+    };
+
+  }
+}
+#endif
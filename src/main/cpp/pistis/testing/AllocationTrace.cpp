@@ -0,0 +1,436 @@
+#include "AllocationTrace.hpp"
+#include "ResourceUsage.hpp"
+#include "Resources.hpp"
+#include "Sharding.hpp"
+#include "Timing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static const char MAGIC[8] = { 'P', 'T', 'A', 'L', 'L', 'O', 'C', 'S' };
+  static const uint32_t VERSION = 1;
+  static const size_t HEADER_SIZE = 16;
+  static const size_t RECORD_SIZE = 32;
+  static const size_t BUFFER_SIZE = 2048 * RECORD_SIZE;
+  static const size_t PAGE_SIZE = 4096;
+
+  // The block whose release the calling thread recorded last, so a
+  // failed release can restore it
+  struct ReleasedBlock {
+    const AllocationTraceWriter* writer;
+    const void* p;
+    uint64_t size;
+    uint32_t alignment;
+  };
+
+  static __thread ReleasedBlock lastReleased
+      __attribute__((tls_model("initial-exec"))) = { };
+
+  static void putLittleEndian(char* p, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+      p[i] = char(value >> (8 * i));
+    }
+  }
+
+  static uint64_t getLittleEndian(const char* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      value |= uint64_t((unsigned char)p[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  static uint8_t log2Alignment(size_t alignment) {
+    uint8_t n = 0;
+    while ((size_t(2) << n) <= alignment) {
+      ++n;
+    }
+    return n;
+  }
+
+  static bool writeFully(int fd, const char* data, size_t size) {
+    while (size) {
+      const ssize_t n = ::write(fd, data, size);
+      if (n < 0) {
+	if (errno == EINTR) {
+	  continue;
+	}
+	return false;
+      }
+      data += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  static size_t readFully(int fd, char* data, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+      const ssize_t n = ::read(fd, data + total, size - total);
+      if (n < 0) {
+	if (errno == EINTR) {
+	  continue;
+	}
+	break;
+      } else if (!n) {
+	break;
+      }
+      total += n;
+    }
+    return total;
+  }
+
+  static std::string traceFilename(const std::string& name) {
+    std::string filename(name);
+    for (char& c : filename) {
+      if (!isalnum((unsigned char)c) && !strchr(".-_", c)) {
+	c = '_';
+      }
+    }
+    return filename + ".trace";
+  }
+
+  // Replays the events once.  Returns the time spent in the strategy.
+  static uint64_t replay(const std::vector<AllocationEvent>& events,
+			 AllocationStrategy& strategy,
+			 std::vector<void*>& blocks, bool touch,
+			 uint64_t& peakLiveBytes) {
+    uint64_t liveBytes = 0;
+    uint64_t time = 0;
+    uint64_t start = monotonicNanoseconds();
+
+    for (const AllocationEvent& e : events) {
+      if (e.type == AllocationEventType::ALLOCATE) {
+	void*& p = blocks[e.block];
+	p = strategy.allocate(e.size, e.alignment);
+	if (touch) {
+	  // Touching the pages is not part of the time measured
+	  time += monotonicNanoseconds() - start;
+	  for (size_t i = 0; i < e.size; i += PAGE_SIZE) {
+	    static_cast<volatile char*>(p)[i] = 1;
+	  }
+	  liveBytes += e.size;
+	  peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+	  start = monotonicNanoseconds();
+	}
+      } else if ((e.type == AllocationEventType::DEALLOCATE) &&
+		 (e.block < blocks.size()) && blocks[e.block]) {
+	strategy.deallocate(blocks[e.block], e.size, e.alignment);
+	blocks[e.block] = nullptr;
+	liveBytes -= touch ? e.size : 0;
+      }
+    }
+    time += monotonicNanoseconds() - start;
+
+    // Release the blocks still allocated at the end of the trace
+    for (const AllocationEvent& e : events) {
+      if ((e.type == AllocationEventType::ALLOCATE) && blocks[e.block]) {
+	strategy.deallocate(blocks[e.block], e.size, e.alignment);
+	blocks[e.block] = nullptr;
+      }
+    }
+    return time;
+  }
+}
+
+AllocationTraceWriter::AllocationTraceWriter(const std::string& filename):
+    filename_(filename), fd_(-1), start_(monotonicNanoseconds()),
+    nextBlock_(0), numEvents_(0), ok_(true), buffer_(BUFFER_SIZE),
+    used_(0), blocks_(), callSites_(), mutex_() {
+  fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+	       0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot create allocation trace " + filename +
+			     ": " + strerror(errno));
+  }
+
+  char header[HEADER_SIZE];
+  memcpy(header, MAGIC, sizeof(MAGIC));
+  putLittleEndian(header + 8, VERSION, 4);
+  putLittleEndian(header + 12, RECORD_SIZE, 4);
+  ok_ = writeFully(fd_, header, sizeof(header));
+}
+
+AllocationTraceWriter::~AllocationTraceWriter() {
+  flush();
+  ::close(fd_);
+}
+
+uint64_t AllocationTraceWriter::numEvents() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return numEvents_;
+}
+
+void AllocationTraceWriter::recordAllocation(const void* p, size_t bytes,
+					     size_t alignment,
+					     const void* caller) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AllocationEvent event;
+  event.type = AllocationEventType::ALLOCATE;
+  event.timestamp = monotonicNanoseconds() - start_;
+  event.block = nextBlock_++;
+  event.size = bytes;
+  event.alignment = uint32_t(alignment);
+  event.callSite = callSiteId(caller, event.timestamp);
+  event.thread = uint16_t(currentThreadShard());
+
+  Block& block = blocks_[p];
+  block.id = event.block;
+  block.size = bytes;
+  block.alignment = event.alignment;
+  append(event);
+}
+
+void AllocationTraceWriter::recordDeallocation(const void* p,
+					       const void* caller) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto i = blocks_.find(p);
+  if (i == blocks_.end()) {
+    return;
+  }
+
+  AllocationEvent event;
+  event.type = AllocationEventType::DEALLOCATE;
+  event.timestamp = monotonicNanoseconds() - start_;
+  event.block = i->second.id;
+  event.size = i->second.size;
+  event.alignment = i->second.alignment;
+  event.callSite = callSiteId(caller, event.timestamp);
+  event.thread = uint16_t(currentThreadShard());
+  blocks_.erase(i);
+  append(event);
+  lastReleased = ReleasedBlock{ this, p, event.size, event.alignment };
+}
+
+void AllocationTraceWriter::recordFailedDeallocation(const void* p,
+						     const void* caller) {
+  const ReleasedBlock released = lastReleased;
+  lastReleased = ReleasedBlock{ };
+  if ((released.writer == this) && (released.p == p)) {
+    recordAllocation(p, released.size, released.alignment, caller);
+  }
+}
+
+bool AllocationTraceWriter::flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return flushBuffer();
+}
+
+uint32_t AllocationTraceWriter::callSiteId(const void* caller,
+					   uint64_t timestamp) {
+  auto i = callSites_.find(caller);
+  if (i != callSites_.end()) {
+    return i->second;
+  }
+
+  const uint32_t id = uint32_t(callSites_.size());
+  AllocationEvent event;
+  event.type = AllocationEventType::CALL_SITE;
+  event.timestamp = timestamp;
+  event.block = 0;
+  event.size = reinterpret_cast<uintptr_t>(caller);
+  event.alignment = 0;
+  event.callSite = id;
+  event.thread = uint16_t(currentThreadShard());
+  callSites_[caller] = id;
+  append(event);
+  return id;
+}
+
+void AllocationTraceWriter::append(const AllocationEvent& event) {
+  if ((used_ + RECORD_SIZE) > buffer_.size()) {
+    flushBuffer();
+  }
+
+  char* record = buffer_.data() + used_;
+  putLittleEndian(record, event.timestamp, 8);
+  putLittleEndian(record + 8, event.block, 8);
+  putLittleEndian(record + 16, event.size, 8);
+  putLittleEndian(record + 24, event.callSite, 4);
+  putLittleEndian(record + 28, event.thread, 2);
+  record[30] = char(event.type);
+  record[31] = char(log2Alignment(event.alignment));
+  used_ += RECORD_SIZE;
+  ++numEvents_;
+}
+
+bool AllocationTraceWriter::flushBuffer() {
+  if (used_) {
+    ok_ = writeFully(fd_, buffer_.data(), used_) && ok_;
+    used_ = 0;
+  }
+  return ok_;
+}
+
+TracingAllocation::TracingAllocation(
+    const std::shared_ptr<AllocationTraceWriter>& writer,
+    const std::shared_ptr<AllocationStrategy>& strategy
+):
+    writer_(writer), strategy_(strategy) {
+}
+
+void* TracingAllocation::allocate(size_t bytes, size_t alignment) {
+  void* p = strategy_->allocate(bytes, alignment);
+  writer_->recordAllocation(p, bytes, alignment,
+			    __builtin_return_address(0));
+  return p;
+}
+
+void TracingAllocation::deallocate(void* p, size_t bytes, size_t alignment) {
+  writer_->recordDeallocation(p, __builtin_return_address(0));
+  strategy_->deallocate(p, bytes, alignment);
+}
+
+GlobalAllocationTrace::GlobalAllocationTrace(const std::string& filename):
+    writer_(filename), tracing_(true) {
+  hooks::AllocationObserver* previous = hooks::setAllocationObserver(this);
+  if (previous) {
+    hooks::setAllocationObserver(previous);
+    throw std::runtime_error("Another allocation observer is installed");
+  }
+}
+
+GlobalAllocationTrace::~GlobalAllocationTrace() {
+  stop();
+}
+
+bool GlobalAllocationTrace::stop() {
+  if (tracing_) {
+    hooks::setAllocationObserver(nullptr);
+    tracing_ = false;
+  }
+  return writer_.flush();
+}
+
+void GlobalAllocationTrace::allocated(void* p, size_t bytes,
+				      size_t alignment, void* caller) {
+  writer_.recordAllocation(p, bytes, alignment, caller);
+}
+
+void GlobalAllocationTrace::deallocating(void* p, void* caller) {
+  writer_.recordDeallocation(p, caller);
+}
+
+void GlobalAllocationTrace::reallocationFailed(void* p, void* caller) {
+  writer_.recordFailedDeallocation(p, caller);
+}
+
+namespace pistis {
+  namespace testing {
+
+    bool readAllocationTrace(const std::string& filename,
+			     std::vector<AllocationEvent>& events) {
+      const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+	return false;
+      }
+
+      char header[HEADER_SIZE];
+      if ((readFully(fd, header, sizeof(header)) != sizeof(header)) ||
+	  memcmp(header, MAGIC, sizeof(MAGIC)) ||
+	  (getLittleEndian(header + 8, 4) != VERSION) ||
+	  (getLittleEndian(header + 12, 4) != RECORD_SIZE)) {
+	::close(fd);
+	return false;
+      }
+
+      std::vector<char> buffer(BUFFER_SIZE);
+      size_t n;
+      bool ok = true;
+      while ((n = readFully(fd, buffer.data(), buffer.size())) > 0) {
+	if (n % RECORD_SIZE) {
+	  ok = false;
+	  n -= n % RECORD_SIZE;
+	}
+	for (size_t i = 0; i < n; i += RECORD_SIZE) {
+	  const char* record = buffer.data() + i;
+	  const unsigned char alignmentBits = (unsigned char)record[31];
+	  AllocationEvent event;
+	  event.timestamp = getLittleEndian(record, 8);
+	  event.block = getLittleEndian(record + 8, 8);
+	  event.size = getLittleEndian(record + 16, 8);
+	  event.callSite = uint32_t(getLittleEndian(record + 24, 4));
+	  event.thread = uint16_t(getLittleEndian(record + 28, 2));
+	  event.type = AllocationEventType(record[30]);
+	  if (event.type == AllocationEventType::CALL_SITE) {
+	    event.alignment = 0;
+	  } else if (alignmentBits < 32) {
+	    event.alignment = uint32_t(1) << alignmentBits;
+	  } else {
+	    // Corrupt record; the alignment would not fit
+	    ok = false;
+	    break;
+	  }
+	  events.push_back(event);
+	}
+	if (!ok) {
+	  break;
+	}
+      }
+      ::close(fd);
+      return ok;
+    }
+
+    std::string getAllocationTraceDir() {
+      return getScratchFile("allocation_traces");
+    }
+
+    std::string allocationTracePath(const std::string& name) {
+      const std::string dir = getAllocationTraceDir();
+      if (!makeDirectories(dir)) {
+	return std::string();
+      }
+      return dir + "/" + traceFilename(name);
+    }
+
+    AllocationReplayResult replayAllocationTrace(
+	const std::vector<AllocationEvent>& events,
+	const std::function<std::shared_ptr<AllocationStrategy> ()>&
+	    makeStrategy
+    ) {
+      AllocationReplayResult result = { 0, 0, 0, 0, 0 };
+      uint64_t numBlocks = 0;
+      for (const AllocationEvent& e : events) {
+	if (e.type == AllocationEventType::ALLOCATE) {
+	  ++result.allocations;
+	  numBlocks = std::max(numBlocks, e.block + 1);
+	} else if (e.type == AllocationEventType::DEALLOCATE) {
+	  ++result.deallocations;
+	}
+      }
+
+      // Measure the footprint first and return the heap's free pages
+      // to the system beforehand, so the footprint pass does not reuse
+      // pages without counting them.  The block table is allocated and
+      // touched before the measurement starts.
+      std::vector<void*> blocks(numBlocks, nullptr);
+      malloc_trim(0);
+      resetPeakRss();
+      const ResourceUsage start = ResourceUsage::current();
+      {
+	std::shared_ptr<AllocationStrategy> strategy = makeStrategy();
+	replay(events, *strategy, blocks, true, result.peakLiveBytes);
+      }
+      result.peakFootprint =
+	  ResourceUsage::difference(start, ResourceUsage::current()).peakRss;
+
+      uint64_t unused = 0;
+      {
+	std::shared_ptr<AllocationStrategy> strategy = makeStrategy();
+	result.time = replay(events, *strategy, blocks, false, unused);
+      }
+      return result;
+    }
+
+  }
+}
@@ -0,0 +1,337 @@
+#ifndef __PISTIS__TESTING__ALLOCATIONTRACE_HPP__
+#define __PISTIS__TESTING__ALLOCATIONTRACE_HPP__
+
+#include <pistis/testing/AllocationHooks.hpp>
+#include <pistis/testing/AllocationStrategy.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file AllocationTrace.hpp
+ *
+ *  Record every allocation and deallocation a workload makes in a
+ *  compact binary trace, and replay the trace against other allocation
+ *  strategies.
+ *
+ *  Trace the allocations of individual containers with an Allocator
+ *  that uses a TracingAllocation strategy, or every allocation the
+ *  process makes with a GlobalAllocationTrace, e.g.
+ *
+ *  @code
+ *  {
+ *    GlobalAllocationTrace trace(allocationTracePath("MapTests.Insert"));
+ *    runWorkload();
+ *  }
+ *  @endcode
+ *
+ *  The replay_allocation_trace tool (see src/tools/cpp) replays traces
+ *  against the system allocator, an arena or an allocator loaded from
+ *  a shared library, and reports throughput and fragmentation.
+ *
+ *  A trace file is a 16-byte header (the magic number "PTALLOCS," a
+ *  32-bit version and a 32-bit record size) followed by one 32-byte
+ *  little-endian record per event.
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Kinds of events in an allocation trace */
+    enum class AllocationEventType : uint8_t {
+      /** @brief A block was allocated */
+      ALLOCATE = 0,
+
+      /** @brief A block was released */
+      DEALLOCATE = 1,
+
+      /** @brief Assigns an id to a call site.  Written before the
+       *         first event from that call site.
+       */
+      CALL_SITE = 2
+    };
+
+    /** @brief One event in an allocation trace */
+    struct AllocationEvent {
+      /** @brief What happened */
+      AllocationEventType type;
+
+      /** @brief Nanoseconds since the trace started */
+      uint64_t timestamp;
+
+      /** @brief Identifies the block.  Blocks are numbered
+       *         consecutively from zero in the order they were
+       *         allocated, so a DEALLOCATE event carries the number of
+       *         the ALLOCATE event it matches.  Zero for CALL_SITE
+       *         events.
+       */
+      uint64_t block;
+
+      /** @brief Size of the block in bytes, or the address of the call
+       *         site for CALL_SITE events
+       */
+      uint64_t size;
+
+      /** @brief Alignment of the block */
+      uint32_t alignment;
+
+      /** @brief Id of the call site that allocated or released the
+       *         block
+       */
+      uint32_t callSite;
+
+      /** @brief Number of the thread that allocated or released the
+       *         block, in the order threads first allocated memory
+       */
+      uint16_t thread;
+    };
+
+    /** @brief Writes an allocation trace.
+     *
+     *  The writer numbers blocks as they are allocated and looks up
+     *  their number, size and alignment when they are released.
+     *  Releases of blocks it did not see allocated are ignored, so a
+     *  trace can start in the middle of a program.  Call sites are
+     *  identified by their return addresses, which are numbered in the
+     *  order they are first seen.
+     *
+     *  AllocationTraceWriter is thread-safe.  Events are buffered and
+     *  written to the file when the buffer fills, when flush() is
+     *  called and when the writer is destroyed.
+     */
+    class AllocationTraceWriter {
+    public:
+      /** @brief Create a new trace file, replacing any existing file
+       *
+       *  @throws std::runtime_error if the file cannot be created
+       */
+      explicit AllocationTraceWriter(const std::string& filename);
+      AllocationTraceWriter(const AllocationTraceWriter&) = delete;
+      ~AllocationTraceWriter();
+
+      /** @brief Name of the trace file */
+      const std::string& filename() const { return filename_; }
+
+      /** @brief Number of events recorded so far, including CALL_SITE
+       *         events
+       */
+      uint64_t numEvents() const;
+
+      /** @brief Record that p was allocated */
+      void recordAllocation(const void* p, size_t bytes, size_t alignment,
+			    const void* caller);
+
+      /** @brief Record that p is about to be released */
+      void recordDeallocation(const void* p, const void* caller);
+
+      /** @brief Record that p is still allocated after all, because
+       *         the call that was to release it failed.
+       *
+       *  Records a new allocation of p with the size and alignment the
+       *  block had when its release was recorded.  Call it on the
+       *  thread that recorded the release, before that thread records
+       *  anything else.
+       */
+      void recordFailedDeallocation(const void* p, const void* caller);
+
+      /** @brief Write the buffered events to the file
+       *
+       *  @returns  True if every event recorded so far was written
+       */
+      bool flush();
+
+      AllocationTraceWriter& operator=(const AllocationTraceWriter&) = delete;
+
+    private:
+      struct Block {
+	uint64_t id;
+	uint64_t size;
+	uint32_t alignment;
+      };
+
+      std::string filename_;
+      int fd_;
+      uint64_t start_;
+      uint64_t nextBlock_;
+      uint64_t numEvents_;
+      bool ok_;
+      std::vector<char> buffer_;
+      size_t used_;
+      std::unordered_map<const void*, Block> blocks_;
+      std::unordered_map<const void*, uint32_t> callSites_;
+      mutable std::mutex mutex_;
+
+      uint32_t callSiteId(const void* caller, uint64_t timestamp);
+      void append(const AllocationEvent& event);
+      bool flushBuffer();
+    };
+
+    /** @brief Records every allocation made through it to a trace,
+     *         then passes it on to another strategy.
+     *
+     *  Use with Allocator to trace the allocations of individual
+     *  containers.  Copies and rebinds of the allocator share the
+     *  trace.
+     */
+    class TracingAllocation : public AllocationStrategy {
+    public:
+      TracingAllocation(
+	  const std::shared_ptr<AllocationTraceWriter>& writer,
+	  const std::shared_ptr<AllocationStrategy>& strategy =
+	      std::make_shared<SystemAllocation>()
+      );
+
+      /** @brief The trace allocations are written to */
+      const std::shared_ptr<AllocationTraceWriter>& writer() const {
+	return writer_;
+      }
+
+      /** @brief The strategy that actually allocates memory */
+      const std::shared_ptr<AllocationStrategy>& strategy() const {
+	return strategy_;
+      }
+
+      virtual void* allocate(size_t bytes, size_t alignment) override;
+      virtual void deallocate(void* p, size_t bytes,
+			      size_t alignment) override;
+
+    private:
+      std::shared_ptr<AllocationTraceWriter> writer_;
+      std::shared_ptr<AllocationStrategy> strategy_;
+    };
+
+    /** @brief Traces every allocation the process makes through the
+     *         allocation functions this library replaces, from
+     *         construction until stop() or destruction.
+     *
+     *  Only one GlobalAllocationTrace, or other
+     *  hooks::AllocationObserver, can be installed at a time.  Other
+     *  threads may keep allocating memory while the trace is stopped
+     *  or destroyed.
+     */
+    class GlobalAllocationTrace : private hooks::AllocationObserver {
+    public:
+      /** @brief Start tracing to the given file
+       *
+       *  @throws std::runtime_error if the file cannot be created or
+       *          another observer is installed
+       */
+      explicit GlobalAllocationTrace(const std::string& filename);
+      GlobalAllocationTrace(const GlobalAllocationTrace&) = delete;
+      ~GlobalAllocationTrace();
+
+      /** @brief The trace allocations are written to */
+      const AllocationTraceWriter& writer() const { return writer_; }
+
+      /** @brief Stop tracing and write the remaining events to the file
+       *
+       *  @returns  True if every event was written
+       */
+      bool stop();
+
+      GlobalAllocationTrace& operator=(const GlobalAllocationTrace&) = delete;
+
+    private:
+      AllocationTraceWriter writer_;
+      bool tracing_;
+
+      virtual void allocated(void* p, size_t bytes, size_t alignment,
+			     void* caller) override;
+      virtual void deallocating(void* p, void* caller) override;
+      virtual void reallocationFailed(void* p, void* caller) override;
+    };
+
+    /** @brief Read an allocation trace
+     *
+     *  @returns  True if the whole file was read, false if it could not
+     *            be opened, is not an allocation trace, is truncated or
+     *            holds a record with an impossible alignment.  On
+     *            failure, events holds the events read before the
+     *            error.
+     */
+    bool readAllocationTrace(const std::string& filename,
+			     std::vector<AllocationEvent>& events);
+
+    /** @brief Returns the directory allocation traces are saved in.
+     *
+     *  Equal to "${SCRATCH_DIR}/allocation_traces," where SCRATCH_DIR
+     *  is the directory returned by getScratchDir().
+     */
+    std::string getAllocationTraceDir();
+
+    /** @brief Returns the path of the trace file for the given name,
+     *         creating the trace directory if necessary.
+     *
+     *  Characters in the name that are not letters, digits, '.', '-'
+     *  or '_' are replaced with '_'.
+     *
+     *  @returns  The path, or an empty string if the directory could
+     *            not be created
+     */
+    std::string allocationTracePath(const std::string& name);
+
+    /** @brief Result of replaying an allocation trace */
+    struct AllocationReplayResult {
+      /** @brief Number of blocks allocated */
+      uint64_t allocations;
+
+      /** @brief Number of blocks released */
+      uint64_t deallocations;
+
+      /** @brief Time spent allocating and releasing blocks, in
+       *         nanoseconds
+       */
+      uint64_t time;
+
+      /** @brief Largest number of bytes the trace had allocated at
+       *         once
+       */
+      uint64_t peakLiveBytes;
+
+      /** @brief Largest increase in the resident set size while
+       *         replaying the trace with every page of every block
+       *         touched, in bytes
+       */
+      uint64_t peakFootprint;
+
+      /** @brief Allocations and deallocations per second */
+      double operationsPerSecond() const {
+	return time ? (allocations + deallocations) * 1e9 / time : 0.0;
+      }
+
+      /** @brief Fraction of the peak footprint not occupied by live
+       *         blocks at the trace's peak, between 0 and 1
+       */
+      double fragmentation() const {
+	return (peakFootprint > peakLiveBytes)
+		   ? 1.0 - double(peakLiveBytes) / double(peakFootprint)
+		   : 0.0;
+      }
+    };
+
+    /** @brief Replay an allocation trace against an allocation
+     *         strategy.
+     *
+     *  Replays the events in the order they were recorded, on the
+     *  calling thread, twice, each time with a new strategy from
+     *  makeStrategy.  The first pass touches every page of every block
+     *  and measures the peak resident set size, which requires
+     *  resetPeakRss() (see ResourceUsage.hpp) to work.  Free memory the
+     *  system allocator has not returned to the system is reused
+     *  without being counted, so the footprint is a lower bound.  The
+     *  second pass only allocates and releases memory, and is timed.
+     *  Blocks still allocated when the trace ends are released after
+     *  each pass.
+     */
+    AllocationReplayResult replayAllocationTrace(
+	const std::vector<AllocationEvent>& events,
+	const std::function<std::shared_ptr<AllocationStrategy> ()>&
+	    makeStrategy
+    );
+
+  }
+}
+#endif
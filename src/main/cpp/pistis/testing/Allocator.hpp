@@ -1,8 +1,14 @@
 #ifndef __PISTIS__TESTING__ALLOCATOR_HPP__
 #define __PISTIS__TESTING__ALLOCATOR_HPP__
 
-#include <string>
+#include <pistis/testing/AllocationStats.hpp>
+#include <pistis/testing/AllocationStrategy.hpp>
+#include <limits>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
 /** @file Allocator.hpp
  *
@@ -11,32 +17,167 @@
 namespace pistis {
   namespace testing {
 
-    template <typename T>
+    /** @brief Selects how containers propagate an Allocator.
+     *
+     *  Supplies the propagate_on_container_copy_assignment,
+     *  propagate_on_container_move_assignment and
+     *  propagate_on_container_swap traits for Allocator.  When
+     *  ALWAYS_EQUAL is false, two Allocators compare equal only if
+     *  they have the same name() and strategy(), so a test can create
+     *  containers whose allocators cannot free each other's memory.
+     *  When it is true, the Allocator's is_always_equal trait is true
+     *  and all Allocators compare equal, so they cannot be given an
+     *  AllocationStrategy.
+     */
+    template <bool PROPAGATE_ON_COPY, bool PROPAGATE_ON_MOVE,
+	      bool PROPAGATE_ON_SWAP, bool ALWAYS_EQUAL>
+    struct AllocatorPropagation {
+      typedef std::integral_constant<bool, PROPAGATE_ON_COPY>
+	  propagate_on_container_copy_assignment;
+      typedef std::integral_constant<bool, PROPAGATE_ON_MOVE>
+	  propagate_on_container_move_assignment;
+      typedef std::integral_constant<bool, PROPAGATE_ON_SWAP>
+	  propagate_on_container_swap;
+      typedef std::integral_constant<bool, ALWAYS_EQUAL> is_always_equal;
+    };
+
+    /** @brief The propagation traits of std::allocator, with names
+     *         ignored in comparisons
+     */
+    typedef AllocatorPropagation<false, true, false, true>
+	StandardPropagation;
+
+    /** @brief The propagation traits of std::allocator, for Allocators
+     *         with an AllocationStrategy.  Allocators compare equal
+     *         only if their names and strategies match.
+     */
+    typedef AllocatorPropagation<false, true, false, false>
+	StrategyPropagation;
+
+    /** @brief Allocators that always propagate but never compare equal
+     *         unless their names match
+     */
+    typedef AllocatorPropagation<true, true, true, false>
+	AlwaysPropagate;
+
+    /** @brief Allocators that never propagate and never compare equal
+     *         unless their names match.
+     *
+     *  A container that is move-assigned from a container with a
+     *  differently-named allocator must move its elements one by one.
+     */
+    typedef AllocatorPropagation<false, false, false, false>
+	NeverPropagate;
+
+    /** @brief Allocator for unit testing
+     *
+     *  Allocator records its name and whether it was moved, so tests
+     *  can verify that containers copy and move their allocators
+     *  correctly.  An Allocator constructed with an AllocationStats
+     *  instance also records every call to allocate() and deallocate()
+     *  in that instance.  Copies and rebinds of the allocator share
+     *  the same AllocationStats, so all allocations a container makes
+     *  are recorded together, e.g.
+     *
+     *  @code
+     *  auto stats = std::make_shared<AllocationStats>();
+     *  std::vector<int, Allocator<int>> v(Allocator<int>("v", stats));
+     *  v.reserve(100);
+     *  for (int i = 0; i < 100; ++i) v.push_back(i);
+     *  EXPECT_EQ(1, stats->allocations());
+     *  @endcode
+     *
+     *  An Allocator constructed with an AllocationStrategy obtains
+     *  its memory from the strategy instead of std::allocator, so a
+     *  test can run a container over cache-line-aligned, deliberately
+     *  misaligned or huge-page-backed storage, e.g.
+     *
+     *  @code
+     *  typedef Allocator<double, StrategyPropagation> DoubleAllocator;
+     *  auto strategy = std::make_shared<MisalignedAllocation>();
+     *  std::vector<double, DoubleAllocator> v(DoubleAllocator("v", strategy));
+     *  @endcode
+     *
+     *  Copies and rebinds share the strategy, too.
+     *
+     *  The Propagation parameter controls the allocator's
+     *  propagation traits and equality; see AllocatorPropagation.
+     *  The default behaves like std::allocator:  all Allocators
+     *  compare equal, so constructing one with a strategy throws
+     *  std::invalid_argument.  Use StrategyPropagation, or any other
+     *  propagation whose ALWAYS_EQUAL is false, with a strategy, since
+     *  Allocators with different strategies cannot free each other's
+     *  memory and must compare unequal.  Splicing or swapping
+     *  containers whose allocators compare unequal is undefined unless
+     *  the allocators propagate, as with AlwaysPropagate.
+     */
+    template <typename T, typename Propagation = StandardPropagation>
     class Allocator : public std::allocator<T> {
     public:
+      typedef typename Propagation::propagate_on_container_copy_assignment
+	  propagate_on_container_copy_assignment;
+      typedef typename Propagation::propagate_on_container_move_assignment
+	  propagate_on_container_move_assignment;
+      typedef typename Propagation::propagate_on_container_swap
+	  propagate_on_container_swap;
+
+      typedef typename Propagation::is_always_equal is_always_equal;
+
       template <typename U>
-      struct rebind { typedef Allocator<U> other; };
+      struct rebind { typedef Allocator<U, Propagation> other; };
       
     public:
       Allocator() :
-	  std::allocator<T>(), name_(), movedFrom_(false), movedInto_(false) {
+	  std::allocator<T>(), name_(), stats_(), strategy_(),
+	  movedFrom_(false), movedInto_(false) {
       }
       Allocator(const std::string& name):
-	  std::allocator<T>(), name_(name), movedFrom_(false),
+	  std::allocator<T>(), name_(name), stats_(), strategy_(),
+	  movedFrom_(false), movedInto_(false) {
+      }
+      Allocator(const std::string& name,
+		const std::shared_ptr<AllocationStats>& stats):
+	  std::allocator<T>(), name_(name), stats_(stats), strategy_(),
+	  movedFrom_(false), movedInto_(false) {
+      }
+      /** @throws std::invalid_argument if strategy is not null and
+       *          is_always_equal is true
+       */
+      Allocator(const std::string& name,
+		const std::shared_ptr<AllocationStrategy>& strategy):
+	  std::allocator<T>(), name_(name), stats_(),
+	  strategy_(checkStrategy(strategy)), movedFrom_(false),
 	  movedInto_(false) {
       }
-      template <typename U>
-      Allocator(const Allocator<U>& other) :
-	  std::allocator<T>(other), name_(other.name()), movedFrom_(false),
+
+      /** @throws std::invalid_argument if strategy is not null and
+       *          is_always_equal is true
+       */
+      Allocator(const std::string& name,
+		const std::shared_ptr<AllocationStats>& stats,
+		const std::shared_ptr<AllocationStrategy>& strategy):
+	  std::allocator<T>(), name_(name), stats_(stats),
+	  strategy_(checkStrategy(strategy)), movedFrom_(false),
 	  movedInto_(false) {
       }
+      template <typename U>
+      Allocator(const Allocator<U, Propagation>& other) :
+	  std::allocator<T>(other), name_(other.name()),
+	  stats_(other.stats()), strategy_(other.strategy()),
+	  movedFrom_(false), movedInto_(false) {
+      }
       Allocator(const Allocator& other) :
-	  std::allocator<T>(other), name_(other.name()), movedFrom_(false),
-	  movedInto_(false) {
+	  std::allocator<T>(other), name_(other.name()),
+	  stats_(other.stats()), strategy_(other.strategy()),
+	  movedFrom_(false), movedInto_(false) {
       }
       Allocator(Allocator&& other) :
 	  std::allocator<T>(std::move(other)), name_(std::move(other.name_)),
-	  movedFrom_(false), movedInto_(true) {
+	  stats_(other.stats_), strategy_(other.strategy_), movedFrom_(false),
+	  movedInto_(true) {
+	// other.stats_ and other.strategy_ are copied rather than moved so
+	// that memory released through the moved-from allocator is still
+	// recorded and returned to the right place
 	other.movedFrom_ = true;
       }
 
@@ -44,10 +185,53 @@ namespace pistis {
       bool movedFrom() const { return movedFrom_; }
       bool moved() const { return movedInto_; }
 
+      /** @brief Statistics shared by this allocator, its copies and
+       *         its rebinds, or null if this allocator does not
+       *         record allocations.
+       */
+      const std::shared_ptr<AllocationStats>& stats() const {
+	return stats_;
+      }
+
+      /** @brief Strategy shared by this allocator, its copies and its
+       *         rebinds, or null if this allocator uses std::allocator.
+       */
+      const std::shared_ptr<AllocationStrategy>& strategy() const {
+	return strategy_;
+      }
+
+      /** @throws std::bad_array_new_length if n * sizeof(T) overflows */
+      T* allocate(std::size_t n) {
+	if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+	  throw std::bad_array_new_length();
+	}
+
+	T* p = strategy_ ?
+	    static_cast<T*>(strategy_->allocate(n * sizeof(T), alignof(T))) :
+	    std::allocator<T>::allocate(n);
+	if (stats_) {
+	  stats_->recordAllocation(n * sizeof(T));
+	}
+	return p;
+      }
+
+      void deallocate(T* p, std::size_t n) {
+	if (strategy_) {
+	  strategy_->deallocate(p, n * sizeof(T), alignof(T));
+	} else {
+	  std::allocator<T>::deallocate(p, n);
+	}
+	if (stats_) {
+	  stats_->recordDeallocation(n * sizeof(T));
+	}
+      }
+
       template <typename U>
-      Allocator& operator=(const Allocator<U>& other) {
+      Allocator& operator=(const Allocator<U, Propagation>& other) {
 	std::allocator<T>::operator=(other);
 	name_ = other.name();
+	stats_ = other.stats();
+	strategy_ = other.strategy();
 	movedFrom_ = false;
 	movedInto_ = false;
 	return *this;
@@ -56,6 +240,8 @@ namespace pistis {
       Allocator& operator=(const Allocator& other) {
 	std::allocator<T>::operator=(other);
 	name_ = other.name();
+	stats_ = other.stats();
+	strategy_ = other.strategy();
 	movedFrom_ = false;
 	movedInto_ = false;
 	return *this;
@@ -64,6 +250,8 @@ namespace pistis {
       Allocator& operator=(Allocator&& other) {
 	std::allocator<T>::operator=(std::move(other));
 	name_ = std::move(other.name_);
+	stats_ = other.stats_;
+	strategy_ = other.strategy_;
 	movedFrom_ = false;
 	movedInto_ = true;
 	other.movedFrom_ = true;
@@ -72,10 +260,37 @@ namespace pistis {
 
     private:
       std::string name_;
+      std::shared_ptr<AllocationStats> stats_;
+      std::shared_ptr<AllocationStrategy> strategy_;
       bool movedFrom_;
       bool movedInto_;
+
+      static const std::shared_ptr<AllocationStrategy>& checkStrategy(
+	  const std::shared_ptr<AllocationStrategy>& strategy
+      ) {
+	if (is_always_equal::value && strategy) {
+	  throw std::invalid_argument(
+	      "An Allocator that is always equal cannot have a strategy"
+	  );
+	}
+	return strategy;
+      }
     };
 
+    template <typename T1, typename T2, typename Propagation>
+    inline bool operator==(const Allocator<T1, Propagation>& left,
+			   const Allocator<T2, Propagation>& right) {
+      return Propagation::is_always_equal::value ||
+	     ((left.name() == right.name()) &&
+	      (left.strategy() == right.strategy()));
+    }
+
+    template <typename T1, typename T2, typename Propagation>
+    inline bool operator!=(const Allocator<T1, Propagation>& left,
+			   const Allocator<T2, Propagation>& right) {
+      return !(left == right);
+    }
+
   }
 }
 #endif
@@ -0,0 +1,111 @@
+#include "Arena.hpp"
+
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace pistis::testing;
+
+struct Arena::Chunk {
+  Chunk* next;
+  size_t size;
+};
+
+namespace {
+  // Chunk headers are padded so the memory following them is aligned
+  // for any fundamental type
+  static const size_t CHUNK_HEADER_SIZE =
+      (sizeof(void*) + sizeof(size_t) + alignof(max_align_t) - 1) &
+      ~(alignof(max_align_t) - 1);
+
+  inline char* alignUp(char* p, size_t alignment) {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    return p + (((address + alignment - 1) & ~(alignment - 1)) - address);
+  }
+}
+
+const size_t Arena::DEFAULT_CHUNK_SIZE;
+
+Arena::Arena(size_t chunkSize):
+    chunkSize_(chunkSize), chunks_(nullptr), next_(nullptr), end_(nullptr),
+    lastAllocation_(nullptr), numChunks_(0), allocations_(0),
+    bytesAllocated_(0), bytesReserved_(0) {
+}
+
+Arena::~Arena() {
+  release();
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+  char* p = alignUp(next_, alignment);
+  if (next_ && (p <= end_) && (bytes <= size_t(end_ - p))) {
+    next_ = p + bytes;
+    lastAllocation_ = p;
+    ++allocations_;
+    bytesAllocated_ += bytes;
+    return p;
+  }
+  return allocateFromNewChunk(bytes, alignment);
+}
+
+void Arena::deallocate(void* p, size_t bytes) {
+  if (p && (p == lastAllocation_) && (lastAllocation_ + bytes == next_)) {
+    next_ = lastAllocation_;
+    lastAllocation_ = nullptr;
+    bytesAllocated_ -= bytes;
+  }
+}
+
+void Arena::release() {
+  while (chunks_) {
+    Chunk* next = chunks_->next;
+    ::free(chunks_);
+    chunks_ = next;
+  }
+  next_ = nullptr;
+  end_ = nullptr;
+  lastAllocation_ = nullptr;
+  numChunks_ = 0;
+  allocations_ = 0;
+  bytesAllocated_ = 0;
+  bytesReserved_ = 0;
+}
+
+void* Arena::allocateFromNewChunk(size_t bytes, size_t alignment) {
+  // Requests that would use more than a quarter of a chunk get their own
+  // chunk, so they do not waste what is left of the current one
+  const size_t padding =
+      alignment > alignof(max_align_t) ? alignment - 1 : 0;
+  if (bytes > (SIZE_MAX - CHUNK_HEADER_SIZE - padding)) {
+    throw std::bad_alloc();
+  }
+  const bool dedicated = (bytes + padding) > (chunkSize_ / 4);
+  const size_t size =
+      CHUNK_HEADER_SIZE + (dedicated ? bytes + padding : chunkSize_);
+  Chunk* chunk = static_cast<Chunk*>(::malloc(size));
+
+  if (!chunk) {
+    throw std::bad_alloc();
+  }
+  chunk->size = size;
+  ++numChunks_;
+  bytesReserved_ += size;
+
+  char* start = reinterpret_cast<char*>(chunk) + CHUNK_HEADER_SIZE;
+  char* p = alignUp(start, alignment);
+  if (dedicated && chunks_) {
+    // Keep allocating from the current chunk
+    chunk->next = chunks_->next;
+    chunks_->next = chunk;
+  } else {
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    next_ = p + bytes;
+    end_ = reinterpret_cast<char*>(chunk) + size;
+  }
+
+  lastAllocation_ = dedicated ? nullptr : p;
+  ++allocations_;
+  bytesAllocated_ += bytes;
+  return p;
+}
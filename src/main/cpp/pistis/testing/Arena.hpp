@@ -0,0 +1,104 @@
+#ifndef __PISTIS__TESTING__ARENA_HPP__
+#define __PISTIS__TESTING__ARENA_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file Arena.hpp
+ *
+ *  Monotonic ("bump") memory arena for unit tests
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Monotonic memory arena.
+     *
+     *  An Arena carves allocations out of large chunks obtained from
+     *  the system allocator by advancing a pointer.  Deallocation does
+     *  nothing, except that releasing the most recent allocation
+     *  returns its memory to the arena, so a buffer that is repeatedly
+     *  grown and released in place does not waste the chunk.  All
+     *  memory is returned to the system at once when the arena is
+     *  destroyed or release() is called.
+     *
+     *  A request that does not fit in the current chunk and needs more
+     *  than a quarter of the chunk size gets a chunk of its own, so
+     *  the arena keeps allocating from what is left of the current one.
+     *
+     *  Arena is not thread-safe.  Use one arena per thread.
+     */
+    class Arena {
+    public:
+      /** @brief Default size of the chunks the arena allocates */
+      static const size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+    public:
+      explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+      Arena(const Arena&) = delete;
+      ~Arena();
+
+      /** @brief Size of the chunks the arena allocates from the system */
+      size_t chunkSize() const { return chunkSize_; }
+
+      /** @brief Number of chunks the arena currently holds */
+      size_t numChunks() const { return numChunks_; }
+
+      /** @brief Number of calls to allocate() since the arena was
+       *         created or last released
+       */
+      uint64_t allocations() const { return allocations_; }
+
+      /** @brief Number of bytes handed out by allocate() since the arena
+       *         was created or last released, less the bytes returned
+       *         by deallocating the most recent allocation.
+       */
+      size_t bytesAllocated() const { return bytesAllocated_; }
+
+      /** @brief Total size of the chunks the arena holds */
+      size_t bytesReserved() const { return bytesReserved_; }
+
+      /** @brief Allocate bytes from the arena
+       *
+       *  @param bytes      Number of bytes to allocate
+       *  @param alignment  Alignment of the returned memory.  Must be
+       *                    a power of two.
+       *  @returns          The allocated memory
+       *  @throws std::bad_alloc  If the system is out of memory
+       */
+      void* allocate(size_t bytes, size_t alignment);
+
+      /** @brief Return memory to the arena.
+       *
+       *  Only the most recent allocation is actually reused.  Memory
+       *  from other allocations is reclaimed when the arena is
+       *  released.
+       */
+      void deallocate(void* p, size_t bytes);
+
+      /** @brief Return all memory held by the arena to the system.
+       *
+       *  Every pointer obtained from allocate() becomes invalid.
+       */
+      void release();
+
+      Arena& operator=(const Arena&) = delete;
+
+    private:
+      struct Chunk;
+
+      size_t chunkSize_;
+      Chunk* chunks_;
+      char* next_;
+      char* end_;
+      char* lastAllocation_;
+      size_t numChunks_;
+      uint64_t allocations_;
+      size_t bytesAllocated_;
+      size_t bytesReserved_;
+
+      void* allocateFromNewChunk(size_t bytes, size_t alignment);
+    };
+
+  }
+}
+#endif
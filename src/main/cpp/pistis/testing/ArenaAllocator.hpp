@@ -0,0 +1,181 @@
+#ifndef __PISTIS__TESTING__ARENAALLOCATOR_HPP__
+#define __PISTIS__TESTING__ARENAALLOCATOR_HPP__
+
+#include <pistis/testing/AllocationStats.hpp>
+#include <pistis/testing/Arena.hpp>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <stddef.h>
+
+/** @file ArenaAllocator.hpp
+ *
+ *  Arena-backed allocator for unit testing
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Allocator for unit testing that allocates from an Arena
+     *
+     *  ArenaAllocator has the same name, move-tracking and statistics
+     *  interface as Allocator, but takes its memory from an Arena
+     *  instead of the system allocator.  Deallocating memory costs
+     *  nothing; the memory is reclaimed all at once when the arena is
+     *  released.  Tests that build many small node-based containers
+     *  should keep an Arena in their fixture, e.g.
+     *
+     *  @code
+     *  class MapTests : public ::testing::Test {
+     *  protected:
+     *    std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+     *    ArenaAllocator<int> allocator{"map", arena};
+     *  };
+     *  @endcode
+     *
+     *  Copies and rebinds of the allocator share its arena and keep it
+     *  alive.  Two ArenaAllocators compare equal if they share an
+     *  arena, and containers carry their allocator with them on copy
+     *  assignment, move assignment and swap, so memory is always
+     *  returned to the arena it came from.
+     */
+    template <typename T>
+    class ArenaAllocator {
+    public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+      typedef std::true_type propagate_on_container_copy_assignment;
+      typedef std::true_type propagate_on_container_move_assignment;
+      typedef std::true_type propagate_on_container_swap;
+      typedef std::false_type is_always_equal;
+
+      template <typename U>
+      struct rebind { typedef ArenaAllocator<U> other; };
+
+    public:
+      ArenaAllocator():
+	  name_(), arena_(std::make_shared<Arena>()), stats_(),
+	  movedFrom_(false), movedInto_(false) {
+      }
+      ArenaAllocator(const std::shared_ptr<Arena>& arena):
+	  name_(), arena_(arena), stats_(), movedFrom_(false),
+	  movedInto_(false) {
+      }
+      ArenaAllocator(const std::string& name,
+		     const std::shared_ptr<Arena>& arena):
+	  name_(name), arena_(arena), stats_(), movedFrom_(false),
+	  movedInto_(false) {
+      }
+      ArenaAllocator(const std::string& name,
+		     const std::shared_ptr<Arena>& arena,
+		     const std::shared_ptr<AllocationStats>& stats):
+	  name_(name), arena_(arena), stats_(stats), movedFrom_(false),
+	  movedInto_(false) {
+      }
+      template <typename U>
+      ArenaAllocator(const ArenaAllocator<U>& other):
+	  name_(other.name()), arena_(other.arena()), stats_(other.stats()),
+	  movedFrom_(false), movedInto_(false) {
+      }
+      ArenaAllocator(const ArenaAllocator& other):
+	  name_(other.name()), arena_(other.arena()), stats_(other.stats()),
+	  movedFrom_(false), movedInto_(false) {
+      }
+      ArenaAllocator(ArenaAllocator&& other):
+	  name_(std::move(other.name_)), arena_(other.arena_),
+	  stats_(other.stats_), movedFrom_(false), movedInto_(true) {
+	// The arena is copied rather than moved so that a container
+	// can still release memory through the moved-from allocator
+	other.movedFrom_ = true;
+      }
+
+      const std::string& name() const { return name_; }
+      bool movedFrom() const { return movedFrom_; }
+      bool moved() const { return movedInto_; }
+
+      /** @brief The arena this allocator allocates from */
+      const std::shared_ptr<Arena>& arena() const { return arena_; }
+
+      /** @brief Statistics shared by this allocator, its copies and
+       *         its rebinds, or null if this allocator does not
+       *         record allocations.
+       */
+      const std::shared_ptr<AllocationStats>& stats() const {
+	return stats_;
+      }
+
+      T* allocate(size_t n) {
+	if (n > max_size()) {
+	  throw std::bad_alloc();
+	}
+	T* p = static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+	if (stats_) {
+	  stats_->recordAllocation(n * sizeof(T));
+	}
+	return p;
+      }
+
+      void deallocate(T* p, size_t n) {
+	arena_->deallocate(p, n * sizeof(T));
+	if (stats_) {
+	  stats_->recordDeallocation(n * sizeof(T));
+	}
+      }
+
+      size_t max_size() const { return size_t(-1) / sizeof(T); }
+
+      template <typename U>
+      ArenaAllocator& operator=(const ArenaAllocator<U>& other) {
+	name_ = other.name();
+	arena_ = other.arena();
+	stats_ = other.stats();
+	movedFrom_ = false;
+	movedInto_ = false;
+	return *this;
+      }
+
+      ArenaAllocator& operator=(const ArenaAllocator& other) {
+	name_ = other.name();
+	arena_ = other.arena();
+	stats_ = other.stats();
+	movedFrom_ = false;
+	movedInto_ = false;
+	return *this;
+      }
+
+      ArenaAllocator& operator=(ArenaAllocator&& other) {
+	name_ = std::move(other.name_);
+	arena_ = other.arena_;
+	stats_ = other.stats_;
+	movedFrom_ = false;
+	movedInto_ = true;
+	other.movedFrom_ = true;
+	return *this;
+      }
+
+      template <typename U>
+      bool operator==(const ArenaAllocator<U>& other) const {
+	return arena_ == other.arena();
+      }
+
+      template <typename U>
+      bool operator!=(const ArenaAllocator<U>& other) const {
+	return arena_ != other.arena();
+      }
+
+    private:
+      std::string name_;
+      std::shared_ptr<Arena> arena_;
+      std::shared_ptr<AllocationStats> stats_;
+      bool movedFrom_;
+      bool movedInto_;
+    };
+
+  }
+}
+#endif
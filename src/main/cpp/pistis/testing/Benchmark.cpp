@@ -0,0 +1,566 @@
+#include "Benchmark.hpp"
+#include "AllocationHooks.hpp"
+#include "Resources.hpp"
+#include "Timing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PISTIS_TESTING_HAVE_TSC 1
+#endif
+
+using namespace pistis::testing;
+using namespace pistis::testing::bench;
+
+namespace {
+  static double median(const std::vector<double>& sorted) {
+    const size_t n = sorted.size();
+    return (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  }
+
+#ifdef PISTIS_TESTING_HAVE_TSC
+  static uint64_t readTsc() {
+    unsigned int aux;
+    return __rdtscp(&aux);
+  }
+
+  static double computeNanosecondsPerTick() {
+    // Compare the TSC against the monotonic clock over ~20ms
+    const uint64_t startTime = monotonicNanoseconds();
+    const uint64_t startTicks = readTsc();
+    uint64_t endTime = startTime;
+    while ((endTime - startTime) < 20000000) {
+      endTime = monotonicNanoseconds();
+    }
+    const uint64_t endTicks = readTsc();
+    return double(endTime - startTime) / double(endTicks - startTicks);
+  }
+
+  static double nanosecondsPerTick() {
+    static const double NS_PER_TICK = computeNanosecondsPerTick();
+    return NS_PER_TICK;
+  }
+#endif
+
+  static double timeSample(const std::function<void (uint64_t)>& body,
+			   uint64_t iterations, ClockType clock) {
+    const uint64_t start = readClock(clock);
+    body(iterations);
+    const uint64_t end = readClock(clock);
+    return ticksToNanoseconds(clock, end - start);
+  }
+
+  static void writeJsonString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+      switch (c) {
+	case '"': out << "\\\""; break;
+	case '\\': out << "\\\\"; break;
+	case '\n': out << "\\n"; break;
+	case '\r': out << "\\r"; break;
+	case '\t': out << "\\t"; break;
+	default:
+	  if ((unsigned char)c < 0x20) {
+	    out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+		<< int(c) << std::dec << std::setfill(' ');
+	  } else {
+	    out << c;
+	  }
+      }
+    }
+    out << '"';
+  }
+
+  // Reads the subset of JSON that writeJson() produces
+  class JsonReader {
+  public:
+    JsonReader(std::istream& in): in_(in) { }
+
+    bool accept(char c) {
+      skipSpace();
+      if (in_.peek() == c) {
+	in_.get();
+	return true;
+      }
+      return false;
+    }
+
+    bool readString(std::string& s) {
+      if (!accept('"')) {
+	return false;
+      }
+      s.clear();
+      for (int c = in_.get(); c != '"'; c = in_.get()) {
+	if (c == EOF) {
+	  return false;
+	} else if (c == '\\') {
+	  c = in_.get();
+	  switch (c) {
+	    case 'n': s.push_back('\n'); break;
+	    case 'r': s.push_back('\r'); break;
+	    case 't': s.push_back('\t'); break;
+	    case 'u': {
+	      char digits[5] = { 0, 0, 0, 0, 0 };
+	      if (!in_.read(digits, 4)) {
+		return false;
+	      }
+	      s.push_back(char(strtol(digits, nullptr, 16)));
+	      break;
+	    }
+	    default:
+	      if (c == EOF) {
+		return false;
+	      }
+	      s.push_back(char(c));
+	  }
+	} else {
+	  s.push_back(char(c));
+	}
+      }
+      return true;
+    }
+
+    bool readNumber(double& x) {
+      skipSpace();
+      return bool(in_ >> x);
+    }
+
+    bool readNumbers(std::vector<double>& values) {
+      values.clear();
+      if (!accept('[')) {
+	return false;
+      } else if (accept(']')) {
+	return true;
+      }
+      do {
+	double x;
+	if (!readNumber(x)) {
+	  return false;
+	}
+	values.push_back(x);
+      } while (accept(','));
+      return accept(']');
+    }
+
+    // Calls readValue(key) for each key in an object.  readValue must
+    // consume the value and return true on success.
+    template <typename F>
+    bool readObject(F readValue) {
+      if (!accept('{')) {
+	return false;
+      } else if (accept('}')) {
+	return true;
+      }
+      do {
+	std::string key;
+	if (!readString(key) || !accept(':') || !readValue(key)) {
+	  return false;
+	}
+      } while (accept(','));
+      return accept('}');
+    }
+
+    bool skipValue() {
+      skipSpace();
+      const int c = in_.peek();
+      if (c == '"') {
+	std::string s;
+	return readString(s);
+      } else if (c == '[') {
+	in_.get();
+	if (accept(']')) {
+	  return true;
+	}
+	do {
+	  if (!skipValue()) {
+	    return false;
+	  }
+	} while (accept(','));
+	return accept(']');
+      } else if (c == '{') {
+	return readObject([this](const std::string&) { return skipValue(); });
+      } else if (isalpha(c)) {
+	std::string word;
+	while (isalpha(in_.peek())) {
+	  word.push_back(char(in_.get()));
+	}
+	return (word == "true") || (word == "false") || (word == "null");
+      } else {
+	double x;
+	return readNumber(x);
+      }
+    }
+
+  private:
+    std::istream& in_;
+
+    void skipSpace() {
+      while (isspace(in_.peek())) {
+	in_.get();
+      }
+    }
+  };
+}
+
+double pistis::testing::bench::normalQuantile(double p) {
+  // Invert the normal CDF by bisection.  Fast enough for the handful
+  // of calls a benchmark run makes, and accurate to double precision.
+  if (p <= 0.0) {
+    return -std::numeric_limits<double>::infinity();
+  } else if (p >= 1.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  double low = -40.0;
+  double high = 40.0;
+  for (int i = 0; i < 100; ++i) {
+    const double mid = (low + high) / 2;
+    const double cdf = 0.5 * std::erfc(-mid / std::sqrt(2.0));
+    if (cdf < p) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return (low + high) / 2;
+}
+
+Statistics pistis::testing::bench::computeStatistics(
+    const std::vector<double>& samples, double confidence
+) {
+  Statistics stats;
+  std::vector<double> sorted(samples);
+  const size_t n = sorted.size();
+
+  std::sort(sorted.begin(), sorted.end());
+  stats.count = n;
+  stats.confidence = confidence;
+  if (!n) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    stats.min = stats.max = stats.mean = stats.standardDeviation = nan;
+    stats.median = stats.mad = stats.medianLow = stats.medianHigh = nan;
+    return stats;
+  }
+
+  stats.min = sorted.front();
+  stats.max = sorted.back();
+
+  double sum = 0.0;
+  for (double x : sorted) {
+    sum += x;
+  }
+  stats.mean = sum / n;
+
+  double sumOfSquares = 0.0;
+  for (double x : sorted) {
+    sumOfSquares += (x - stats.mean) * (x - stats.mean);
+  }
+  stats.standardDeviation = (n > 1) ? std::sqrt(sumOfSquares / (n - 1)) : 0.0;
+
+  stats.median = median(sorted);
+  std::vector<double> deviations;
+  deviations.reserve(n);
+  for (double x : sorted) {
+    deviations.push_back(std::fabs(x - stats.median));
+  }
+  std::sort(deviations.begin(), deviations.end());
+  stats.mad = median(deviations);
+
+  // The number of samples below the median is Binomial(n, 1/2), so the
+  // order statistics at ranks n/2 -/+ z * sqrt(n)/2 bound the median
+  // with the requested confidence
+  const double z = normalQuantile(0.5 + confidence / 2);
+  const double halfWidth = z * std::sqrt(double(n)) / 2;
+  const double lowRank = std::floor(n / 2.0 - halfWidth);
+  const double highRank = std::ceil(n / 2.0 + halfWidth);
+  stats.medianLow = sorted[size_t(std::max(lowRank, 1.0)) - 1];
+  stats.medianHigh = sorted[size_t(std::min(highRank, double(n))) - 1];
+  return stats;
+}
+
+Result pistis::testing::bench::run(
+    const std::string& name, const std::function<void (uint64_t)>& body,
+    const Options& options
+) {
+  Result result;
+  result.name = name;
+  result.clock = options.clock;
+
+  // Find the number of iterations that makes a sample last at least
+  // minSampleTime.  This also serves as the first part of the warmup.
+  const uint64_t warmupStart = monotonicNanoseconds();
+  uint64_t iterations = 1;
+  for (;;) {
+    const double t = timeSample(body, iterations, options.clock);
+    if ((t >= options.minSampleTime) || (iterations >= options.maxIterations)) {
+      break;
+    }
+
+    // Aim 20% past the target, but grow by at least 2x and at most 10x
+    // per step in case the first samples were unrepresentative
+    const double target = 1.2 * options.minSampleTime;
+    double next = (t > 0.0) ? (iterations * target / t) : (iterations * 10.0);
+    next = std::min(std::max(next, 2.0 * iterations), 10.0 * iterations);
+    iterations = std::min(uint64_t(next), options.maxIterations);
+  }
+
+  while ((monotonicNanoseconds() - warmupStart) < options.warmupTime) {
+    timeSample(body, iterations, options.clock);
+  }
+
+  result.iterationsPerSample = iterations;
+  result.samples.reserve(options.samples);
+  for (size_t i = 0; i < options.samples; ++i) {
+    const double t = timeSample(body, iterations, options.clock);
+    result.samples.push_back(t / double(iterations));
+  }
+  result.statistics = computeStatistics(result.samples, options.confidence);
+  return result;
+}
+
+uint64_t pistis::testing::bench::layoutSeed() {
+  const char* value = getenv("PISTIS_TESTING_LAYOUT_SEED");
+  return (value && *value) ? strtoull(value, nullptr, 0) : 1;
+}
+
+LayoutResult pistis::testing::bench::runAcrossLayouts(
+    const std::string& name,
+    const std::function<std::function<void (uint64_t)> ()>& setup,
+    size_t layouts, uint64_t seed, const Options& options
+) {
+  LayoutResult result;
+  std::vector<double> medians;
+
+  result.name = name;
+  for (size_t i = 0; i < layouts; ++i) {
+    const uint64_t layout = seed + i;
+    {
+      hooks::enableLayoutRandomization(layout);
+      std::function<void (uint64_t)> body;
+      try {
+	body = setup();
+      } catch(...) {
+	hooks::disableLayoutRandomization();
+	hooks::releaseLayoutSpacers();
+	throw;
+      }
+      hooks::disableLayoutRandomization();
+
+      result.runs.push_back(
+	  run(name + "/layout-" + std::to_string(layout), body, options)
+      );
+    }
+    hooks::releaseLayoutSpacers();
+
+    result.seeds.push_back(layout);
+    medians.push_back(result.runs.back().statistics.median);
+  }
+  result.statistics = computeStatistics(medians, options.confidence);
+  return result;
+}
+
+LayoutComparison pistis::testing::bench::compareLayouts(
+    const LayoutResult& baseline, const LayoutResult& candidate,
+    double confidence
+) {
+  LayoutComparison c;
+  const double n1 = double(baseline.runs.size());
+  const double n2 = double(candidate.runs.size());
+
+  c.baselineMedian = baseline.statistics.median;
+  c.candidateMedian = candidate.statistics.median;
+
+  // U counts the pairs in which the candidate is slower, with ties
+  // counting half
+  double u = 0.0;
+  for (const Result& b : baseline.runs) {
+    for (const Result& x : candidate.runs) {
+      const double bm = b.statistics.median;
+      const double xm = x.statistics.median;
+      u += (xm > bm) ? 1.0 : ((xm == bm) ? 0.5 : 0.0);
+    }
+  }
+
+  const double sd = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0);
+  c.z = (sd > 0.0) ? (u - n1 * n2 / 2.0) / sd : 0.0;
+  c.significant = std::fabs(c.z) > normalQuantile(0.5 + confidence / 2);
+  return c;
+}
+
+uint64_t pistis::testing::bench::readClock(ClockType clock) {
+#ifdef PISTIS_TESTING_HAVE_TSC
+  if (clock == ClockType::TSC) {
+    return readTsc();
+  }
+#endif
+  return monotonicNanoseconds();
+}
+
+double pistis::testing::bench::ticksToNanoseconds(ClockType clock,
+						  uint64_t ticks) {
+#ifdef PISTIS_TESTING_HAVE_TSC
+  if (clock == ClockType::TSC) {
+    return double(ticks) * nanosecondsPerTick();
+  }
+#endif
+  return double(ticks);
+}
+
+const char* pistis::testing::bench::clockName(ClockType clock) {
+  switch (clock) {
+    case ClockType::MONOTONIC: return "monotonic";
+    case ClockType::TSC: return "tsc";
+  }
+  return "unknown";
+}
+
+void pistis::testing::bench::writeJson(std::ostream& out,
+				       const Result& result) {
+  const Statistics& stats = result.statistics;
+  const std::streamsize precision = out.precision(10);
+
+  out << "{\n  \"name\": ";
+  writeJsonString(out, result.name);
+  out << ",\n  \"clock\": \"" << clockName(result.clock) << "\""
+      << ",\n  \"iterations_per_sample\": " << result.iterationsPerSample
+      << ",\n  \"samples\": [";
+  for (size_t i = 0; i < result.samples.size(); ++i) {
+    out << (i ? ", " : "") << result.samples[i];
+  }
+  out << "],\n  \"statistics\": {"
+      << "\n    \"count\": " << stats.count
+      << ",\n    \"min\": " << stats.min
+      << ",\n    \"max\": " << stats.max
+      << ",\n    \"mean\": " << stats.mean
+      << ",\n    \"stddev\": " << stats.standardDeviation
+      << ",\n    \"median\": " << stats.median
+      << ",\n    \"mad\": " << stats.mad
+      << ",\n    \"confidence\": " << stats.confidence
+      << ",\n    \"median_low\": " << stats.medianLow
+      << ",\n    \"median_high\": " << stats.medianHigh
+      << "\n  }\n}\n";
+  out.precision(precision);
+}
+
+bool pistis::testing::bench::readJson(std::istream& in, Result& result) {
+  JsonReader reader(in);
+  Statistics& stats = result.statistics;
+  bool haveName = false;
+  bool haveSamples = false;
+  bool haveMedian = false;
+
+  result.clock = ClockType::MONOTONIC;
+  result.iterationsPerSample = 0;
+  stats = computeStatistics(std::vector<double>());
+
+  auto readStatistic = [&reader, &stats, &haveMedian](const std::string& key) {
+    double x;
+    if (!reader.readNumber(x)) {
+      return false;
+    } else if (key == "count") {
+      stats.count = size_t(x);
+    } else if (key == "min") {
+      stats.min = x;
+    } else if (key == "max") {
+      stats.max = x;
+    } else if (key == "mean") {
+      stats.mean = x;
+    } else if (key == "stddev") {
+      stats.standardDeviation = x;
+    } else if (key == "median") {
+      stats.median = x;
+      haveMedian = true;
+    } else if (key == "mad") {
+      stats.mad = x;
+    } else if (key == "confidence") {
+      stats.confidence = x;
+    } else if (key == "median_low") {
+      stats.medianLow = x;
+    } else if (key == "median_high") {
+      stats.medianHigh = x;
+    }
+    return true;
+  };
+
+  auto readField = [&](const std::string& key) {
+    if (key == "name") {
+      haveName = true;
+      return reader.readString(result.name);
+    } else if (key == "clock") {
+      std::string clock;
+      if (!reader.readString(clock)) {
+	return false;
+      }
+      result.clock = (clock == clockName(ClockType::TSC)) ? ClockType::TSC
+							  : ClockType::MONOTONIC;
+      return true;
+    } else if (key == "iterations_per_sample") {
+      double x;
+      if (!reader.readNumber(x)) {
+	return false;
+      }
+      result.iterationsPerSample = uint64_t(x);
+      return true;
+    } else if (key == "samples") {
+      haveSamples = true;
+      return reader.readNumbers(result.samples);
+    } else if (key == "statistics") {
+      return reader.readObject(readStatistic);
+    } else {
+      return reader.skipValue();
+    }
+  };
+
+  if (!reader.readObject(readField) || !haveName || !haveSamples) {
+    return false;
+  }
+
+  // Statistics missing from the file are recomputed from the samples
+  if (!haveMedian) {
+    stats = computeStatistics(result.samples);
+  }
+  return true;
+}
+
+std::string pistis::testing::bench::getResultDir() {
+  return getScratchFile("benchmarks");
+}
+
+std::string pistis::testing::bench::resultFilename(
+    const std::string& benchmarkName
+) {
+  std::string filename(benchmarkName);
+  for (char& c : filename) {
+    if (!isalnum((unsigned char)c) && !strchr(".-_", c)) {
+      c = '_';
+    }
+  }
+  return filename + ".json";
+}
+
+std::string pistis::testing::bench::saveResult(const Result& result) {
+  const std::string dir = getResultDir();
+  if (!makeDirectories(dir)) {
+    return std::string();
+  }
+
+  const std::string path = dir + "/" + resultFilename(result.name);
+  std::ofstream out(path.c_str());
+  writeJson(out, result);
+  return out ? path : std::string();
+}
+
+bool pistis::testing::bench::enabled() {
+  const char* value = getenv("PISTIS_TESTING_RUN_BENCHMARKS");
+  return value && *value && strcmp(value, "0");
+}
@@ -0,0 +1,330 @@
+#ifndef __PISTIS__TESTING__BENCHMARK_HPP__
+#define __PISTIS__TESTING__BENCHMARK_HPP__
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file Benchmark.hpp
+ *
+ *  Benchmark harness that runs inside unit test executables.
+ *
+ *  A benchmark is timed in samples.  Each sample runs the code under
+ *  test a fixed number of iterations, chosen adaptively so that one
+ *  sample takes at least Options::minSampleTime nanoseconds, which
+ *  keeps the clock's resolution and overhead out of the result.  The
+ *  harness warms up the code under test, takes Options::samples
+ *  samples and summarizes the time per iteration with robust
+ *  statistics:  the median, the median absolute deviation (MAD) and
+ *  a distribution-free confidence interval for the median.
+ *
+ *  See BenchmarkTest.hpp for running benchmarks inside Google Test
+ *  tests.
+ */
+namespace pistis {
+  namespace testing {
+    namespace bench {
+
+      /** @brief Clocks the harness can time samples with */
+      enum class ClockType {
+	/** @brief clock_gettime(CLOCK_MONOTONIC) */
+	MONOTONIC,
+
+	/** @brief The processor's time-stamp counter, calibrated against
+	 *         CLOCK_MONOTONIC.  Has lower overhead and finer
+	 *         resolution than MONOTONIC.  Falls back to MONOTONIC on
+	 *         processors without a time-stamp counter.
+	 */
+	TSC
+      };
+
+      /** @brief Parameters for running a benchmark */
+      struct Options {
+	/** @brief Minimum time to run the code under test before taking
+	 *         samples, in nanoseconds
+	 */
+	uint64_t warmupTime;
+
+	/** @brief Minimum duration of one sample, in nanoseconds */
+	uint64_t minSampleTime;
+
+	/** @brief Number of samples to take */
+	size_t samples;
+
+	/** @brief Upper bound on the number of iterations per sample */
+	uint64_t maxIterations;
+
+	/** @brief Clock used to time samples */
+	ClockType clock;
+
+	/** @brief Confidence level of the interval around the median */
+	double confidence;
+
+	Options():
+	    warmupTime(100000000), minSampleTime(10000000), samples(21),
+	    maxIterations(uint64_t(1) << 40), clock(ClockType::TSC),
+	    confidence(0.95) {
+	}
+      };
+
+      /** @brief Summary statistics for a set of samples */
+      struct Statistics {
+	size_t count;
+	double min;
+	double max;
+	double mean;
+	double standardDeviation;
+	double median;
+
+	/** @brief Median absolute deviation from the median.
+	 *
+	 *  Multiply by 1.4826 to estimate the standard deviation of
+	 *  normally-distributed samples.
+	 */
+	double mad;
+
+	/** @brief Confidence level of [medianLow, medianHigh] */
+	double confidence;
+
+	/** @brief Lower bound of the confidence interval for the median */
+	double medianLow;
+
+	/** @brief Upper bound of the confidence interval for the median */
+	double medianHigh;
+      };
+
+      /** @brief Compute summary statistics.
+       *
+       *  The confidence interval for the median is computed from the
+       *  order statistics of the samples, so it does not assume any
+       *  particular distribution.  With fewer than about ten samples,
+       *  it is the range of the samples.
+       *
+       *  @param samples     The samples.  Must not be empty.
+       *  @param confidence  Confidence level of the interval for the
+       *                     median, between 0 and 1.
+       */
+      Statistics computeStatistics(const std::vector<double>& samples,
+				   double confidence = 0.95);
+
+      /** @brief Returns the p-th quantile of the standard normal
+       *         distribution
+       */
+      double normalQuantile(double p);
+
+      /** @brief Result of running a benchmark */
+      struct Result {
+	/** @brief Name of the benchmark */
+	std::string name;
+
+	/** @brief Clock that timed the samples */
+	ClockType clock;
+
+	/** @brief Number of iterations of the code under test in each
+	 *         sample
+	 */
+	uint64_t iterationsPerSample;
+
+	/** @brief Time per iteration for each sample, in nanoseconds */
+	std::vector<double> samples;
+
+	/** @brief Statistics of the samples */
+	Statistics statistics;
+      };
+
+      /** @brief Run a benchmark
+       *
+       *  @param name     Name of the benchmark
+       *  @param body     Runs the code under test the given number of
+       *                  times
+       *  @param options  How to run the benchmark
+       *  @returns        The samples and their statistics
+       */
+      Result run(const std::string& name,
+		 const std::function<void (uint64_t)>& body,
+		 const Options& options = Options());
+
+      /** @brief Run a benchmark of a single operation
+       *
+       *  Calls f() once per iteration.  Use doNotOptimize() from
+       *  Timing.hpp on the values f() computes, so the compiler does
+       *  not remove the code under test.
+       */
+      template <typename F>
+      Result measure(const std::string& name, F f,
+		     const Options& options = Options()) {
+	return run(name, [&f](uint64_t n) {
+	    for (uint64_t i = 0; i < n; ++i) {
+	      f();
+	    }
+	  },
+	  options);
+      }
+
+      /** @brief Result of running a benchmark under several heap
+       *         layouts
+       */
+      struct LayoutResult {
+	/** @brief Name of the benchmark */
+	std::string name;
+
+	/** @brief Seed of each layout */
+	std::vector<uint64_t> seeds;
+
+	/** @brief Result of the benchmark under each layout */
+	std::vector<Result> runs;
+
+	/** @brief Statistics of the runs' medians */
+	Statistics statistics;
+
+	/** @brief Range of the runs' medians relative to the median of
+	 *         the medians.  A difference between two builds smaller
+	 *         than this is likely to be layout luck.
+	 */
+	double spread() const {
+	  return (statistics.max - statistics.min) / statistics.median;
+	}
+      };
+
+      /** @brief Returns the seed of the first layout runAcrossLayouts()
+       *         uses by default.
+       *
+       *  Read from the PISTIS_TESTING_LAYOUT_SEED environment variable,
+       *  so a run can be repeated with the same layouts or tried with
+       *  new ones.  Defaults to 1.
+       */
+      uint64_t layoutSeed();
+
+      /** @brief Run a benchmark under several randomized heap layouts.
+       *
+       *  For each layout, enables the heap layout randomization
+       *  described in AllocationHooks.hpp with its own seed, calls
+       *  setup() to allocate the data the benchmark uses and return the
+       *  body of the benchmark, disables randomization and runs the
+       *  body with run().  Allocations the body makes while it is timed
+       *  are not padded, so randomization does not add to the time
+       *  measured, but they land in the randomized heap.  The spacers
+       *  are released after each layout.
+       *
+       *  setup() must allocate everything the body uses.  Data
+       *  allocated before runAcrossLayouts() is called keeps its
+       *  layout in every run.
+       *
+       *  @param name     Name of the benchmark.  The run under each
+       *                  layout is named "name/layout-<seed>."
+       *  @param setup    Allocates the data and returns the body
+       *  @param layouts  Number of layouts to run under
+       *  @param seed     Seed of the first layout.  The others follow
+       *                  it consecutively.
+       *  @param options  How to run the benchmark under each layout
+       */
+      LayoutResult runAcrossLayouts(
+	  const std::string& name,
+	  const std::function<std::function<void (uint64_t)> ()>& setup,
+	  size_t layouts = 10, uint64_t seed = layoutSeed(),
+	  const Options& options = Options()
+      );
+
+      /** @brief Comparison of a benchmark's times under randomized
+       *         layouts between two builds
+       */
+      struct LayoutComparison {
+	/** @brief Median of the baseline's per-layout medians */
+	double baselineMedian;
+
+	/** @brief Median of the candidate's per-layout medians */
+	double candidateMedian;
+
+	/** @brief Normal approximation of the Mann-Whitney U statistic
+	 *         of the per-layout medians.  Negative if the candidate
+	 *         tends to be faster.
+	 */
+	double z;
+
+	/** @brief Whether the difference is significant at the
+	 *         requested confidence level, i.e. is not explained by
+	 *         layout alone
+	 */
+	bool significant;
+
+	/** @brief candidateMedian / baselineMedian */
+	double ratio() const { return candidateMedian / baselineMedian; }
+      };
+
+      /** @brief Decide whether the candidate's per-layout medians differ
+       *         from the baseline's by more than layout luck.
+       *
+       *  Uses a two-sided Mann-Whitney U test, which does not assume
+       *  the times are normally distributed.  Both results need at
+       *  least five or so layouts for the test to mean anything.
+       */
+      LayoutComparison compareLayouts(const LayoutResult& baseline,
+				      const LayoutResult& candidate,
+				      double confidence = 0.95);
+
+      /** @brief Read the given clock.
+       *
+       *  Convert the difference between two readings to nanoseconds
+       *  with ticksToNanoseconds().
+       */
+      uint64_t readClock(ClockType clock);
+
+      /** @brief Convert a difference between two readings of the
+       *         given clock into nanoseconds
+       */
+      double ticksToNanoseconds(ClockType clock, uint64_t ticks);
+
+      /** @brief Returns the name of the clock, as written in reports */
+      const char* clockName(ClockType clock);
+
+      /** @brief Write the result as a JSON object */
+      void writeJson(std::ostream& out, const Result& result);
+
+      /** @brief Read a result written by writeJson().
+       *
+       *  Unknown keys are ignored, so files written by newer versions
+       *  of the harness can still be read.
+       *
+       *  @returns  True if a result was read, false if the input is
+       *            not a JSON object or is missing required keys
+       */
+      bool readJson(std::istream& in, Result& result);
+
+      /** @brief Returns the directory benchmark results are saved in.
+       *
+       *  Equal to "${SCRATCH_DIR}/benchmarks," where SCRATCH_DIR is
+       *  the directory returned by getScratchDir().
+       */
+      std::string getResultDir();
+
+      /** @brief Returns the name of the file a benchmark's result is
+       *         saved in.
+       *
+       *  Characters in the benchmark's name that are not letters,
+       *  digits, '.', '-' or '_' are replaced with '_'.
+       */
+      std::string resultFilename(const std::string& benchmarkName);
+
+      /** @brief Save a result as JSON in the result directory
+       *
+       *  @returns  The full path to the file written, or an empty
+       *            string if the file could not be written
+       */
+      std::string saveResult(const Result& result);
+
+      /** @brief Returns true if benchmarks should run.
+       *
+       *  Benchmarks run when the PISTIS_TESTING_RUN_BENCHMARKS
+       *  environment variable is set to anything other than "" or "0".
+       *  "make benchmark" sets it.
+       */
+      bool enabled();
+
+    }
+  }
+}
+#endif
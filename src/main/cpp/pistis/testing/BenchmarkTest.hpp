@@ -0,0 +1,204 @@
+#ifndef __PISTIS__TESTING__BENCHMARKTEST_HPP__
+#define __PISTIS__TESTING__BENCHMARKTEST_HPP__
+
+/** @file BenchmarkTest.hpp
+ *
+ *  Running benchmarks inside Google Test tests.
+ *
+ *  Benchmarks live in the same test executables and fixtures as the
+ *  unit tests, so the code under test is set up exactly as it is
+ *  tested.  They are skipped unless benchmarks are enabled (see
+ *  bench::enabled()), and "make benchmark" runs only tests whose
+ *  names start with "Benchmark", e.g.
+ *
+ *  @code
+ *  TEST_F(MapTests, BenchmarkLookup) {
+ *    PISTIS_SKIP_UNLESS_BENCHMARKING();
+ *    bench::benchmark([this]() { doNotOptimize(map.find(key)); });
+ *  }
+ *  @endcode
+ */
+#include <pistis/testing/Benchmark.hpp>
+#include <pistis/testing/PerfBaseline.hpp>
+#include <pistis/testing/Timing.hpp>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+    namespace bench {
+
+      /** @brief Returns the full name of the current test, or an empty
+       *         string if no test is running
+       */
+      inline std::string currentTestName() {
+	const ::testing::TestInfo* info =
+	    ::testing::UnitTest::GetInstance()->current_test_info();
+	return info ? std::string(info->test_suite_name()) + "." + info->name()
+		    : std::string();
+      }
+
+      /** @brief Compare a result with its baseline, or replace the
+       *         baseline, according to baselineMode().
+       *
+       *  Fails if the result regressed, or if the baseline could not
+       *  be replaced.  Succeeds if the benchmark has no baseline, but
+       *  prints a note saying so when checking is enabled, so a
+       *  missing baseline is not mistaken for a pass.
+       */
+      inline ::testing::AssertionResult checkBaseline(
+	  const Result& result,
+	  const PerfCheckOptions& options = PerfCheckOptions()
+      ) {
+	const BaselineMode mode = baselineMode();
+	Result baseline;
+
+	if (mode == BaselineMode::UPDATE) {
+	  const std::string path = saveBaseline(result);
+	  if (path.empty()) {
+	    return ::testing::AssertionFailure()
+		<< "Could not save the baseline for " << result.name
+		<< " in " << getBaselineDir();
+	  }
+	  std::cout << "[ BASELINE ] Saved " << path << std::endl;
+	  return ::testing::AssertionSuccess();
+	} else if (mode == BaselineMode::OFF) {
+	  return ::testing::AssertionSuccess();
+	} else if (!loadBaseline(result.name, baseline)) {
+	  std::cout << "[ BASELINE ] NOTE: " << result.name << " has no "
+		    << "baseline in " << getBaselineDir() << ", so it was "
+		    << "not checked.  Run \"make perf-baseline\" to record "
+		    << "one." << std::endl;
+	  return ::testing::AssertionSuccess();
+	}
+
+	const BaselineComparison c =
+	    compareWithBaseline(baseline, result, options);
+	std::cout << "[ BASELINE ] " << result.name << ": " << c.currentMedian
+		  << " ns vs. " << c.baselineMedian << " ns (x" << c.ratio()
+		  << ", threshold +" << c.threshold << " ns)" << std::endl;
+	if (!c.regressed) {
+	  return ::testing::AssertionSuccess();
+	}
+	return ::testing::AssertionFailure()
+	    << "Performance regression in " << result.name << ": median "
+	    << c.currentMedian << " ns is more than " << c.threshold
+	    << " ns slower than the baseline median of " << c.baselineMedian
+	    << " ns";
+      }
+
+      /** @brief Report a benchmark result.
+       *
+       *  Writes a summary to std::cout, records the statistics as
+       *  properties of the current test, saves the result as JSON in
+       *  the directory returned by getResultDir() and checks it
+       *  against its baseline with checkBaseline().
+       */
+      inline void report(const Result& result) {
+	const Statistics& s = result.statistics;
+	std::cout << "[ BENCH    ] " << result.name << ": median "
+		  << s.median << " ns (MAD " << s.mad << ", "
+		  << (100.0 * s.confidence) << "% CI [" << s.medianLow
+		  << ", " << s.medianHigh << "]) over " << s.count
+		  << " samples of " << result.iterationsPerSample
+		  << " iterations" << std::endl;
+
+	if (::testing::UnitTest::GetInstance()->current_test_info()) {
+	  ::testing::Test::RecordProperty(result.name + ".median",
+					  std::to_string(s.median));
+	  ::testing::Test::RecordProperty(result.name + ".mad",
+					  std::to_string(s.mad));
+	}
+
+	if (saveResult(result).empty()) {
+	  ADD_FAILURE() << "Could not save the result of benchmark "
+			<< result.name << " in " << getResultDir();
+	}
+	EXPECT_TRUE(checkBaseline(result));
+      }
+
+      /** @brief Benchmark f() and report the result
+       *
+       *  @param name     Name of the benchmark
+       *  @param f        The operation to benchmark
+       *  @param options  How to run the benchmark
+       */
+      template <typename F>
+      Result benchmark(const std::string& name, F f,
+		       const Options& options = Options()) {
+	const Result result = measure(name, f, options);
+	report(result);
+	return result;
+      }
+
+      /** @brief Benchmark f() and report the result under the name
+       *         of the current test
+       */
+      template <typename F>
+      Result benchmark(F f, const Options& options = Options()) {
+	return benchmark(currentTestName(), f, options);
+      }
+
+      /** @brief Report a benchmark's results under several layouts.
+       *
+       *  Writes the median under each layout and the spread of the
+       *  medians to std::cout, records the median of the medians and
+       *  the spread as properties of the current test and saves the
+       *  result under each layout as JSON in the directory returned by
+       *  getResultDir().  Does not check baselines, since the runs are
+       *  meant to be compared with compareLayouts().
+       */
+      inline void reportLayouts(const LayoutResult& result) {
+	const Statistics& s = result.statistics;
+	for (const Result& run : result.runs) {
+	  std::cout << "[ LAYOUT   ] " << run.name << ": median "
+		    << run.statistics.median << " ns (MAD "
+		    << run.statistics.mad << ")" << std::endl;
+	  if (saveResult(run).empty()) {
+	    ADD_FAILURE() << "Could not save the result of benchmark "
+			  << run.name << " in " << getResultDir();
+	  }
+	}
+	std::cout << "[ BENCH    ] " << result.name << ": median "
+		  << s.median << " ns over " << s.count << " layouts, range ["
+		  << s.min << ", " << s.max << "], spread "
+		  << (100.0 * result.spread()) << "%" << std::endl;
+
+	if (::testing::UnitTest::GetInstance()->current_test_info()) {
+	  ::testing::Test::RecordProperty(result.name + ".median",
+					  std::to_string(s.median));
+	  ::testing::Test::RecordProperty(result.name + ".spread",
+					  std::to_string(result.spread()));
+	}
+      }
+
+      /** @brief Run a benchmark under several randomized heap layouts
+       *         and report the result.
+       *
+       *  See runAcrossLayouts() for the meaning of the arguments.
+       */
+      inline LayoutResult benchmarkAcrossLayouts(
+	  const std::string& name,
+	  const std::function<std::function<void (uint64_t)> ()>& setup,
+	  size_t layouts = 10, const Options& options = Options()
+      ) {
+	const LayoutResult result =
+	    runAcrossLayouts(name, setup, layouts, layoutSeed(), options);
+	reportLayouts(result);
+	return result;
+      }
+
+    }
+  }
+}
+
+/** @brief Skip the current test unless benchmarks are enabled */
+#define PISTIS_SKIP_UNLESS_BENCHMARKING()				\
+  if (!::pistis::testing::bench::enabled())				\
+    GTEST_SKIP() << "Benchmarks are disabled.  Run \"make benchmark\" "	\
+		 << "or set PISTIS_TESTING_RUN_BENCHMARKS=1 to run them"
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef __PISTIS__TESTING__CONTAINERS_HPP__
+#define __PISTIS__TESTING__CONTAINERS_HPP__
+
+/** @file Containers.hpp
+ *
+ *  Functions for testing that container moves and swaps take constant
+ *  time
+ */
+#include <pistis/testing/AllocationScope.hpp>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+    namespace containers {
+
+      // A container move or swap takes constant time when it hands the
+      // source's memory to the destination instead of copying or moving
+      // its elements.  These tests detect an O(n) move or swap by
+      // checking that every element is still at the same address
+      // afterwards and that the operation did not allocate memory.
+      // The allocation count covers the whole process; see
+      // AllocationScope.
+
+      /** @brief Returns the addresses of the elements of a container,
+       *         in iteration order
+       */
+      template <typename Container>
+      std::vector<const void*> elementAddresses(const Container& c) {
+	std::vector<const void*> addresses;
+	for (const auto& x : c) {
+	  addresses.push_back(std::addressof(x));
+	}
+	return addresses;
+      }
+
+      /** @brief Test that move construction takes the source's elements
+       *         without copying them or allocating memory
+       */
+      template <typename ContainerFactory>
+      void testMoveConstructionIsConstantTime(
+          ContainerFactory createContainer
+      ) {
+	SCOPED_TRACE("testMoveConstructionIsConstantTime");
+	auto source = createContainer();
+	typedef decltype(source) Container;
+	const std::vector<const void*> truth = elementAddresses(source);
+	ASSERT_FALSE(truth.empty());
+
+	uint64_t allocations = 0;
+	{
+	  AllocationScope scope;
+	  Container destination(std::move(source));
+	  allocations = scope.allocations();
+	  EXPECT_EQ(truth, elementAddresses(destination));
+	}
+	EXPECT_EQ(0, allocations);
+      }
+
+      /** @brief Test that move assignment takes the source's elements
+       *         without copying them or allocating memory
+       *
+       *  createSource() and createDestination() must create non-empty
+       *  containers of the same type.  For a container whose allocator
+       *  does not propagate on move assignment, the test passes only
+       *  if the two containers' allocators compare equal.
+       */
+      template <typename SourceFactory, typename DestinationFactory>
+      void testMoveAssignmentIsConstantTime(
+          SourceFactory createSource, DestinationFactory createDestination
+      ) {
+	SCOPED_TRACE("testMoveAssignmentIsConstantTime");
+	auto source = createSource();
+	auto destination = createDestination();
+	const std::vector<const void*> truth = elementAddresses(source);
+	ASSERT_FALSE(truth.empty());
+
+	uint64_t allocations = 0;
+	{
+	  AllocationScope scope;
+	  destination = std::move(source);
+	  allocations = scope.allocations();
+	}
+	EXPECT_EQ(truth, elementAddresses(destination));
+	EXPECT_EQ(0, allocations);
+      }
+
+      /** @brief Test that swap exchanges the containers' elements without
+       *         copying them or allocating memory
+       *
+       *  Swapping two containers whose allocators do not propagate on
+       *  swap and do not compare equal is undefined behavior, so do
+       *  not call this function with such containers.
+       */
+      template <typename FirstFactory, typename SecondFactory>
+      void testSwapIsConstantTime(FirstFactory createFirst,
+				  SecondFactory createSecond) {
+	SCOPED_TRACE("testSwapIsConstantTime");
+	auto first = createFirst();
+	auto second = createSecond();
+	const std::vector<const void*> firstTruth = elementAddresses(first);
+	const std::vector<const void*> secondTruth = elementAddresses(second);
+
+	uint64_t allocations = 0;
+	{
+	  AllocationScope scope;
+	  using std::swap;
+	  swap(first, second);
+	  allocations = scope.allocations();
+	}
+	EXPECT_EQ(secondTruth, elementAddresses(first));
+	EXPECT_EQ(firstTruth, elementAddresses(second));
+	EXPECT_EQ(0, allocations);
+      }
+
+      /** @brief Test that move construction, move assignment and swap
+       *         all take constant time.
+       *
+       *  The containers createContainer() returns must be non-empty and
+       *  have allocators that compare equal or propagate.
+       */
+      template <typename ContainerFactory>
+      void testConstantTimeMovesAndSwaps(ContainerFactory createContainer) {
+	SCOPED_TRACE("testConstantTimeMovesAndSwaps");
+	testMoveConstructionIsConstantTime(createContainer);
+	testMoveAssignmentIsConstantTime(createContainer, createContainer);
+	testSwapIsConstantTime(createContainer, createContainer);
+      }
+
+    }
+  }
+}
+#endif
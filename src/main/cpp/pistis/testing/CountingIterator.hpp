@@ -0,0 +1,217 @@
+#ifndef __PISTIS__TESTING__COUNTINGITERATOR_HPP__
+#define __PISTIS__TESTING__COUNTINGITERATOR_HPP__
+
+/** @file CountingIterator.hpp
+ *
+ *  Iterator adapter that counts the operations performed on it
+ */
+#include <iterator>
+#include <memory>
+#include <stdint.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Number of operations performed on one or more
+     *         CountingIterators
+     */
+    struct IteratorOperationCounts {
+      /** @brief Calls to prefix or postfix operator++ */
+      uint64_t increments;
+
+      /** @brief Calls to prefix or postfix operator-- */
+      uint64_t decrements;
+
+      /** @brief Calls to operator*, operator-> or operator[] */
+      uint64_t dereferences;
+
+      /** @brief Calls to ==, !=, <, <=, > or >= */
+      uint64_t comparisons;
+
+      /** @brief Calls to +=, -=, + or - with an offset */
+      uint64_t jumps;
+
+      /** @brief Calls to operator- between two iterators */
+      uint64_t differences;
+
+      IteratorOperationCounts() { reset(); }
+
+      /** @brief Total number of operations of all kinds */
+      uint64_t total() const {
+	return increments + decrements + dereferences + comparisons + jumps +
+	       differences;
+      }
+
+      void reset() {
+	increments = 0;
+	decrements = 0;
+	dereferences = 0;
+	comparisons = 0;
+	jumps = 0;
+	differences = 0;
+      }
+    };
+
+    /** @brief Wraps an iterator and counts the operations performed on
+     *         it.
+     *
+     *  CountingIterator has the same category, value type and
+     *  reference type as the iterator it wraps.  Each operation
+     *  performed on it adds one to the corresponding field of an
+     *  IteratorOperationCounts instance shared by all copies of the
+     *  iterator.  The counts do not belong to the iterator, and must
+     *  outlive it.
+     *
+     *  Build the iterator under test on top of a CountingIterator to
+     *  see how many operations on the underlying sequence each of its
+     *  own operations performs, e.g. to detect a random access
+     *  iterator whose operator+= is implemented with a loop.
+     */
+    template <typename Iterator>
+    class CountingIterator {
+    private:
+      typedef std::iterator_traits<Iterator> Traits;
+
+    public:
+      typedef typename Traits::iterator_category iterator_category;
+      typedef typename Traits::value_type value_type;
+      typedef typename Traits::difference_type difference_type;
+      typedef typename Traits::pointer pointer;
+      typedef typename Traits::reference reference;
+
+    public:
+      CountingIterator(): it_(), counts_(nullptr) { }
+      CountingIterator(Iterator it, IteratorOperationCounts* counts):
+	  it_(it), counts_(counts) {
+      }
+
+      /** @brief The wrapped iterator */
+      const Iterator& base() const { return it_; }
+
+      /** @brief Counts shared by this iterator and its copies */
+      IteratorOperationCounts* counts() const { return counts_; }
+
+      reference operator*() const {
+	++counts_->dereferences;
+	return *it_;
+      }
+
+      pointer operator->() const {
+	++counts_->dereferences;
+	return std::addressof(*it_);
+      }
+
+      reference operator[](difference_type n) const {
+	++counts_->dereferences;
+	return it_[n];
+      }
+
+      CountingIterator& operator++() {
+	++counts_->increments;
+	++it_;
+	return *this;
+      }
+
+      CountingIterator operator++(int) {
+	CountingIterator tmp(*this);
+	++counts_->increments;
+	++it_;
+	return tmp;
+      }
+
+      CountingIterator& operator--() {
+	++counts_->decrements;
+	--it_;
+	return *this;
+      }
+
+      CountingIterator operator--(int) {
+	CountingIterator tmp(*this);
+	++counts_->decrements;
+	--it_;
+	return tmp;
+      }
+
+      CountingIterator& operator+=(difference_type n) {
+	++counts_->jumps;
+	it_ += n;
+	return *this;
+      }
+
+      CountingIterator& operator-=(difference_type n) {
+	++counts_->jumps;
+	it_ -= n;
+	return *this;
+      }
+
+      CountingIterator operator+(difference_type n) const {
+	++counts_->jumps;
+	return CountingIterator(it_ + n, counts_);
+      }
+
+      CountingIterator operator-(difference_type n) const {
+	++counts_->jumps;
+	return CountingIterator(it_ - n, counts_);
+      }
+
+      difference_type operator-(const CountingIterator& other) const {
+	++counts_->differences;
+	return it_ - other.it_;
+      }
+
+      bool operator==(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ == other.it_;
+      }
+
+      bool operator!=(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ != other.it_;
+      }
+
+      bool operator<(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ < other.it_;
+      }
+
+      bool operator<=(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ <= other.it_;
+      }
+
+      bool operator>(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ > other.it_;
+      }
+
+      bool operator>=(const CountingIterator& other) const {
+	++counts_->comparisons;
+	return it_ >= other.it_;
+      }
+
+    private:
+      Iterator it_;
+      IteratorOperationCounts* counts_;
+    };
+
+    template <typename Iterator>
+    inline CountingIterator<Iterator> operator+(
+	typename CountingIterator<Iterator>::difference_type n,
+	const CountingIterator<Iterator>& it
+    ) {
+      return it + n;
+    }
+
+    /** @brief Create a CountingIterator that records operations in
+     *         the given counts
+     */
+    template <typename Iterator>
+    inline CountingIterator<Iterator> makeCountingIterator(
+	Iterator it, IteratorOperationCounts& counts
+    ) {
+      return CountingIterator<Iterator>(it, &counts);
+    }
+
+  }
+}
+#endif
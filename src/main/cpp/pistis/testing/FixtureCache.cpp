@@ -0,0 +1,207 @@
+#include "FixtureCache.hpp"
+#include "Timing.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static size_t byteBudgetFromEnvironment() {
+    const char* value = getenv("PISTIS_FILESYSTEM_TEST_FIXTURE_CACHE_SIZE");
+    char* end = nullptr;
+    if (!value || !*value) {
+      return FixtureCache::DEFAULT_BYTE_BUDGET;
+    }
+
+    size_t budget = strtoull(value, &end, 10);
+    switch (*end) {
+      case 'G': case 'g': budget *= 1024;  // Fall through
+      case 'M': case 'm': budget *= 1024;  // Fall through
+      case 'K': case 'k': budget *= 1024; ++end; break;
+      default: break;
+    }
+
+    if ((end == value) || *end) {
+      std::cerr << "WARNING: Ignoring invalid value \"" << value
+		<< "\" for PISTIS_FILESYSTEM_TEST_FIXTURE_CACHE_SIZE"
+		<< std::endl;
+      return FixtureCache::DEFAULT_BYTE_BUDGET;
+    }
+    return budget;
+  }
+
+  static std::string demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    const std::string result(demangled ? demangled : name);
+    free(demangled);
+    return result;
+  }
+
+  static void printStatisticsAtExit() {
+    const FixtureCache& cache = FixtureCache::instance();
+    const FixtureCache::Statistics stats = cache.statistics();
+    if (stats.hits || stats.misses) {
+      cache.printStatistics(std::cerr);
+    }
+  }
+}
+
+FixtureCache::Key::Key(const ResourceView& resource, const ParserId& p,
+		       std::type_index f):
+    path(resource.path()), modifiedSeconds(0), modifiedNanoseconds(0),
+    parser(p), fixture(f) {
+  struct stat info;
+  if (!::stat(path.c_str(), &info)) {
+    modifiedSeconds = info.st_mtim.tv_sec;
+    modifiedNanoseconds = info.st_mtim.tv_nsec;
+  }
+}
+
+bool FixtureCache::Key::operator<(const Key& other) const {
+  if (path != other.path) {
+    return path < other.path;
+  } else if (modifiedSeconds != other.modifiedSeconds) {
+    return modifiedSeconds < other.modifiedSeconds;
+  } else if (modifiedNanoseconds != other.modifiedNanoseconds) {
+    return modifiedNanoseconds < other.modifiedNanoseconds;
+  } else if (parser.type != other.parser.type) {
+    return parser.type < other.parser.type;
+  } else if (parser.address != other.parser.address) {
+    return parser.address < other.parser.address;
+  }
+  return fixture < other.fixture;
+}
+
+FixtureCache::FixtureCache(size_t byteBudget):
+    byteBudget_(byteBudget), bytesCached_(0), entries_(), index_(),
+    sources_(), totals_(), mutex_() {
+}
+
+size_t FixtureCache::bytesCached() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytesCached_;
+}
+
+size_t FixtureCache::numFixtures() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+FixtureCache::Statistics FixtureCache::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return totals_;
+}
+
+void FixtureCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  bytesCached_ = 0;
+}
+
+void FixtureCache::printStatistics(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<const SourceStatistics*> sources;
+  for (const auto& source : sources_) {
+    sources.push_back(&source.second);
+  }
+  std::sort(sources.begin(), sources.end(),
+	    [](const SourceStatistics* x, const SourceStatistics* y) {
+	      return x->statistics.loadTime > y->statistics.loadTime;
+	    });
+
+  const std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(1)
+      << "Fixture cache: " << totals_.hits << " hits, " << totals_.misses
+      << " misses, " << totals_.evictions << " evictions, "
+      << (totals_.loadTime / 1e6) << " ms parsing; " << entries_.size()
+      << " fixtures (" << bytesCached_ << " of " << byteBudget_
+      << " bytes) cached" << std::endl;
+  for (const SourceStatistics* source : sources) {
+    out << "  " << std::setw(10) << (source->statistics.loadTime / 1e6)
+	<< " ms  " << source->statistics.hits << " hits, "
+	<< source->statistics.misses << " misses, "
+	<< source->statistics.evictions << " evictions  " << source->path
+	<< " [" << source->fixtureType << "]" << std::endl;
+  }
+  out.flags(flags);
+}
+
+FixtureCache& FixtureCache::instance() {
+  // Never destroyed, so fixtures outlive every test and static object
+  static FixtureCache* cache = []() {
+    FixtureCache* c = new FixtureCache(byteBudgetFromEnvironment());
+    atexit(printStatisticsAtExit);
+    return c;
+  }();
+  return *cache;
+}
+
+std::shared_ptr<const void> FixtureCache::lookup(const Key& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto i = index_.find(key);
+  if (i == index_.end()) {
+    return std::shared_ptr<const void>();
+  }
+
+  entries_.splice(entries_.begin(), entries_, i->second);
+  ++totals_.hits;
+  ++sourceFor(key).statistics.hits;
+  return i->second->fixture;
+}
+
+void FixtureCache::insert(const Key& key,
+			  const std::shared_ptr<const void>& fixture,
+			  size_t bytes, uint64_t loadTime) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SourceStatistics& source = sourceFor(key);
+
+  ++totals_.misses;
+  totals_.loadTime += loadTime;
+  ++source.statistics.misses;
+  source.statistics.loadTime += loadTime;
+
+  if ((bytes > byteBudget_) || index_.count(key)) {
+    // Too large to cache, or another thread cached it first
+    return;
+  }
+
+  entries_.push_front(Entry{ key, fixture, bytes });
+  index_.insert(std::make_pair(key, entries_.begin()));
+  bytesCached_ += bytes;
+  evictUntilWithinBudget();
+}
+
+FixtureCache::SourceStatistics& FixtureCache::sourceFor(const Key& key) {
+  auto i = sources_.find(key);
+  if (i == sources_.end()) {
+    SourceStatistics source;
+    source.path = key.path;
+    source.fixtureType = demangle(key.fixture.name());
+    i = sources_.insert(std::make_pair(key, source)).first;
+  }
+  return i->second;
+}
+
+void FixtureCache::evictUntilWithinBudget() {
+  while (bytesCached_ > byteBudget_) {
+    const Entry& victim = entries_.back();
+    ++totals_.evictions;
+    ++sourceFor(victim.key).statistics.evictions;
+    bytesCached_ -= victim.bytes;
+    index_.erase(victim.key);
+    entries_.pop_back();
+  }
+}
+
+uint64_t FixtureCache::now() {
+  return monotonicNanoseconds();
+}
@@ -0,0 +1,246 @@
+#ifndef __PISTIS__TESTING__FIXTURECACHE_HPP__
+#define __PISTIS__TESTING__FIXTURECACHE_HPP__
+
+#include <pistis/testing/ResourceView.hpp>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file FixtureCache.hpp
+ *
+ *  Process-wide cache of fixtures parsed from test resources
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Caches fixtures parsed from resources, so each one is
+     *         parsed once per test executable instead of once per
+     *         test.
+     *
+     *  A fixture is identified by the full path of its resource (see
+     *  getResourcePath()), the resource's modification time, the
+     *  parser and the type of the fixture.  Function objects are told
+     *  apart by their types, so two lambdas never share fixtures, but
+     *  two instances of the same function object class do.  Function
+     *  pointers, and std::functions that wrap them, are told apart by
+     *  the function they point to.  A std::function that wraps a
+     *  function object is identified by the type of that object.
+     *
+     *  Fixtures are shared and immutable.  get() returns a shared_ptr
+     *  to a const fixture, which stays valid after the cache evicts
+     *  it.
+     *
+     *  The cache holds at most byteBudget() bytes of fixtures, and
+     *  evicts the least-recently used fixtures to stay within it.
+     *  The size of a fixture is estimated by a caller-supplied
+     *  function, or is the size of its resource by default.  A
+     *  fixture larger than the whole budget is returned but not
+     *  cached.
+     *
+     *  The cache returned by instance() takes its budget from the
+     *  PISTIS_FILESYSTEM_TEST_FIXTURE_CACHE_SIZE environment variable,
+     *  in bytes, optionally followed by K, M or G.  The default is
+     *  256M, and 0 disables caching.  Its statistics are written to
+     *  std::cerr at exit if any fixtures were requested.
+     *
+     *  FixtureCache is thread-safe.  The parser runs without holding
+     *  the cache's lock, so two threads that miss on the same fixture
+     *  at the same time both parse it.
+     */
+    class FixtureCache {
+    public:
+      /** @brief Default value of byteBudget() for instance() */
+      static const size_t DEFAULT_BYTE_BUDGET = 256 * 1024 * 1024;
+
+      /** @brief Statistics for all fixtures, or for one resource and
+       *         parser
+       */
+      struct Statistics {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+
+	/** @brief Total time spent in parsers, in nanoseconds */
+	uint64_t loadTime;
+
+	Statistics(): hits(0), misses(0), evictions(0), loadTime(0) { }
+      };
+
+    public:
+      explicit FixtureCache(size_t byteBudget = DEFAULT_BYTE_BUDGET);
+      FixtureCache(const FixtureCache&) = delete;
+
+      /** @brief Largest number of bytes of fixtures the cache holds */
+      size_t byteBudget() const { return byteBudget_; }
+
+      /** @brief Estimated size of the fixtures in the cache */
+      size_t bytesCached() const;
+
+      /** @brief Number of fixtures in the cache */
+      size_t numFixtures() const;
+
+      /** @brief Statistics for all fixtures */
+      Statistics statistics() const;
+
+      /** @brief Get a fixture, parsing it if it is not in the cache
+       *
+       *  @param filename  Name of the resource, expanded to a full
+       *                   path by getResourcePath()
+       *  @param parse     Function object that takes a
+       *                   const ResourceView& and returns a T
+       *  @param sizeOf    Function object that takes a const T& and
+       *                   returns its size in bytes
+       *  @throws std::runtime_error  If the resource cannot be mapped.
+       *                              Exceptions thrown by parse
+       *                              propagate to the caller.
+       */
+      template <typename T, typename Parser, typename SizeFunction>
+      std::shared_ptr<const T> get(const std::string& filename,
+				   Parser parse, SizeFunction sizeOf) {
+	return getFromResource<T>(ResourceView(filename), parse, sizeOf);
+      }
+
+      /** @brief Get a fixture whose size is estimated as the size of
+       *         its resource
+       */
+      template <typename T, typename Parser>
+      std::shared_ptr<const T> get(const std::string& filename,
+				   Parser parse) {
+	const ResourceView resource(filename);
+	const size_t resourceSize = resource.size();
+	return getFromResource<T>(
+	    resource, parse,
+	    [resourceSize](const T&) { return resourceSize; }
+	);
+      }
+
+      /** @brief Remove all fixtures from the cache.  Statistics are
+       *         kept.
+       */
+      void clear();
+
+      /** @brief Write the statistics for all fixtures and for each
+       *         resource and parser, most expensive first
+       */
+      void printStatistics(std::ostream& out) const;
+
+      FixtureCache& operator=(const FixtureCache&) = delete;
+
+      /** @brief The process-wide cache */
+      static FixtureCache& instance();
+
+    private:
+      // Identifies a parser by its type and, for functions, address
+      struct ParserId {
+	std::type_index type;
+	uintptr_t address;
+      };
+
+      struct Key {
+	std::string path;
+	int64_t modifiedSeconds;
+	int64_t modifiedNanoseconds;
+	ParserId parser;
+	std::type_index fixture;
+
+	Key(const ResourceView& resource, const ParserId& p,
+	    std::type_index f);
+	bool operator<(const Key& other) const;
+      };
+
+      struct Entry {
+	Key key;
+	std::shared_ptr<const void> fixture;
+	size_t bytes;
+      };
+
+      // Per-resource statistics outlive the resource's fixtures
+      struct SourceStatistics {
+	std::string path;
+	std::string fixtureType;
+	Statistics statistics;
+      };
+
+      typedef std::list<Entry> EntryList;
+
+      size_t byteBudget_;
+      size_t bytesCached_;
+      EntryList entries_;  // Most recently used first
+      std::map<Key, EntryList::iterator> index_;
+      std::map<Key, SourceStatistics> sources_;
+      Statistics totals_;
+      mutable std::mutex mutex_;
+
+      std::shared_ptr<const void> lookup(const Key& key);
+      void insert(const Key& key, const std::shared_ptr<const void>& fixture,
+		  size_t bytes, uint64_t loadTime);
+      SourceStatistics& sourceFor(const Key& key);
+      void evictUntilWithinBudget();
+      static uint64_t now();
+
+      template <typename T, typename Parser, typename SizeFunction>
+      std::shared_ptr<const T> getFromResource(const ResourceView& resource,
+					       Parser parse,
+					       SizeFunction sizeOf) {
+	const Key key(resource, parserId(parse), std::type_index(typeid(T)));
+	std::shared_ptr<const void> fixture = lookup(key);
+
+	if (!fixture) {
+	  const uint64_t start = now();
+	  std::shared_ptr<const T> value =
+	      std::make_shared<const T>(parse(resource));
+	  const uint64_t loadTime = now() - start;
+	  insert(key, value, sizeOf(*value), loadTime);
+	  return value;
+	}
+	return std::static_pointer_cast<const T>(fixture);
+      }
+
+      template <typename Parser>
+      static ParserId parserId(const Parser&) {
+	return ParserId{ std::type_index(typeid(Parser)), 0 };
+      }
+
+      template <typename R, typename... Args>
+      static ParserId parserId(R (*parse)(Args...)) {
+	return ParserId{ std::type_index(typeid(parse)),
+			 reinterpret_cast<uintptr_t>(parse) };
+      }
+
+      template <typename R, typename... Args>
+      static ParserId parserId(const std::function<R (Args...)>& parse) {
+	typedef R (*Function)(Args...);
+	const Function* f = parse.template target<Function>();
+	return f ? parserId(*f) : ParserId{ parse.target_type(), 0 };
+      }
+    };
+
+    /** @brief Get a fixture from the process-wide cache */
+    template <typename T, typename Parser>
+    inline std::shared_ptr<const T> getCachedFixture(
+	const std::string& filename, Parser parse
+    ) {
+      return FixtureCache::instance().get<T>(filename, parse);
+    }
+
+    /** @brief Get a fixture from the process-wide cache, estimating its
+     *         size with sizeOf
+     */
+    template <typename T, typename Parser, typename SizeFunction>
+    inline std::shared_ptr<const T> getCachedFixture(
+	const std::string& filename, Parser parse, SizeFunction sizeOf
+    ) {
+      return FixtureCache::instance().get<T>(filename, parse, sizeOf);
+    }
+
+  }
+}
+#endif
@@ -0,0 +1,56 @@
+#ifndef __PISTIS__TESTING__GOLDENFILEASSERTIONS_HPP__
+#define __PISTIS__TESTING__GOLDENFILEASSERTIONS_HPP__
+
+/** @file GoldenFileAssertions.hpp
+ *
+ *  Google Test assertions that compare output files with golden
+ *  resources, e.g.
+ *
+ *  @code
+ *  pipeline.run(getTestScratchFile("out.csv"));
+ *  EXPECT_FILE_MATCHES_GOLDEN(getTestScratchFile("out.csv"),
+ *                             "pipeline/expected.csv");
+ *  @endcode
+ *
+ *  The actual file is resolved with getScratchFile() and the golden
+ *  file with getResourcePath().  Files of any size can be compared
+ *  (see compareFiles()).  On failure, the message shows the offset,
+ *  line and column of the first difference and the bytes around it.
+ */
+#include <pistis/testing/GoldenFiles.hpp>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Verify the scratch file actual has the same contents as
+     *         the golden resource
+     */
+    inline ::testing::AssertionResult checkFileMatchesGolden(
+	const std::string& actual, const std::string& golden
+    ) {
+      try {
+	const FileComparison comparison = compareWithGolden(actual, golden);
+	if (comparison.identical) {
+	  return ::testing::AssertionSuccess();
+	}
+	return ::testing::AssertionFailure() << comparison.description;
+      } catch (const std::runtime_error& e) {
+	return ::testing::AssertionFailure() << e.what();
+      }
+    }
+
+  }
+}
+
+/** @brief Expect the scratch file to match the golden resource */
+#define EXPECT_FILE_MATCHES_GOLDEN(actual, golden)			\
+  EXPECT_TRUE(::pistis::testing::checkFileMatchesGolden((actual), (golden)))
+
+/** @brief Assert the scratch file matches the golden resource */
+#define ASSERT_FILE_MATCHES_GOLDEN(actual, golden)			\
+  ASSERT_TRUE(::pistis::testing::checkFileMatchesGolden((actual), (golden)))
+
+#endif
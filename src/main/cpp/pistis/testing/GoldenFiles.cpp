@@ -0,0 +1,226 @@
+#include "GoldenFiles.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace pistis::testing;
+
+namespace {
+  // Bytes compared per call to memcmp()
+  static const size_t COMPARE_CHUNK_SIZE = 256 * 1024;
+
+  // Compared pages are released in blocks of this size
+  static const size_t RELEASE_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path):
+	path_(path), data_(nullptr), size_(0) {
+      const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat info;
+      if (fd < 0) {
+	throw error("open");
+      } else if (::fstat(fd, &info)) {
+	const std::runtime_error e = error("stat");
+	::close(fd);
+	throw e;
+      }
+
+      size_ = size_t(info.st_size);
+      if (size_) {
+	void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+	  const std::runtime_error e = error("map");
+	  ::close(fd);
+	  throw e;
+	}
+	data_ = (const uint8_t*)p;
+	::madvise(p, size_, MADV_SEQUENTIAL);
+      }
+      ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+
+    ~MappedFile() {
+      if (data_) {
+	::munmap((void*)data_, size_);
+      }
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Tell the kernel the pages in [0, end) are no longer needed
+    void release(size_t end) const {
+      const size_t pageSize = size_t(::sysconf(_SC_PAGESIZE));
+      end -= end % pageSize;
+      if (data_ && end) {
+	::madvise((void*)data_, end, MADV_DONTNEED);
+      }
+    }
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+  private:
+    std::string path_;
+    const uint8_t* data_;
+    size_t size_;
+
+    std::runtime_error error(const char* operation) const {
+      std::ostringstream msg;
+      msg << "Cannot " << operation << " " << path_ << " ("
+	  << strerror(errno) << ")";
+      return std::runtime_error(msg.str());
+    }
+  };
+
+  // Where two files first differ, and the line it is on
+  struct Mismatch {
+    size_t offset;
+    uint64_t line;
+    size_t lineStart;
+  };
+
+  // Counts the newlines in data[begin, end), and records the offset
+  // just past the last one in lineStart
+  static void countLines(const uint8_t* data, size_t begin, size_t end,
+			 uint64_t& line, size_t& lineStart) {
+    while (const void* newline = memchr(data + begin, '\n', end - begin)) {
+      ++line;
+      begin = (const uint8_t*)newline - data + 1;
+      lineStart = begin;
+    }
+  }
+
+  // Lines are counted chunk by chunk as the files are compared, so the
+  // chunks are never touched again after they are released
+  static Mismatch findMismatch(const MappedFile& actual,
+			       const MappedFile& expected) {
+    const size_t n = std::min(actual.size(), expected.size());
+    const uint8_t* a = actual.data();
+    const uint8_t* e = expected.data();
+    size_t released = 0;
+    Mismatch mismatch{ n, 1, 0 };
+
+    for (size_t offset = 0; offset < n; offset += COMPARE_CHUNK_SIZE) {
+      const size_t chunk = std::min(COMPARE_CHUNK_SIZE, n - offset);
+      if (memcmp(a + offset, e + offset, chunk)) {
+	mismatch.offset = size_t(std::mismatch(a + offset, a + offset + chunk,
+					       e + offset).first - a);
+	countLines(a, offset, mismatch.offset, mismatch.line,
+		   mismatch.lineStart);
+	return mismatch;
+      }
+      countLines(a, offset, offset + chunk, mismatch.line,
+		 mismatch.lineStart);
+      if ((offset - released) >= RELEASE_BLOCK_SIZE) {
+	actual.release(offset);
+	expected.release(offset);
+	released = offset;
+      }
+    }
+    return mismatch;
+  }
+
+  static void writeEscaped(std::ostream& out, const uint8_t* data,
+			   size_t begin, size_t end) {
+    out << '"';
+    for (size_t i = begin; i < end; ++i) {
+      const uint8_t c = data[i];
+      if (c == '\n') {
+	out << "\\n";
+      } else if (c == '\t') {
+	out << "\\t";
+      } else if (c == '"' || c == '\\') {
+	out << '\\' << char(c);
+      } else if ((c < 0x20) || (c >= 0x7F)) {
+	out << "\\x" << std::hex << std::setw(2) << std::setfill('0')
+	    << int(c) << std::dec << std::setfill(' ');
+      } else {
+	out << char(c);
+      }
+    }
+    out << '"';
+  }
+
+  static void writeHex(std::ostream& out, const uint8_t* data, size_t begin,
+		       size_t end, size_t mismatch) {
+    out << std::hex << std::setfill('0');
+    for (size_t i = begin; i < end; ++i) {
+      out << ((i == mismatch) ? '[' : ' ') << std::setw(2) << int(data[i])
+	  << ((i == mismatch) ? ']' : ' ');
+    }
+    out << std::dec << std::setfill(' ');
+  }
+
+  static void describeFile(std::ostream& out, const char* label,
+			   const MappedFile& file, size_t begin,
+			   size_t mismatch, size_t contextSize) {
+    const size_t end = std::min(file.size(), mismatch + contextSize);
+    const size_t start = std::min(begin, end);
+    out << "\n  " << label << " text: ";
+    writeEscaped(out, file.data(), start, end);
+    if (mismatch >= file.size()) {
+      out << " <end of file>";
+    }
+    out << "\n  " << label << " hex: ";
+    writeHex(out, file.data(), start, end, mismatch);
+  }
+}
+
+FileComparison pistis::testing::compareFiles(const std::string& actualPath,
+					     const std::string& expectedPath,
+					     size_t contextSize) {
+  const MappedFile actual(actualPath);
+  const MappedFile expected(expectedPath);
+  FileComparison result;
+
+  result.actualSize = actual.size();
+  result.expectedSize = expected.size();
+  const Mismatch mismatch = findMismatch(actual, expected);
+  result.mismatchOffset = mismatch.offset;
+  result.identical = (actual.size() == expected.size()) &&
+		     (mismatch.offset == actual.size());
+  result.line = 1;
+  result.column = 1;
+  if (result.identical) {
+    return result;
+  }
+
+  const size_t offset = mismatch.offset;
+  result.line = mismatch.line;
+  result.column = offset - mismatch.lineStart + 1;
+
+  std::ostringstream msg;
+  const size_t begin = (offset > contextSize) ? offset - contextSize : 0;
+  msg << actualPath << " differs from " << expectedPath << " at offset "
+      << offset << " (line " << result.line << ", column " << result.column
+      << ")";
+  if (offset == std::min(actual.size(), expected.size())) {
+    msg << ": " << ((actual.size() < expected.size()) ? "actual" : "expected")
+	<< " file ends first (actual has " << actual.size()
+	<< " bytes, expected has " << expected.size() << ")";
+  }
+  describeFile(msg, "expected", expected, begin, offset, contextSize);
+  describeFile(msg, "actual  ", actual, begin, offset, contextSize);
+  result.description = msg.str();
+  return result;
+}
+
+FileComparison pistis::testing::compareWithGolden(const std::string& actual,
+						  const std::string& golden,
+						  size_t contextSize) {
+  return compareFiles(getScratchFile(actual), getResourcePath(golden),
+		      contextSize);
+}
@@ -0,0 +1,76 @@
+#ifndef __PISTIS__TESTING__GOLDENFILES_HPP__
+#define __PISTIS__TESTING__GOLDENFILES_HPP__
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file GoldenFiles.hpp
+ *
+ *  Comparing test output with golden files
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Outcome of comparing two files */
+    struct FileComparison {
+      /** @brief True if the files have the same contents */
+      bool identical;
+
+      /** @brief Size of the actual file, in bytes */
+      uint64_t actualSize;
+
+      /** @brief Size of the expected file, in bytes */
+      uint64_t expectedSize;
+
+      /** @brief Offset of the first byte that differs, or the size of
+       *         the shorter file if it is a prefix of the longer one.
+       *         Equal to actualSize if the files are identical.
+       */
+      uint64_t mismatchOffset;
+
+      /** @brief Line of the first mismatch, counting from 1 */
+      uint64_t line;
+
+      /** @brief Column of the first mismatch, counting from 1 */
+      uint64_t column;
+
+      /** @brief Description of the mismatch, with the bytes around it
+       *         from both files as escaped text and hex.  Empty if the
+       *         files are identical.
+       */
+      std::string description;
+    };
+
+    /** @brief Compare two files without reading them into memory.
+     *
+     *  Both files are mapped read-only and compared a chunk at a time
+     *  with memcmp(), which the C library vectorizes.  Pages are
+     *  released as soon as they have been compared, so files of any
+     *  size can be compared with little memory.  Lines are counted
+     *  a chunk at a time as the chunks are compared, before their
+     *  pages are released.
+     *
+     *  @param actualPath    Full path to the file under test
+     *  @param expectedPath  Full path to the golden file
+     *  @param contextSize   Number of bytes of each file to show on
+     *                       either side of the first mismatch
+     *  @throws std::runtime_error  If either file cannot be opened or
+     *                              mapped
+     */
+    FileComparison compareFiles(const std::string& actualPath,
+				const std::string& expectedPath,
+				size_t contextSize = 16);
+
+    /** @brief Compare a scratch file with a golden resource.
+     *
+     *  Same as compareFiles(getScratchFile(actual),
+     *  getResourcePath(golden), contextSize).
+     */
+    FileComparison compareWithGolden(const std::string& actual,
+				     const std::string& golden,
+				     size_t contextSize = 16);
+
+  }
+}
+#endif
@@ -0,0 +1,433 @@
+#ifndef __PISTIS__TESTING__ITERATORBENCHMARKS_HPP__
+#define __PISTIS__TESTING__ITERATORBENCHMARKS_HPP__
+
+/** @file IteratorBenchmarks.hpp
+ *
+ *  Microbenchmarks for iterators, driven by the same factories as the
+ *  conformance tests in Iterators.hpp
+ */
+#include <pistis/testing/Timing.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+    namespace iterators {
+
+      // Each benchmark takes the start and end iterator factories and
+      // the truth sequence that would be passed to the corresponding
+      // test function, e.g. benchmarkRandomAccessIterator() takes the
+      // arguments of testRandomAccessIterator().  It times each
+      // operation on the iterator under test and on a
+      // std::vector<ValueType>::const_iterator over a copy of the truth
+      // sequence, which serves as the baseline, and reports the time
+      // per element of both.  The results are written to std::cout and
+      // recorded as properties of the current test, so they appear in
+      // gtest's XML and JSON output.
+
+      /** @brief Timing of one operation */
+      struct IteratorBenchmarkResult {
+	/** @brief Name of the operation */
+	std::string operation;
+
+	/** @brief Time per element for the iterator under test, in
+	 *         nanoseconds
+	 */
+	double nsPerElement;
+
+	/** @brief Time per element for the baseline iterator, in
+	 *         nanoseconds
+	 */
+	double baselineNsPerElement;
+
+	/** @brief How many times slower the iterator under test is than
+	 *         the baseline
+	 */
+	double ratio() const {
+	  return nsPerElement / std::max(baselineNsPerElement, 1e-3);
+	}
+      };
+
+      typedef std::vector<IteratorBenchmarkResult> IteratorBenchmarkResults;
+
+      /** @brief Parameters for the iterator benchmarks */
+      struct IteratorBenchmarkOptions {
+	/** @brief Number of times to time each operation.  The fastest
+	 *         time is reported.
+	 */
+	size_t repetitions;
+
+	/** @brief Whether to write the results to std::cout */
+	bool print;
+
+	IteratorBenchmarkOptions(size_t r = 10, bool p = true):
+	    repetitions(r), print(p) {
+	}
+      };
+
+      /** @brief Returns the fastest time per element of f(), which
+       *         processes n elements, over the given number of
+       *         repetitions
+       */
+      template <typename F>
+      double timePerElement(size_t n, size_t repetitions, F f) {
+	uint64_t best = ~uint64_t(0);
+	for (size_t i = 0; i < std::max(repetitions, size_t(1)); ++i) {
+	  const uint64_t start = monotonicNanoseconds();
+	  f();
+	  best = std::min(best, monotonicNanoseconds() - start);
+	}
+	return double(best) / double(n ? n : 1);
+      }
+
+      template <typename Iterator>
+      double timePreincrement(Iterator start, Iterator end, size_t n,
+			      size_t repetitions) {
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  for (Iterator i = start; i != end; ++i) {
+	    clobberMemory();
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timePostincrement(Iterator start, Iterator end, size_t n,
+			       size_t repetitions) {
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  for (Iterator i = start; i != end; i++) {
+	    clobberMemory();
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timePredecrement(Iterator start, Iterator end, size_t n,
+			      size_t repetitions) {
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  for (Iterator i = end; i != start; --i) {
+	    clobberMemory();
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timePostdecrement(Iterator start, Iterator end, size_t n,
+			       size_t repetitions) {
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  for (Iterator i = end; i != start; i--) {
+	    clobberMemory();
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timeDereference(Iterator it, size_t n, size_t repetitions) {
+	return timePerElement(n, repetitions, [&it, n]() {
+	  for (size_t i = 0; i < n; ++i) {
+	    doNotOptimize(*it);
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timeTraversal(Iterator start, Iterator end, size_t n,
+			   size_t repetitions) {
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  for (Iterator i = start; i != end; ++i) {
+	    doNotOptimize(*i);
+	  }
+	});
+      }
+
+      template <typename Iterator>
+      double timeRandomJumps(Iterator start,
+			     const std::vector<ptrdiff_t>& offsets,
+			     size_t repetitions) {
+	return timePerElement(offsets.size(), repetitions,
+			      [&start, &offsets]() {
+	  for (ptrdiff_t offset : offsets) {
+	    doNotOptimize(*(start + offset));
+	  }
+	});
+      }
+
+      /** @brief Time summing the elements in [start, end).
+       *
+       *  The loop has the shape compilers vectorize, so comparing
+       *  the time per element with the same loop over raw pointers
+       *  shows whether the iterator still vectorizes.  Floating-point
+       *  sums only vectorize with -ffast-math or similar, so use an
+       *  integer value type to check.
+       */
+      template <typename Iterator>
+      double timeReduction(Iterator start, Iterator end, size_t n,
+			   size_t repetitions) {
+	typedef typename std::iterator_traits<Iterator>::value_type Value;
+	return timePerElement(n, repetitions, [&start, &end]() {
+	  Value sum = Value();
+	  for (Iterator i = start; i != end; ++i) {
+	    sum += *i;
+	  }
+	  doNotOptimize(sum);
+	});
+      }
+
+      /** @brief Returns n pseudo-random offsets in [0, n).
+       *
+       *  The offsets are the same on every call, so benchmarks are
+       *  repeatable.
+       */
+      inline std::vector<ptrdiff_t> randomOffsets(size_t n) {
+	std::vector<ptrdiff_t> offsets;
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	offsets.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+	  state ^= state << 13;
+	  state ^= state >> 7;
+	  state ^= state << 17;
+	  offsets.push_back(ptrdiff_t(state % n));
+	}
+	return offsets;
+      }
+
+      /** @brief Write benchmark results as a table */
+      inline void printIteratorBenchmarkResults(
+	  std::ostream& out, const IteratorBenchmarkResults& results
+      ) {
+	out << std::left << std::setw(16) << "operation"
+	    << std::right << std::setw(14) << "ns/element"
+	    << std::setw(14) << "baseline" << std::setw(10) << "ratio"
+	    << std::endl;
+	for (const auto& r : results) {
+	  out << std::left << std::setw(16) << r.operation << std::right
+	      << std::fixed << std::setprecision(3)
+	      << std::setw(14) << r.nsPerElement
+	      << std::setw(14) << r.baselineNsPerElement
+	      << std::setprecision(2) << std::setw(10) << r.ratio()
+	      << std::endl;
+	}
+	out.unsetf(std::ios::floatfield);
+      }
+
+      /** @brief Record the results as properties of the current test
+       *         and print them if requested
+       */
+      inline void reportIteratorBenchmarkResults(
+	  const std::string& name, const IteratorBenchmarkResults& results,
+	  const IteratorBenchmarkOptions& options
+      ) {
+	if (::testing::UnitTest::GetInstance()->current_test_info()) {
+	  for (const auto& r : results) {
+	    ::testing::Test::RecordProperty(
+		name + "." + r.operation + ".nsPerElement",
+		std::to_string(r.nsPerElement)
+	    );
+	    ::testing::Test::RecordProperty(
+		name + "." + r.operation + ".ratio", std::to_string(r.ratio())
+	    );
+	  }
+	}
+	if (options.print) {
+	  std::cout << name << ":" << std::endl;
+	  printIteratorBenchmarkResults(std::cout, results);
+	}
+      }
+
+      /** @brief The type of the elements of a truth sequence */
+      template <typename Sequence>
+      struct SequenceValue {
+	typedef typename std::remove_cv<
+	    typename std::remove_reference<
+		decltype(*std::declval<const Sequence&>().begin())
+	    >::type
+	>::type type;
+      };
+
+      template <typename Sequence>
+      std::vector<typename SequenceValue<Sequence>::type>
+	  makeBaselineSequence(const Sequence& truth) {
+	return std::vector<typename SequenceValue<Sequence>::type>(
+	    truth.begin(), truth.end()
+	);
+      }
+
+      template <typename Iterator, typename BaselineIterator>
+      void benchmarkForwardOperations(Iterator start, Iterator end,
+				      BaselineIterator baseStart,
+				      BaselineIterator baseEnd, size_t n,
+				      size_t repetitions,
+				      IteratorBenchmarkResults& results) {
+	results.push_back(IteratorBenchmarkResult{
+	    "preincrement", timePreincrement(start, end, n, repetitions),
+	    timePreincrement(baseStart, baseEnd, n, repetitions)
+	});
+	results.push_back(IteratorBenchmarkResult{
+	    "postincrement", timePostincrement(start, end, n, repetitions),
+	    timePostincrement(baseStart, baseEnd, n, repetitions)
+	});
+	results.push_back(IteratorBenchmarkResult{
+	    "dereference", timeDereference(start, n, repetitions),
+	    timeDereference(baseStart, n, repetitions)
+	});
+	results.push_back(IteratorBenchmarkResult{
+	    "traversal", timeTraversal(start, end, n, repetitions),
+	    timeTraversal(baseStart, baseEnd, n, repetitions)
+	});
+      }
+
+      template <typename Iterator, typename BaselineIterator>
+      void benchmarkBidirectionalOperations(Iterator start, Iterator end,
+					    BaselineIterator baseStart,
+					    BaselineIterator baseEnd,
+					    size_t n, size_t repetitions,
+					    IteratorBenchmarkResults& results) {
+	results.push_back(IteratorBenchmarkResult{
+	    "predecrement", timePredecrement(start, end, n, repetitions),
+	    timePredecrement(baseStart, baseEnd, n, repetitions)
+	});
+	results.push_back(IteratorBenchmarkResult{
+	    "postdecrement", timePostdecrement(start, end, n, repetitions),
+	    timePostdecrement(baseStart, baseEnd, n, repetitions)
+	});
+      }
+
+      /** @brief Benchmark a forward iterator
+       *
+       *  Takes the same factories and truth sequence as
+       *  testForwardIterator()
+       */
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Sequence>
+      IteratorBenchmarkResults benchmarkForwardIterator(
+	  StartIteratorFactory createIteratorAtStart,
+	  EndIteratorFactory createIteratorAtEnd,
+	  const Sequence& truth,
+	  const IteratorBenchmarkOptions& options = IteratorBenchmarkOptions()
+      ) {
+	const auto baseline = makeBaselineSequence(truth);
+	IteratorBenchmarkResults results;
+
+	benchmarkForwardOperations(createIteratorAtStart(),
+				   createIteratorAtEnd(),
+				   baseline.cbegin(), baseline.cend(),
+				   baseline.size(), options.repetitions,
+				   results);
+	reportIteratorBenchmarkResults("benchmarkForwardIterator", results,
+				       options);
+	return results;
+      }
+
+      /** @brief Benchmark a bidirectional iterator
+       *
+       *  Takes the same factories and truth sequence as
+       *  testBidirectionalIterator()
+       */
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Sequence>
+      IteratorBenchmarkResults benchmarkBidirectionalIterator(
+	  StartIteratorFactory createIteratorAtStart,
+	  EndIteratorFactory createIteratorAtEnd,
+	  const Sequence& truth,
+	  const IteratorBenchmarkOptions& options = IteratorBenchmarkOptions()
+      ) {
+	const auto baseline = makeBaselineSequence(truth);
+	const auto start = createIteratorAtStart();
+	const auto end = createIteratorAtEnd();
+	IteratorBenchmarkResults results;
+
+	benchmarkForwardOperations(start, end, baseline.cbegin(),
+				   baseline.cend(), baseline.size(),
+				   options.repetitions, results);
+	benchmarkBidirectionalOperations(start, end, baseline.cbegin(),
+					 baseline.cend(), baseline.size(),
+					 options.repetitions, results);
+	reportIteratorBenchmarkResults("benchmarkBidirectionalIterator",
+				       results, options);
+	return results;
+      }
+
+      /** @brief Benchmark a random access iterator
+       *
+       *  Takes the same factories and truth sequence as
+       *  testRandomAccessIterator()
+       */
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Sequence>
+      IteratorBenchmarkResults benchmarkRandomAccessIterator(
+	  StartIteratorFactory createIteratorAtStart,
+	  EndIteratorFactory createIteratorAtEnd,
+	  const Sequence& truth,
+	  const IteratorBenchmarkOptions& options = IteratorBenchmarkOptions()
+      ) {
+	const auto baseline = makeBaselineSequence(truth);
+	const auto start = createIteratorAtStart();
+	const auto end = createIteratorAtEnd();
+	const std::vector<ptrdiff_t> offsets = randomOffsets(baseline.size());
+	IteratorBenchmarkResults results;
+
+	benchmarkForwardOperations(start, end, baseline.cbegin(),
+				   baseline.cend(), baseline.size(),
+				   options.repetitions, results);
+	benchmarkBidirectionalOperations(start, end, baseline.cbegin(),
+					 baseline.cend(), baseline.size(),
+					 options.repetitions, results);
+	results.push_back(IteratorBenchmarkResult{
+	    "randomJump", timeRandomJumps(start, offsets, options.repetitions),
+	    timeRandomJumps(baseline.cbegin(), offsets, options.repetitions)
+	});
+	reportIteratorBenchmarkResults("benchmarkRandomAccessIterator",
+				       results, options);
+	return results;
+      }
+
+      /** @brief Benchmark a contiguous iterator
+       *
+       *  Takes the same factories and truth sequence as
+       *  testContiguousIterator().  In addition to the operations
+       *  benchmarkRandomAccessIterator() times, it times a sum of the
+       *  elements ("reduction").  The baseline for the reduction is the
+       *  same loop over raw pointers to the iterator's own elements, so
+       *  a ratio well above 1 in an optimized build means the iterator
+       *  no longer collapses to a pointer and the loop over it is not
+       *  vectorized.
+       */
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Sequence>
+      IteratorBenchmarkResults benchmarkContiguousIterator(
+	  StartIteratorFactory createIteratorAtStart,
+	  EndIteratorFactory createIteratorAtEnd,
+	  const Sequence& truth,
+	  const IteratorBenchmarkOptions& options = IteratorBenchmarkOptions()
+      ) {
+	IteratorBenchmarkResults results = benchmarkRandomAccessIterator(
+	    createIteratorAtStart, createIteratorAtEnd, truth,
+	    IteratorBenchmarkOptions(options.repetitions, false)
+	);
+	const auto start = createIteratorAtStart();
+	const auto end = createIteratorAtEnd();
+	const size_t n = end - start;
+	const auto* const first = n ? std::addressof(*start) : nullptr;
+
+	results.push_back(IteratorBenchmarkResult{
+	    "reduction", timeReduction(start, end, n, options.repetitions),
+	    timeReduction(first, first + n, n, options.repetitions)
+	});
+	reportIteratorBenchmarkResults("benchmarkContiguousIterator",
+				       results, options);
+	return results;
+      }
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,291 @@
+#ifndef __PISTIS__TESTING__ITERATORCOMPLEXITY_HPP__
+#define __PISTIS__TESTING__ITERATORCOMPLEXITY_HPP__
+
+/** @file IteratorComplexity.hpp
+ *
+ *  Functions for testing that iterator operations have the complexity
+ *  their iterator category requires
+ */
+#include <pistis/testing/CountingIterator.hpp>
+#include <pistis/testing/Timing.hpp>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+    namespace iterators {
+
+      // The complexity tests create the sequence under test at several
+      // sizes and measure the cost of each iterator operation at each
+      // size.  Operations that must take constant time fail the test
+      // if their cost at the largest size exceeds their cost at the
+      // smallest size by more than ComplexityOptions::maxGrowth.
+      // Traversals must take linear time, so their cost is divided by
+      // the sequence size before comparing.
+      //
+      // The sequence under test is created by a RangeFactory, a
+      // callable that takes a size n and returns an object with begin()
+      // and end() methods -- usually the container itself -- that
+      // holds a sequence of n elements.
+      //
+      // The cost of an operation is measured by a Meter, which is an
+      // object with a method "template <typename F> double measure(F f)"
+      // that returns the cost of one call to f().
+
+      /** @brief Parameters for the complexity tests */
+      struct ComplexityOptions {
+	/** @brief Sizes of the sequences to measure, smallest first */
+	std::vector<size_t> sizes;
+
+	/** @brief Largest allowed ratio between the cost of an operation
+	 *         on the largest and smallest sequences
+	 */
+	double maxGrowth;
+
+	ComplexityOptions():
+	    sizes{ 256, 4096, 65536 }, maxGrowth(8.0) {
+	}
+	ComplexityOptions(const std::vector<size_t>& s, double g):
+	    sizes(s), maxGrowth(g) {
+	}
+      };
+
+      /** @brief Measures cost as elapsed time, in nanoseconds.
+       *
+       *  The operation is run in batches, and the cost is the time
+       *  per call of the fastest batch, which filters out most of the
+       *  noise caused by interrupts and other processes.  Works with
+       *  any iterator, but the results are only meaningful in an
+       *  optimized build.
+       */
+      class ElapsedTimeMeter {
+      public:
+	ElapsedTimeMeter(size_t batchSize = 64, size_t numBatches = 16):
+	    batchSize_(batchSize), numBatches_(numBatches) {
+	}
+
+	template <typename F>
+	double measure(F f) const {
+	  uint64_t best = ~uint64_t(0);
+	  for (size_t i = 0; i < numBatches_; ++i) {
+	    const uint64_t start = monotonicNanoseconds();
+	    for (size_t j = 0; j < batchSize_; ++j) {
+	      f();
+	    }
+	    best = std::min(best, monotonicNanoseconds() - start);
+	  }
+	  return double(best) / double(batchSize_);
+	}
+
+      private:
+	size_t batchSize_;
+	size_t numBatches_;
+      };
+
+      /** @brief Measures cost as the number of operations performed on
+       *         CountingIterators.
+       *
+       *  Use when the iterator under test is built on top of
+       *  CountingIterators that share the given counts.  The
+       *  measurement is exact and does not depend on the build or the
+       *  machine.
+       */
+      class OperationCountMeter {
+      public:
+	OperationCountMeter(IteratorOperationCounts& counts):
+	    counts_(&counts) {
+	}
+
+	template <typename F>
+	double measure(F f) const {
+	  counts_->reset();
+	  f();
+	  return double(counts_->total());
+	}
+
+      private:
+	IteratorOperationCounts* counts_;
+      };
+
+      /** @brief Verify that costs grew by no more than maxGrowth
+       *         between the smallest and largest sequence sizes.
+       *
+       *  @param operation  Name of the operation, for the failure
+       *                    message
+       *  @param sizes      Sequence sizes
+       *  @param costs      Cost of the operation at each size
+       *  @param perElement If true, divide each cost by the sequence
+       *                    size before comparing
+       *  @param maxGrowth  Largest allowed ratio of the last cost to
+       *                    the first
+       */
+      inline ::testing::AssertionResult checkCostGrowth(
+	  const std::string& operation, const std::vector<size_t>& sizes,
+	  const std::vector<double>& costs, bool perElement, double maxGrowth
+      ) {
+	std::vector<double> normalized(costs);
+	if (perElement) {
+	  for (size_t i = 0; i < costs.size(); ++i) {
+	    normalized[i] = costs[i] / double(sizes[i] ? sizes[i] : 1);
+	  }
+	}
+
+	// Costs can be zero when the compiler removes an operation
+	// entirely or when the clock is too coarse to see it
+	const double floor = std::max(normalized.front(), 1e-3);
+	const double growth = normalized.back() / floor;
+	if (growth <= maxGrowth) {
+	  return ::testing::AssertionSuccess();
+	}
+
+	::testing::AssertionResult failure = ::testing::AssertionFailure();
+	failure << "Cost of " << operation << (perElement ? " per element" : "")
+		<< " grew by a factor of " << growth << " (more than "
+		<< maxGrowth << ") between sizes " << sizes.front() << " and "
+		<< sizes.back() << ".  Costs:";
+	for (size_t i = 0; i < sizes.size(); ++i) {
+	  failure << " [" << sizes[i] << "] " << normalized[i];
+	}
+	return failure;
+      }
+
+      /** @brief Test that traversing the sequence with the pre-increment
+       *         operator takes linear time
+       */
+      template <typename RangeFactory, typename Meter = ElapsedTimeMeter>
+      void testForwardIteratorComplexity(
+	  RangeFactory createRange,
+	  const ComplexityOptions& options = ComplexityOptions(),
+	  Meter meter = Meter()
+      ) {
+	SCOPED_TRACE("testForwardIteratorComplexity");
+	std::vector<double> traversal;
+
+	for (size_t n : options.sizes) {
+	  auto range = createRange(n);
+	  const auto start = range.begin();
+	  const auto end = range.end();
+
+	  traversal.push_back(meter.measure([&start, &end]() {
+	    for (auto i = start; i != end; ++i) {
+	      doNotOptimize(*i);
+	    }
+	  }));
+	}
+	EXPECT_TRUE(checkCostGrowth("forward traversal", options.sizes,
+				    traversal, true, options.maxGrowth));
+      }
+
+      /** @brief Test that traversing the sequence in either direction
+       *         takes linear time
+       */
+      template <typename RangeFactory, typename Meter = ElapsedTimeMeter>
+      void testBidirectionalIteratorComplexity(
+	  RangeFactory createRange,
+	  const ComplexityOptions& options = ComplexityOptions(),
+	  Meter meter = Meter()
+      ) {
+	testForwardIteratorComplexity(createRange, options, meter);
+	SCOPED_TRACE("testBidirectionalIteratorComplexity");
+	std::vector<double> traversal;
+
+	for (size_t n : options.sizes) {
+	  auto range = createRange(n);
+	  const auto start = range.begin();
+	  const auto end = range.end();
+
+	  traversal.push_back(meter.measure([&start, &end]() {
+	    for (auto i = end; i != start; ) {
+	      --i;
+	      doNotOptimize(*i);
+	    }
+	  }));
+	}
+	EXPECT_TRUE(checkCostGrowth("reverse traversal", options.sizes,
+				    traversal, true, options.maxGrowth));
+      }
+
+      /** @brief Test that jumps, differences, subscripts and relational
+       *         comparisons take constant time.
+       *
+       *  Each operation spans the whole sequence, so an implementation
+       *  that steps through the elements one at a time costs
+       *  (roughly) n times as much on a sequence of n elements.
+       */
+      template <typename RangeFactory, typename Meter = ElapsedTimeMeter>
+      void testRandomAccessIteratorComplexity(
+	  RangeFactory createRange,
+	  const ComplexityOptions& options = ComplexityOptions(),
+	  Meter meter = Meter()
+      ) {
+	testBidirectionalIteratorComplexity(createRange, options, meter);
+	SCOPED_TRACE("testRandomAccessIteratorComplexity");
+	std::vector<double> addition;
+	std::vector<double> additionAssignment;
+	std::vector<double> subtraction;
+	std::vector<double> subtractionAssignment;
+	std::vector<double> difference;
+	std::vector<double> subscript;
+	std::vector<double> comparison;
+
+	for (size_t n : options.sizes) {
+	  auto range = createRange(n);
+	  const auto start = range.begin();
+	  const auto end = range.end();
+	  typedef decltype(end - start) DifferenceType;
+	  const DifferenceType last = DifferenceType(n) - 1;
+
+	  addition.push_back(meter.measure([&start, last]() {
+	    doNotOptimize(start + last);
+	  }));
+	  additionAssignment.push_back(meter.measure([&start, last]() {
+	    auto i = start;
+	    i += last;
+	    doNotOptimize(i);
+	  }));
+	  subtraction.push_back(meter.measure([&end, last]() {
+	    doNotOptimize(end - last);
+	  }));
+	  subtractionAssignment.push_back(meter.measure([&end, last]() {
+	    auto i = end;
+	    i -= last;
+	    doNotOptimize(i);
+	  }));
+	  difference.push_back(meter.measure([&start, &end]() {
+	    doNotOptimize(end - start);
+	  }));
+	  subscript.push_back(meter.measure([&start, last]() {
+	    doNotOptimize(start[last]);
+	  }));
+	  comparison.push_back(meter.measure([&start, &end]() {
+	    doNotOptimize(start < end);
+	  }));
+	}
+
+	EXPECT_TRUE(checkCostGrowth("it + n", options.sizes, addition, false,
+				    options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("it += n", options.sizes,
+				    additionAssignment, false,
+				    options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("it - n", options.sizes, subtraction,
+				    false, options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("it -= n", options.sizes,
+				    subtractionAssignment, false,
+				    options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("end - start", options.sizes, difference,
+				    false, options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("it[n]", options.sizes, subscript, false,
+				    options.maxGrowth));
+	EXPECT_TRUE(checkCostGrowth("start < end", options.sizes, comparison,
+				    false, options.maxGrowth));
+      }
+
+    }
+  }
+}
+#endif
@@ -2,9 +2,13 @@
 #define __PISTIS__TESTING__ITERATORS_HPP__
 
 /** @file Functions for testing iterator behavior */
+#include <pistis/testing/SequenceViews.hpp>
+#include <pistis/testing/Tracked.hpp>
 #include <cstddef>
 #include <iterator>
+#include <memory>
 #include <type_traits>
+#include <stdint.h>
 
 #include <gtest/gtest.h>
 
@@ -14,6 +18,14 @@ namespace pistis {
 
       // Unit tests written using Google Test
       // Iterator testing functions will return gtest's AssertionResult
+      //
+      // The truth sequence only needs begin() and end(), plus rbegin()
+      // and rend() for bidirectional and random access iterators, and
+      // is only ever traversed, never copied.  Use a GeneratedSequence
+      // or a ReversedSequence from SequenceViews.hpp to test iterators
+      // over sequences too large to hold in memory, or pass the
+      // generator itself to the overloads that take a size and a
+      // generator.
 
       /** @brief Test dereferencing and reading from an iterator */
       template <typename Iterator, typename Value>
@@ -101,7 +113,7 @@ namespace pistis {
       /** @brief Test the '+' and '+=' operators */
       template <typename Iterator, typename Value>
       void testAdditionOperator(Iterator it,
-				typename Iterator::difference_type offset,
+				typename std::iterator_traits<Iterator>::difference_type offset,
 				Value valueAtStart, Value valueAtOffset) {
 	Iterator p= it + offset;
 	ASSERT_EQ(*it, valueAtStart);
@@ -114,11 +126,11 @@ namespace pistis {
       /** @brief Test the '-' and '-=' operators */
       template <typename Iterator, typename Value>
       void testSubtractionOperator(Iterator it,
-				   typename Iterator::difference_type offset,
+				   typename std::iterator_traits<Iterator>::difference_type offset,
 				   Value valueAtStart, Value valueAtOffset) {
 	Iterator p= it - offset;
 	ASSERT_EQ(*it, valueAtStart);
-	ASSERT_EQ(*it, valueAtOffset);
+	ASSERT_EQ(*p, valueAtOffset);
 	
 	it -= offset;
 	ASSERT_EQ(*it, valueAtOffset);
@@ -127,7 +139,7 @@ namespace pistis {
       /** @brief Test the difference operation */
       template <typename Iterator>
       void testDifferenceOperator(Iterator start, Iterator end,
-				  typename Iterator::difference_type distance) {
+				  typename std::iterator_traits<Iterator>::difference_type distance) {
 	ASSERT_EQ(end - start, distance);
       }
 
@@ -151,6 +163,106 @@ namespace pistis {
 	ASSERT_TRUE(after >= it);
       }
 
+      namespace detail {
+	template <typename Iterator>
+	auto iteratorAddress(const Iterator& it, int)
+	    -> decltype(it.operator->()) {
+	  return it.operator->();
+	}
+
+	template <typename Iterator>
+	auto iteratorAddress(const Iterator& it, long)
+	    -> decltype(std::addressof(*it)) {
+	  return std::addressof(*it);
+	}
+      }
+
+      /** @brief Returns the address of the element an iterator refers
+       *         to, as std::to_address() does:  the result of
+       *         operator-> if the iterator has one, otherwise the
+       *         address of *it
+       */
+      template <typename Iterator>
+      auto iteratorAddress(const Iterator& it)
+	  -> decltype(detail::iteratorAddress(it, 0)) {
+	return detail::iteratorAddress(it, 0);
+      }
+
+      /** @brief Test that the elements in [start, end) are contiguous in
+       *         memory.
+       *
+       *  For every n, the address of *(start + n), start[n] and the
+       *  element reached by incrementing start n times must all equal
+       *  the address of *start plus n, and must agree with
+       *  iteratorAddress().
+       */
+      template <typename Iterator>
+      void testContiguousAddresses(Iterator start, Iterator end) {
+	typedef typename std::iterator_traits<Iterator>::difference_type
+	    DifferenceType;
+
+	if (start == end) {
+	  return;
+	}
+
+	const auto base = std::addressof(*start);
+	DifferenceType n = 0;
+	for (Iterator it = start; it != end; ++it, ++n) {
+	  const auto address = std::addressof(*it);
+	  ASSERT_EQ(base + n, address)
+	      << "Element " << n << " is not contiguous with element 0";
+	  ASSERT_EQ(address, std::addressof(*(start + n)))
+	      << "&*(start + " << n << ") differs from the address reached "
+	      << "by incrementing";
+	  ASSERT_EQ(address, std::addressof(start[n]))
+	      << "&start[" << n << "] differs from the address reached by "
+	      << "incrementing";
+	  ASSERT_EQ(address, iteratorAddress(it))
+	      << "operator-> and &* disagree at element " << n;
+	}
+	ASSERT_EQ(end - start, n);
+      }
+
+      /** @brief Test that dereferencing the iterators in [start, end)
+       *         does not create any elements.
+       *
+       *  The elements must be Tracked objects (see Tracked.hpp).  An
+       *  iterator whose operator* returns a Tracked<T> by value instead
+       *  of by reference copies the element every time it is
+       *  dereferenced, which this test reports.
+       */
+      template <typename Iterator>
+      void testDereferenceDoesNotCopy(Iterator start, Iterator end) {
+	if (start == end) {
+	  return;
+	}
+
+	const std::shared_ptr<TrackedLedger> ledger = (*start).ledger();
+	const TrackedCounts before = ledger->counts();
+	for (Iterator it = start; it != end; ++it) {
+	  auto&& element = *it;
+	  (void)element;
+	}
+
+	const TrackedCounts counts =
+	    TrackedCounts::difference(before, ledger->counts());
+	ASSERT_EQ(0, counts.copies() + counts.moves() + counts.constructions)
+	    << "Dereferencing the iterator created elements (" << counts
+	    << "); does operator* return by value?";
+      }
+
+      namespace detail {
+	template <typename Iterator>
+	void testDereferenceDoesNotCopy(Iterator start, Iterator end,
+					std::true_type) {
+	  iterators::testDereferenceDoesNotCopy(start, end);
+	}
+
+	template <typename Iterator>
+	void testDereferenceDoesNotCopy(Iterator, Iterator, std::false_type) {
+	}
+      }
+
       template <typename MutableIterator, typename ConstIterator>
       void testConstructConstIteratorFromMutable(MutableIterator mutableIterator,
 						 ConstIterator truth) {
@@ -294,22 +406,34 @@ namespace pistis {
       void testInputIterator(StartIteratorFactory createIteratorAtStart,
 			     EndIteratorFactory createIteratorAtEnd,
 			     const Sequence& truth) {
+	// Input iterators are single-pass, so createIteratorAtStart() is
+	// called exactly once and the truth sequence is traversed exactly
+	// once.  Copies of the iterator are only compared and
+	// dereferenced, never incremented.
 	SCOPED_TRACE("testInputIterator");
-	testCopyConstruction(createIteratorAtStart());
-	testCopyAssignment(createIteratorAtStart());
-	testDereferenceAndRead(createIteratorAtStart(), *truth.begin());
-	testEqualityOp(createIteratorAtEnd(), createIteratorAtEnd(),
-		       createIteratorAtStart());
-	testInequalityOp(createIteratorAtEnd(), createIteratorAtEnd(),
-			 createIteratorAtStart());
-
 	auto it = createIteratorAtStart();
-	testPreincrementIteration(it, truth, it);
-	EXPECT_EQ(it, createIteratorAtEnd());
+	const auto end = createIteratorAtEnd();
 
-	it = createIteratorAtStart();
-	it= testPostincrementIteration(it, truth, it);
-	EXPECT_EQ(it, createIteratorAtEnd());
+	testCopyConstruction(it);
+	testCopyAssignment(it);
+	testEqualityOp(end, createIteratorAtEnd(), it);
+	testInequalityOp(end, createIteratorAtEnd(), it);
+
+	// Alternate between pre- and post-increment
+	uint64_t position = 0;
+	for (auto x : truth) {
+	  ASSERT_TRUE(it != end) << "Iterator reached the end at position "
+				 << position;
+	  ASSERT_EQ(*it, x) << "at position " << position;
+	  if (position & 1) {
+	    ASSERT_EQ(*it++, x) << "at position " << position;
+	  } else {
+	    ++it;
+	  }
+	  ++position;
+	}
+	EXPECT_TRUE(it == end) << "Iterator did not reach the end after "
+			       << position << " elements";
       }
 
       template <typename StartIteratorFactory, typename EndIteratorFactory,
@@ -333,6 +457,13 @@ namespace pistis {
 	it = createIteratorAtStart();
 	testPostincrementIteration(it, truth, it);
 	EXPECT_EQ(it, createIteratorAtEnd());
+
+	detail::testDereferenceDoesNotCopy(
+	    createIteratorAtStart(), createIteratorAtEnd(),
+	    IsTracked<
+		typename std::decay<decltype(*createIteratorAtStart())>::type
+	    >()
+	);
       }
 
       template <typename StartIteratorFactory, typename EndIteratorFactory,
@@ -351,8 +482,7 @@ namespace pistis {
       void testBidirectionalIterator(StartIteratorFactory createIteratorAtStart,
 				     EndIteratorFactory createIteratorAtEnd,
 				     const Sequence& truth) {
-	typedef typename std::remove_cv<typename std::remove_reference<decltype(truth[0])>::type>::type ValueType;
-	std::vector<ValueType> reversedTruth(truth.rbegin(), truth.rend());
+	const ReversedSequence<Sequence> reversedTruth(truth);
 
 	testForwardIterator(createIteratorAtStart, createIteratorAtEnd, truth);
 	SCOPED_TRACE("testBidirectionalIterator");
@@ -388,22 +518,96 @@ namespace pistis {
 	testBidirectionalIterator(createIteratorAtStart, createIteratorAtEnd, truth);
 	
 	SCOPED_TRACE("testRandomAccessIterator");
-	testAdditionOperator(createIteratorAtStart(), 2, truth[0], truth[2]);
+	const auto first = truth.begin();
+	const auto third = std::next(first, 2);
+	const auto last = truth.rbegin();
+	testAdditionOperator(createIteratorAtStart(), 2, *first, *third);
 
 	auto it= createIteratorAtEnd();
 	--it;
-	testSubtractionOperator(it, 2, truth[truth.size()-1], truth[truth.size()-3]);
+	testSubtractionOperator(it, 2, *last, *std::next(last, 2));
 
 	testDifferenceOperator(createIteratorAtStart(), createIteratorAtEnd(),
-			       truth.size());
+			       std::distance(truth.begin(), truth.end()));
 	testRelationalOperators(createIteratorAtStart(),
 				createIteratorAtStart(),
 				createIteratorAtEnd());
 
 	it= createIteratorAtStart();
-	ASSERT_EQ(it[2], truth[2]);
+	ASSERT_EQ(it[2], *third);
       }
       
+      // Overloads that compare the iterator under test against the
+      // sequence generator(0), generator(1), ..., generator(size - 1),
+      // which is computed as it is read and never held in memory.
+      // See GeneratedSequence in SequenceViews.hpp.
+
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Generator>
+      void testInputIterator(StartIteratorFactory createIteratorAtStart,
+			     EndIteratorFactory createIteratorAtEnd,
+			     uint64_t size, Generator generator) {
+	testInputIterator(createIteratorAtStart, createIteratorAtEnd,
+			  generatedSequence(size, generator));
+      }
+
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Generator>
+      void testForwardIterator(StartIteratorFactory createIteratorAtStart,
+			       EndIteratorFactory createIteratorAtEnd,
+			       uint64_t size, Generator generator) {
+	testForwardIterator(createIteratorAtStart, createIteratorAtEnd,
+			    generatedSequence(size, generator));
+      }
+
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Generator>
+      void testBidirectionalIterator(StartIteratorFactory createIteratorAtStart,
+				     EndIteratorFactory createIteratorAtEnd,
+				     uint64_t size, Generator generator) {
+	testBidirectionalIterator(createIteratorAtStart, createIteratorAtEnd,
+				  generatedSequence(size, generator));
+      }
+
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Generator>
+      void testRandomAccessIterator(StartIteratorFactory createIteratorAtStart,
+				    EndIteratorFactory createIteratorAtEnd,
+				    uint64_t size, Generator generator) {
+	testRandomAccessIterator(createIteratorAtStart, createIteratorAtEnd,
+				 generatedSequence(size, generator));
+      }
+
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Generator>
+      void testContiguousIterator(StartIteratorFactory createIteratorAtStart,
+				  EndIteratorFactory createIteratorAtEnd,
+				  uint64_t size, Generator generator) {
+	testContiguousIterator(createIteratorAtStart, createIteratorAtEnd,
+			       generatedSequence(size, generator));
+      }
+
+      /** @brief Test a contiguous iterator, which is a random access
+       *         iterator whose elements are adjacent in memory, like a
+       *         pointer into an array.
+       *
+       *  Code that converts iterators to pointers, e.g. to hand the
+       *  elements to a vectorized kernel, relies on this.  See
+       *  benchmarkContiguousIterator() in IteratorBenchmarks.hpp for
+       *  checking that loops over the iterator still compile down to
+       *  loops over pointers.
+       */
+      template <typename StartIteratorFactory, typename EndIteratorFactory,
+		typename Sequence>
+      void testContiguousIterator(StartIteratorFactory createIteratorAtStart,
+				  EndIteratorFactory createIteratorAtEnd,
+				  const Sequence& truth) {
+	testRandomAccessIterator(createIteratorAtStart, createIteratorAtEnd,
+				 truth);
+	SCOPED_TRACE("testContiguousIterator");
+	testContiguousAddresses(createIteratorAtStart(), createIteratorAtEnd());
+      }
+
       template <typename ConstIteratorFactory, typename MutableIteratorFactory>
       void testConstAndMutableIteratorCompatibility(ConstIteratorFactory constIteratorFactory,
 						    MutableIteratorFactory mutableIteratorFactory) {
@@ -0,0 +1,134 @@
+#include "LargeFiles.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static const size_t FILL_BUFFER_SIZE = 1024 * 1024;
+
+  class FileDescriptor {
+  public:
+    explicit FileDescriptor(int fd): fd_(fd) { }
+    FileDescriptor(const FileDescriptor&) = delete;
+    ~FileDescriptor() { if (fd_ >= 0) ::close(fd_); }
+
+    int fd() const { return fd_; }
+
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  private:
+    int fd_;
+  };
+
+  static std::runtime_error fileError(const std::string& path,
+				      const char* operation) {
+    std::ostringstream msg;
+    msg << "Cannot " << operation << " " << path << " ("
+	<< strerror(errno) << ")";
+    return std::runtime_error(msg.str());
+  }
+
+  static void fillRegion(int fd, const std::string& path,
+			 const LargeFileRegion& region) {
+    if (region.pattern.empty() || !region.length) {
+      return;
+    }
+
+    // Fill the buffer with a whole number of patterns, so every chunk
+    // starts at the beginning of the pattern
+    const size_t patternSize = region.pattern.size();
+    const size_t patternsPerBuffer =
+	std::max(FILL_BUFFER_SIZE / patternSize, size_t(1));
+    std::string buffer;
+    buffer.reserve(patternsPerBuffer * patternSize);
+    for (size_t i = 0; i < patternsPerBuffer; ++i) {
+      buffer.append(region.pattern);
+    }
+
+    uint64_t written = 0;
+    while (written < region.length) {
+      const size_t n = size_t(std::min(uint64_t(buffer.size()),
+				       region.length - written));
+      const ssize_t result = ::pwrite(fd, buffer.data(), n,
+				      off_t(region.offset + written));
+      if (result < 0) {
+	if (errno == EINTR) {
+	  continue;
+	}
+	throw fileError(path, "write");
+      }
+      written += uint64_t(result);
+      if (result % patternSize) {
+	// Short write in the middle of a pattern.  Realign the buffer.
+	std::rotate(buffer.begin(), buffer.begin() + result % patternSize,
+		    buffer.end());
+      }
+    }
+  }
+}
+
+LargeFileInfo pistis::testing::createLargeFile(
+    const std::string& filename, uint64_t size,
+    LargeFileAllocation allocation,
+    const std::vector<LargeFileRegion>& regions
+) {
+  LargeFileInfo info;
+  info.path = getScratchFile(filename);
+  info.size = size;
+  info.bytesAllocated = 0;
+  info.allocation = allocation;
+  info.honored = false;
+
+  uint64_t bytesFilled = 0;
+  for (const LargeFileRegion& region : regions) {
+    if ((region.offset > size) || (region.length > size - region.offset)) {
+      std::ostringstream msg;
+      msg << "Region [" << region.offset << ", "
+	  << (region.offset + region.length) << ") does not fit in "
+	  << info.path << ", which has " << size << " bytes";
+      throw std::runtime_error(msg.str());
+    }
+    bytesFilled += region.length;
+  }
+
+  FileDescriptor file(::open(info.path.c_str(),
+			     O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+  if (file.fd() < 0) {
+    throw fileError(info.path, "create");
+  }
+
+  bool fallocated = false;
+  if (allocation == LargeFileAllocation::PREALLOCATED) {
+    fallocated = !::fallocate(file.fd(), 0, 0, off_t(size));
+  }
+  if (!fallocated && ::ftruncate(file.fd(), off_t(size))) {
+    throw fileError(info.path, "resize");
+  }
+
+  for (const LargeFileRegion& region : regions) {
+    fillRegion(file.fd(), info.path, region);
+  }
+
+  struct stat status;
+  if (::fstat(file.fd(), &status)) {
+    throw fileError(info.path, "stat");
+  }
+  info.bytesAllocated = uint64_t(status.st_blocks) * 512;
+
+  if (allocation == LargeFileAllocation::SPARSE) {
+    info.honored = (bytesFilled >= size) || (info.bytesAllocated < size);
+  } else {
+    info.honored = fallocated && (info.bytesAllocated >= size);
+  }
+  return info;
+}
@@ -0,0 +1,100 @@
+#ifndef __PISTIS__TESTING__LARGEFILES_HPP__
+#define __PISTIS__TESTING__LARGEFILES_HPP__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/** @file LargeFiles.hpp
+ *
+ *  Creating very large scratch files without writing them
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief How to allocate the space for a large file */
+    enum class LargeFileAllocation {
+      /** @brief Extend the file with ftruncate(), leaving a hole that
+       *         takes no disk space and reads as zeroes
+       */
+      SPARSE,
+
+      /** @brief Reserve disk space for the whole file with fallocate().
+       *         The space reads as zeroes.
+       */
+      PREALLOCATED
+    };
+
+    /** @brief A range of a large file filled with a repeating pattern.
+     *
+     *  The byte at file offset x is pattern[(x - offset) % pattern.size()].
+     */
+    struct LargeFileRegion {
+      uint64_t offset;
+      uint64_t length;
+      std::string pattern;
+
+      LargeFileRegion(uint64_t o, uint64_t n, const std::string& p):
+	  offset(o), length(n), pattern(p) {
+      }
+    };
+
+    /** @brief Describes a file created by createLargeFile() */
+    struct LargeFileInfo {
+      /** @brief Full path to the file */
+      std::string path;
+
+      /** @brief Size of the file, in bytes */
+      uint64_t size;
+
+      /** @brief Disk space the file occupies, in bytes (from
+       *         st_blocks)
+       */
+      uint64_t bytesAllocated;
+
+      /** @brief The allocation createLargeFile() was asked for */
+      LargeFileAllocation allocation;
+
+      /** @brief True if the filesystem did what was asked.
+       *
+       *  A SPARSE file is honored if it occupies less space than its
+       *  size (or if the regions cover the whole file).  A
+       *  PREALLOCATED file is honored if fallocate() succeeded and the
+       *  file occupies at least its size.  A file that was not
+       *  honored is still created with the right size and contents,
+       *  but may take disk space (SPARSE) or may fail to grow later
+       *  when the disk is full (PREALLOCATED).
+       */
+      bool honored;
+    };
+
+    /** @brief Create a large file quickly.
+     *
+     *  Only the regions are written.  Everything else reads as zero.
+     *  The file is replaced if it exists.
+     *
+     *  Relative file names are expanded by getScratchFile(), so the
+     *  file can be removed with removeFile().  Pass a name from
+     *  getTestScratchFile() (see TestScratch.hpp) to have the file
+     *  removed when the current test ends.
+     *
+     *  @param filename    The file to create
+     *  @param size        Size of the file, in bytes
+     *  @param allocation  How to allocate space for the file
+     *  @param regions     Ranges to fill with patterns.  Must lie
+     *                     within the file.
+     *  @returns           Path, size and allocation of the file
+     *  @throws std::runtime_error  If the file cannot be created,
+     *                              resized or written, or a region
+     *                              does not fit in the file
+     */
+    LargeFileInfo createLargeFile(
+	const std::string& filename, uint64_t size,
+	LargeFileAllocation allocation = LargeFileAllocation::SPARSE,
+	const std::vector<LargeFileRegion>& regions =
+	    std::vector<LargeFileRegion>()
+    );
+
+  }
+}
+#endif
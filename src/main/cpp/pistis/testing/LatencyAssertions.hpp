@@ -0,0 +1,62 @@
+#ifndef __PISTIS__TESTING__LATENCYASSERTIONS_HPP__
+#define __PISTIS__TESTING__LATENCYASSERTIONS_HPP__
+
+/** @file LatencyAssertions.hpp
+ *
+ *  Google Test assertions on the percentiles of a LatencyHistogram,
+ *  e.g.
+ *
+ *  @code
+ *  LatencyHistogram latency;
+ *  for (const auto& key : keys) {
+ *    latency.recordTime([&]() { map.insert(key, value); });
+ *  }
+ *  EXPECT_PERCENTILE_AT_MOST(latency, 99.0, 2000);   // p99 under 2us
+ *  EXPECT_PERCENTILE_AT_MOST(latency, 99.9, 20000);
+ *  @endcode
+ */
+#include <pistis/testing/LatencyHistogram.hpp>
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Verify the value at percentile p is at most maxValue.
+     *
+     *  Fails if the histogram is empty.
+     */
+    inline ::testing::AssertionResult checkPercentileAtMost(
+	const LatencyHistogram& histogram, double p, uint64_t maxValue
+    ) {
+      if (histogram.empty()) {
+	return ::testing::AssertionFailure()
+	    << "No latencies were recorded";
+      }
+
+      const uint64_t value = histogram.percentile(p);
+      if (value <= maxValue) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << "p" << p << " is " << value << ", which exceeds the limit of "
+	  << maxValue << ".  Histogram: " << histogram;
+    }
+
+  }
+}
+
+/** @brief Expect the value at percentile p of the histogram to be at
+ *         most maxValue
+ */
+#define EXPECT_PERCENTILE_AT_MOST(histogram, p, maxValue)		\
+  EXPECT_TRUE(::pistis::testing::checkPercentileAtMost(			\
+      (histogram), (p), (maxValue)))
+
+/** @brief Assert the value at percentile p of the histogram is at most
+ *         maxValue
+ */
+#define ASSERT_PERCENTILE_AT_MOST(histogram, p, maxValue)		\
+  ASSERT_TRUE(::pistis::testing::checkPercentileAtMost(			\
+      (histogram), (p), (maxValue)))
+
+#endif
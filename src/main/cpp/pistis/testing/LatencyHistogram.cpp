@@ -0,0 +1,238 @@
+#include "LatencyHistogram.hpp"
+#include "Resources.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+#include <ctype.h>
+#include <string.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static const unsigned MIN_PRECISION = 2;
+  static const unsigned MAX_PRECISION = 16;
+
+  static size_t numBucketsForPrecision(unsigned precision) {
+    // Values below 2^precision each get a bucket.  Each of the
+    // 64 - precision larger powers of two gets 2^(precision - 1).
+    return (size_t(66 - precision)) << (precision - 1);
+  }
+
+  // Percentiles are rounded to this fraction of a percent, so ranks
+  // can be computed exactly
+  static const uint64_t PERCENTILE_SCALE = 10000000;
+
+  // Returns the 1-based rank of the value at percentile p among count
+  // values, i.e. ceil(p / 100 * count), computed in integers so that
+  // 99.9% of 1000 values is rank 999 rather than 1000
+  static uint64_t percentileRank(double p, uint64_t count) {
+    const uint64_t scaledP = uint64_t(std::llround(
+	std::max(std::min(p, 100.0), 0.0) * double(PERCENTILE_SCALE)
+    ));
+    const unsigned __int128 divisor =
+	(unsigned __int128)(100 * PERCENTILE_SCALE);
+    const unsigned __int128 rank =
+	((unsigned __int128)count * scaledP + divisor - 1) / divisor;
+    return std::max(uint64_t(rank), uint64_t(1));
+  }
+
+  static std::string histogramFilename(const std::string& name) {
+    std::string filename(name);
+    for (char& c : filename) {
+      if (!isalnum((unsigned char)c) && !strchr(".-_", c)) {
+	c = '_';
+      }
+    }
+    return filename + ".hgrm";
+  }
+}
+
+LatencyHistogram::LatencyHistogram(unsigned precision):
+    precision_(precision), counts_(), count_(0), sum_(0.0),
+    min_(std::numeric_limits<uint64_t>::max()), max_(0) {
+  if ((precision < MIN_PRECISION) || (precision > MAX_PRECISION)) {
+    throw std::invalid_argument("Histogram precision must be between 2 "
+				"and 16 bits");
+  }
+  counts_.resize(numBucketsForPrecision(precision), 0);
+}
+
+void LatencyHistogram::record(uint64_t value, uint64_t n) {
+  if (n) {
+    counts_[bucketIndex(value)] += n;
+    count_ += n;
+    sum_ += double(value) * double(n);
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+  if (!count_) {
+    return 0;
+  }
+  if (p <= 0.0) {
+    return min_;
+  }
+
+  const uint64_t rank = percentileRank(p, count_);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(bucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  if (other.precision_ != precision_) {
+    throw std::invalid_argument("Cannot merge histograms with different "
+				"precisions");
+  }
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  sum_ = 0.0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index) const {
+  if (index < (size_t(1) << precision_)) {
+    return index;
+  }
+
+  const unsigned shift = unsigned(index >> (precision_ - 1)) - 1;
+  const uint64_t subBucket = index - (size_t(shift) << (precision_ - 1));
+  return subBucket << shift;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) const {
+  if (index < (size_t(1) << precision_)) {
+    return index;
+  }
+
+  const unsigned shift = unsigned(index >> (precision_ - 1)) - 1;
+  return bucketLowerBound(index) + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::writeSummary(std::ostream& out) const {
+  out << "count=" << count_ << " min=" << min() << " p50="
+      << percentile(50.0) << " p90=" << percentile(90.0) << " p99="
+      << percentile(99.0) << " p99.9=" << percentile(99.9) << " max="
+      << max() << " mean=" << mean();
+}
+
+void LatencyHistogram::writeDistribution(
+    std::ostream& out, unsigned ticksPerHalfDistance
+) const {
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  const unsigned ticks = std::max(ticksPerHalfDistance, 1u);
+
+  out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile"
+      << " " << std::setw(10) << "TotalCount" << " " << std::setw(14)
+      << "1/(1-Percentile)" << "\n\n" << std::fixed;
+
+  // Report ticks evenly-spaced percentiles between 0 and 50%, then
+  // between 50% and 75%, and so on, halving the distance to 100% each
+  // time, until the percentile reaches the largest value
+  size_t bucket = 0;
+  uint64_t seen = counts_.empty() ? 0 : counts_[0];
+  for (unsigned half = 0; count_ && (half < 64); ++half) {
+    const double start = 100.0 - 100.0 / std::ldexp(1.0, half);
+    const double step = 100.0 / std::ldexp(1.0, half + 1) / ticks;
+    bool done = false;
+
+    for (unsigned t = 0; (t < ticks) && !done; ++t) {
+      const double p = start + step * t;
+      const uint64_t rank = percentileRank(p, count_);
+      while (seen < rank) {
+	seen += counts_[++bucket];
+      }
+
+      // The row for 100% is written after the loop
+      const uint64_t value = std::min(bucketUpperBound(bucket), max_);
+      done = (value >= max_) || (seen >= count_);
+      if (!done) {
+	out << std::setprecision(3) << std::setw(12) << double(value) << " "
+	    << std::setprecision(12) << std::setw(14) << (p / 100.0) << " "
+	    << std::setw(10) << seen << " " << std::setprecision(2)
+	    << std::setw(14) << (1.0 / (1.0 - p / 100.0)) << "\n";
+      }
+    }
+    if (done) {
+      break;
+    }
+  }
+  if (count_) {
+    out << std::setprecision(3) << std::setw(12) << double(max_) << " "
+	<< std::setprecision(12) << std::setw(14) << 1.0 << " "
+	<< std::setw(10) << count_ << "\n";
+  }
+
+  // Approximate the standard deviation from the bucket midpoints
+  double sumOfSquares = 0.0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    if (counts_[i]) {
+      const double mid = (double(bucketLowerBound(i)) +
+			  double(bucketUpperBound(i))) / 2.0;
+      sumOfSquares += double(counts_[i]) * (mid - mean()) * (mid - mean());
+    }
+  }
+  const double sd = count_ ? std::sqrt(sumOfSquares / double(count_)) : 0.0;
+
+  out << std::setprecision(3) << "#[Mean    = " << std::setw(12) << mean()
+      << ", StdDeviation   = " << std::setw(12) << sd << "]\n"
+      << "#[Max     = " << std::setw(12) << double(max())
+      << ", Total count    = " << std::setw(12) << count_ << "]\n"
+      << "#[Buckets = " << std::setw(12) << (66 - precision_)
+      << ", SubBuckets     = " << std::setw(12) << (1u << precision_)
+      << "]" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+namespace pistis {
+  namespace testing {
+
+    std::ostream& operator<<(std::ostream& out, const LatencyHistogram& h) {
+      h.writeSummary(out);
+      return out;
+    }
+
+    std::string getLatencyHistogramDir() {
+      return getScratchFile("latency");
+    }
+
+    std::string saveLatencyHistogram(const std::string& name,
+				     const LatencyHistogram& histogram) {
+      const std::string dir = getLatencyHistogramDir();
+      if (!makeDirectories(dir)) {
+	return std::string();
+      }
+
+      const std::string path = dir + "/" + histogramFilename(name);
+      std::ofstream out(path.c_str());
+      histogram.writeDistribution(out);
+      return out ? path : std::string();
+    }
+
+  }
+}
@@ -0,0 +1,187 @@
+#ifndef __PISTIS__TESTING__LATENCYHISTOGRAM_HPP__
+#define __PISTIS__TESTING__LATENCYHISTOGRAM_HPP__
+
+#include <pistis/testing/Benchmark.hpp>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file LatencyHistogram.hpp
+ *
+ *  Log-bucketed histogram of latencies, for checking tail latency in
+ *  unit tests.
+ *
+ *  Like HdrHistogram, the histogram divides each power of two into a
+ *  fixed number of linear sub-buckets, so every value is recorded
+ *  with the same relative precision, from nanoseconds to hours, in a
+ *  few thousand counters.  Recording a value is a count leading zeros,
+ *  two shifts and an increment.
+ *
+ *  A histogram is not thread-safe.  Give each thread its own and merge
+ *  them when the threads finish.  See LatencyAssertions.hpp for
+ *  assertions on percentiles.
+ */
+namespace pistis {
+  namespace testing {
+
+    class LatencyHistogram {
+    public:
+      /** @brief Default number of bits of precision.  Values are
+       *         recorded to within 1/64 (about 1.6%).
+       */
+      static const unsigned DEFAULT_PRECISION = 7;
+
+    public:
+      /** @brief Create an empty histogram
+       *
+       *  @param precision  Number of significant bits kept for each
+       *                    value.  Values are recorded to within
+       *                    1/2^(precision - 1) of their true value.
+       *                    Must be between 2 and 16.
+       *  @throws std::invalid_argument if precision is out of range
+       */
+      LatencyHistogram(unsigned precision = DEFAULT_PRECISION);
+
+      /** @brief Number of significant bits kept for each value */
+      unsigned precision() const { return precision_; }
+
+      /** @brief Number of values recorded */
+      uint64_t count() const { return count_; }
+
+      /** @brief Whether no values have been recorded */
+      bool empty() const { return !count_; }
+
+      /** @brief Smallest value recorded, or zero if none have been */
+      uint64_t min() const { return count_ ? min_ : 0; }
+
+      /** @brief Largest value recorded, or zero if none have been */
+      uint64_t max() const { return max_; }
+
+      /** @brief Mean of the values recorded, or zero if none have been */
+      double mean() const { return count_ ? sum_ / double(count_) : 0.0; }
+
+      /** @brief Record one value, usually a latency in nanoseconds */
+      void record(uint64_t value) {
+	++counts_[bucketIndex(value)];
+	++count_;
+	sum_ += double(value);
+	min_ = std::min(min_, value);
+	max_ = std::max(max_, value);
+      }
+
+      /** @brief Record the same value n times */
+      void record(uint64_t value, uint64_t n);
+
+      /** @brief Time one call to f() and record the elapsed time in
+       *         nanoseconds.
+       *
+       *  Uses the time-stamp counter where available, so timing adds
+       *  only a few nanoseconds to each call.
+       */
+      template <typename F>
+      void recordTime(F f) {
+	const uint64_t start = bench::readClock(bench::ClockType::TSC);
+	f();
+	const uint64_t end = bench::readClock(bench::ClockType::TSC);
+	record(uint64_t(bench::ticksToNanoseconds(bench::ClockType::TSC,
+						  end - start)));
+      }
+
+      /** @brief Returns the value at the given percentile.
+       *
+       *  The result is the largest value that is recorded in the same
+       *  bucket as the value at the percentile, so it overestimates the
+       *  true value by less than the histogram's precision, and never
+       *  exceeds max().
+       *
+       *  @param p  Percentile, between 0 and 100
+       *  @returns  The value, or zero if the histogram is empty
+       */
+      uint64_t percentile(double p) const;
+
+      /** @brief Add the counts in another histogram to this one
+       *
+       *  @throws std::invalid_argument if the histograms have different
+       *          precisions
+       */
+      void merge(const LatencyHistogram& other);
+
+      /** @brief Forget all recorded values */
+      void reset();
+
+      /** @brief Number of buckets.  Bucket indexes run from zero to
+       *         numBuckets() - 1.
+       */
+      size_t numBuckets() const { return counts_.size(); }
+
+      /** @brief Index of the bucket that holds the value */
+      size_t bucketIndex(uint64_t value) const {
+	const unsigned msb = 63 - __builtin_clzll(value | 1);
+	const unsigned shift = (msb >= precision_) ? msb - precision_ + 1 : 0;
+	return (size_t(shift) << (precision_ - 1)) + size_t(value >> shift);
+      }
+
+      /** @brief Smallest value recorded in the given bucket */
+      uint64_t bucketLowerBound(size_t index) const;
+
+      /** @brief Largest value recorded in the given bucket */
+      uint64_t bucketUpperBound(size_t index) const;
+
+      /** @brief Number of values in the given bucket */
+      uint64_t bucketCount(size_t index) const { return counts_[index]; }
+
+      /** @brief Write a one-line summary of the histogram, e.g.
+       *         "count=1000 min=10 p50=12 p90=15 p99=40 p99.9=95
+       *          max=120 mean=13.1"
+       */
+      void writeSummary(std::ostream& out) const;
+
+      /** @brief Write the percentile distribution in HdrHistogram's
+       *         ".hgrm" text format.
+       *
+       *  Tools that plot HdrHistogram output can read the result.
+       *
+       *  @param out                 Where to write the distribution
+       *  @param ticksPerHalfDistance  Number of percentiles reported
+       *                               between 0 and 50%, 50% and
+       *                               75% and so on
+       */
+      void writeDistribution(std::ostream& out,
+			     unsigned ticksPerHalfDistance = 5) const;
+
+    private:
+      unsigned precision_;
+      std::vector<uint64_t> counts_;
+      uint64_t count_;
+      double sum_;
+      uint64_t min_;
+      uint64_t max_;
+    };
+
+    std::ostream& operator<<(std::ostream& out, const LatencyHistogram& h);
+
+    /** @brief Returns the directory latency histograms are saved in.
+     *
+     *  Equal to "${SCRATCH_DIR}/latency," where SCRATCH_DIR is the
+     *  directory returned by getScratchDir().
+     */
+    std::string getLatencyHistogramDir();
+
+    /** @brief Save the histogram's distribution in the latency
+     *         histogram directory, in a file named "<name>.hgrm".
+     *
+     *  Characters in the name that are not letters, digits, '.', '-'
+     *  or '_' are replaced with '_'.
+     *
+     *  @returns  The full path to the file written, or an empty string
+     *            if the file could not be written
+     */
+    std::string saveLatencyHistogram(const std::string& name,
+				     const LatencyHistogram& histogram);
+
+  }
+}
+#endif
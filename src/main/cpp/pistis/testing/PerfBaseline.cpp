@@ -0,0 +1,87 @@
+#include "PerfBaseline.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::bench;
+
+namespace {
+  static double getDoubleFromEnv(const char* name, double defaultValue) {
+    const char* value = getenv(name);
+    char* end = nullptr;
+    if (!value || !*value) {
+      return defaultValue;
+    }
+
+    const double x = strtod(value, &end);
+    return *end ? defaultValue : x;
+  }
+
+  static std::string baselinePath(const std::string& benchmarkName) {
+    return getBaselineDir() + "/" + resultFilename(benchmarkName);
+  }
+}
+
+BaselineMode pistis::testing::bench::baselineMode() {
+  const char* value = getenv("PISTIS_TESTING_PERF_CHECK");
+  if (!value || !*value || !strcmp(value, "0")) {
+    return BaselineMode::OFF;
+  } else if (!strcmp(value, "update")) {
+    return BaselineMode::UPDATE;
+  } else {
+    return BaselineMode::CHECK;
+  }
+}
+
+PerfCheckOptions::PerfCheckOptions():
+    minSlowdown(getDoubleFromEnv("PISTIS_TESTING_PERF_MIN_SLOWDOWN", 0.05)),
+    noiseMultiplier(getDoubleFromEnv("PISTIS_TESTING_PERF_NOISE_MULTIPLIER",
+				     3.0)) {
+}
+
+BaselineComparison pistis::testing::bench::compareWithBaseline(
+    const Result& baseline, const Result& current,
+    const PerfCheckOptions& options
+) {
+  static const double MAD_TO_STDDEV = 1.4826;
+  BaselineComparison comparison;
+  const double noise = MAD_TO_STDDEV * std::hypot(baseline.statistics.mad,
+						  current.statistics.mad);
+
+  comparison.baselineMedian = baseline.statistics.median;
+  comparison.currentMedian = current.statistics.median;
+  comparison.threshold =
+      std::max(options.minSlowdown * comparison.baselineMedian,
+	       options.noiseMultiplier * noise);
+  comparison.regressed =
+      (comparison.currentMedian - comparison.baselineMedian) >
+	  comparison.threshold;
+  return comparison;
+}
+
+std::string pistis::testing::bench::getBaselineDir() {
+  return getResourcePath("benchmarks");
+}
+
+bool pistis::testing::bench::loadBaseline(const std::string& benchmarkName,
+					  Result& baseline) {
+  std::ifstream in(baselinePath(benchmarkName).c_str());
+  return in && readJson(in, baseline);
+}
+
+std::string pistis::testing::bench::saveBaseline(const Result& result) {
+  if (!makeDirectories(getBaselineDir())) {
+    return std::string();
+  }
+
+  const std::string path = baselinePath(result.name);
+  std::ofstream out(path.c_str());
+  writeJson(out, result);
+  return out ? path : std::string();
+}
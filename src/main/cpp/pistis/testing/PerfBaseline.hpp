@@ -0,0 +1,129 @@
+#ifndef __PISTIS__TESTING__PERFBASELINE_HPP__
+#define __PISTIS__TESTING__PERFBASELINE_HPP__
+
+#include <pistis/testing/Benchmark.hpp>
+#include <string>
+
+/** @file PerfBaseline.hpp
+ *
+ *  Comparing benchmark results against stored baselines.
+ *
+ *  Baselines are benchmark results saved as JSON in
+ *  "${RESOURCE_DIR}/benchmarks," where RESOURCE_DIR is the directory
+ *  returned by getResourceDir().  "make perf-check," which "make
+ *  install" runs, runs the benchmarks that have a baseline and fails
+ *  each one that is slower than its baseline by more than its
+ *  threshold.  It finds them by file name, so it only checks
+ *  benchmarks named after their tests.  "make perf-baseline" runs the
+ *  benchmarks and replaces the baselines with the new results.
+ *  Benchmarks without a baseline pass.
+ *
+ *  Both targets point PISTIS_FILESYSTEM_TEST_RESOURCE_DIR at
+ *  src/test/resources, so the baselines are kept under source control,
+ *  unless that variable is already set.
+ */
+namespace pistis {
+  namespace testing {
+    namespace bench {
+
+      /** @brief What to do with baselines after running a benchmark */
+      enum class BaselineMode {
+	/** @brief Ignore baselines */
+	OFF,
+
+	/** @brief Compare the result with the baseline */
+	CHECK,
+
+	/** @brief Replace the baseline with the result */
+	UPDATE
+      };
+
+      /** @brief Returns the baseline mode.
+       *
+       *  Set by the PISTIS_TESTING_PERF_CHECK environment variable:
+       *  "update" selects UPDATE, any other value except "" and "0"
+       *  selects CHECK, and OFF is the default.
+       */
+      BaselineMode baselineMode();
+
+      /** @brief Thresholds for detecting a regression */
+      struct PerfCheckOptions {
+	/** @brief Slowdowns no larger than this fraction of the
+	 *         baseline median are never regressions
+	 */
+	double minSlowdown;
+
+	/** @brief Slowdowns no larger than this many standard deviations
+	 *         of the combined noise of the baseline and the result
+	 *         are never regressions
+	 */
+	double noiseMultiplier;
+
+	/** @brief Options from the environment.
+	 *
+	 *  minSlowdown is PISTIS_TESTING_PERF_MIN_SLOWDOWN if set, or
+	 *  0.05 otherwise.  noiseMultiplier is
+	 *  PISTIS_TESTING_PERF_NOISE_MULTIPLIER if set, or 3 otherwise.
+	 */
+	PerfCheckOptions();
+	PerfCheckOptions(double slowdown, double multiplier):
+	    minSlowdown(slowdown), noiseMultiplier(multiplier) {
+	}
+      };
+
+      /** @brief Outcome of comparing a result with its baseline */
+      struct BaselineComparison {
+	/** @brief Median time per iteration of the baseline, in ns */
+	double baselineMedian;
+
+	/** @brief Median time per iteration of the result, in ns */
+	double currentMedian;
+
+	/** @brief Largest increase in the median, in ns, that is not a
+	 *         regression
+	 */
+	double threshold;
+
+	/** @brief True if currentMedian - baselineMedian > threshold */
+	bool regressed;
+
+	/** @brief Ratio of the current median to the baseline median */
+	double ratio() const { return currentMedian / baselineMedian; }
+      };
+
+      /** @brief Compare a result with its baseline.
+       *
+       *  The threshold is computed separately for every benchmark
+       *  from its own noise.  Each side's noise is estimated from its
+       *  MAD (as 1.4826 * MAD, the standard deviation of a normal
+       *  distribution with that MAD), and the threshold is the larger
+       *  of options.minSlowdown times the baseline median and
+       *  options.noiseMultiplier times the combined noise.  Noisy
+       *  benchmarks therefore tolerate larger changes than quiet ones.
+       */
+      BaselineComparison compareWithBaseline(
+	  const Result& baseline, const Result& current,
+	  const PerfCheckOptions& options = PerfCheckOptions()
+      );
+
+      /** @brief Returns the directory baselines are stored in */
+      std::string getBaselineDir();
+
+      /** @brief Load the baseline for the named benchmark
+       *
+       *  @returns  True if the baseline was loaded, false if it does
+       *            not exist or cannot be read
+       */
+      bool loadBaseline(const std::string& benchmarkName, Result& baseline);
+
+      /** @brief Save a result as the baseline for its benchmark
+       *
+       *  @returns  The full path to the file written, or an empty
+       *            string if the file could not be written
+       */
+      std::string saveBaseline(const Result& result);
+
+    }
+  }
+}
+#endif
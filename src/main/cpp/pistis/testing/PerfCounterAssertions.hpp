@@ -0,0 +1,132 @@
+#ifndef __PISTIS__TESTING__PERFCOUNTERASSERTIONS_HPP__
+#define __PISTIS__TESTING__PERFCOUNTERASSERTIONS_HPP__
+
+/** @file PerfCounterAssertions.hpp
+ *
+ *  Google Test assertions that limit the events a block of code may
+ *  cause on the current thread, e.g.
+ *
+ *  @code
+ *  EXPECT_PERF_COUNT_PER_ELEMENT_AT_MOST(PerfEvent::L1D_MISSES, n, 0.2,
+ *                                        sum = std::accumulate(...));
+ *  EXPECT_PERF_COUNT_AT_MOST(PerfEvent::PAGE_FAULTS, 0, lookup(key));
+ *  @endcode
+ *
+ *  Instruction and cache-miss counts are much more stable than elapsed
+ *  time on shared machines.  When an event cannot be counted (see
+ *  PerfCounterScope), the check passes and a note is printed, so the
+ *  same tests run on machines with and without hardware counters.
+ *  Use PISTIS_SKIP_UNLESS_PERF_EVENT() to skip a test instead.
+ */
+#include <pistis/testing/PerfCounters.hpp>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Verify the count for the event divided by numElements
+     *         is at most maxPerElement.
+     *
+     *  Succeeds if the event was not counted.
+     */
+    inline ::testing::AssertionResult checkPerfCountPerElementAtMost(
+	const PerfCounts& counts, PerfEvent event, uint64_t numElements,
+	double maxPerElement
+    ) {
+      if (!counts.available(event)) {
+	std::cout << "[   NOTE   ] " << perfEventName(event)
+		  << " cannot be counted on this machine; check skipped"
+		  << std::endl;
+	return ::testing::AssertionSuccess();
+      }
+
+      const double perElement = counts.perElement(event, numElements);
+      if (perElement <= maxPerElement) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << counts[event] << " " << perfEventName(event) << " ("
+	  << perfCounterSourceName(counts.source(event)) << ") over "
+	  << numElements << " elements is " << perElement
+	  << " per element, which exceeds the limit of " << maxPerElement
+	  << ".  All counts: " << counts;
+    }
+
+    /** @brief Verify the count for the event is at most maxCount.
+     *
+     *  Succeeds if the event was not counted.
+     */
+    inline ::testing::AssertionResult checkPerfCountAtMost(
+	const PerfCounts& counts, PerfEvent event, uint64_t maxCount
+    ) {
+      return checkPerfCountPerElementAtMost(counts, event, 1,
+					    double(maxCount));
+    }
+
+  }
+}
+
+#define PISTIS_TESTING_PERF_BUDGET_(check, fail, ...)			\
+  do {									\
+    ::testing::AssertionResult pistisPerfResult_ =			\
+	::testing::AssertionSuccess();					\
+    {									\
+      ::pistis::testing::PerfCounterScope pistisPerfScope_;		\
+      __VA_ARGS__;							\
+      pistisPerfScope_.stop();						\
+      pistisPerfResult_ = check;					\
+    }									\
+    if (!pistisPerfResult_) {						\
+      fail(pistisPerfResult_.message());				\
+    }									\
+  } while (false)
+
+#define PISTIS_TESTING_PERF_EXPECT_FAILURE_(message) ADD_FAILURE() << message
+#define PISTIS_TESTING_PERF_ASSERT_FAILURE_(message) FAIL() << message
+
+/** @brief Expect statement to cause at most n of the event */
+#define EXPECT_PERF_COUNT_AT_MOST(event, n, ...)			\
+  PISTIS_TESTING_PERF_BUDGET_(						\
+      ::pistis::testing::checkPerfCountAtMost(				\
+	  pistisPerfScope_.counts(), (event), (n)),			\
+      PISTIS_TESTING_PERF_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement causes at most n of the event */
+#define ASSERT_PERF_COUNT_AT_MOST(event, n, ...)			\
+  PISTIS_TESTING_PERF_BUDGET_(						\
+      ::pistis::testing::checkPerfCountAtMost(				\
+	  pistisPerfScope_.counts(), (event), (n)),			\
+      PISTIS_TESTING_PERF_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Expect statement, which processes numElements elements, to
+ *         cause at most maxPerElement of the event per element
+ */
+#define EXPECT_PERF_COUNT_PER_ELEMENT_AT_MOST(event, numElements,	\
+					      maxPerElement, ...)	\
+  PISTIS_TESTING_PERF_BUDGET_(						\
+      ::pistis::testing::checkPerfCountPerElementAtMost(		\
+	  pistisPerfScope_.counts(), (event), (numElements),		\
+	  (maxPerElement)),						\
+      PISTIS_TESTING_PERF_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement, which processes numElements elements,
+ *         causes at most maxPerElement of the event per element
+ */
+#define ASSERT_PERF_COUNT_PER_ELEMENT_AT_MOST(event, numElements,	\
+					      maxPerElement, ...)	\
+  PISTIS_TESTING_PERF_BUDGET_(						\
+      ::pistis::testing::checkPerfCountPerElementAtMost(		\
+	  pistisPerfScope_.counts(), (event), (numElements),		\
+	  (maxPerElement)),						\
+      PISTIS_TESTING_PERF_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Skip the current test unless the event can be counted */
+#define PISTIS_SKIP_UNLESS_PERF_EVENT(event)				\
+  if (::pistis::testing::PerfCounterScope(false).source(event) ==	\
+      ::pistis::testing::PerfCounterSource::UNAVAILABLE)		\
+    GTEST_SKIP() << ::pistis::testing::perfEventName(event)		\
+		 << " cannot be counted on this machine"
+
+#endif
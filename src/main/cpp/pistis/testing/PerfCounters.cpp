@@ -0,0 +1,305 @@
+#include "PerfCounters.hpp"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static const PerfEvent HARDWARE_EVENTS[] = {
+    PerfEvent::INSTRUCTIONS, PerfEvent::CYCLES, PerfEvent::CACHE_MISSES,
+    PerfEvent::BRANCH_MISSES, PerfEvent::L1D_MISSES
+  };
+
+  static const PerfEvent SOFTWARE_EVENTS[] = {
+    PerfEvent::PAGE_FAULTS, PerfEvent::CONTEXT_SWITCHES,
+    PerfEvent::TASK_CLOCK
+  };
+
+  static void describeEvent(PerfEvent event, perf_event_attr& attr) {
+    switch (event) {
+      case PerfEvent::INSTRUCTIONS:
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	break;
+
+      case PerfEvent::CYCLES:
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	break;
+
+      case PerfEvent::CACHE_MISSES:
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	break;
+
+      case PerfEvent::BRANCH_MISSES:
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+	break;
+
+      case PerfEvent::L1D_MISSES:
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_L1D |
+		      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	break;
+
+      case PerfEvent::PAGE_FAULTS:
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+	break;
+
+      case PerfEvent::CONTEXT_SWITCHES:
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+	break;
+
+      case PerfEvent::TASK_CLOCK:
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_TASK_CLOCK;
+	break;
+    }
+  }
+
+  static int openEvent(PerfEvent event, int groupLeader) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    describeEvent(event, attr);
+    attr.disabled = (groupLeader < 0) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+		       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupLeader,
+			PERF_FLAG_FD_CLOEXEC);
+  }
+
+  static bool perfEventsDisabled() {
+    const char* value = getenv("PISTIS_TESTING_DISABLE_PERF_EVENTS");
+    return value && *value && strcmp(value, "0");
+  }
+
+  static uint64_t toNanoseconds(const timeval& t) {
+    return uint64_t(t.tv_sec) * 1000000000 + uint64_t(t.tv_usec) * 1000;
+  }
+
+  static void readRusage(PerfCounts& counts) {
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage)) {
+      return;
+    }
+    counts.set(PerfEvent::PAGE_FAULTS, usage.ru_minflt + usage.ru_majflt,
+	       PerfCounterSource::RUSAGE);
+    counts.set(PerfEvent::CONTEXT_SWITCHES, usage.ru_nvcsw + usage.ru_nivcsw,
+	       PerfCounterSource::RUSAGE);
+    counts.set(PerfEvent::TASK_CLOCK,
+	       toNanoseconds(usage.ru_utime) + toNanoseconds(usage.ru_stime),
+	       PerfCounterSource::RUSAGE);
+  }
+}
+
+const char* pistis::testing::perfEventName(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::INSTRUCTIONS: return "instructions";
+    case PerfEvent::CYCLES: return "cycles";
+    case PerfEvent::CACHE_MISSES: return "cache-misses";
+    case PerfEvent::BRANCH_MISSES: return "branch-misses";
+    case PerfEvent::L1D_MISSES: return "L1-dcache-load-misses";
+    case PerfEvent::PAGE_FAULTS: return "page-faults";
+    case PerfEvent::CONTEXT_SWITCHES: return "context-switches";
+    case PerfEvent::TASK_CLOCK: return "task-clock";
+  }
+  return "unknown";
+}
+
+const char* pistis::testing::perfCounterSourceName(PerfCounterSource source) {
+  switch (source) {
+    case PerfCounterSource::UNAVAILABLE: return "unavailable";
+    case PerfCounterSource::HARDWARE: return "hardware";
+    case PerfCounterSource::SOFTWARE: return "software";
+    case PerfCounterSource::RUSAGE: return "getrusage";
+  }
+  return "unknown";
+}
+
+PerfCounts::PerfCounts() {
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    values_[i] = 0;
+    sources_[i] = PerfCounterSource::UNAVAILABLE;
+  }
+}
+
+std::ostream& pistis::testing::operator<<(std::ostream& out,
+					  const PerfCounts& counts) {
+  bool first = true;
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    const PerfEvent event = PerfEvent(i);
+    if (counts.available(event)) {
+      out << (first ? "" : " ") << perfEventName(event) << "="
+	  << counts[event];
+      first = false;
+    }
+  }
+  return out;
+}
+
+PerfCounterScope::PerfCounterScope(bool start): running_(false) {
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    sources_[i] = PerfCounterSource::UNAVAILABLE;
+  }
+
+  if (!perfEventsDisabled()) {
+    openGroup(HARDWARE_EVENTS,
+	      sizeof(HARDWARE_EVENTS) / sizeof(HARDWARE_EVENTS[0]),
+	      PerfCounterSource::HARDWARE);
+    openGroup(SOFTWARE_EVENTS,
+	      sizeof(SOFTWARE_EVENTS) / sizeof(SOFTWARE_EVENTS[0]),
+	      PerfCounterSource::SOFTWARE);
+  }
+
+  // getrusage() covers the software events the kernel would not open
+  PerfCounts usage;
+  readRusage(usage);
+  for (PerfEvent event : SOFTWARE_EVENTS) {
+    if (!usage.available(event)) {
+      continue;
+    } else if (sources_[size_t(event)] == PerfCounterSource::UNAVAILABLE) {
+      sources_[size_t(event)] = PerfCounterSource::RUSAGE;
+    }
+  }
+
+  if (start) {
+    this->start();
+  }
+}
+
+PerfCounterScope::~PerfCounterScope() {
+  for (int fd : fds_) {
+    ::close(fd);
+  }
+}
+
+void PerfCounterScope::start() {
+  for (const Group& group : groups_) {
+    ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  running_ = true;
+  atStart_ = readCounters();
+}
+
+void PerfCounterScope::stop() {
+  if (running_) {
+    atStop_ = readCounters();
+    for (const Group& group : groups_) {
+      ioctl(group.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    running_ = false;
+  }
+}
+
+PerfCounts PerfCounterScope::counts() const {
+  const PerfCounts end = running_ ? readCounters() : atStop_;
+  PerfCounts result;
+
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    const PerfEvent event = PerfEvent(i);
+    if (end.available(event)) {
+      const uint64_t start = atStart_[event];
+      result.set(event, (end[event] > start) ? end[event] - start : 0,
+		 end.source(event));
+    }
+  }
+  return result;
+}
+
+bool PerfCounterScope::hardwareEventsAvailable() {
+  static const bool AVAILABLE = []() {
+    if (perfEventsDisabled()) {
+      return false;
+    }
+    const int fd = openEvent(PerfEvent::INSTRUCTIONS, -1);
+    if (fd < 0) {
+      return false;
+    }
+    ::close(fd);
+    return true;
+  }();
+  return AVAILABLE;
+}
+
+void PerfCounterScope::openGroup(const PerfEvent* events, size_t numEvents,
+				 PerfCounterSource source) {
+  Group group;
+  group.leader = -1;
+
+  for (size_t i = 0; i < numEvents; ++i) {
+    // Events the PMU cannot count, or that do not fit into the group,
+    // are left unavailable rather than failing the whole group
+    const int fd = openEvent(events[i], group.leader);
+    if (fd >= 0) {
+      fds_.push_back(fd);
+      group.events.push_back(events[i]);
+      sources_[size_t(events[i])] = source;
+      if (group.leader < 0) {
+	group.leader = fd;
+      }
+    }
+  }
+
+  if (group.leader >= 0) {
+    // Layout is nr, time_enabled, time_running, then one value per event
+    readBuffer_.resize(std::max(readBuffer_.size(),
+				3 + group.events.size()));
+    groups_.push_back(group);
+  }
+}
+
+PerfCounts PerfCounterScope::readCounters() const {
+  PerfCounts counts;
+  readRusage(counts);
+
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    const PerfEvent event = PerfEvent(i);
+    if (sources_[i] != PerfCounterSource::RUSAGE) {
+      counts.set(event, 0, PerfCounterSource::UNAVAILABLE);
+    }
+  }
+
+  for (const Group& group : groups_) {
+    uint64_t* const buffer = readBuffer_.data();
+    const ssize_t n = ::read(group.leader, buffer,
+			     (3 + group.events.size()) * sizeof(uint64_t));
+    if (n < ssize_t(3 * sizeof(uint64_t))) {
+      continue;
+    }
+
+    // A group that was never scheduled onto the PMU, e.g. because the
+    // NMI watchdog or another tool holds the counters, counted nothing
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    if (!running) {
+      continue;
+    }
+
+    const double scale =
+	(running < enabled) ? double(enabled) / double(running) : 1.0;
+    const size_t numValues = std::min<size_t>(buffer[0], group.events.size());
+    for (size_t i = 0; i < numValues; ++i) {
+      const PerfEvent event = group.events[i];
+      counts.set(event, uint64_t(double(buffer[3 + i]) * scale),
+		 sources_[size_t(event)]);
+    }
+  }
+  return counts;
+}
@@ -0,0 +1,200 @@
+#ifndef __PISTIS__TESTING__PERFCOUNTERS_HPP__
+#define __PISTIS__TESTING__PERFCOUNTERS_HPP__
+
+#include <ostream>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file PerfCounters.hpp
+ *
+ *  Hardware and software event counts for unit tests and benchmarks
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Events a PerfCounterScope can count */
+    enum class PerfEvent {
+      /** @brief Instructions retired */
+      INSTRUCTIONS,
+
+      /** @brief CPU cycles */
+      CYCLES,
+
+      /** @brief Last-level cache misses */
+      CACHE_MISSES,
+
+      /** @brief Mispredicted branches */
+      BRANCH_MISSES,
+
+      /** @brief L1 data cache read misses */
+      L1D_MISSES,
+
+      /** @brief Minor and major page faults */
+      PAGE_FAULTS,
+
+      /** @brief Voluntary and involuntary context switches */
+      CONTEXT_SWITCHES,
+
+      /** @brief CPU time, in nanoseconds */
+      TASK_CLOCK
+    };
+
+    /** @brief Number of values in PerfEvent */
+    static const size_t NUM_PERF_EVENTS = 8;
+
+    /** @brief Where the count for an event came from */
+    enum class PerfCounterSource {
+      /** @brief The event could not be counted */
+      UNAVAILABLE,
+
+      /** @brief A hardware counter, through perf_event_open() */
+      HARDWARE,
+
+      /** @brief A software counter kept by the kernel, through
+       *         perf_event_open()
+       */
+      SOFTWARE,
+
+      /** @brief getrusage(RUSAGE_THREAD).  Has much coarser
+       *         resolution than the perf_event_open() counters.
+       */
+      RUSAGE
+    };
+
+    /** @brief Returns the name of the event, e.g. "instructions" */
+    const char* perfEventName(PerfEvent event);
+
+    /** @brief Returns the name of the source, e.g. "hardware" */
+    const char* perfCounterSourceName(PerfCounterSource source);
+
+    /** @brief Counts for all of the events in PerfEvent */
+    class PerfCounts {
+    public:
+      PerfCounts();
+
+      /** @brief Value of the counter for the given event.  Zero if
+       *         the event is not available.
+       */
+      uint64_t operator[](PerfEvent event) const {
+	return values_[size_t(event)];
+      }
+
+      /** @brief Where the count for the given event came from */
+      PerfCounterSource source(PerfEvent event) const {
+	return sources_[size_t(event)];
+      }
+
+      /** @brief True if the event was counted */
+      bool available(PerfEvent event) const {
+	return source(event) != PerfCounterSource::UNAVAILABLE;
+      }
+
+      /** @brief Count for the event divided by n, e.g. the number of
+       *         elements the code under test processed
+       */
+      double perElement(PerfEvent event, uint64_t n) const {
+	return double((*this)[event]) / double(n ? n : 1);
+      }
+
+      /** @brief Set the count for an event */
+      void set(PerfEvent event, uint64_t value, PerfCounterSource source) {
+	values_[size_t(event)] = value;
+	sources_[size_t(event)] = source;
+      }
+
+    private:
+      uint64_t values_[NUM_PERF_EVENTS];
+      PerfCounterSource sources_[NUM_PERF_EVENTS];
+    };
+
+    /** @brief Write the available counts, one "name=value" per event */
+    std::ostream& operator<<(std::ostream& out, const PerfCounts& counts);
+
+    /** @brief Counts hardware and software events on the current
+     *         thread while it is running.
+     *
+     *  The hardware events are opened as one perf_event_open() group
+     *  so they are scheduled onto the PMU together and their counts
+     *  cover the same instructions.  When the kernel multiplexes the
+     *  group with other users of the PMU, the counts are scaled up by
+     *  the fraction of time the group was not scheduled.  A group that
+     *  was never scheduled, e.g. because the NMI watchdog holds the
+     *  PMU, reports its events unavailable.  Only events in user space
+     *  are counted.
+     *
+     *  Hardware events are unavailable in many containers and virtual
+     *  machines, or when /proc/sys/kernel/perf_event_paranoid forbids
+     *  them.  Page faults, context switches and CPU time fall back to
+     *  getrusage() when the kernel's software counters are unavailable
+     *  too.  Check PerfCounts::available() or source() before relying
+     *  on a count, or use the macros in PerfCounterAssertions.hpp,
+     *  which skip checks on unavailable events.
+     *
+     *  Setting the PISTIS_TESTING_DISABLE_PERF_EVENTS environment
+     *  variable to anything other than "" or "0" disables
+     *  perf_event_open(), so only the getrusage() counts are kept.
+     *
+     *  A PerfCounterScope counts the thread that created it, and must
+     *  be started, stopped and destroyed by that thread.
+     */
+    class PerfCounterScope {
+    public:
+      /** @brief Open the counters, and start them if start is true */
+      explicit PerfCounterScope(bool start = true);
+      PerfCounterScope(const PerfCounterScope&) = delete;
+      ~PerfCounterScope();
+
+      /** @brief Where counts for the given event will come from */
+      PerfCounterSource source(PerfEvent event) const {
+	return sources_[size_t(event)];
+      }
+
+      /** @brief True between start() and stop() */
+      bool running() const { return running_; }
+
+      /** @brief Reset the counts to zero and start counting */
+      void start();
+
+      /** @brief Stop counting.  The counts are kept until the next
+       *         call to start().
+       */
+      void stop();
+
+      /** @brief Counts since the last call to start().  If the scope
+       *         is stopped, counts between start() and stop().
+       */
+      PerfCounts counts() const;
+
+      PerfCounterScope& operator=(const PerfCounterScope&) = delete;
+
+      /** @brief Returns true if perf_event_open() can count hardware
+       *         events in this process
+       */
+      static bool hardwareEventsAvailable();
+
+    private:
+      struct Group {
+	int leader;
+	std::vector<PerfEvent> events;
+      };
+
+      PerfCounterSource sources_[NUM_PERF_EVENTS];
+      std::vector<Group> groups_;
+      std::vector<int> fds_;
+
+      // Holds what read() returns for a group, allocated up front so
+      // reading the counters does not allocate inside the measurement
+      mutable std::vector<uint64_t> readBuffer_;
+      PerfCounts atStart_;
+      PerfCounts atStop_;
+      bool running_;
+
+      void openGroup(const PerfEvent* events, size_t numEvents,
+		     PerfCounterSource source);
+      PerfCounts readCounters() const;
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,261 @@
+#include "ResourceUsage.hpp"
+#include "AllocationHooks.hpp"
+#include "Timing.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static uint64_t toNanoseconds(const struct timeval& t) {
+    return uint64_t(t.tv_sec) * 1000000000ULL + uint64_t(t.tv_usec) * 1000;
+  }
+
+  // Reads VmRSS and VmHWM from /proc/self/status, in bytes
+  static void readMemoryStatus(uint64_t& rss, uint64_t& peakRss) {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+
+    rss = 0;
+    peakRss = 0;
+    while (std::getline(in, line)) {
+      if (!line.compare(0, 6, "VmRSS:")) {
+	rss = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+      } else if (!line.compare(0, 6, "VmHWM:")) {
+	peakRss = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+      }
+    }
+  }
+
+  static uint64_t minus(uint64_t end, uint64_t start) {
+    return (end > start) ? end - start : 0;
+  }
+
+  static void writeJsonString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+      switch (c) {
+	case '"': out << "\\\""; break;
+	case '\\': out << "\\\\"; break;
+	case '\n': out << "\\n"; break;
+	case '\r': out << "\\r"; break;
+	case '\t': out << "\\t"; break;
+	default:
+	  if ((unsigned char)c < 0x20) {
+	    out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+		<< int(c) << std::dec << std::setfill(' ');
+	  } else {
+	    out << c;
+	  }
+      }
+    }
+    out << '"';
+  }
+
+  static void writeUsageJson(std::ostream& out, const ResourceUsage& u,
+			     const char* indent) {
+    out << indent << "\"wallTime\": " << u.wallTime << ",\n"
+	<< indent << "\"userTime\": " << u.userTime << ",\n"
+	<< indent << "\"systemTime\": " << u.systemTime << ",\n"
+	<< indent << "\"rssDelta\": " << u.rssDelta << ",\n"
+	<< indent << "\"peakRssDelta\": " << u.peakRss << ",\n"
+	<< indent << "\"peakRssReset\": "
+	<< (u.peakRssReset ? "true" : "false") << ",\n"
+	<< indent << "\"minorFaults\": " << u.minorFaults << ",\n"
+	<< indent << "\"majorFaults\": " << u.majorFaults << ",\n"
+	<< indent << "\"voluntaryContextSwitches\": "
+	<< u.voluntaryContextSwitches << ",\n"
+	<< indent << "\"involuntaryContextSwitches\": "
+	<< u.involuntaryContextSwitches;
+    if (u.allocationsCounted) {
+      out << ",\n" << indent << "\"allocations\": " << u.allocations
+	  << ",\n" << indent << "\"bytesAllocated\": " << u.bytesAllocated;
+    }
+  }
+
+  // Writes a table of the n tests with the largest value of the
+  // given field
+  static void writeTopTests(
+      std::ostream& out, const std::vector<TestResourceUsage>& tests,
+      size_t n, const char* title, const char* units, double scale,
+      const std::function<uint64_t (const ResourceUsage&)>& field
+  ) {
+    std::vector<const TestResourceUsage*> sorted;
+    for (const auto& t : tests) {
+      sorted.push_back(&t);
+    }
+    n = std::min(n, sorted.size());
+    std::partial_sort(
+	sorted.begin(), sorted.begin() + n, sorted.end(),
+	[&field](const TestResourceUsage* x, const TestResourceUsage* y) {
+	  return field(x->usage) > field(y->usage);
+	}
+    );
+
+    out << title << ":" << std::endl;
+    for (size_t i = 0; i < n; ++i) {
+      out << std::setw(14) << std::fixed << std::setprecision(3)
+	  << (double(field(sorted[i]->usage)) / scale) << " " << units
+	  << "  " << sorted[i]->fullName() << std::endl;
+    }
+  }
+}
+
+ResourceUsage::ResourceUsage():
+    wallTime(0), userTime(0), systemTime(0), rss(0), rssDelta(0),
+    peakRss(0), peakRssReset(false), minorFaults(0), majorFaults(0), voluntaryContextSwitches(0),
+    involuntaryContextSwitches(0), allocationsCounted(false),
+    allocations(0), bytesAllocated(0) {
+}
+
+ResourceUsage ResourceUsage::current() {
+  ResourceUsage usage;
+  struct rusage r;
+
+  usage.wallTime = monotonicNanoseconds();
+  if (!getrusage(RUSAGE_SELF, &r)) {
+    usage.userTime = toNanoseconds(r.ru_utime);
+    usage.systemTime = toNanoseconds(r.ru_stime);
+    usage.minorFaults = r.ru_minflt;
+    usage.majorFaults = r.ru_majflt;
+    usage.voluntaryContextSwitches = r.ru_nvcsw;
+    usage.involuntaryContextSwitches = r.ru_nivcsw;
+  }
+  readMemoryStatus(usage.rss, usage.peakRss);
+
+  usage.allocationsCounted = hooks::globalAllocationCountingEnabled();
+  if (usage.allocationsCounted) {
+    const hooks::GlobalAllocationCounts counts =
+	hooks::globalAllocationCounts();
+    usage.allocations = counts.allocations;
+    usage.bytesAllocated = counts.bytesAllocated;
+  }
+  return usage;
+}
+
+ResourceUsage ResourceUsage::difference(const ResourceUsage& start,
+					const ResourceUsage& end) {
+  ResourceUsage usage;
+  usage.wallTime = minus(end.wallTime, start.wallTime);
+  usage.userTime = minus(end.userTime, start.userTime);
+  usage.systemTime = minus(end.systemTime, start.systemTime);
+  usage.rss = end.rss;
+  usage.rssDelta = int64_t(end.rss) - int64_t(start.rss);
+  usage.peakRss = minus(end.peakRss, start.rss);
+  usage.peakRssReset = start.peakRssReset;
+  usage.minorFaults = minus(end.minorFaults, start.minorFaults);
+  usage.majorFaults = minus(end.majorFaults, start.majorFaults);
+  usage.voluntaryContextSwitches =
+      minus(end.voluntaryContextSwitches, start.voluntaryContextSwitches);
+  usage.involuntaryContextSwitches =
+      minus(end.involuntaryContextSwitches, start.involuntaryContextSwitches);
+  usage.allocationsCounted =
+      start.allocationsCounted && end.allocationsCounted;
+  if (usage.allocationsCounted) {
+    usage.allocations = minus(end.allocations, start.allocations);
+    usage.bytesAllocated = minus(end.bytesAllocated, start.bytesAllocated);
+  }
+  return usage;
+}
+
+bool pistis::testing::resetPeakRss() {
+  const int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  const bool ok = ::write(fd, "5", 1) == 1;
+  ::close(fd);
+  return ok;
+}
+
+ResourceUsageReport::ResourceUsageReport(): tests_() {
+}
+
+ResourceUsage ResourceUsageReport::total() const {
+  ResourceUsage sum;
+  sum.peakRssReset = !tests_.empty();
+  sum.allocationsCounted = !tests_.empty();
+  for (const auto& t : tests_) {
+    const ResourceUsage& u = t.usage;
+    sum.wallTime += u.wallTime;
+    sum.userTime += u.userTime;
+    sum.systemTime += u.systemTime;
+    sum.rssDelta += u.rssDelta;
+    sum.peakRss = std::max(sum.peakRss, u.peakRss);
+    sum.peakRssReset = sum.peakRssReset && u.peakRssReset;
+    sum.minorFaults += u.minorFaults;
+    sum.majorFaults += u.majorFaults;
+    sum.voluntaryContextSwitches += u.voluntaryContextSwitches;
+    sum.involuntaryContextSwitches += u.involuntaryContextSwitches;
+    sum.allocationsCounted = sum.allocationsCounted && u.allocationsCounted;
+    sum.allocations += u.allocations;
+    sum.bytesAllocated += u.bytesAllocated;
+  }
+  return sum;
+}
+
+void ResourceUsageReport::add(const TestResourceUsage& test) {
+  tests_.push_back(test);
+}
+
+void ResourceUsageReport::clear() {
+  tests_.clear();
+}
+
+void ResourceUsageReport::writeJson(std::ostream& out) const {
+  out << "{\n  \"tests\": [";
+  for (size_t i = 0; i < tests_.size(); ++i) {
+    const TestResourceUsage& t = tests_[i];
+    out << (i ? ",\n" : "\n") << "    {\n      \"suite\": ";
+    writeJsonString(out, t.suite);
+    out << ",\n      \"name\": ";
+    writeJsonString(out, t.name);
+    out << ",\n      \"passed\": " << (t.passed ? "true" : "false")
+	<< ",\n";
+    writeUsageJson(out, t.usage, "      ");
+    out << "\n    }";
+  }
+  out << (tests_.empty() ? "],\n" : "\n  ],\n") << "  \"total\": {\n";
+  writeUsageJson(out, total(), "    ");
+  out << "\n  }\n}\n";
+}
+
+void ResourceUsageReport::writeSummary(std::ostream& out, size_t n) const {
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  const ResourceUsage sum = total();
+
+  writeTopTests(out, tests_, n, "Slowest tests", "ms", 1e6,
+		[](const ResourceUsage& u) { return u.wallTime; });
+  writeTopTests(out, tests_, n, "Largest peak memory increases", "MiB",
+		1048576.0,
+		[](const ResourceUsage& u) { return u.peakRss; });
+  if (sum.allocationsCounted) {
+    writeTopTests(out, tests_, n, "Most bytes allocated", "MiB", 1048576.0,
+		  [](const ResourceUsage& u) { return u.bytesAllocated; });
+  }
+  out << std::fixed << std::setprecision(3) << "Total: " << tests_.size()
+      << " tests, " << (double(sum.wallTime) / 1e9) << " s wall, "
+      << (double(sum.userTime) / 1e9) << " s user, "
+      << (double(sum.systemTime) / 1e9) << " s system, "
+      << sum.majorFaults << " major faults" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool ResourceUsageReport::save(const std::string& filename) const {
+  std::ofstream out(filename.c_str());
+  writeJson(out);
+  return bool(out);
+}
@@ -0,0 +1,176 @@
+#ifndef __PISTIS__TESTING__RESOURCEUSAGE_HPP__
+#define __PISTIS__TESTING__RESOURCEUSAGE_HPP__
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file ResourceUsage.hpp
+ *
+ *  Measure the time, memory, page faults and context switches used by
+ *  a stretch of code, and report them for many tests at once.
+ *
+ *  See ResourceUsageListener.hpp for recording the resources each
+ *  Google Test test uses.
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Resources used by the process, or the difference between
+     *         two such snapshots.
+     *
+     *  CPU times, faults and context switches come from
+     *  getrusage(RUSAGE_SELF) and cover all of the process's threads.
+     *  Memory sizes come from /proc/self/status.
+     */
+    struct ResourceUsage {
+      /** @brief Elapsed time on the monotonic clock, in nanoseconds */
+      uint64_t wallTime;
+
+      /** @brief CPU time spent in user mode, in nanoseconds */
+      uint64_t userTime;
+
+      /** @brief CPU time spent in the kernel, in nanoseconds */
+      uint64_t systemTime;
+
+      /** @brief Resident set size, in bytes.
+       *
+       *  In a difference, the resident set size at the end.
+       */
+      uint64_t rss;
+
+      /** @brief Change in resident set size, in bytes.  Negative if it
+       *         shrank.  Zero except in a difference.
+       */
+      int64_t rssDelta;
+
+      /** @brief Peak resident set size, in bytes.
+       *
+       *  In a difference, the amount the peak rose above the resident
+       *  set size at the start.  Call resetPeakRss() at the start to
+       *  measure the peak of the stretch of code rather than of the
+       *  whole process.
+       */
+      uint64_t peakRss;
+
+      /** @brief Whether resetPeakRss() succeeded just before this
+       *         snapshot, or before the start of a difference.
+       *
+       *  current() leaves this false; whoever resets the peak sets it.
+       *  If false, peakRss in a difference is the rise of the whole
+       *  process's peak above the starting resident set size.
+       */
+      bool peakRssReset;
+
+      /** @brief Page faults serviced without I/O */
+      uint64_t minorFaults;
+
+      /** @brief Page faults that required I/O */
+      uint64_t majorFaults;
+
+      /** @brief Times the process gave up the processor, usually to
+       *         wait for I/O or a lock
+       */
+      uint64_t voluntaryContextSwitches;
+
+      /** @brief Times the process was preempted */
+      uint64_t involuntaryContextSwitches;
+
+      /** @brief Whether the allocation fields are meaningful, i.e.
+       *         whether allocation counting (see AllocationHooks.hpp)
+       *         was enabled
+       */
+      bool allocationsCounted;
+
+      /** @brief Calls to the allocation functions */
+      uint64_t allocations;
+
+      /** @brief Bytes requested from the allocation functions */
+      uint64_t bytesAllocated;
+
+      ResourceUsage();
+
+      /** @brief Returns the resources the process has used so far */
+      static ResourceUsage current();
+
+      /** @brief Resources used between two snapshots.
+       *
+       *  The rssDelta field is the change in resident set size,
+       *  peakRss is the rise of the peak above the starting resident
+       *  set size and peakRssReset comes from start.
+       */
+      static ResourceUsage difference(const ResourceUsage& start,
+				      const ResourceUsage& end);
+    };
+
+    /** @brief Reset the process's peak resident set size to its current
+     *         resident set size.
+     *
+     *  Writes to /proc/self/clear_refs, which Linux supports since
+     *  version 4.0.
+     *
+     *  @returns  True if the peak was reset
+     */
+    bool resetPeakRss();
+
+    /** @brief Resources used by one test */
+    struct TestResourceUsage {
+      /** @brief Name of the test suite */
+      std::string suite;
+
+      /** @brief Name of the test */
+      std::string name;
+
+      /** @brief Whether the test passed */
+      bool passed;
+
+      /** @brief Resources the test used */
+      ResourceUsage usage;
+
+      /** @brief "suite.name" */
+      std::string fullName() const { return suite + "." + name; }
+    };
+
+    /** @brief Resources used by a set of tests */
+    class ResourceUsageReport {
+    public:
+      ResourceUsageReport();
+
+      /** @brief Usage of each test, in the order they were added */
+      const std::vector<TestResourceUsage>& tests() const {
+	return tests_;
+      }
+
+      /** @brief Total resources used by all the tests */
+      ResourceUsage total() const;
+
+      /** @brief Add one test's usage */
+      void add(const TestResourceUsage& test);
+
+      /** @brief Forget all tests */
+      void clear();
+
+      /** @brief Write every test's usage as a JSON object */
+      void writeJson(std::ostream& out) const;
+
+      /** @brief Write tables of the n tests that took the most wall
+       *         time, raised the peak resident set size the most and,
+       *         if allocations were counted, allocated the most bytes
+       */
+      void writeSummary(std::ostream& out, size_t n = 10) const;
+
+      /** @brief Write the JSON report to the given file
+       *
+       *  @returns  True if the file was written
+       */
+      bool save(const std::string& filename) const;
+
+    private:
+      std::vector<TestResourceUsage> tests_;
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,172 @@
+#ifndef __PISTIS__TESTING__RESOURCEUSAGELISTENER_HPP__
+#define __PISTIS__TESTING__RESOURCEUSAGELISTENER_HPP__
+
+/** @file ResourceUsageListener.hpp
+ *
+ *  Google Test listener that records the resources each test uses.
+ *
+ *  The listener records each test's wall time, user and system CPU
+ *  time, peak memory increase, page faults, context switches and,
+ *  optionally, allocations (see ResourceUsage).  When the test program
+ *  ends, it writes a JSON report of every test and prints the slowest
+ *  and hungriest tests.  Each test's "peakRssReset" in the report is
+ *  false if the listener could not reset the peak resident set size
+ *  when the test started, in which case its "peakRssDelta" measures
+ *  the whole process's peak rather than the test's.
+ *
+ *  To make the listener available to a test program that uses
+ *  gtest_main, put
+ *
+ *  @code
+ *  PISTIS_TESTING_REGISTER_RESOURCE_USAGE_LISTENER();
+ *  @endcode
+ *
+ *  at namespace scope in exactly one of its source files, then run it
+ *  with PISTIS_TESTING_RESOURCE_USAGE set (see
+ *  installResourceUsageListenerFromEnvironment()).  "make
+ *  resource-report" does this for this library's unit tests.
+ */
+#include <pistis/testing/AllocationHooks.hpp>
+#include <pistis/testing/ResourceUsage.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    class ResourceUsageListener : public ::testing::EmptyTestEventListener {
+    public:
+      /** @brief Create a new listener
+       *
+       *  @param reportFile        File the JSON report is written to
+       *                           when the program ends.  If empty, no
+       *                           report is written.
+       *  @param countAllocations  Whether to count each test's
+       *                           allocations.  Counting slows down
+       *                           every allocation a little.
+       *  @param summarySize       Number of tests in each table of the
+       *                           summary printed when the program
+       *                           ends.  If zero, no summary is
+       *                           printed.
+       */
+      ResourceUsageListener(const std::string& reportFile,
+			    bool countAllocations, size_t summarySize = 10):
+	  reportFile_(reportFile), countAllocations_(countAllocations),
+	  summarySize_(summarySize), start_(), report_() {
+      }
+
+      /** @brief Resources used by the tests that have finished so far */
+      const ResourceUsageReport& report() const { return report_; }
+
+      virtual void OnTestStart(const ::testing::TestInfo&) override {
+	if (countAllocations_) {
+	  hooks::enableGlobalAllocationCounting();
+	}
+	const bool peakRssReset = resetPeakRss();
+	start_ = ResourceUsage::current();
+	start_.peakRssReset = peakRssReset;
+      }
+
+      virtual void OnTestEnd(const ::testing::TestInfo& info) override {
+	const ResourceUsage end = ResourceUsage::current();
+	if (countAllocations_) {
+	  hooks::disableGlobalAllocationCounting();
+	}
+
+	TestResourceUsage usage;
+	usage.suite = info.test_suite_name();
+	usage.name = info.name();
+	usage.passed = !info.result() || info.result()->Passed();
+	usage.usage = ResourceUsage::difference(start_, end);
+	report_.add(usage);
+      }
+
+      virtual void OnTestProgramEnd(const ::testing::UnitTest&) override {
+	if (summarySize_) {
+	  std::cout << std::endl;
+	  report_.writeSummary(std::cout, summarySize_);
+	}
+	if (!reportFile_.empty()) {
+	  if (report_.save(reportFile_)) {
+	    std::cout << "Resource usage report written to " << reportFile_
+		      << std::endl;
+	  } else {
+	    std::cout << "Could not write resource usage report to "
+		      << reportFile_ << std::endl;
+	  }
+	}
+      }
+
+    private:
+      std::string reportFile_;
+      bool countAllocations_;
+      size_t summarySize_;
+      ResourceUsage start_;
+      ResourceUsageReport report_;
+    };
+
+    /** @brief Append a ResourceUsageListener to gtest's listeners.
+     *
+     *  Google Test owns the listener.  Call before RUN_ALL_TESTS().
+     */
+    inline ResourceUsageListener* installResourceUsageListener(
+	const std::string& reportFile, bool countAllocations,
+	size_t summarySize = 10
+    ) {
+      ResourceUsageListener* listener =
+	  new ResourceUsageListener(reportFile, countAllocations,
+				    summarySize);
+      ::testing::UnitTest::GetInstance()->listeners().Append(listener);
+      return listener;
+    }
+
+    /** @brief Install a ResourceUsageListener if the environment asks
+     *         for one.
+     *
+     *  Does nothing unless PISTIS_TESTING_RESOURCE_USAGE is set to
+     *  something other than "" or "0."  If it is "1," the report is
+     *  written to "resource_usage.json" in the scratch directory;
+     *  otherwise it names the report file.  Allocations are counted if
+     *  PISTIS_TESTING_RESOURCE_USAGE_ALLOCATIONS is set to something
+     *  other than "" or "0."  Installs at most one listener no matter
+     *  how many times it is called.
+     *
+     *  @returns  True if a listener is installed
+     */
+    inline bool installResourceUsageListenerFromEnvironment() {
+      static bool installed = false;
+      const char* report = getenv("PISTIS_TESTING_RESOURCE_USAGE");
+      const char* allocations =
+	  getenv("PISTIS_TESTING_RESOURCE_USAGE_ALLOCATIONS");
+
+      if (!installed && report && *report && strcmp(report, "0")) {
+	std::string reportFile(report);
+	if (reportFile == "1") {
+	  makeDirectories(getScratchDir());
+	  reportFile = getScratchFile("resource_usage.json");
+	}
+	installResourceUsageListener(
+	    reportFile, allocations && *allocations && strcmp(allocations, "0")
+	);
+	installed = true;
+      }
+      return installed;
+    }
+
+  }
+}
+
+/** @brief Install a ResourceUsageListener before main() runs, if the
+ *         environment asks for one.  Use at namespace scope in one
+ *         source file of the test program.
+ */
+#define PISTIS_TESTING_REGISTER_RESOURCE_USAGE_LISTENER()		\
+  static const bool pistisResourceUsageListenerInstalled_ =		\
+      ::pistis::testing::installResourceUsageListenerFromEnvironment()
+
+#endif
@@ -0,0 +1,163 @@
+#include "ResourceView.hpp"
+#include "Resources.hpp"
+
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace pistis::testing;
+
+class pistis::testing::ResourceMapping {
+public:
+  std::string path;
+  void* address;
+  size_t size;
+  dev_t device;
+  ino_t inode;
+  struct timespec modified;
+
+  ResourceMapping(): address(nullptr), size(0), device(0), inode(0) {
+    modified.tv_sec = 0;
+    modified.tv_nsec = 0;
+  }
+
+  ResourceMapping(const ResourceMapping&) = delete;
+
+  ~ResourceMapping() {
+    if (address) {
+      ::munmap(address, size);
+    }
+  }
+
+  bool matches(const struct stat& info) const {
+    return (device == info.st_dev) && (inode == info.st_ino) &&
+	   (size == size_t(info.st_size)) &&
+	   (modified.tv_sec == info.st_mtim.tv_sec) &&
+	   (modified.tv_nsec == info.st_mtim.tv_nsec);
+  }
+
+  ResourceMapping& operator=(const ResourceMapping&) = delete;
+};
+
+namespace {
+  // Maps the real path of each mapped file to its mapping
+  typedef std::unordered_map<
+      std::string, std::weak_ptr<const ResourceMapping>
+  > MappingRegistry;
+
+  static std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static MappingRegistry& registry() {
+    static MappingRegistry* mappings = new MappingRegistry();
+    return *mappings;
+  }
+
+  static std::runtime_error mappingError(const std::string& path,
+					 const char* operation) {
+    std::ostringstream msg;
+    msg << "Cannot " << operation << " resource " << path << " ("
+	<< strerror(errno) << ")";
+    return std::runtime_error(msg.str());
+  }
+
+  static int adviceFor(ResourceAccess access) {
+    switch (access) {
+      case ResourceAccess::SEQUENTIAL: return MADV_SEQUENTIAL;
+      case ResourceAccess::RANDOM: return MADV_RANDOM;
+      case ResourceAccess::WILL_NEED: return MADV_WILLNEED;
+      default: return MADV_NORMAL;
+    }
+  }
+}
+
+ResourceView::ResourceView(): mapping_(), data_(nullptr), size_(0) { }
+
+ResourceView::ResourceView(const std::string& filename,
+			   ResourceAccess access):
+    mapping_(), data_(nullptr), size_(0) {
+  const std::string path = getResourcePath(filename);
+  char resolved[PATH_MAX];
+  if (!::realpath(path.c_str(), resolved)) {
+    throw mappingError(path, "open");
+  }
+
+  const int fd = ::open(resolved, O_RDONLY | O_CLOEXEC);
+  struct stat info;
+  if (fd < 0) {
+    throw mappingError(path, "open");
+  } else if (::fstat(fd, &info)) {
+    const std::runtime_error error = mappingError(path, "stat");
+    ::close(fd);
+    throw error;
+  }
+
+  std::lock_guard<std::mutex> lock(registryMutex());
+  std::weak_ptr<const ResourceMapping>& entry = registry()[resolved];
+  std::shared_ptr<const ResourceMapping> mapping = entry.lock();
+
+  if (!mapping || !mapping->matches(info)) {
+    std::shared_ptr<ResourceMapping> m = std::make_shared<ResourceMapping>();
+    m->path = resolved;
+    m->size = size_t(info.st_size);
+    m->device = info.st_dev;
+    m->inode = info.st_ino;
+    m->modified = info.st_mtim;
+    if (m->size) {
+      void* address = ::mmap(nullptr, m->size, PROT_READ, MAP_SHARED, fd, 0);
+      if (address == MAP_FAILED) {
+	const std::runtime_error error = mappingError(path, "map");
+	::close(fd);
+	throw error;
+      }
+      m->address = address;
+    }
+    mapping = m;
+    entry = mapping;
+  }
+  ::close(fd);
+
+  mapping_ = mapping;
+  data_ = (const uint8_t*)mapping->address;
+  size_ = mapping->size;
+  advise(access);
+}
+
+const std::string& ResourceView::path() const {
+  static const std::string NO_PATH;
+  return mapping_ ? mapping_->path : NO_PATH;
+}
+
+void ResourceView::advise(ResourceAccess access) const {
+  if (mapping_ && mapping_->address) {
+    ::madvise(mapping_->address, mapping_->size, adviceFor(access));
+  }
+}
+
+size_t ResourceView::numMappings() {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  MappingRegistry& mappings = registry();
+  size_t n = 0;
+
+  for (auto i = mappings.begin(); i != mappings.end(); ) {
+    if (i->second.expired()) {
+      i = mappings.erase(i);
+    } else {
+      ++n;
+      ++i;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,131 @@
+#ifndef __PISTIS__TESTING__RESOURCEVIEW_HPP__
+#define __PISTIS__TESTING__RESOURCEVIEW_HPP__
+
+#include <memory>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file ResourceView.hpp
+ *
+ *  Read-only, memory-mapped views of test resources
+ */
+namespace pistis {
+  namespace testing {
+
+    class ResourceMapping;
+
+    /** @brief How a test will access a mapped resource.  Passed to
+     *         madvise() as a hint to the kernel's read-ahead.
+     */
+    enum class ResourceAccess {
+      /** @brief No particular pattern (MADV_NORMAL) */
+      NORMAL,
+
+      /** @brief Front to back (MADV_SEQUENTIAL).  The kernel reads
+       *         ahead aggressively and drops pages soon after they
+       *         are read.
+       */
+      SEQUENTIAL,
+
+      /** @brief Random order (MADV_RANDOM).  The kernel does not read
+       *         ahead.
+       */
+      RANDOM,
+
+      /** @brief The whole resource will be needed soon
+       *         (MADV_WILLNEED).  The kernel starts reading it in the
+       *         background.
+       */
+      WILL_NEED
+    };
+
+    /** @brief A test resource, mapped read-only into memory.
+     *
+     *  Mappings are shared process-wide:  all ResourceViews of the
+     *  same file share one mapping, which is unmapped when the last
+     *  of them is destroyed.  Mapping a resource does not read it, so
+     *  a test that touches a few pages of a multi-gigabyte corpus
+     *  only pays for those pages, and pages read by one test are
+     *  still in memory for the next one.  The memory is backed by the
+     *  page cache rather than the heap.
+     *
+     *  A file that has changed size or modification time since it was
+     *  mapped gets a new mapping.  Changing a file while it is mapped
+     *  changes the contents of its views, and truncating it causes
+     *  SIGBUS on access, so resources should not be modified while
+     *  tests are running.
+     *
+     *  ResourceView is cheap to copy.  Copies share the mapping.
+     */
+    class ResourceView {
+    public:
+      typedef const uint8_t* const_iterator;
+
+    public:
+      /** @brief Create an empty view that maps nothing */
+      ResourceView();
+
+      /** @brief Map a resource.
+       *
+       *  @param filename  Name of the resource, expanded to a full path
+       *                   by getResourcePath()
+       *  @param access    How the test will access the resource
+       *  @throws std::runtime_error  If the resource cannot be opened
+       *                              or mapped
+       */
+      explicit ResourceView(const std::string& filename,
+			    ResourceAccess access = ResourceAccess::NORMAL);
+
+      /** @brief Full path to the mapped file.  Empty for an empty view */
+      const std::string& path() const;
+
+      /** @brief The first byte of the resource */
+      const uint8_t* data() const { return data_; }
+
+      /** @brief The resource's contents as characters */
+      const char* chars() const { return (const char*)data_; }
+
+      /** @brief Size of the resource in bytes */
+      size_t size() const { return size_; }
+
+      /** @brief True if the resource has no bytes */
+      bool empty() const { return !size_; }
+
+      const_iterator begin() const { return data_; }
+      const_iterator end() const { return data_ + size_; }
+
+      uint8_t operator[](size_t i) const { return data_[i]; }
+
+      /** @brief Copy the resource into a string */
+      std::string toString() const {
+	return std::string(chars(), size_);
+      }
+
+      /** @brief Tell the kernel how the resource will be accessed.
+       *
+       *  The hint applies to the shared mapping, so it affects every
+       *  view of the same file.
+       */
+      void advise(ResourceAccess access) const;
+
+      /** @brief Number of files currently mapped by ResourceViews */
+      static size_t numMappings();
+
+    private:
+      std::shared_ptr<const ResourceMapping> mapping_;
+      const uint8_t* data_;
+      size_t size_;
+    };
+
+    /** @brief Map a resource.  Same as ResourceView(filename, access) */
+    inline ResourceView mapResource(
+	const std::string& filename,
+	ResourceAccess access = ResourceAccess::NORMAL
+    ) {
+      return ResourceView(filename, access);
+    }
+
+  }
+}
+#endif
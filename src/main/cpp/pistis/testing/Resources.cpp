@@ -1,9 +1,16 @@
 #include "Resources.hpp"
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 using namespace pistis::testing;
 
@@ -48,6 +55,131 @@ namespace {
       return base + "/tmp";
     }
   }
+
+  // Creates dir if it does not exist, and returns true if it is a
+  // directory, not a symbolic link, that belongs to this user and
+  // that no one else can write to
+  static bool makePrivateDirectory(const std::string& dir) {
+    struct stat info;
+    if (::mkdir(dir.c_str(), 0700) && (errno != EEXIST)) {
+      return false;
+    }
+    return !::lstat(dir.c_str(), &info) && S_ISDIR(info.st_mode) &&
+	   (info.st_uid == ::getuid()) &&
+	   !(info.st_mode & (S_IWGRP | S_IWOTH));
+  }
+
+  static std::string computeTmpfsScratchDir() {
+    const char* dirEnvVar = getenv("PISTIS_FILESYSTEM_TEST_TMPFS_SCRATCH_DIR");
+    struct stat info;
+    if (dirEnvVar) {
+      return stripTrailingPathSeparator(std::string(dirEnvVar));
+    } else if (::stat("/dev/shm", &info) || !S_ISDIR(info.st_mode)) {
+      return getScratchDir();
+    }
+
+    // Anyone can create this name in /dev/shm, so only use it if this
+    // user owns it
+    const std::string dir =
+	"/dev/shm/pistis_testing." + std::to_string(::getuid());
+    if (!makePrivateDirectory(dir)) {
+      std::cerr << "WARNING: " << dir << " is not a private directory "
+		<< "owned by this user; using " << getScratchDir()
+		<< " instead" << std::endl;
+      return getScratchDir();
+    }
+    return dir;
+  }
+
+  // Returns the absolute form of path, with empty and "." components
+  // removed and ".." components applied, without following symbolic
+  // links.  Relative paths are resolved against the current directory.
+  static std::string normalizePath(const std::string& relativePath) {
+    std::string path(relativePath);
+    if (path.empty() || (path[0] != '/')) {
+      std::vector<char> cwd(PATH_MAX);
+      if (::getcwd(cwd.data(), cwd.size())) {
+	path = std::string(cwd.data()) + "/" + path;
+      }
+    }
+
+    const bool absolute = !path.empty() && (path[0] == '/');
+    std::vector<std::string> components;
+    size_t start = 0;
+
+    while (start <= path.size()) {
+      size_t end = path.find('/', start);
+      if (end == std::string::npos) {
+	end = path.size();
+      }
+
+      const std::string component = path.substr(start, end - start);
+      if (component == "..") {
+	if (!components.empty() && (components.back() != "..")) {
+	  components.pop_back();
+	} else if (!absolute) {
+	  components.push_back(component);
+	}
+      } else if (!component.empty() && (component != ".")) {
+	components.push_back(component);
+      }
+      start = end + 1;
+    }
+
+    std::string normalized(absolute ? "/" : "");
+    for (const std::string& component : components) {
+      if (!normalized.empty() && (normalized.back() != '/')) {
+	normalized += '/';
+      }
+      normalized += component;
+    }
+    return normalized.empty() ? std::string(".") : normalized;
+  }
+
+  // Returns true if path is ancestor or lies inside it.  Both paths
+  // must be normalized.
+  static bool isWithin(const std::string& path, const std::string& ancestor) {
+    return !path.compare(0, ancestor.size(), ancestor) &&
+	   ((path.size() == ancestor.size()) || (ancestor == "/") ||
+	    (path[ancestor.size()] == '/'));
+  }
+
+  // Removes everything in the directory open on dirFd, and closes it
+  static bool removeDirectoryContents(int dirFd) {
+    DIR* dir = ::fdopendir(dirFd);
+    bool removedAll = true;
+    if (!dir) {
+      ::close(dirFd);
+      return false;
+    }
+
+    while (const struct dirent* entry = ::readdir(dir)) {
+      const char* name = entry->d_name;
+      if (!strcmp(name, ".") || !strcmp(name, "..")) {
+	continue;
+      }
+
+      // d_type saves a failed unlinkat() on each subdirectory, but
+      // some filesystems leave it as DT_UNKNOWN
+      if ((entry->d_type != DT_DIR) && !::unlinkat(::dirfd(dir), name, 0)) {
+	continue;
+      } else if ((entry->d_type != DT_DIR) && (errno != EISDIR)) {
+	removedAll = removedAll && (errno == ENOENT);
+	continue;
+      }
+
+      const int childFd = ::openat(::dirfd(dir), name,
+				   O_RDONLY | O_DIRECTORY | O_NOFOLLOW |
+				       O_CLOEXEC);
+      if ((childFd < 0) || !removeDirectoryContents(childFd) ||
+	  ::unlinkat(::dirfd(dir), name, AT_REMOVEDIR)) {
+	removedAll = false;
+      }
+    }
+
+    ::closedir(dir);
+    return removedAll;
+  }
 }
 
 std::string pistis::testing::getExecutableDir() {
@@ -98,6 +230,53 @@ std::string pistis::testing::getScratchFile(
   }
 }
 
+std::string pistis::testing::getTmpfsScratchDir() {
+  static const std::string TMPFS_SCRATCH_DIR = computeTmpfsScratchDir();
+  return TMPFS_SCRATCH_DIR;
+}
+
+bool pistis::testing::makeDirectories(const std::string& path) {
+  struct stat info;
+  if (path.empty()) {
+    return false;
+  } else if (!::stat(path.c_str(), &info)) {
+    return S_ISDIR(info.st_mode);
+  }
+
+  const std::string parent = stripLastComponent(path);
+  if ((parent != path) && !makeDirectories(parent)) {
+    return false;
+  }
+  return !::mkdir(path.c_str(), 0777) || (errno == EEXIST);
+}
+
 void pistis::testing::removeFile(const std::string& filename) {
   ::unlink(getScratchFile(filename).c_str());
 }
+
+bool pistis::testing::removeTree(const std::string& path) {
+  // Removing the scratch directory or one of its ancestors would
+  // destroy the scratch files of every test running in parallel
+  const std::string fullPath = getScratchFile(path);
+  if (path.empty() ||
+      isWithin(normalizePath(getScratchDir()), normalizePath(fullPath))) {
+    throw std::invalid_argument("Cannot remove \"" + path + "\":  it is "
+				"empty or names the root or scratch "
+				"directory or one of its ancestors");
+  }
+
+  struct stat info;
+  if (::lstat(fullPath.c_str(), &info)) {
+    return errno == ENOENT;
+  } else if (!S_ISDIR(info.st_mode)) {
+    return !::unlink(fullPath.c_str()) || (errno == ENOENT);
+  }
+
+  const int dirFd = ::open(fullPath.c_str(),
+			   O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (dirFd < 0) {
+    return false;
+  }
+  removeDirectoryContents(dirFd);
+  return !::rmdir(fullPath.c_str()) || (errno == ENOENT);
+}
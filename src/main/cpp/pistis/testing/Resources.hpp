@@ -50,6 +50,30 @@ namespace pistis {
      */
     std::string getScratchFile(const std::string& filename);
 
+    /** @brief Returns a scratch directory on a memory-backed (tmpfs)
+     *         filesystem, for tests that do a lot of I/O.
+     *
+     *  Equal to PISTIS_FILESYSTEM_TEST_TMPFS_SCRATCH_DIR if that
+     *  environment variable is set.  Otherwise, it is
+     *  "/dev/shm/pistis_testing.${UID}" if /dev/shm exists, or the
+     *  directory returned by getScratchDir() if it does not.  The
+     *  /dev/shm directory is created with mode 0700 on first use.  If
+     *  it already exists but is not a directory owned by the current
+     *  user that only that user can write to, e.g. because another
+     *  user created it or made it a symbolic link, a warning is
+     *  printed and getScratchDir() is used instead.
+     */
+    std::string getTmpfsScratchDir();
+
+    /** @brief Create a directory and any of its parents that do not
+     *         exist.
+     *
+     *  @param path  The directory to create
+     *  @returns     True if the directory exists when makeDirectories()
+     *               returns, false if it could not be created.
+     */
+    bool makeDirectories(const std::string& path);
+
     /** @brief Remove the named file.
      *
      *  If the file is not an absolute path, it is joined with the
@@ -62,6 +86,23 @@ namespace pistis {
      */
     void removeFile(const std::string& filename);
 
+    /** @brief Remove the named file or directory, and everything in the
+     *         directory.
+     *
+     *  Relative names are resolved against the scratch directory, as
+     *  in removeFile().  Directories are walked with openat() and
+     *  emptied with unlinkat(), so no full paths are built, and
+     *  symbolic links are removed rather than followed.  Continues
+     *  past entries it cannot remove.
+     *
+     *  @param path  The file or directory to remove
+     *  @returns     True if path no longer exists
+     *  @throws std::invalid_argument if path is empty or resolves to
+     *          "/", the scratch directory or one of its ancestors,
+     *          e.g. ".", "..", "/a/.." or getScratchDir()
+     */
+    bool removeTree(const std::string& path);
+
   }
 }
 #endif
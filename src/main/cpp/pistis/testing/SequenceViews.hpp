@@ -0,0 +1,217 @@
+#ifndef __PISTIS__TESTING__SEQUENCEVIEWS_HPP__
+#define __PISTIS__TESTING__SEQUENCEVIEWS_HPP__
+
+/** @file SequenceViews.hpp
+ *
+ *  Truth sequences for the iterator tests in Iterators.hpp that do not
+ *  hold their elements in memory
+ */
+#include <iterator>
+#include <type_traits>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace testing {
+    namespace iterators {
+
+      // The iterator tests compare the iterator under test against a
+      // truth sequence.  A truth sequence has begin() and end() and,
+      // for bidirectional iterators, rbegin() and rend().  Random
+      // access tests also need size() and operator[].  Containers
+      // have all of these, but holding 10^9 elements or the contents
+      // of a large file in a container just to test an iterator is
+      // impractical.  The views below provide the same interface
+      // using O(1) memory.
+
+      /** @brief Random access iterator over a GeneratedSequence.
+       *
+       *  Dereferencing returns the generator's value by value, so
+       *  there is no operator->.
+       */
+      template <typename Generator>
+      class GeneratedSequenceIterator {
+      public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef typename std::decay<
+	    decltype(std::declval<const Generator&>()(uint64_t(0)))
+	>::type value_type;
+	typedef ptrdiff_t difference_type;
+	typedef const value_type* pointer;
+	typedef value_type reference;
+
+      public:
+	GeneratedSequenceIterator(): generator_(nullptr), index_(0) { }
+	GeneratedSequenceIterator(const Generator* generator, uint64_t index):
+	    generator_(generator), index_(index) {
+	}
+
+	/** @brief Index of the element the iterator refers to */
+	uint64_t index() const { return index_; }
+
+	reference operator*() const { return (*generator_)(index_); }
+	reference operator[](difference_type n) const {
+	  return (*generator_)(index_ + n);
+	}
+
+	GeneratedSequenceIterator& operator++() { ++index_; return *this; }
+	GeneratedSequenceIterator operator++(int) {
+	  GeneratedSequenceIterator tmp(*this);
+	  ++index_;
+	  return tmp;
+	}
+	GeneratedSequenceIterator& operator--() { --index_; return *this; }
+	GeneratedSequenceIterator operator--(int) {
+	  GeneratedSequenceIterator tmp(*this);
+	  --index_;
+	  return tmp;
+	}
+
+	GeneratedSequenceIterator& operator+=(difference_type n) {
+	  index_ += n;
+	  return *this;
+	}
+	GeneratedSequenceIterator& operator-=(difference_type n) {
+	  index_ -= n;
+	  return *this;
+	}
+	GeneratedSequenceIterator operator+(difference_type n) const {
+	  return GeneratedSequenceIterator(generator_, index_ + n);
+	}
+	GeneratedSequenceIterator operator-(difference_type n) const {
+	  return GeneratedSequenceIterator(generator_, index_ - n);
+	}
+	difference_type operator-(const GeneratedSequenceIterator& other) const {
+	  return difference_type(index_ - other.index_);
+	}
+
+	bool operator==(const GeneratedSequenceIterator& other) const {
+	  return index_ == other.index_;
+	}
+	bool operator!=(const GeneratedSequenceIterator& other) const {
+	  return index_ != other.index_;
+	}
+	bool operator<(const GeneratedSequenceIterator& other) const {
+	  return index_ < other.index_;
+	}
+	bool operator<=(const GeneratedSequenceIterator& other) const {
+	  return index_ <= other.index_;
+	}
+	bool operator>(const GeneratedSequenceIterator& other) const {
+	  return index_ > other.index_;
+	}
+	bool operator>=(const GeneratedSequenceIterator& other) const {
+	  return index_ >= other.index_;
+	}
+
+      private:
+	const Generator* generator_;
+	uint64_t index_;
+      };
+
+      /** @brief A sequence whose i-th element is generator(i).
+       *
+       *  The generator is any function object with
+       *  "T operator()(uint64_t i) const," such as the generators in
+       *  Generators.hpp or a lambda.  Elements are computed when they
+       *  are read, so the sequence takes O(1) memory regardless of its
+       *  size.  The generator must return the same value for the same
+       *  index every time it is called.
+       */
+      template <typename Generator>
+      class GeneratedSequence {
+      public:
+	typedef GeneratedSequenceIterator<Generator> const_iterator;
+	typedef const_iterator iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+	typedef const_reverse_iterator reverse_iterator;
+	typedef typename const_iterator::value_type value_type;
+	typedef uint64_t size_type;
+
+      public:
+	GeneratedSequence(uint64_t size, Generator generator):
+	    size_(size), generator_(generator) {
+	}
+
+	uint64_t size() const { return size_; }
+	bool empty() const { return !size_; }
+	const Generator& generator() const { return generator_; }
+
+	value_type operator[](uint64_t i) const { return generator_(i); }
+
+	const_iterator begin() const {
+	  return const_iterator(&generator_, 0);
+	}
+	const_iterator end() const {
+	  return const_iterator(&generator_, size_);
+	}
+	const_reverse_iterator rbegin() const {
+	  return const_reverse_iterator(end());
+	}
+	const_reverse_iterator rend() const {
+	  return const_reverse_iterator(begin());
+	}
+
+      private:
+	uint64_t size_;
+	Generator generator_;
+      };
+
+      /** @brief Create a GeneratedSequence of the given size */
+      template <typename Generator>
+      inline GeneratedSequence<Generator> generatedSequence(
+	  uint64_t size, Generator generator
+      ) {
+	return GeneratedSequence<Generator>(size, generator);
+      }
+
+      /** @brief Views a sequence in reverse order without copying it.
+       *
+       *  The sequence must have rbegin() and rend() and must outlive
+       *  the view.  Reversing a view that has operator[] and size()
+       *  keeps them, so a reversed GeneratedSequence or std::vector can
+       *  still be indexed.
+       */
+      template <typename Sequence>
+      class ReversedSequence {
+      public:
+	typedef decltype(std::declval<const Sequence&>().rbegin())
+	    const_iterator;
+	typedef const_iterator iterator;
+	typedef decltype(std::declval<const Sequence&>().begin())
+	    const_reverse_iterator;
+	typedef const_reverse_iterator reverse_iterator;
+
+      public:
+	ReversedSequence(const Sequence& sequence): sequence_(&sequence) { }
+
+	const_iterator begin() const { return sequence_->rbegin(); }
+	const_iterator end() const { return sequence_->rend(); }
+	const_reverse_iterator rbegin() const { return sequence_->begin(); }
+	const_reverse_iterator rend() const { return sequence_->end(); }
+
+	template <typename S = Sequence>
+	auto size() const -> decltype(std::declval<const S&>().size()) {
+	  return sequence_->size();
+	}
+
+	template <typename S = Sequence>
+	auto operator[](decltype(std::declval<const S&>().size()) i) const
+	    -> decltype(std::declval<const S&>()[i]) {
+	  return (*sequence_)[sequence_->size() - 1 - i];
+	}
+
+      private:
+	const Sequence* sequence_;
+      };
+
+      /** @brief View the sequence in reverse order */
+      template <typename Sequence>
+      inline ReversedSequence<Sequence> reversed(const Sequence& sequence) {
+	return ReversedSequence<Sequence>(sequence);
+      }
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,19 @@
+#include "Sharding.hpp"
+
+#include <atomic>
+
+namespace {
+  static std::atomic<size_t> nextShard(0);
+
+  // initial-exec TLS never allocates on first access, which matters
+  // because currentThreadShard() is called from malloc()
+  static __thread size_t threadShardPlusOne
+      __attribute__((tls_model("initial-exec"))) = 0;
+}
+
+size_t pistis::testing::currentThreadShard() {
+  if (!threadShardPlusOne) {
+    threadShardPlusOne = nextShard.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  return threadShardPlusOne - 1;
+}
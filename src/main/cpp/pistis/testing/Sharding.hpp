@@ -0,0 +1,101 @@
+#ifndef __PISTIS__TESTING__SHARDING_HPP__
+#define __PISTIS__TESTING__SHARDING_HPP__
+
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+
+/** @file Sharding.hpp
+ *
+ *  Per-thread, cache-line-padded slots for statistics that are updated
+ *  concurrently by many threads and read rarely.
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Size of a cache line on the platforms we support */
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    /** @brief Wraps a value so it has a cache line to itself */
+    template <typename T>
+    struct alignas(CACHE_LINE_SIZE) CacheLinePadded {
+      T value;
+    };
+
+    /** @brief Returns the shard assigned to the calling thread.
+     *
+     *  Threads are assigned consecutive shard numbers in the order they
+     *  first call this function.  The assignment never changes, so a
+     *  thread always updates the same slot.  Callers reduce the shard
+     *  number modulo their number of slots; when there are more
+     *  threads than slots, some threads share a slot.
+     *
+     *  This function never allocates memory, so it can be called from
+     *  within malloc().
+     */
+    size_t currentThreadShard();
+
+    /** @brief A fixed number of cache-line-padded slots, one of which
+     *         belongs to each thread.
+     *
+     *  Each thread updates its own slot through local(), so threads
+     *  never contend for a cache line unless there are more than
+     *  NUM_SHARDS of them.  Readers aggregate over all the slots.
+     *  Slots must be updated with atomic operations, since a slot
+     *  may be shared when there are many threads and is read
+     *  concurrently with updates.
+     *
+     *  The slots live in a separately-allocated, cache-line-aligned
+     *  block, so ShardedSlots can be embedded in objects created with
+     *  new or std::make_shared.
+     *
+     *  @tparam Slot  Type of a slot.  Must be default-constructible.
+     *  @tparam N     Number of slots.  Must be a power of two.
+     */
+    template <typename Slot, size_t N = 64>
+    class ShardedSlots {
+    public:
+      static const size_t NUM_SHARDS = N;
+      static_assert(N && !(N & (N - 1)), "N must be a power of two");
+
+    public:
+      ShardedSlots(): slots_(nullptr) {
+	void* p = nullptr;
+	if (::posix_memalign(&p, CACHE_LINE_SIZE, N * sizeof(Padded))) {
+	  throw std::bad_alloc();
+	}
+	slots_ = static_cast<Padded*>(p);
+	for (size_t i = 0; i < N; ++i) {
+	  new(slots_ + i) Padded();
+	}
+      }
+      ShardedSlots(const ShardedSlots&) = delete;
+      ~ShardedSlots() {
+	for (size_t i = 0; i < N; ++i) {
+	  slots_[i].~Padded();
+	}
+	::free(slots_);
+      }
+
+      /** @brief The calling thread's slot */
+      Slot& local() { return slots_[currentThreadShard() & (N - 1)].value; }
+
+      /** @brief The slot for shard i */
+      Slot& operator[](size_t i) { return slots_[i].value; }
+
+      /** @brief The slot for shard i */
+      const Slot& operator[](size_t i) const { return slots_[i].value; }
+
+      ShardedSlots& operator=(const ShardedSlots&) = delete;
+
+    private:
+      typedef CacheLinePadded<Slot> Padded;
+      Padded* slots_;
+    };
+
+    template <typename Slot, size_t N>
+    const size_t ShardedSlots<Slot, N>::NUM_SHARDS;
+
+  }
+}
+#endif
@@ -0,0 +1,321 @@
+#include "Stress.hpp"
+#include "Generators.hpp"
+#include "Timing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PISTIS_TESTING_HAVE_PAUSE 1
+#endif
+
+using namespace pistis::testing;
+using namespace pistis::testing::stress;
+
+namespace {
+  // Spins before a thread waiting on a SpinBarrier starts yielding
+  static const unsigned MAX_SPINS = 4096;
+
+  static void cpuRelax() {
+#ifdef PISTIS_TESTING_HAVE_PAUSE
+    _mm_pause();
+#endif
+  }
+
+  static std::vector<int> allowedProcessors() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (!sched_getaffinity(0, sizeof(set), &set)) {
+      for (int i = 0; i < CPU_SETSIZE; ++i) {
+	if (CPU_ISSET(i, &set)) {
+	  cpus.push_back(i);
+	}
+      }
+    }
+    return cpus;
+  }
+
+  // Returns the processor the thread was pinned to, or -1 if it could
+  // not be pinned
+  static int pinCurrentThread(const std::vector<int>& cpus, size_t index) {
+    if (cpus.empty()) {
+      return -1;
+    }
+
+    const int cpu = cpus[index % cpus.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+      return -1;
+    }
+    return cpu;
+  }
+
+  // Cumulative weights of the operations, scaled to end at 1
+  static std::vector<double> operationThresholds(
+      const std::vector<Operation>& operations
+  ) {
+    if (operations.empty()) {
+      throw std::invalid_argument("A stress test needs at least one "
+				  "operation");
+    }
+
+    std::vector<double> thresholds;
+    double total = 0.0;
+    for (const auto& op : operations) {
+      if (op.weight < 0.0) {
+	throw std::invalid_argument("Operation \"" + op.name +
+				    "\" has a negative weight");
+      }
+      total += op.weight;
+      thresholds.push_back(total);
+    }
+    if (total <= 0.0) {
+      throw std::invalid_argument("At least one operation must have a "
+				  "positive weight");
+    }
+    for (auto& t : thresholds) {
+      t /= total;
+    }
+    thresholds.back() = 1.0;
+    return thresholds;
+  }
+
+  static void runWorker(size_t index,
+			const std::vector<Operation>& operations,
+			const std::vector<double>& thresholds,
+			const StressOptions& options,
+			const std::vector<int>& cpus, SpinBarrier& barrier,
+			std::atomic<bool>& stop, ThreadResult& result,
+			std::exception_ptr& error) {
+    const uint64_t seed = generators::randomBits(options.seed, index);
+    const uint64_t limit = options.operationsPerThread;
+
+    result.cpu = options.pinThreads ? pinCurrentThread(cpus, index) : -1;
+    result.operationCounts.assign(operations.size(), 0);
+    result.operations = 0;
+
+    barrier.wait();
+    const uint64_t start = monotonicNanoseconds();
+    try {
+      for (uint64_t i = 0;
+	   (!limit || (i < limit)) && !stop.load(std::memory_order_relaxed);
+	   ++i) {
+	const double r = generators::randomUnit(seed, i);
+	const size_t op =
+	    std::upper_bound(thresholds.begin(), thresholds.end() - 1, r) -
+	    thresholds.begin();
+	operations[op].run(index);
+	++result.operationCounts[op];
+      }
+    } catch(...) {
+      error = std::current_exception();
+      stop.store(true);
+    }
+    result.elapsed = monotonicNanoseconds() - start;
+
+    for (uint64_t n : result.operationCounts) {
+      result.operations += n;
+    }
+  }
+}
+
+SpinBarrier::SpinBarrier(size_t numThreads):
+    numThreads_(numThreads), waiting_(0), generation_(0) {
+}
+
+void SpinBarrier::wait() {
+  const uint64_t generation = generation_.load(std::memory_order_acquire);
+
+  if ((waiting_.fetch_add(1, std::memory_order_acq_rel) + 1) == numThreads_) {
+    waiting_.store(0, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    return;
+  }
+
+  for (unsigned spins = 0;
+       generation_.load(std::memory_order_acquire) == generation;
+       ++spins) {
+    if (spins < MAX_SPINS) {
+      cpuRelax();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+double ThreadResult::throughput() const {
+  return elapsed ? double(operations) * 1e9 / double(elapsed) : 0.0;
+}
+
+uint64_t StressResult::totalOperations() const {
+  uint64_t total = 0;
+  for (const auto& t : threads) {
+    total += t.operations;
+  }
+  return total;
+}
+
+uint64_t StressResult::operationCount(size_t i) const {
+  uint64_t total = 0;
+  for (const auto& t : threads) {
+    total += t.operationCounts[i];
+  }
+  return total;
+}
+
+double StressResult::throughput() const {
+  return elapsed ? double(totalOperations()) * 1e9 / double(elapsed) : 0.0;
+}
+
+double StressResult::fairness() const {
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+  for (const auto& t : threads) {
+    const double x = t.throughput();
+    sum += x;
+    sumOfSquares += x * x;
+  }
+  return (sumOfSquares > 0.0) ? (sum * sum) / (threads.size() * sumOfSquares)
+			      : 1.0;
+}
+
+namespace pistis {
+  namespace testing {
+    namespace stress {
+
+      StressResult run(const std::vector<Operation>& operations,
+		       const StressOptions& options) {
+	const std::vector<double> thresholds = operationThresholds(operations);
+	const size_t numThreads = std::max(options.threads, size_t(1));
+	const std::vector<int> cpus = allowedProcessors();
+	SpinBarrier barrier(numThreads + 1);
+	std::atomic<bool> stop(false);
+	std::vector<std::exception_ptr> errors(numThreads);
+	std::vector<std::thread> threads;
+	StressResult result;
+
+	for (const auto& op : operations) {
+	  result.operationNames.push_back(op.name);
+	}
+	result.threads.resize(numThreads);
+	for (size_t i = 0; i < numThreads; ++i) {
+	  threads.emplace_back(runWorker, i, std::cref(operations),
+			       std::cref(thresholds), std::cref(options),
+			       std::cref(cpus), std::ref(barrier),
+			       std::ref(stop), std::ref(result.threads[i]),
+			       std::ref(errors[i]));
+	}
+
+	barrier.wait();
+	const uint64_t start = monotonicNanoseconds();
+	if (!options.operationsPerThread) {
+	  // Sleep in short slices so a thread that fails stops the run
+	  // early
+	  const uint64_t end = start + options.duration;
+	  for (uint64_t now = start; (now < end) && !stop.load();
+	       now = monotonicNanoseconds()) {
+	    std::this_thread::sleep_for(
+		std::chrono::nanoseconds(std::min(end - now,
+						  uint64_t(1000000)))
+	    );
+	  }
+	  stop.store(true);
+	}
+	for (auto& t : threads) {
+	  t.join();
+	}
+	result.elapsed = monotonicNanoseconds() - start;
+
+	for (const auto& e : errors) {
+	  if (e) {
+	    std::rethrow_exception(e);
+	  }
+	}
+	return result;
+      }
+
+      std::vector<StressResult> runScaling(
+	  const std::vector<Operation>& operations,
+	  const std::vector<size_t>& threadCounts,
+	  const StressOptions& options
+      ) {
+	std::vector<StressResult> results;
+	StressOptions o(options);
+
+	for (size_t n : threadCounts) {
+	  o.threads = n;
+	  results.push_back(run(operations, o));
+	}
+	return results;
+      }
+
+      double scalingEfficiency(const StressResult& baseline,
+			       const StressResult& result) {
+	const double baseThroughput = baseline.throughput();
+	if ((baseThroughput <= 0.0) || baseline.threads.empty() ||
+	    result.threads.empty()) {
+	  return 0.0;
+	}
+
+	const double speedup = result.throughput() / baseThroughput;
+	const double threadRatio =
+	    double(result.threads.size()) / double(baseline.threads.size());
+	return speedup / threadRatio;
+      }
+
+      size_t availableProcessors() {
+	const size_t n = allowedProcessors().size();
+	return n ? n : 1;
+      }
+
+      void printStressResult(std::ostream& out, const StressResult& result) {
+	const std::streamsize precision = out.precision();
+
+	out << std::left << std::setw(8) << "thread" << std::right
+	    << std::setw(6) << "cpu" << std::setw(14) << "operations"
+	    << std::setw(16) << "ops/sec";
+	for (const auto& name : result.operationNames) {
+	  out << " " << std::setw(std::max(name.size(), size_t(10))) << name;
+	}
+	out << std::endl;
+
+	for (size_t i = 0; i < result.threads.size(); ++i) {
+	  const ThreadResult& t = result.threads[i];
+	  out << std::left << std::setw(8) << i << std::right << std::setw(6);
+	  if (t.cpu < 0) {
+	    out << "-";
+	  } else {
+	    out << t.cpu;
+	  }
+	  out << std::setw(14) << t.operations << std::fixed
+	      << std::setprecision(0) << std::setw(16) << t.throughput();
+	  for (size_t j = 0; j < t.operationCounts.size(); ++j) {
+	    out << " " << std::setw(std::max(result.operationNames[j].size(),
+					     size_t(10)))
+		<< t.operationCounts[j];
+	  }
+	  out << std::endl;
+	}
+	out << "total: " << result.totalOperations() << " operations in "
+	    << std::setprecision(3) << (double(result.elapsed) / 1e6)
+	    << " ms, " << std::setprecision(0) << result.throughput()
+	    << " ops/sec, fairness " << std::setprecision(3)
+	    << result.fairness() << std::endl;
+	out.unsetf(std::ios::floatfield);
+	out.precision(precision);
+      }
+
+    }
+  }
+}
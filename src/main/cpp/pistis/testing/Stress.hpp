@@ -0,0 +1,208 @@
+#ifndef __PISTIS__TESTING__STRESS_HPP__
+#define __PISTIS__TESTING__STRESS_HPP__
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file Stress.hpp
+ *
+ *  Driver for multithreaded stress tests.
+ *
+ *  The driver starts a number of threads, releases them all at once
+ *  from a spin barrier, and has each run a mix of operations, e.g. 90%
+ *  reads and 10% writes, for a fixed time or a fixed number of
+ *  operations.  Each operation is chosen by a counter-based random
+ *  number generator seeded from StressOptions::seed and the thread's
+ *  index, so every run performs the same sequence of operations on
+ *  each thread.  It reports each thread's throughput, the aggregate
+ *  throughput and how fairly the threads shared the work.
+ *
+ *  runScaling() repeats the run at several thread counts.  See
+ *  StressAssertions.hpp for Google Test assertions on the scaling
+ *  efficiency and fairness.
+ */
+namespace pistis {
+  namespace testing {
+    namespace stress {
+
+      /** @brief Barrier that releases a fixed number of threads at once.
+       *
+       *  Waiting threads spin rather than sleep, so they all start
+       *  within a few hundred nanoseconds of each other.  Threads yield
+       *  the processor after spinning a while, so the barrier still
+       *  makes progress when there are more threads than cores.  The
+       *  barrier can be reused once all threads have left it.
+       */
+      class SpinBarrier {
+      public:
+	SpinBarrier(size_t numThreads);
+	SpinBarrier(const SpinBarrier&) = delete;
+
+	/** @brief Number of threads the barrier waits for */
+	size_t numThreads() const { return numThreads_; }
+
+	/** @brief Wait until numThreads() threads have called wait() */
+	void wait();
+
+	SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+      private:
+	const size_t numThreads_;
+	std::atomic<size_t> waiting_;
+	std::atomic<uint64_t> generation_;
+      };
+
+      /** @brief One of the operations in the mix a stress test runs */
+      struct Operation {
+	/** @brief Name of the operation, for reports */
+	std::string name;
+
+	/** @brief Relative frequency of the operation.  Frequencies need
+	 *         not add up to any particular total.
+	 */
+	double weight;
+
+	/** @brief Runs the operation once.  Called with the index of the
+	 *         calling thread, from 0 to StressOptions::threads - 1.
+	 */
+	std::function<void (size_t)> run;
+
+	Operation(const std::string& n, double w,
+		  const std::function<void (size_t)>& r):
+	    name(n), weight(w), run(r) {
+	}
+      };
+
+      /** @brief How to run a stress test */
+      struct StressOptions {
+	/** @brief Number of threads to run */
+	size_t threads;
+
+	/** @brief How long to run, in nanoseconds.  Ignored if
+	 *         operationsPerThread is not zero.
+	 */
+	uint64_t duration;
+
+	/** @brief Number of operations each thread runs.  If zero, the
+	 *         threads run for "duration" nanoseconds instead.
+	 */
+	uint64_t operationsPerThread;
+
+	/** @brief Whether to pin thread i to the i-th processor the
+	 *         process may run on (modulo the number of processors)
+	 */
+	bool pinThreads;
+
+	/** @brief Seed for choosing operations from the mix */
+	uint64_t seed;
+
+	StressOptions():
+	    threads(2), duration(100000000), operationsPerThread(0),
+	    pinThreads(false), seed(0) {
+	}
+      };
+
+      /** @brief What one thread did during a stress test */
+      struct ThreadResult {
+	/** @brief Number of operations the thread ran */
+	uint64_t operations;
+
+	/** @brief Number of times the thread ran each operation, in the
+	 *         order the operations were given
+	 */
+	std::vector<uint64_t> operationCounts;
+
+	/** @brief Time from leaving the barrier to running the last
+	 *         operation, in nanoseconds
+	 */
+	uint64_t elapsed;
+
+	/** @brief Processor the thread was pinned to, or -1 if it was
+	 *         not pinned
+	 */
+	int cpu;
+
+	/** @brief Operations per second */
+	double throughput() const;
+      };
+
+      /** @brief Result of a stress test */
+      struct StressResult {
+	/** @brief Names of the operations, in the order they were given */
+	std::vector<std::string> operationNames;
+
+	/** @brief Results for each thread */
+	std::vector<ThreadResult> threads;
+
+	/** @brief Time from releasing the threads to the last thread
+	 *         finishing, in nanoseconds
+	 */
+	uint64_t elapsed;
+
+	/** @brief Total number of operations run by all threads */
+	uint64_t totalOperations() const;
+
+	/** @brief Total number of times all threads ran operation i */
+	uint64_t operationCount(size_t i) const;
+
+	/** @brief Operations per second, summed over all threads */
+	double throughput() const;
+
+	/** @brief Jain's fairness index of the per-thread throughputs.
+	 *
+	 *  Equal to 1 when all threads ran at the same rate and 1/n when
+	 *  one of the n threads did all the work.
+	 */
+	double fairness() const;
+      };
+
+      /** @brief Run a stress test.
+       *
+       *  If an operation throws an exception, the threads stop and the
+       *  first exception thrown is rethrown once they have all
+       *  finished.
+       *
+       *  @throws std::invalid_argument if there are no operations,
+       *          a weight is negative or all weights are zero
+       */
+      StressResult run(const std::vector<Operation>& operations,
+		       const StressOptions& options = StressOptions());
+
+      /** @brief Run the stress test once for each thread count.
+       *
+       *  Uses all the options except "threads."  The results are in
+       *  the same order as threadCounts.
+       */
+      std::vector<StressResult> runScaling(
+	  const std::vector<Operation>& operations,
+	  const std::vector<size_t>& threadCounts,
+	  const StressOptions& options = StressOptions()
+      );
+
+      /** @brief Scaling efficiency of a run relative to a baseline run
+       *         with fewer threads.
+       *
+       *  Equal to the speedup in aggregate throughput divided by the
+       *  increase in the number of threads, so 1 is perfect linear
+       *  scaling and 1/n means n times the threads did no more work.
+       */
+      double scalingEfficiency(const StressResult& baseline,
+			       const StressResult& result);
+
+      /** @brief Returns the number of processors the calling thread may
+       *         run on
+       */
+      size_t availableProcessors();
+
+      /** @brief Write a per-thread report of the result */
+      void printStressResult(std::ostream& out, const StressResult& result);
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,137 @@
+#ifndef __PISTIS__TESTING__STRESSASSERTIONS_HPP__
+#define __PISTIS__TESTING__STRESSASSERTIONS_HPP__
+
+/** @file StressAssertions.hpp
+ *
+ *  Google Test assertions on the results of the stress tests in
+ *  Stress.hpp, e.g.
+ *
+ *  @code
+ *  const auto results = stress::runScaling(operations, { 1, 2, 4, 8 });
+ *  EXPECT_SCALING_EFFICIENCY_AT_LEAST(results, 0.7);
+ *  EXPECT_FAIRNESS_AT_LEAST(results.back(), 0.9);
+ *  @endcode
+ *
+ *  Threads that share a processor cannot run faster than one thread
+ *  alone, so the scaling check skips runs with more threads than the
+ *  process has processors and prints a note instead.
+ */
+#include <pistis/testing/Stress.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+    namespace stress {
+
+      /** @brief Verify that each run scales with at least the given
+       *         efficiency relative to the first run.
+       *
+       *  See scalingEfficiency().  Runs with more threads than
+       *  availableProcessors() are not checked.
+       */
+      inline ::testing::AssertionResult checkScalingEfficiency(
+	  const std::vector<StressResult>& results, double minEfficiency
+      ) {
+	if (results.empty()) {
+	  return ::testing::AssertionFailure() << "No results to check";
+	}
+
+	const size_t processors = availableProcessors();
+	const StressResult& baseline = results.front();
+	bool failed = false;
+	std::ostringstream details;
+
+	for (const auto& r : results) {
+	  const double efficiency = scalingEfficiency(baseline, r);
+	  details << " [" << r.threads.size() << " threads] "
+		  << r.throughput() << " ops/sec, efficiency " << efficiency;
+	  if (r.threads.size() > processors) {
+	    std::cout << "[   NOTE   ] " << r.threads.size()
+		      << " threads exceed the " << processors
+		      << " available processors; scaling not checked"
+		      << std::endl;
+	  } else if (efficiency < minEfficiency) {
+	    failed = true;
+	  }
+	}
+
+	if (!failed) {
+	  return ::testing::AssertionSuccess();
+	}
+	return ::testing::AssertionFailure()
+	    << "Scaling efficiency fell below " << minEfficiency << ":"
+	    << details.str();
+      }
+
+      /** @brief Verify the threads shared the work with at least the
+       *         given fairness.  See StressResult::fairness().
+       */
+      inline ::testing::AssertionResult checkFairness(
+	  const StressResult& result, double minFairness
+      ) {
+	const double fairness = result.fairness();
+	if (fairness >= minFairness) {
+	  return ::testing::AssertionSuccess();
+	}
+
+	::testing::AssertionResult failure = ::testing::AssertionFailure();
+	failure << "Fairness " << fairness << " is below " << minFairness
+		<< ".  Operations per second by thread:";
+	for (size_t i = 0; i < result.threads.size(); ++i) {
+	  failure << " [" << i << "] " << result.threads[i].throughput();
+	}
+	return failure;
+      }
+
+      /** @brief Print the result and record its aggregate throughput
+       *         and fairness as properties of the current test
+       */
+      inline void reportStressResult(const std::string& name,
+				     const StressResult& result) {
+	if (::testing::UnitTest::GetInstance()->current_test_info()) {
+	  const std::string prefix =
+	      name + "." + std::to_string(result.threads.size()) + "threads";
+	  ::testing::Test::RecordProperty(prefix + ".opsPerSecond",
+					  std::to_string(result.throughput()));
+	  ::testing::Test::RecordProperty(prefix + ".fairness",
+					  std::to_string(result.fairness()));
+	}
+	std::cout << name << " (" << result.threads.size() << " threads):"
+		  << std::endl;
+	printStressResult(std::cout, result);
+      }
+
+    }
+  }
+}
+
+/** @brief Expect every run in results to scale with at least the given
+ *         efficiency relative to the first
+ */
+#define EXPECT_SCALING_EFFICIENCY_AT_LEAST(results, minEfficiency)	\
+  EXPECT_TRUE(::pistis::testing::stress::checkScalingEfficiency(	\
+      (results), (minEfficiency)))
+
+/** @brief Assert every run in results scales with at least the given
+ *         efficiency relative to the first
+ */
+#define ASSERT_SCALING_EFFICIENCY_AT_LEAST(results, minEfficiency)	\
+  ASSERT_TRUE(::pistis::testing::stress::checkScalingEfficiency(	\
+      (results), (minEfficiency)))
+
+/** @brief Expect the result's fairness to be at least minFairness */
+#define EXPECT_FAIRNESS_AT_LEAST(result, minFairness)			\
+  EXPECT_TRUE(::pistis::testing::stress::checkFairness(			\
+      (result), (minFairness)))
+
+/** @brief Assert the result's fairness is at least minFairness */
+#define ASSERT_FAIRNESS_AT_LEAST(result, minFairness)			\
+  ASSERT_TRUE(::pistis::testing::stress::checkFairness(			\
+      (result), (minFairness)))
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef __PISTIS__TESTING__TESTSCRATCH_HPP__
+#define __PISTIS__TESTING__TESTSCRATCH_HPP__
+
+/** @file TestScratch.hpp
+ *
+ *  Scratch directories private to each Google Test test.
+ *
+ *  getTestScratchDir() returns a directory that belongs to the
+ *  running test and process:
+ *
+ *  @code
+ *  ${ROOT}/${PID}/${TEST_SUITE}.${TEST_NAME}
+ *  @endcode
+ *
+ *  where ROOT is getScratchDir(), or getTmpfsScratchDir() for
+ *  ScratchStorage::TMPFS.  Tests running in parallel, whether in
+ *  different shards of the same executable or in different
+ *  executables sharing PISTIS_FILESYSTEM_TEST_SCRATCH_DIR, never see
+ *  each other's files.
+ *
+ *  The directory is created on first use, and it is removed with
+ *  removeTree() when the test ends.  The process's directory is
+ *  removed when the test program ends.  Set
+ *  PISTIS_FILESYSTEM_TEST_KEEP_SCRATCH to anything other than "" or
+ *  "0" to keep them for debugging.  Set
+ *  PISTIS_FILESYSTEM_TEST_SCRATCH_ON_TMPFS the same way to put every
+ *  test's directory on tmpfs.
+ */
+#include <pistis/testing/Resources.hpp>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Where to put a test's scratch directory */
+    enum class ScratchStorage {
+      /** @brief Under getScratchDir() */
+      DISK,
+
+      /** @brief Under getTmpfsScratchDir().  Faster for I/O-heavy
+       *         tests, but uses memory.
+       */
+      TMPFS
+    };
+
+    namespace scratch_detail {
+      inline bool isEnabled(const char* name) {
+	const char* value = getenv(name);
+	return value && *value && strcmp(value, "0");
+      }
+
+      // Directories of the current test and process, for cleanup
+      struct ScratchState {
+	std::mutex mutex;
+	std::vector<std::string> testDirs;
+	std::vector<std::string> processDirs;
+	bool listenerInstalled;
+
+	ScratchState(): listenerInstalled(false) { }
+      };
+
+      inline ScratchState& scratchState() {
+	static ScratchState* state = new ScratchState();
+	return *state;
+      }
+
+      inline std::string processScratchDir(ScratchStorage storage) {
+	const bool tmpfs =
+	    (storage == ScratchStorage::TMPFS) ||
+	    isEnabled("PISTIS_FILESYSTEM_TEST_SCRATCH_ON_TMPFS");
+	return (tmpfs ? getTmpfsScratchDir() : getScratchDir()) + "/" +
+	       std::to_string(::getpid());
+      }
+
+      inline std::string currentTestDirName(
+	  const ::testing::TestInfo* info
+      ) {
+	std::string name =
+	    info ? std::string(info->test_suite_name()) + "." + info->name()
+		 : std::string("_no_test");
+
+	// Parameterized tests have '/' in their names
+	for (char& c : name) {
+	  if (c == '/') {
+	    c = '_';
+	  }
+	}
+	return name;
+      }
+
+      inline void removeAll(std::vector<std::string>& dirs) {
+	if (!isEnabled("PISTIS_FILESYSTEM_TEST_KEEP_SCRATCH")) {
+	  for (const std::string& dir : dirs) {
+	    removeTree(dir);
+	  }
+	}
+	dirs.clear();
+      }
+
+      class ScratchCleaner : public ::testing::EmptyTestEventListener {
+      public:
+	virtual void OnTestEnd(const ::testing::TestInfo&) override {
+	  ScratchState& state = scratchState();
+	  std::lock_guard<std::mutex> lock(state.mutex);
+	  removeAll(state.testDirs);
+	}
+
+	virtual void OnTestProgramEnd(const ::testing::UnitTest&) override {
+	  ScratchState& state = scratchState();
+	  std::lock_guard<std::mutex> lock(state.mutex);
+	  removeAll(state.testDirs);
+	  removeAll(state.processDirs);
+	}
+      };
+    }
+
+    /** @brief Returns the current test's scratch directory, creating it
+     *         if necessary.
+     *
+     *  Outside of a test, returns a directory shared by all code that
+     *  runs outside of tests, which is removed when the test program
+     *  ends.
+     *
+     *  @param storage  Where to put the directory
+     *  @returns        Full path to the directory, or an empty string
+     *                  if it could not be created
+     */
+    inline std::string getTestScratchDir(
+	ScratchStorage storage = ScratchStorage::DISK
+    ) {
+      using namespace scratch_detail;
+      ScratchState& state = scratchState();
+      const ::testing::TestInfo* info =
+	  ::testing::UnitTest::GetInstance()->current_test_info();
+      const std::string processDir = processScratchDir(storage);
+      const std::string dir = processDir + "/" + currentTestDirName(info);
+      std::lock_guard<std::mutex> lock(state.mutex);
+
+      // Outside of a test, e.g. in SetUpTestSuite(), the directory
+      // lasts until the program ends rather than until the next test
+      // does
+      std::vector<std::string>& dirs =
+	  info ? state.testDirs : state.processDirs;
+
+      if (!state.listenerInstalled) {
+	::testing::UnitTest::GetInstance()->listeners().Append(
+	    new ScratchCleaner()
+	);
+	state.listenerInstalled = true;
+      }
+
+      if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+	if (!makeDirectories(dir)) {
+	  return std::string();
+	}
+	dirs.push_back(dir);
+	if (std::find(state.processDirs.begin(), state.processDirs.end(),
+		      processDir) == state.processDirs.end()) {
+	  state.processDirs.push_back(processDir);
+	}
+      }
+      return dir;
+    }
+
+    /** @brief Expands the given filename to a full path inside the
+     *         current test's scratch directory.
+     *
+     *  Absolute paths are returned as-is.  Returns an empty string if
+     *  the scratch directory could not be created.
+     */
+    inline std::string getTestScratchFile(
+	const std::string& filename,
+	ScratchStorage storage = ScratchStorage::DISK
+    ) {
+      if (!filename.empty() && (filename[0] == '/')) {
+	return filename;
+      }
+
+      const std::string dir = getTestScratchDir(storage);
+      if (dir.empty() || filename.empty()) {
+	return dir;
+      }
+      return dir + "/" + filename;
+    }
+
+  }
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef __PISTIS__TESTING__TIMING_HPP__
+#define __PISTIS__TESTING__TIMING_HPP__
+
+/** @file Timing.hpp
+ *
+ *  Primitives for timing short sections of code
+ */
+#include <stdint.h>
+#include <time.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Current value of the monotonic clock, in nanoseconds */
+    inline uint64_t monotonicNanoseconds() {
+      struct timespec t;
+      ::clock_gettime(CLOCK_MONOTONIC, &t);
+      return uint64_t(t.tv_sec) * 1000000000ULL + uint64_t(t.tv_nsec);
+    }
+
+    /** @brief Prevent the compiler from optimizing away the computation
+     *         of a value.
+     *
+     *  The compiler must assume the value is read, so it has to
+     *  compute it, and that all memory may have been read or written,
+     *  so it cannot move loads and stores across the call.
+     */
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+      asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /** @brief Prevent the compiler from moving loads and stores across
+     *         the call
+     */
+    inline void clobberMemory() {
+      asm volatile("" : : : "memory");
+    }
+
+  }
+}
+#endif
@@ -0,0 +1,77 @@
+#include "Tracked.hpp"
+
+using namespace pistis::testing;
+
+namespace {
+  static void writeCount(std::ostream& out, uint64_t n, const char* what,
+			 bool& first) {
+    if (!first) {
+      out << ", ";
+    }
+    out << n << " " << what << ((n == 1) ? "" : "s");
+    first = false;
+  }
+}
+
+TrackedCounts TrackedCounts::difference(const TrackedCounts& start,
+					const TrackedCounts& end) {
+  TrackedCounts counts;
+  counts.constructions = end.constructions - start.constructions;
+  counts.copyConstructions = end.copyConstructions - start.copyConstructions;
+  counts.moveConstructions = end.moveConstructions - start.moveConstructions;
+  counts.copyAssignments = end.copyAssignments - start.copyAssignments;
+  counts.moveAssignments = end.moveAssignments - start.moveAssignments;
+  counts.destructions = end.destructions - start.destructions;
+  return counts;
+}
+
+TrackedLedger::TrackedLedger():
+    constructions_(0), copyConstructions_(0), moveConstructions_(0),
+    copyAssignments_(0), moveAssignments_(0), destructions_(0) {
+}
+
+TrackedCounts TrackedLedger::counts() const {
+  TrackedCounts counts;
+  counts.constructions = constructions_.load(std::memory_order_relaxed);
+  counts.copyConstructions =
+      copyConstructions_.load(std::memory_order_relaxed);
+  counts.moveConstructions =
+      moveConstructions_.load(std::memory_order_relaxed);
+  counts.copyAssignments = copyAssignments_.load(std::memory_order_relaxed);
+  counts.moveAssignments = moveAssignments_.load(std::memory_order_relaxed);
+  counts.destructions = destructions_.load(std::memory_order_relaxed);
+  return counts;
+}
+
+void TrackedLedger::reset() {
+  constructions_.store(0, std::memory_order_relaxed);
+  copyConstructions_.store(0, std::memory_order_relaxed);
+  moveConstructions_.store(0, std::memory_order_relaxed);
+  copyAssignments_.store(0, std::memory_order_relaxed);
+  moveAssignments_.store(0, std::memory_order_relaxed);
+  destructions_.store(0, std::memory_order_relaxed);
+}
+
+const std::shared_ptr<TrackedLedger>& TrackedLedger::global() {
+  static const std::shared_ptr<TrackedLedger> ledger =
+      std::make_shared<TrackedLedger>();
+  return ledger;
+}
+
+namespace pistis {
+  namespace testing {
+
+    std::ostream& operator<<(std::ostream& out,
+			     const TrackedCounts& counts) {
+      bool first = true;
+      writeCount(out, counts.constructions, "construction", first);
+      writeCount(out, counts.copyConstructions, "copy construction", first);
+      writeCount(out, counts.moveConstructions, "move construction", first);
+      writeCount(out, counts.copyAssignments, "copy assignment", first);
+      writeCount(out, counts.moveAssignments, "move assignment", first);
+      writeCount(out, counts.destructions, "destruction", first);
+      return out;
+    }
+
+  }
+}
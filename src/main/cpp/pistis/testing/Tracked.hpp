@@ -0,0 +1,271 @@
+#ifndef __PISTIS__TESTING__TRACKED_HPP__
+#define __PISTIS__TESTING__TRACKED_HPP__
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+/** @file Tracked.hpp
+ *
+ *  Element type that counts its own constructions, copies, moves,
+ *  assignments and destructions, so tests can detect hidden copies in
+ *  containers, algorithms and iterators.
+ *
+ *  See TrackedAssertions.hpp for Google Test macros built on Tracked.
+ */
+namespace pistis {
+  namespace testing {
+
+    /** @brief Numbers of calls to the special member functions of
+     *         Tracked objects, or the difference between two such
+     *         snapshots
+     */
+    struct TrackedCounts {
+      /** @brief Objects constructed from a value or by default */
+      uint64_t constructions;
+
+      /** @brief Objects constructed by copying another */
+      uint64_t copyConstructions;
+
+      /** @brief Objects constructed by moving from another */
+      uint64_t moveConstructions;
+
+      /** @brief Copy assignments */
+      uint64_t copyAssignments;
+
+      /** @brief Move assignments */
+      uint64_t moveAssignments;
+
+      /** @brief Objects destroyed */
+      uint64_t destructions;
+
+      /** @brief Copy constructions and copy assignments */
+      uint64_t copies() const { return copyConstructions + copyAssignments; }
+
+      /** @brief Move constructions and move assignments */
+      uint64_t moves() const { return moveConstructions + moveAssignments; }
+
+      /** @brief Objects constructed, in any way, less objects
+       *         destroyed
+       */
+      int64_t live() const {
+	return int64_t(constructions + copyConstructions + moveConstructions) -
+	       int64_t(destructions);
+      }
+
+      /** @brief Calls made between two snapshots */
+      static TrackedCounts difference(const TrackedCounts& start,
+				      const TrackedCounts& end);
+    };
+
+    /** @brief Write the counts as "2 constructions, 1 copy
+     *         construction, ..."
+     */
+    std::ostream& operator<<(std::ostream& out, const TrackedCounts& counts);
+
+    /** @brief Counts calls to the special member functions of the
+     *         Tracked objects that share it.
+     *
+     *  TrackedLedger is thread-safe.  Tracked objects hold a reference
+     *  to their ledger, so it lives as long as they do.
+     */
+    class TrackedLedger {
+    public:
+      TrackedLedger();
+      TrackedLedger(const TrackedLedger&) = delete;
+
+      /** @brief Calls recorded since the ledger was created or last
+       *         reset
+       */
+      TrackedCounts counts() const;
+
+      /** @brief Restart counting from zero */
+      void reset();
+
+      void recordConstruction() { add(constructions_); }
+      void recordCopyConstruction() { add(copyConstructions_); }
+      void recordMoveConstruction() { add(moveConstructions_); }
+      void recordCopyAssignment() { add(copyAssignments_); }
+      void recordMoveAssignment() { add(moveAssignments_); }
+      void recordDestruction() { add(destructions_); }
+
+      /** @brief The ledger Tracked objects use unless given another */
+      static const std::shared_ptr<TrackedLedger>& global();
+
+      TrackedLedger& operator=(const TrackedLedger&) = delete;
+
+    private:
+      std::atomic<uint64_t> constructions_;
+      std::atomic<uint64_t> copyConstructions_;
+      std::atomic<uint64_t> moveConstructions_;
+      std::atomic<uint64_t> copyAssignments_;
+      std::atomic<uint64_t> moveAssignments_;
+      std::atomic<uint64_t> destructions_;
+
+      static void add(std::atomic<uint64_t>& counter) {
+	counter.fetch_add(1, std::memory_order_relaxed);
+      }
+    };
+
+    /** @brief Value wrapper that records its constructions, copies,
+     *         moves, assignments and destructions in a TrackedLedger.
+     *
+     *  Use Tracked<T> as the element type of a container or the value
+     *  type of an iterator under test to catch code that copies
+     *  elements it should move or refer to, e.g.
+     *
+     *  @code
+     *  std::vector<Tracked<std::string>> v(names.begin(), names.end());
+     *  EXPECT_NO_COPIES(std::sort(v.begin(), v.end()));
+     *  EXPECT_NO_COPIES(v.reserve(2 * v.size()));
+     *  @endcode
+     *
+     *  Copies and moves of a Tracked object record the call in the
+     *  source's ledger and share it.  Assignments record the call in,
+     *  and keep, the target's ledger.  Moves and move assignments are
+     *  noexcept exactly when T's are, so containers choose between
+     *  copying and moving Tracked<T> as they would for T.  Tracked
+     *  objects compare like their values.
+     */
+    template <typename T>
+    class Tracked {
+    public:
+      typedef T value_type;
+
+    public:
+      Tracked():
+	  value_(), ledger_(TrackedLedger::global()), movedFrom_(false) {
+	ledger_->recordConstruction();
+      }
+
+      Tracked(const T& value,
+	      const std::shared_ptr<TrackedLedger>& ledger =
+		  TrackedLedger::global()):
+	  value_(value), ledger_(ledger), movedFrom_(false) {
+	ledger_->recordConstruction();
+      }
+
+      Tracked(T&& value,
+	      const std::shared_ptr<TrackedLedger>& ledger =
+		  TrackedLedger::global()):
+	  value_(std::move(value)), ledger_(ledger), movedFrom_(false) {
+	ledger_->recordConstruction();
+      }
+
+      Tracked(const Tracked& other):
+	  value_(other.value_), ledger_(other.ledger_), movedFrom_(false) {
+	ledger_->recordCopyConstruction();
+      }
+
+      Tracked(Tracked&& other)
+	  noexcept(std::is_nothrow_move_constructible<T>::value):
+	  value_(std::move(other.value_)), ledger_(other.ledger_),
+	  movedFrom_(false) {
+	// other.ledger_ is copied rather than moved so that the
+	// moved-from object's destruction is still recorded
+	other.movedFrom_ = true;
+	ledger_->recordMoveConstruction();
+      }
+
+      ~Tracked() {
+	ledger_->recordDestruction();
+      }
+
+      /** @brief The wrapped value */
+      const T& value() const { return value_; }
+
+      /** @brief The wrapped value */
+      T& value() { return value_; }
+
+      const T& operator*() const { return value_; }
+      T& operator*() { return value_; }
+      const T* operator->() const { return &value_; }
+      T* operator->() { return &value_; }
+
+      /** @brief The ledger this object records its calls in */
+      const std::shared_ptr<TrackedLedger>& ledger() const {
+	return ledger_;
+      }
+
+      /** @brief True if this object was moved from and has not been
+       *         assigned since
+       */
+      bool movedFrom() const { return movedFrom_; }
+
+      Tracked& operator=(const Tracked& other) {
+	value_ = other.value_;
+	movedFrom_ = false;
+	ledger_->recordCopyAssignment();
+	return *this;
+      }
+
+      Tracked& operator=(Tracked&& other)
+	  noexcept(std::is_nothrow_move_assignable<T>::value) {
+	value_ = std::move(other.value_);
+	movedFrom_ = false;
+	other.movedFrom_ = (&other != this);
+	ledger_->recordMoveAssignment();
+	return *this;
+      }
+
+    private:
+      T value_;
+      std::shared_ptr<TrackedLedger> ledger_;
+      bool movedFrom_;
+    };
+
+    /** @brief Construct a Tracked<T> from a value */
+    template <typename T>
+    inline Tracked<typename std::decay<T>::type> track(T&& value) {
+      return Tracked<typename std::decay<T>::type>(std::forward<T>(value));
+    }
+
+    template <typename T>
+    inline bool operator==(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() == right.value();
+    }
+
+    template <typename T>
+    inline bool operator!=(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() != right.value();
+    }
+
+    template <typename T>
+    inline bool operator<(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() < right.value();
+    }
+
+    template <typename T>
+    inline bool operator<=(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() <= right.value();
+    }
+
+    template <typename T>
+    inline bool operator>(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() > right.value();
+    }
+
+    template <typename T>
+    inline bool operator>=(const Tracked<T>& left, const Tracked<T>& right) {
+      return left.value() >= right.value();
+    }
+
+    template <typename T>
+    inline std::ostream& operator<<(std::ostream& out,
+				    const Tracked<T>& tracked) {
+      return out << tracked.value();
+    }
+
+    /** @brief Whether a type is a specialization of Tracked */
+    template <typename T>
+    struct IsTracked : std::false_type { };
+
+    template <typename T>
+    struct IsTracked< Tracked<T> > : std::true_type { };
+
+  }
+}
+#endif
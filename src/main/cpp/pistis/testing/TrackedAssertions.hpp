@@ -0,0 +1,108 @@
+#ifndef __PISTIS__TESTING__TRACKEDASSERTIONS_HPP__
+#define __PISTIS__TESTING__TRACKEDASSERTIONS_HPP__
+
+/** @file TrackedAssertions.hpp
+ *
+ *  Google Test assertions that limit the copies and moves of Tracked
+ *  objects a block of code may perform.
+ *
+ *  The statement may be a braced block.  The macros count the calls
+ *  recorded in the global TrackedLedger while the statement runs,
+ *  including those made by other threads, e.g.
+ *
+ *  @code
+ *  std::vector<Tracked<std::string>> v = makeNames();
+ *  EXPECT_NO_COPIES(std::sort(v.begin(), v.end()));
+ *  EXPECT_MOVES_AT_MOST(v.size(), v.reserve(2 * v.size()));
+ *  EXPECT_NO_COPIES(for (const auto& name : v) { lookup(name); });
+ *  @endcode
+ */
+#include <pistis/testing/Tracked.hpp>
+#include <gtest/gtest.h>
+
+namespace pistis {
+  namespace testing {
+
+    /** @brief Verify the counts include at most maxCopies copy
+     *         constructions and copy assignments
+     */
+    inline ::testing::AssertionResult checkCopiesAtMost(
+	const TrackedCounts& counts, uint64_t maxCopies
+    ) {
+      if (counts.copies() <= maxCopies) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << counts.copies() << " copies exceeds the budget of " << maxCopies
+	  << " copies (" << counts << ")";
+    }
+
+    /** @brief Verify the counts include at most maxMoves move
+     *         constructions and move assignments
+     */
+    inline ::testing::AssertionResult checkMovesAtMost(
+	const TrackedCounts& counts, uint64_t maxMoves
+    ) {
+      if (counts.moves() <= maxMoves) {
+	return ::testing::AssertionSuccess();
+      }
+      return ::testing::AssertionFailure()
+	  << counts.moves() << " moves exceeds the budget of " << maxMoves
+	  << " moves (" << counts << ")";
+    }
+
+  }
+}
+
+#define PISTIS_TESTING_TRACKED_BUDGET_(check, limit, fail, ...)		\
+  do {									\
+    const ::pistis::testing::TrackedCounts pistisTrackedStart_ =	\
+	::pistis::testing::TrackedLedger::global()->counts();		\
+    __VA_ARGS__;							\
+    const ::testing::AssertionResult pistisTrackedResult_ = check(	\
+	::pistis::testing::TrackedCounts::difference(			\
+	    pistisTrackedStart_,					\
+	    ::pistis::testing::TrackedLedger::global()->counts()),	\
+	(limit));							\
+    if (!pistisTrackedResult_) {					\
+      fail(pistisTrackedResult_.message());				\
+    }									\
+  } while (false)
+
+#define PISTIS_TESTING_TRACKED_EXPECT_FAILURE_(message)			\
+  ADD_FAILURE() << message
+#define PISTIS_TESTING_TRACKED_ASSERT_FAILURE_(message) FAIL() << message
+
+/** @brief Expect statement to copy Tracked objects at most n times */
+#define EXPECT_COPIES_AT_MOST(n, ...)					\
+  PISTIS_TESTING_TRACKED_BUDGET_(					\
+      ::pistis::testing::checkCopiesAtMost, n,				\
+      PISTIS_TESTING_TRACKED_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement copies Tracked objects at most n times */
+#define ASSERT_COPIES_AT_MOST(n, ...)					\
+  PISTIS_TESTING_TRACKED_BUDGET_(					\
+      ::pistis::testing::checkCopiesAtMost, n,				\
+      PISTIS_TESTING_TRACKED_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Expect statement to move Tracked objects at most n times */
+#define EXPECT_MOVES_AT_MOST(n, ...)					\
+  PISTIS_TESTING_TRACKED_BUDGET_(					\
+      ::pistis::testing::checkMovesAtMost, n,				\
+      PISTIS_TESTING_TRACKED_EXPECT_FAILURE_, __VA_ARGS__)
+
+/** @brief Assert statement moves Tracked objects at most n times */
+#define ASSERT_MOVES_AT_MOST(n, ...)					\
+  PISTIS_TESTING_TRACKED_BUDGET_(					\
+      ::pistis::testing::checkMovesAtMost, n,				\
+      PISTIS_TESTING_TRACKED_ASSERT_FAILURE_, __VA_ARGS__)
+
+/** @brief Expect statement not to copy Tracked objects */
+#define EXPECT_NO_COPIES(...)						\
+  EXPECT_COPIES_AT_MOST(0, __VA_ARGS__)
+
+/** @brief Assert statement does not copy Tracked objects */
+#define ASSERT_NO_COPIES(...)						\
+  ASSERT_COPIES_AT_MOST(0, __VA_ARGS__)
+
+#endif
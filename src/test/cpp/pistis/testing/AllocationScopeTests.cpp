@@ -0,0 +1,219 @@
+/** @file AllocationScopeTests.cpp
+ *
+ *  Unit tests for pistis::testing::AllocationScope and the assertions
+ *  in AllocationAssertions.hpp
+ */
+#include <pistis/testing/AllocationAssertions.hpp>
+#include <pistis/testing/AllocationHooks.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace pistis::testing;
+
+TEST(AllocationScope, HooksInstalled) {
+  EXPECT_TRUE(AllocationScope::hooksInstalled());
+}
+
+TEST(AllocationScope, CountOperatorNew) {
+  AllocationScope scope;
+  std::unique_ptr<std::vector<int>> v(new std::vector<int>(100));
+
+  EXPECT_EQ(2, scope.allocations());
+  EXPECT_EQ(sizeof(std::vector<int>) + 100 * sizeof(int),
+	    scope.bytesAllocated());
+  EXPECT_EQ(0, scope.deallocations());
+
+  v.reset();
+  EXPECT_EQ(2, scope.deallocations());
+}
+
+TEST(AllocationScope, CountMalloc) {
+  void* (* volatile allocate)(size_t) = &::malloc;
+  AllocationScope scope;
+  void* p = allocate(100);
+
+  EXPECT_EQ(1, scope.allocations());
+  EXPECT_EQ(100, scope.bytesAllocated());
+
+  p = ::realloc(p, 200);
+  EXPECT_EQ(2, scope.allocations());
+  EXPECT_EQ(300, scope.bytesAllocated());
+  EXPECT_EQ(1, scope.deallocations());
+
+  ::free(p);
+  EXPECT_EQ(2, scope.deallocations());
+}
+
+TEST(AllocationScope, CountLibraryAllocations) {
+  AllocationScope scope;
+  std::string s(100, 'x');
+  std::function<size_t ()> f = [s]() { return s.size(); };
+  std::shared_ptr<std::string> p = std::make_shared<std::string>(s);
+
+  EXPECT_LE(4, scope.allocations());
+}
+
+TEST(AllocationScope, Reset) {
+  AllocationScope scope;
+  std::unique_ptr<int> p(new int(1));
+
+  EXPECT_EQ(1, scope.allocations());
+  scope.reset();
+  EXPECT_EQ(0, scope.allocations());
+  EXPECT_EQ(0, scope.bytesAllocated());
+}
+
+TEST(AllocationScope, NestedScopes) {
+  AllocationScope outer;
+  std::unique_ptr<int> p(new int(1));
+  {
+    AllocationScope inner;
+    std::unique_ptr<int> q(new int(2));
+    EXPECT_EQ(1, inner.allocations());
+  }
+  EXPECT_EQ(2, outer.allocations());
+}
+
+TEST(AllocationScope, CountAllThreads) {
+  const int NUM_THREADS = 8;
+  std::vector<std::thread> threads;
+  threads.reserve(NUM_THREADS);
+
+  AllocationScope scope;
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    threads.emplace_back([]() {
+      // Keep the pointers so the compiler cannot elide the allocations
+      std::vector< std::unique_ptr<int> > values;
+      values.reserve(100);
+      for (int j = 0; j < 100; ++j) {
+	values.emplace_back(new int(j));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_LE(NUM_THREADS * 100, scope.allocations());
+  EXPECT_LE(NUM_THREADS * 100, scope.deallocations());
+}
+
+TEST(AllocationScope, BudgetAssertions) {
+  std::vector<int> v;
+  int total = 0;
+
+  EXPECT_NO_ALLOCATIONS(for (int i = 0; i < 100; ++i) total += i);
+  EXPECT_EQ(4950, total);
+  EXPECT_ALLOCATIONS_AT_MOST(1, {
+    v.reserve(100);
+    for (int i = 0; i < 100; ++i) v.push_back(i);
+  });
+  ASSERT_ALLOCATED_BYTES_AT_MOST(
+      200 * sizeof(int), std::vector<int> w(v.begin(), v.end())
+  );
+}
+
+TEST(AllocationScope, BudgetExceeded) {
+  EXPECT_NONFATAL_FAILURE(EXPECT_NO_ALLOCATIONS(std::make_shared<int>(1)),
+			  "exceeds the budget of 0 allocations");
+  EXPECT_FATAL_FAILURE(
+      ASSERT_ALLOCATED_BYTES_AT_MOST(10, std::string(100, 'x')),
+      "exceeds the budget of 10 bytes"
+  );
+}
+
+TEST(AllocationScope, LayoutRandomization) {
+  void* (* volatile allocate)(size_t) = &::malloc;
+  std::vector<void*> blocks;
+  std::set<intptr_t> strides;
+
+  blocks.reserve(100);
+  hooks::enableLayoutRandomization(42);
+  EXPECT_TRUE(hooks::layoutRandomizationEnabled());
+  {
+    // Randomization does not change what is counted
+    AllocationScope scope;
+    for (int i = 0; i < 100; ++i) {
+      blocks.push_back(allocate(32));
+    }
+    EXPECT_EQ(100, scope.allocations());
+    EXPECT_EQ(3200, scope.bytesAllocated());
+  }
+  hooks::disableLayoutRandomization();
+  EXPECT_FALSE(hooks::layoutRandomizationEnabled());
+
+  for (size_t i = 1; i < blocks.size(); ++i) {
+    strides.insert(reinterpret_cast<intptr_t>(blocks[i]) -
+		   reinterpret_cast<intptr_t>(blocks[i - 1]));
+  }
+  EXPECT_LT(10u, strides.size());
+
+  for (void* p : blocks) {
+    ::free(p);
+  }
+  hooks::releaseLayoutSpacers();
+}
+
+namespace {
+  // Blocks allocations by one thread inside the callback until released
+  class BlockingObserver : public hooks::AllocationObserver {
+  public:
+    std::thread::id blockedThread;
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> released{false};
+
+    virtual void allocated(void*, size_t, size_t, void*) override {
+      if (std::this_thread::get_id() == blockedThread) {
+	blocked = true;
+	while (!released) {
+	  std::this_thread::yield();
+	}
+      }
+    }
+
+    virtual void deallocating(void*, void*) override { }
+    virtual void reallocationFailed(void*, void*) override { }
+  };
+}
+
+TEST(AllocationScope, RemovingObserverWaitsForCallbacks) {
+  void* (* volatile allocate)(size_t) = &::malloc;
+  BlockingObserver observer;
+  std::atomic<bool> start(false);
+  std::thread allocating([&]() {
+    while (!start) {
+      std::this_thread::yield();
+    }
+    ::free(allocate(100));
+  });
+
+  observer.blockedThread = allocating.get_id();
+  ASSERT_EQ(nullptr, hooks::setAllocationObserver(&observer));
+  start = true;
+  while (!observer.blocked) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<bool> removed(false);
+  std::thread removing([&]() {
+    hooks::setAllocationObserver(nullptr);
+    removed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(removed);
+
+  observer.released = true;
+  removing.join();
+  allocating.join();
+  EXPECT_TRUE(removed);
+}
@@ -0,0 +1,267 @@
+/** @file AllocationStrategyTests.cpp
+ *
+ *  Unit tests for the allocation strategies in AllocationStrategy.hpp
+ */
+#include <pistis/testing/AllocationStrategy.hpp>
+#include <pistis/testing/Allocator.hpp>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+using namespace pistis::testing;
+
+namespace {
+  template <typename T>
+  using StrategyAllocator = Allocator<T, StrategyPropagation>;
+
+  uintptr_t address(const void* p) {
+    return reinterpret_cast<uintptr_t>(p);
+  }
+}
+
+TEST(AllocationStrategy, AlignedAllocation) {
+  for (size_t boundary : { size_t(64), size_t(4096) }) {
+    auto strategy = std::make_shared<AlignedAllocation>(boundary);
+    std::vector<uint8_t, StrategyAllocator<uint8_t>> v(
+	StrategyAllocator<uint8_t>("v", strategy)
+    );
+
+    EXPECT_EQ(boundary, strategy->boundary());
+    for (size_t n = 1; n < 1000; n = n * 2 + 1) {
+      v.resize(n, 0);
+      v.shrink_to_fit();
+      EXPECT_EQ(0, address(v.data()) % boundary);
+    }
+  }
+}
+
+TEST(AllocationStrategy, AlignedAllocationRespectsTypeAlignment) {
+  struct alignas(128) Wide { char c; };
+  AlignedAllocation strategy(16);
+  void* p = strategy.allocate(sizeof(Wide), alignof(Wide));
+
+  EXPECT_EQ(0, address(p) % alignof(Wide));
+  strategy.deallocate(p, sizeof(Wide), alignof(Wide));
+}
+
+TEST(AllocationStrategy, MisalignedAllocation) {
+  auto strategy = std::make_shared<MisalignedAllocation>();
+  std::vector<double, StrategyAllocator<double>> v(
+      StrategyAllocator<double>("v", strategy)
+  );
+
+  for (size_t n = 1; n < 1000; n = n * 2 + 1) {
+    v.resize(n, 1.0);
+    v.shrink_to_fit();
+
+    // Aligned to the element type, but to nothing larger
+    EXPECT_EQ(alignof(double), address(v.data()) % (2 * alignof(double)));
+    EXPECT_EQ(alignof(double), address(v.data()) % strategy->boundary());
+    EXPECT_EQ(double(n), std::accumulate(v.begin(), v.end(), 0.0));
+  }
+}
+
+TEST(AllocationStrategy, MisalignedNodes) {
+  auto strategy = std::make_shared<MisalignedAllocation>();
+  std::list<uint64_t, StrategyAllocator<uint64_t>> l(
+      StrategyAllocator<uint64_t>("l", strategy)
+  );
+
+  for (uint64_t i = 0; i < 100; ++i) {
+    l.push_back(i);
+    EXPECT_EQ(i, l.back());
+  }
+  EXPECT_EQ(strategy, l.get_allocator().strategy());
+}
+
+TEST(AllocationStrategy, InvalidBoundary) {
+  EXPECT_THROW(AlignedAllocation(0), std::invalid_argument);
+  EXPECT_THROW(AlignedAllocation(48), std::invalid_argument);
+  EXPECT_THROW(MisalignedAllocation(100), std::invalid_argument);
+}
+
+TEST(AllocationStrategy, HugePageAllocation) {
+  const size_t size = 2 * HugePageAllocation::HUGE_PAGE;
+  auto strategy = std::make_shared<HugePageAllocation>();
+  std::vector<uint8_t, StrategyAllocator<uint8_t>> v(
+      size, 1, StrategyAllocator<uint8_t>("v", strategy)
+  );
+
+  EXPECT_EQ(0, address(v.data()) % HugePageAllocation::HUGE_PAGE);
+  EXPECT_EQ(size, std::accumulate(v.begin(), v.end(), size_t(0)));
+
+  // Whether the kernel actually used huge pages depends on its
+  // configuration and on how fragmented memory is, so only report it
+  if (HugePageAllocation::available()) {
+    std::cout << "NOTE: " << HugePageAllocation::hugePageBytes(v.data())
+	      << " bytes of the vector are backed by huge pages"
+	      << std::endl;
+  }
+  EXPECT_EQ(0, HugePageAllocation::hugePageBytes(nullptr));
+}
+
+TEST(AllocationStrategy, HugePageAllocationOfSmallBlocks) {
+  HugePageAllocation strategy;
+  void* p = strategy.allocate(1, 1);
+  void* q = strategy.allocate(1, 1);
+
+  EXPECT_EQ(0, address(p) % HugePageAllocation::HUGE_PAGE);
+  EXPECT_EQ(0, address(q) % HugePageAllocation::HUGE_PAGE);
+  EXPECT_NE(p, q);
+  memset(p, 0xff, HugePageAllocation::HUGE_PAGE);
+  strategy.deallocate(p, 1, 1);
+  strategy.deallocate(q, 1, 1);
+}
+
+TEST(AllocationStrategy, RandomizedAllocation) {
+  auto strategy = std::make_shared<RandomizedAllocation>(7, 1024);
+  std::vector<std::vector<double, StrategyAllocator<double>>> vectors;
+  std::set<uintptr_t> offsets;
+
+  EXPECT_EQ(7, strategy->seed());
+  EXPECT_EQ(1024, strategy->maxPadding());
+  for (int i = 0; i < 100; ++i) {
+    vectors.emplace_back(10, double(i),
+			 StrategyAllocator<double>("v", strategy));
+    EXPECT_EQ(0, address(vectors.back().data()) % alignof(double));
+    offsets.insert(address(vectors.back().data()) % 4096);
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(10.0 * i, std::accumulate(vectors[i].begin(),
+					vectors[i].end(), 0.0));
+  }
+
+  // Blocks land at many different offsets within a page
+  EXPECT_LT(20u, offsets.size());
+}
+
+TEST(AllocationStrategy, SpliceAcrossStrategies) {
+  typedef std::list<uint64_t, StrategyAllocator<uint64_t>> List;
+  List misaligned(StrategyAllocator<uint64_t>(
+      "misaligned", std::make_shared<MisalignedAllocation>()
+  ));
+  List plain{ 4, 5, 6 };
+
+  misaligned.assign({ 1, 2, 3 });
+
+  // Nodes can only move between lists whose allocators compare equal
+  ASSERT_NE(misaligned.get_allocator(), plain.get_allocator());
+  plain.insert(plain.end(), misaligned.begin(), misaligned.end());
+  misaligned.clear();
+
+  List sameStrategy(misaligned.get_allocator());
+  sameStrategy.assign({ 7, 8 });
+  ASSERT_EQ(misaligned.get_allocator(), sameStrategy.get_allocator());
+  misaligned.splice(misaligned.end(), sameStrategy);
+
+  EXPECT_EQ(std::list<uint64_t>({ 4, 5, 6, 1, 2, 3 }),
+	    std::list<uint64_t>(plain.begin(), plain.end()));
+  EXPECT_EQ(std::list<uint64_t>({ 7, 8 }),
+	    std::list<uint64_t>(misaligned.begin(), misaligned.end()));
+  EXPECT_TRUE(sameStrategy.empty());
+}
+
+TEST(AllocationStrategy, SwapAcrossStrategies) {
+  typedef Allocator<uint64_t, AlwaysPropagate> TestAllocator;
+  typedef std::list<uint64_t, TestAllocator> List;
+  auto misalignedStrategy = std::make_shared<MisalignedAllocation>();
+  auto alignedStrategy = std::make_shared<AlignedAllocation>(4096);
+  List misaligned({ 1, 2, 3 }, TestAllocator("a", misalignedStrategy));
+  List aligned({ 4, 5 }, TestAllocator("a", alignedStrategy));
+
+  ASSERT_NE(misaligned.get_allocator(), aligned.get_allocator());
+  misaligned.swap(aligned);
+  EXPECT_EQ(alignedStrategy, misaligned.get_allocator().strategy());
+  EXPECT_EQ(misalignedStrategy, aligned.get_allocator().strategy());
+  EXPECT_EQ(std::list<uint64_t>({ 4, 5 }),
+	    std::list<uint64_t>(misaligned.begin(), misaligned.end()));
+
+  // Each list frees its nodes through the strategy that allocated them
+  misaligned.clear();
+  aligned.clear();
+}
+
+TEST(AllocationStrategy, SharedByCopiesAndRebinds) {
+  auto strategy = std::make_shared<AlignedAllocation>(4096);
+  auto stats = std::make_shared<AllocationStats>();
+  StrategyAllocator<uint32_t> a("a", stats, strategy);
+  StrategyAllocator<uint32_t> copy(a);
+  StrategyAllocator<uint64_t> rebound(a);
+  StrategyAllocator<uint32_t> assigned;
+
+  assigned = rebound;
+  EXPECT_EQ(strategy, copy.strategy());
+  EXPECT_EQ(strategy, rebound.strategy());
+  EXPECT_EQ(strategy, assigned.strategy());
+  EXPECT_EQ(stats, rebound.stats());
+
+  uint64_t* p = rebound.allocate(3);
+  EXPECT_EQ(0, address(p) % 4096);
+  EXPECT_EQ(1, stats->allocations());
+  rebound.deallocate(p, 3);
+  EXPECT_EQ(1, stats->deallocations());
+}
+
+TEST(AllocationStrategy, AllocationSizeOverflows) {
+  auto stats = std::make_shared<AllocationStats>();
+  StrategyAllocator<uint64_t> allocator("a", stats,
+				std::make_shared<AlignedAllocation>());
+
+  EXPECT_THROW(allocator.allocate(SIZE_MAX / 4), std::bad_array_new_length);
+  EXPECT_EQ(0, stats->allocations());
+}
+
+TEST(AllocationStrategy, HugeRequestsThrow) {
+  const std::vector<std::shared_ptr<AllocationStrategy>> strategies{
+    std::make_shared<MisalignedAllocation>(),
+    std::make_shared<HugePageAllocation>(),
+    std::make_shared<RandomizedAllocation>(1)
+  };
+
+  for (const auto& strategy : strategies) {
+    std::vector<char, StrategyAllocator<char>> v(
+	StrategyAllocator<char>("v", strategy)
+    );
+    EXPECT_THROW(v.reserve(v.max_size()), std::bad_alloc);
+    EXPECT_THROW(strategy->allocate(SIZE_MAX - 8, 8), std::bad_alloc);
+  }
+}
+
+TEST(AllocationStrategy, Equality) {
+  typedef Allocator<uint32_t, NeverPropagate> TestAllocator;
+  auto aligned = std::make_shared<AlignedAllocation>();
+  auto misaligned = std::make_shared<MisalignedAllocation>();
+
+  EXPECT_TRUE(TestAllocator("A", aligned) == TestAllocator("A", aligned));
+  EXPECT_FALSE(TestAllocator("A", aligned) ==
+	       TestAllocator("A", misaligned));
+  EXPECT_FALSE(TestAllocator("A", aligned) == TestAllocator("A"));
+  EXPECT_TRUE(StrategyAllocator<uint32_t>("A", aligned) ==
+	      StrategyAllocator<uint64_t>("A", aligned));
+  EXPECT_FALSE(StrategyAllocator<uint32_t>("A", aligned) ==
+	       StrategyAllocator<uint32_t>("B", aligned));
+  EXPECT_FALSE(StrategyAllocator<uint32_t>("A", aligned) ==
+	       StrategyAllocator<uint32_t>("A"));
+  EXPECT_FALSE(StrategyAllocator<uint32_t>("A", aligned) ==
+	       StrategyAllocator<uint32_t>("A", misaligned));
+}
+
+TEST(AllocationStrategy, AlwaysEqualAllocatorsRejectStrategies) {
+  auto strategy = std::make_shared<AlignedAllocation>();
+  auto stats = std::make_shared<AllocationStats>();
+
+  EXPECT_THROW(Allocator<uint32_t>("A", strategy), std::invalid_argument);
+  EXPECT_THROW(Allocator<uint32_t>("A", stats, strategy),
+	       std::invalid_argument);
+  EXPECT_NO_THROW(Allocator<uint32_t>("A", stats, nullptr));
+  EXPECT_TRUE(Allocator<uint32_t>::is_always_equal::value);
+  EXPECT_FALSE(StrategyAllocator<uint32_t>::is_always_equal::value);
+}
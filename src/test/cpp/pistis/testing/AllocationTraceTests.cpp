@@ -0,0 +1,259 @@
+/** @file AllocationTraceTests.cpp
+ *
+ *  Unit tests for allocation tracing and replay in AllocationTrace.hpp
+ */
+#include <pistis/testing/AllocationTrace.hpp>
+#include <pistis/testing/Allocator.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace pistis::testing;
+
+namespace {
+  AllocationEvent event(AllocationEventType type, uint64_t block,
+			uint64_t size) {
+    AllocationEvent e;
+    e.type = type;
+    e.timestamp = block;
+    e.block = block;
+    e.size = size;
+    e.alignment = 16;
+    e.callSite = 0;
+    e.thread = 0;
+    return e;
+  }
+
+  // Returns the events other than CALL_SITE events
+  std::vector<AllocationEvent> blockEvents(
+      const std::vector<AllocationEvent>& events
+  ) {
+    std::vector<AllocationEvent> result;
+    for (const AllocationEvent& e : events) {
+      if (e.type != AllocationEventType::CALL_SITE) {
+	result.push_back(e);
+      }
+    }
+    return result;
+  }
+}
+
+TEST(AllocationTrace, TraceAllocator) {
+  const std::string path = allocationTracePath("AllocationTrace.Allocator");
+  ASSERT_FALSE(path.empty());
+  {
+    auto writer = std::make_shared<AllocationTraceWriter>(path);
+    auto strategy = std::make_shared<TracingAllocation>(writer);
+    typedef Allocator<uint64_t, StrategyPropagation> TestAllocator;
+    std::vector<uint64_t, TestAllocator> v(TestAllocator("v", strategy));
+
+    v.reserve(10);
+    v.reserve(100);
+    v.clear();
+    v.shrink_to_fit();
+    EXPECT_EQ(path, writer->filename());
+    EXPECT_LT(3, writer->numEvents());
+  }
+
+  std::vector<AllocationEvent> events;
+  ASSERT_TRUE(readAllocationTrace(path, events));
+
+  // Each call site is announced before its first event
+  std::set<uint32_t> callSites;
+  for (const AllocationEvent& e : events) {
+    if (e.type == AllocationEventType::CALL_SITE) {
+      EXPECT_EQ(callSites.size(), e.callSite);
+      EXPECT_NE(0, e.size);
+      callSites.insert(e.callSite);
+    } else {
+      EXPECT_EQ(1, callSites.count(e.callSite));
+    }
+  }
+  EXPECT_LE(1, callSites.size());
+
+  const std::vector<AllocationEvent> blocks = blockEvents(events);
+  ASSERT_EQ(4, blocks.size());
+  EXPECT_EQ(AllocationEventType::ALLOCATE, blocks[0].type);
+  EXPECT_EQ(0, blocks[0].block);
+  EXPECT_EQ(80, blocks[0].size);
+  EXPECT_EQ(alignof(uint64_t), blocks[0].alignment);
+  EXPECT_EQ(AllocationEventType::ALLOCATE, blocks[1].type);
+  EXPECT_EQ(1, blocks[1].block);
+  EXPECT_EQ(800, blocks[1].size);
+  EXPECT_EQ(AllocationEventType::DEALLOCATE, blocks[2].type);
+  EXPECT_EQ(0, blocks[2].block);
+  EXPECT_EQ(80, blocks[2].size);
+  EXPECT_EQ(AllocationEventType::DEALLOCATE, blocks[3].type);
+  EXPECT_EQ(1, blocks[3].block);
+  EXPECT_EQ(800, blocks[3].size);
+  EXPECT_LE(blocks[0].timestamp, blocks[2].timestamp);
+  removeFile(path);
+}
+
+TEST(AllocationTrace, GlobalTrace) {
+  const std::string path = allocationTracePath("AllocationTrace.Global");
+  void* (* volatile allocate)(size_t) = &::malloc;
+  ASSERT_FALSE(path.empty());
+  {
+    GlobalAllocationTrace trace(path);
+    void* p = allocate(12345);
+    std::unique_ptr<std::vector<int>> v(new std::vector<int>(1000));
+    ::free(p);
+    v.reset();
+    EXPECT_THROW(GlobalAllocationTrace(path + ".2"), std::runtime_error);
+    EXPECT_TRUE(trace.stop());
+
+    // Not traced
+    ::free(allocate(54321));
+  }
+
+  std::vector<AllocationEvent> events;
+  ASSERT_TRUE(readAllocationTrace(path, events));
+
+  // Find the malloc() call and check that free() released the same
+  // block.  The trace may contain other allocations, e.g. by gtest.
+  uint64_t block = UINT64_MAX;
+  std::set<uint64_t> released;
+  for (const AllocationEvent& e : blockEvents(events)) {
+    EXPECT_NE(54321, e.size);
+    if ((e.type == AllocationEventType::ALLOCATE) && (e.size == 12345)) {
+      block = e.block;
+    } else if (e.type == AllocationEventType::DEALLOCATE) {
+      released.insert(e.block);
+    }
+  }
+  ASSERT_NE(UINT64_MAX, block);
+  EXPECT_EQ(1, released.count(block));
+  removeFile(path);
+  removeFile(path + ".2");
+}
+
+TEST(AllocationTrace, FailedReallocationKeepsBlockSize) {
+  const std::string path =
+      allocationTracePath("AllocationTrace.FailedReallocation");
+  void* (* volatile allocate)(size_t) = &::malloc;
+  void* (* volatile reallocate)(void*, size_t) = &::realloc;
+  ASSERT_FALSE(path.empty());
+  {
+    GlobalAllocationTrace trace(path);
+    void* p = allocate(12345);
+    ASSERT_TRUE(p);
+    EXPECT_FALSE(reallocate(p, SIZE_MAX / 2));
+    ::free(p);
+    EXPECT_TRUE(trace.stop());
+  }
+
+  std::vector<AllocationEvent> events;
+  ASSERT_TRUE(readAllocationTrace(path, events));
+
+  // The block is allocated, released by realloc(), allocated again
+  // with its original size when realloc() fails and released by free()
+  std::vector<AllocationEvent> block;
+  std::set<uint64_t> ids;
+  for (const AllocationEvent& e : blockEvents(events)) {
+    EXPECT_NE(SIZE_MAX / 2, e.size);
+    if ((e.type == AllocationEventType::ALLOCATE) && (e.size == 12345)) {
+      ids.insert(e.block);
+    }
+    if (ids.count(e.block)) {
+      block.push_back(e);
+    }
+  }
+  ASSERT_EQ(4, block.size());
+  EXPECT_EQ(AllocationEventType::ALLOCATE, block[0].type);
+  EXPECT_EQ(AllocationEventType::DEALLOCATE, block[1].type);
+  EXPECT_EQ(block[0].block, block[1].block);
+  EXPECT_EQ(AllocationEventType::ALLOCATE, block[2].type);
+  EXPECT_EQ(12345, block[2].size);
+  EXPECT_EQ(block[0].alignment, block[2].alignment);
+  EXPECT_EQ(AllocationEventType::DEALLOCATE, block[3].type);
+  EXPECT_EQ(block[2].block, block[3].block);
+  EXPECT_EQ(12345, block[3].size);
+  removeFile(path);
+}
+
+TEST(AllocationTrace, ReadInvalidTrace) {
+  const std::string path = allocationTracePath("AllocationTrace.Invalid");
+  std::vector<AllocationEvent> events;
+
+  { std::ofstream out(path.c_str()); out << "not a trace"; }
+  EXPECT_FALSE(readAllocationTrace(path, events));
+  EXPECT_TRUE(events.empty());
+  EXPECT_FALSE(readAllocationTrace(path + ".missing", events));
+  removeFile(path);
+}
+
+TEST(AllocationTrace, ReadCorruptAlignment) {
+  const std::string path =
+      allocationTracePath("AllocationTrace.CorruptAlignment");
+  std::vector<AllocationEvent> events;
+
+  // A valid header, one allocation aligned to 2^4 bytes and one whose
+  // alignment byte is out of range
+  std::string trace("PTALLOCS\x01\0\0\0\x20\0\0\0", 16);
+  std::string record(32, '\0');
+  record[16] = 64;
+  record[31] = 4;
+  trace += record;
+  record[31] = 32;
+  trace += record;
+  { std::ofstream out(path.c_str()); out << trace; }
+
+  EXPECT_FALSE(readAllocationTrace(path, events));
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(AllocationEventType::ALLOCATE, events[0].type);
+  EXPECT_EQ(64, events[0].size);
+  EXPECT_EQ(16, events[0].alignment);
+  removeFile(path);
+}
+
+TEST(AllocationTrace, TracePath) {
+  EXPECT_EQ(getAllocationTraceDir() + "/a_b.c.trace",
+	    allocationTracePath("a/b.c"));
+}
+
+TEST(AllocationTrace, Replay) {
+  const std::vector<AllocationEvent> events{
+    event(AllocationEventType::ALLOCATE, 0, 1 << 20),
+    event(AllocationEventType::ALLOCATE, 1, 100),
+    event(AllocationEventType::ALLOCATE, 2, 3 << 20),
+    event(AllocationEventType::DEALLOCATE, 0, 1 << 20),
+    event(AllocationEventType::DEALLOCATE, 2, 3 << 20),
+    event(AllocationEventType::ALLOCATE, 3, 1 << 20),
+    event(AllocationEventType::DEALLOCATE, 1, 100)
+  };
+  size_t strategies = 0;
+
+  const AllocationReplayResult system = replayAllocationTrace(
+      events, [&strategies]() {
+	++strategies;
+	return std::make_shared<SystemAllocation>();
+      }
+  );
+  EXPECT_EQ(2, strategies);
+  EXPECT_EQ(4, system.allocations);
+  EXPECT_EQ(3, system.deallocations);
+  EXPECT_EQ((4 << 20) + 100, system.peakLiveBytes);
+  EXPECT_LT(0.0, system.operationsPerSecond());
+  EXPECT_LE(0.0, system.fragmentation());
+  EXPECT_GT(1.0, system.fragmentation());
+
+  std::shared_ptr<Arena> arena;
+  const AllocationReplayResult arenaResult = replayAllocationTrace(
+      events, [&arena]() {
+	arena = std::make_shared<Arena>();
+	return std::make_shared<ArenaAllocation>(arena);
+      }
+  );
+  EXPECT_EQ(4, arenaResult.allocations);
+  EXPECT_EQ((4 << 20) + 100, arenaResult.peakLiveBytes);
+
+  // The arena never reuses the first block, so it held all of them
+  EXPECT_EQ(4, arena->allocations());
+}
@@ -3,8 +3,14 @@
  *  Unit tests for pistis::testing::Allocator
  */
 #include <pistis/testing/Allocator.hpp>
+#include <pistis/testing/AllocationScope.hpp>
+#include <pistis/testing/Containers.hpp>
 #include <gtest/gtest.h>
+#include <list>
+#include <map>
+#include <thread>
 #include <utility>
+#include <vector>
 #include <stdint.h>
 
 using namespace pistis::testing;
@@ -87,3 +93,221 @@ TEST(Allocator, MoveAssignmentTest) {
   EXPECT_TRUE(dest.moved());
 }
 
+
+TEST(Allocator, CopiesAndRebindsShareStats) {
+  auto stats = std::make_shared<AllocationStats>();
+  Allocator<uint32_t> allocator("TEST", stats);
+  Allocator<uint32_t> copy(allocator);
+  Allocator<uint64_t> rebound(allocator);
+  Allocator<uint32_t> moved(std::move(copy));
+
+  EXPECT_EQ(stats, allocator.stats());
+  EXPECT_EQ(stats, rebound.stats());
+  EXPECT_EQ(stats, moved.stats());
+  EXPECT_FALSE(Allocator<uint32_t>("TEST").stats());
+}
+
+TEST(Allocator, RecordAllocations) {
+  auto stats = std::make_shared<AllocationStats>();
+  Allocator<uint32_t> allocator("TEST", stats);
+  Allocator<uint64_t> rebound(allocator);
+
+  uint32_t* p = allocator.allocate(10);
+  uint64_t* q = rebound.allocate(100);
+  EXPECT_EQ(2, stats->allocations());
+  EXPECT_EQ(0, stats->deallocations());
+  EXPECT_EQ(840, stats->bytesAllocated());
+  EXPECT_EQ(840, stats->currentBytes());
+  EXPECT_EQ(840, stats->peakBytes());
+  EXPECT_EQ(1, stats->allocationsInSizeClass(5));
+  EXPECT_EQ(1, stats->allocationsInSizeClass(9));
+
+  allocator.deallocate(p, 10);
+  EXPECT_EQ(1, stats->deallocations());
+  EXPECT_EQ(40, stats->bytesDeallocated());
+  EXPECT_EQ(800, stats->currentBytes());
+  EXPECT_EQ(840, stats->peakBytes());
+
+  rebound.deallocate(q, 100);
+  EXPECT_EQ(2, stats->deallocations());
+  EXPECT_EQ(0, stats->currentBytes());
+  EXPECT_EQ(840, stats->peakBytes());
+
+  stats->reset();
+  EXPECT_EQ(0, stats->allocations());
+  EXPECT_EQ(0, stats->peakBytes());
+  EXPECT_EQ(0, stats->allocationsInSizeClass(5));
+}
+
+TEST(Allocator, ReserveThenPushBackAllocatesOnce) {
+  auto stats = std::make_shared<AllocationStats>();
+  std::vector< uint32_t, Allocator<uint32_t> > v(
+      Allocator<uint32_t>("TEST", stats)
+  );
+
+  v.reserve(100);
+  for (uint32_t i = 0; i < 100; ++i) {
+    v.push_back(i);
+  }
+  EXPECT_EQ(1, stats->allocations());
+  EXPECT_EQ(400, stats->currentBytes());
+}
+
+TEST(Allocator, NodeContainerUsesReboundAllocator) {
+  auto stats = std::make_shared<AllocationStats>();
+  {
+    std::list< uint32_t, Allocator<uint32_t> > l(
+	Allocator<uint32_t>("TEST", stats)
+    );
+    for (uint32_t i = 0; i < 10; ++i) {
+      l.push_back(i);
+    }
+    EXPECT_EQ(10, stats->allocations());
+  }
+  EXPECT_EQ(10, stats->deallocations());
+  EXPECT_EQ(0, stats->currentBytes());
+}
+
+TEST(Allocator, SampledPeak) {
+  auto stats = std::make_shared<AllocationStats>();
+  Allocator<uint64_t> allocator("TEST", stats);
+  EXPECT_FALSE(stats->exactPeak());
+
+  // The peak is only seen when the statistics are read
+  allocator.deallocate(allocator.allocate(100), 100);
+  EXPECT_EQ(0, stats->peakBytes());
+
+  uint64_t* p = allocator.allocate(10);
+  std::thread([&allocator, p]() { allocator.deallocate(p, 10); }).join();
+  EXPECT_EQ(0, stats->currentBytes());
+  EXPECT_EQ(0, stats->peakBytes());
+
+  p = allocator.allocate(10);
+  EXPECT_EQ(80, stats->currentBytes());
+  std::thread([&allocator, p]() { allocator.deallocate(p, 10); }).join();
+  EXPECT_EQ(0, stats->currentBytes());
+  EXPECT_EQ(80, stats->peakBytes());
+}
+
+TEST(Allocator, PeakWithCrossThreadFrees) {
+  const int NUM_ITEMS = 1000;
+  auto stats = std::make_shared<AllocationStats>(true);
+  Allocator<uint64_t> allocator("TEST", stats);
+
+  // A producer allocates each item and a consumer frees it, so at most
+  // one item is live at a time
+  for (int i = 0; i < NUM_ITEMS; ++i) {
+    uint64_t* item = nullptr;
+    std::thread producer([&allocator, &item]() {
+      item = allocator.allocate(1);
+    });
+    producer.join();
+    std::thread consumer([&allocator, item]() {
+      allocator.deallocate(item, 1);
+    });
+    consumer.join();
+  }
+
+  EXPECT_TRUE(stats->exactPeak());
+  EXPECT_EQ(0, stats->currentBytes());
+  EXPECT_EQ(8, stats->peakBytes());
+}
+
+TEST(Allocator, ConcurrentAllocations) {
+  const int NUM_THREADS = 16;
+  const int NUM_ALLOCATIONS = 1000;
+  auto stats = std::make_shared<AllocationStats>();
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    threads.emplace_back([stats, NUM_ALLOCATIONS]() {
+      Allocator<uint64_t> allocator("TEST", stats);
+      for (int j = 0; j < NUM_ALLOCATIONS; ++j) {
+	allocator.deallocate(allocator.allocate(2), 2);
+      }
+      uint64_t* p = allocator.allocate(1);
+      allocator.deallocate(p, 1);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(NUM_THREADS * (NUM_ALLOCATIONS + 1), stats->allocations());
+  EXPECT_EQ(NUM_THREADS * (NUM_ALLOCATIONS + 1), stats->deallocations());
+  EXPECT_EQ(NUM_THREADS * (NUM_ALLOCATIONS * 16 + 8),
+	    stats->bytesAllocated());
+  EXPECT_EQ(0, stats->currentBytes());
+  EXPECT_EQ(NUM_THREADS * NUM_ALLOCATIONS, stats->allocationsInSizeClass(4));
+  EXPECT_EQ(NUM_THREADS, stats->allocationsInSizeClass(3));
+}
+
+TEST(Allocator, StandardPropagation) {
+  typedef std::allocator_traits< Allocator<uint32_t> > Traits;
+
+  EXPECT_FALSE(Traits::propagate_on_container_copy_assignment::value);
+  EXPECT_TRUE(Traits::propagate_on_container_move_assignment::value);
+  EXPECT_FALSE(Traits::propagate_on_container_swap::value);
+  EXPECT_TRUE(Traits::is_always_equal::value);
+  EXPECT_TRUE(Allocator<uint32_t>("A") == Allocator<uint64_t>("B"));
+  EXPECT_FALSE(Allocator<uint32_t>("A") != Allocator<uint32_t>("B"));
+}
+
+TEST(Allocator, ConfigurablePropagation) {
+  typedef AllocatorPropagation<true, false, true, false> Propagation;
+  typedef Allocator<uint32_t, Propagation> TestAllocator;
+  typedef std::allocator_traits<TestAllocator> Traits;
+
+  EXPECT_TRUE(Traits::propagate_on_container_copy_assignment::value);
+  EXPECT_FALSE(Traits::propagate_on_container_move_assignment::value);
+  EXPECT_TRUE(Traits::propagate_on_container_swap::value);
+  EXPECT_FALSE(Traits::is_always_equal::value);
+
+  typedef Traits::rebind_alloc<uint64_t> Rebound;
+  EXPECT_TRUE((std::is_same< Allocator<uint64_t, Propagation>,
+			     Rebound >::value));
+}
+
+TEST(Allocator, UnequalInstances) {
+  typedef Allocator<uint32_t, NeverPropagate> TestAllocator;
+  TestAllocator a("A");
+  TestAllocator b("B");
+
+  EXPECT_TRUE(a == TestAllocator("A"));
+  EXPECT_TRUE((a == Allocator<uint64_t, NeverPropagate>(a)));
+  EXPECT_FALSE(a == b);
+  EXPECT_TRUE(a != b);
+}
+
+TEST(Allocator, ConstantTimeMovesAndSwaps) {
+  typedef Allocator<uint32_t, AlwaysPropagate> TestAllocator;
+  typedef std::vector<uint32_t, TestAllocator> Vector;
+  typedef std::map<uint32_t, uint32_t, std::less<uint32_t>,
+		   Allocator< std::pair<const uint32_t, uint32_t>,
+			      AlwaysPropagate > > Map;
+  int count = 0;
+
+  containers::testConstantTimeMovesAndSwaps([&count]() {
+    Vector v(10, 1, TestAllocator(std::to_string(++count)));
+    return v;
+  });
+  containers::testConstantTimeMovesAndSwaps([&count]() {
+    Map m(Map::allocator_type(std::to_string(++count)));
+    m[1] = 2;
+    m[3] = 4;
+    return m;
+  });
+}
+
+TEST(Allocator, MoveAssignmentWithUnequalAllocatorsCopies) {
+  typedef Allocator<uint32_t, NeverPropagate> TestAllocator;
+  std::vector<uint32_t, TestAllocator> source(10, 1, TestAllocator("A"));
+  std::vector<uint32_t, TestAllocator> destination(TestAllocator("B"));
+  const uint32_t* data = source.data();
+  AllocationScope scope;
+
+  destination = std::move(source);
+  EXPECT_EQ(1, scope.allocations());
+  EXPECT_NE(data, destination.data());
+  EXPECT_EQ("B", destination.get_allocator().name());
+}
@@ -0,0 +1,161 @@
+/** @file ArenaAllocatorTests.cpp
+ *
+ *  Unit tests for pistis::testing::Arena and
+ *  pistis::testing::ArenaAllocator
+ */
+#include <pistis/testing/ArenaAllocator.hpp>
+#include <gtest/gtest.h>
+#include <list>
+#include <map>
+#include <new>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+using namespace pistis::testing;
+
+namespace {
+  class ArenaAllocatorTests : public ::testing::Test {
+  protected:
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>(4096);
+  };
+}
+
+TEST(Arena, AllocateFromChunk) {
+  Arena arena(4096);
+  char* p = static_cast<char*>(arena.allocate(10, 1));
+  char* q = static_cast<char*>(arena.allocate(8, 8));
+
+  EXPECT_EQ(1, arena.numChunks());
+  EXPECT_EQ(2, arena.allocations());
+  EXPECT_EQ(18, arena.bytesAllocated());
+  EXPECT_LE(4096, arena.bytesReserved());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(q) % 8);
+  EXPECT_EQ(16, q - p);
+
+  arena.release();
+  EXPECT_EQ(0, arena.numChunks());
+  EXPECT_EQ(0, arena.allocations());
+  EXPECT_EQ(0, arena.bytesAllocated());
+  EXPECT_EQ(0, arena.bytesReserved());
+}
+
+TEST(Arena, AllocateNewChunkWhenFull) {
+  Arena arena(4096);
+  for (int i = 0; i < 5; ++i) {
+    arena.allocate(1000, 8);
+  }
+  EXPECT_EQ(2, arena.numChunks());
+}
+
+TEST(Arena, LargeAllocationsGetTheirOwnChunk) {
+  Arena arena(4096);
+  char* p = static_cast<char*>(arena.allocate(16, 16));
+  void* large = arena.allocate(100000, 64);
+  char* q = static_cast<char*>(arena.allocate(16, 16));
+
+  EXPECT_EQ(2, arena.numChunks());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % 64);
+  EXPECT_EQ(16, q - p);
+}
+
+TEST(Arena, HugeRequestsThrow) {
+  Arena arena(4096);
+  EXPECT_THROW(arena.allocate(SIZE_MAX - 8, 8), std::bad_alloc);
+  EXPECT_THROW(arena.allocate(SIZE_MAX - 64, 4096), std::bad_alloc);
+  EXPECT_EQ(0, arena.numChunks());
+}
+
+TEST(Arena, ReuseMostRecentAllocation) {
+  Arena arena(4096);
+  void* p = arena.allocate(100, 8);
+  void* q = arena.allocate(100, 8);
+
+  arena.deallocate(p, 100);
+  EXPECT_EQ(200, arena.bytesAllocated());
+
+  arena.deallocate(q, 100);
+  EXPECT_EQ(100, arena.bytesAllocated());
+  EXPECT_EQ(q, arena.allocate(50, 8));
+}
+
+TEST_F(ArenaAllocatorTests, Construction) {
+  ArenaAllocator<uint32_t> allocator("TEST", arena);
+
+  EXPECT_EQ("TEST", allocator.name());
+  EXPECT_EQ(arena, allocator.arena());
+  EXPECT_FALSE(allocator.stats());
+  EXPECT_FALSE(allocator.moved());
+  EXPECT_FALSE(allocator.movedFrom());
+}
+
+TEST_F(ArenaAllocatorTests, CopyAndRebind) {
+  ArenaAllocator<uint32_t> allocator("TEST", arena);
+  ArenaAllocator<uint32_t> copy(allocator);
+  ArenaAllocator<uint64_t> rebound(allocator);
+
+  EXPECT_EQ("TEST", copy.name());
+  EXPECT_EQ("TEST", rebound.name());
+  EXPECT_TRUE(allocator == copy);
+  EXPECT_TRUE(allocator == rebound);
+  EXPECT_FALSE(allocator != rebound);
+  EXPECT_FALSE(copy.moved());
+  EXPECT_FALSE(copy.movedFrom());
+  EXPECT_TRUE(allocator != ArenaAllocator<uint32_t>("TEST",
+						    std::make_shared<Arena>()));
+}
+
+TEST_F(ArenaAllocatorTests, Move) {
+  ArenaAllocator<uint32_t> src("TEST", arena);
+  ArenaAllocator<uint32_t> dest(std::move(src));
+
+  EXPECT_TRUE(src.movedFrom());
+  EXPECT_EQ("TEST", dest.name());
+  EXPECT_EQ(arena, dest.arena());
+  EXPECT_TRUE(dest.moved());
+
+  ArenaAllocator<uint32_t> assigned;
+  assigned = std::move(dest);
+  EXPECT_TRUE(dest.movedFrom());
+  EXPECT_EQ("TEST", assigned.name());
+  EXPECT_EQ(arena, assigned.arena());
+  EXPECT_TRUE(assigned.moved());
+}
+
+TEST_F(ArenaAllocatorTests, NodeContainers) {
+  auto stats = std::make_shared<AllocationStats>();
+  typedef ArenaAllocator< std::pair<const int, int> > MapAllocator;
+  std::map<int, int, std::less<int>, MapAllocator> m(
+      MapAllocator("map", arena, stats)
+  );
+  std::list< int, ArenaAllocator<int> > l(ArenaAllocator<int>("list", arena));
+
+  for (int i = 0; i < 100; ++i) {
+    m[i] = i * i;
+    l.push_back(i);
+  }
+  EXPECT_EQ(100, stats->allocations());
+  EXPECT_EQ(200, arena->allocations());
+  EXPECT_EQ(81, m[9]);
+  EXPECT_EQ(99, l.back());
+}
+
+TEST_F(ArenaAllocatorTests, VectorGrowth) {
+  std::vector< uint64_t, ArenaAllocator<uint64_t> > v(
+      ArenaAllocator<uint64_t>("vector", arena)
+  );
+  for (uint64_t i = 0; i < 1000; ++i) {
+    v.push_back(i);
+  }
+  for (uint64_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(i, v[i]);
+  }
+}
+
+TEST_F(ArenaAllocatorTests, ReserveMaxSize) {
+  std::vector< char, ArenaAllocator<char> > v(
+      ArenaAllocator<char>("vector", arena)
+  );
+  EXPECT_THROW(v.reserve(v.max_size()), std::bad_alloc);
+  EXPECT_EQ(0, arena->numChunks());
+}
@@ -0,0 +1,213 @@
+/** @file BenchmarkTests.cpp
+ *
+ *  Unit tests for the benchmark harness in Benchmark.hpp and
+ *  BenchmarkTest.hpp
+ */
+#include <pistis/testing/AllocationHooks.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::bench;
+
+namespace {
+  Options quickOptions(ClockType clock) {
+    Options options;
+    options.warmupTime = 1000000;
+    options.minSampleTime = 100000;
+    options.samples = 5;
+    options.clock = clock;
+    return options;
+  }
+}
+
+TEST(Benchmark, NormalQuantile) {
+  EXPECT_NEAR(0.0, normalQuantile(0.5), 1e-9);
+  EXPECT_NEAR(1.959964, normalQuantile(0.975), 1e-6);
+  EXPECT_NEAR(-1.644854, normalQuantile(0.05), 1e-6);
+  EXPECT_TRUE(std::isinf(normalQuantile(1.0)));
+}
+
+TEST(Benchmark, ComputeStatistics) {
+  const std::vector<double> samples{ 5.0, 1.0, 4.0, 2.0, 3.0, 100.0 };
+  const Statistics stats = computeStatistics(samples, 0.95);
+
+  EXPECT_EQ(6u, stats.count);
+  EXPECT_DOUBLE_EQ(1.0, stats.min);
+  EXPECT_DOUBLE_EQ(100.0, stats.max);
+  EXPECT_DOUBLE_EQ(115.0 / 6.0, stats.mean);
+  EXPECT_DOUBLE_EQ(3.5, stats.median);
+  EXPECT_DOUBLE_EQ(1.5, stats.mad);
+  EXPECT_DOUBLE_EQ(0.95, stats.confidence);
+  EXPECT_LE(stats.medianLow, stats.median);
+  EXPECT_GE(stats.medianHigh, stats.median);
+}
+
+TEST(Benchmark, MedianConfidenceIntervalNarrowsWithMoreSamples) {
+  std::vector<double> samples(1001);
+  std::iota(samples.begin(), samples.end(), 0.0);
+  const Statistics stats = computeStatistics(samples, 0.95);
+
+  EXPECT_DOUBLE_EQ(500.0, stats.median);
+  // The interval spans about 1.96 * sqrt(1001) ~= 62 ranks
+  EXPECT_NEAR(469.0, stats.medianLow, 2.0);
+  EXPECT_NEAR(531.0, stats.medianHigh, 2.0);
+}
+
+TEST(Benchmark, Run) {
+  for (ClockType clock : { ClockType::MONOTONIC, ClockType::TSC }) {
+    uint64_t total = 0;
+    const Result result = measure("sum", [&total]() {
+	doNotOptimize(++total);
+      }, quickOptions(clock));
+
+    EXPECT_EQ("sum", result.name);
+    EXPECT_EQ(clock, result.clock);
+    EXPECT_LE(1u, result.iterationsPerSample);
+    EXPECT_EQ(5u, result.samples.size());
+    EXPECT_EQ(5u, result.statistics.count);
+    EXPECT_LT(0.0, result.statistics.median);
+    EXPECT_LE(result.statistics.min, result.statistics.median);
+  }
+}
+
+TEST(Benchmark, WriteJson) {
+  Result result;
+  result.name = "a \"quoted\" name";
+  result.clock = ClockType::MONOTONIC;
+  result.iterationsPerSample = 10;
+  result.samples = std::vector<double>{ 1.0, 2.0, 3.0 };
+  result.statistics = computeStatistics(result.samples);
+
+  std::ostringstream out;
+  writeJson(out, result);
+  const std::string json = out.str();
+  EXPECT_NE(std::string::npos,
+	    json.find("\"name\": \"a \\\"quoted\\\" name\""));
+  EXPECT_NE(std::string::npos, json.find("\"clock\": \"monotonic\""));
+  EXPECT_NE(std::string::npos, json.find("\"iterations_per_sample\": 10"));
+  EXPECT_NE(std::string::npos, json.find("\"samples\": [1, 2, 3]"));
+  EXPECT_NE(std::string::npos, json.find("\"median\": 2"));
+}
+
+TEST(Benchmark, ResultFilename) {
+  EXPECT_EQ("Suite.Test.json", resultFilename("Suite.Test"));
+  EXPECT_EQ("a_b_c-d.json", resultFilename("a/b c-d"));
+}
+
+TEST(Benchmark, RunAcrossLayouts) {
+  size_t setups = 0;
+  const LayoutResult result = runAcrossLayouts(
+      "sum",
+      [&setups]() -> std::function<void (uint64_t)> {
+	EXPECT_TRUE(hooks::layoutRandomizationEnabled());
+	++setups;
+	auto data = std::make_shared<std::vector<uint32_t>>(256, 1);
+	return [data](uint64_t n) {
+	  for (uint64_t i = 0; i < n; ++i) {
+	    doNotOptimize(
+		std::accumulate(data->begin(), data->end(), uint32_t(0))
+	    );
+	  }
+	};
+      },
+      3, 100, quickOptions(ClockType::MONOTONIC)
+  );
+
+  EXPECT_FALSE(hooks::layoutRandomizationEnabled());
+  EXPECT_EQ(3u, setups);
+  EXPECT_EQ("sum", result.name);
+  EXPECT_EQ((std::vector<uint64_t>{ 100, 101, 102 }), result.seeds);
+  ASSERT_EQ(3u, result.runs.size());
+  EXPECT_EQ("sum/layout-101", result.runs[1].name);
+  EXPECT_EQ(3u, result.statistics.count);
+  EXPECT_LT(0.0, result.statistics.median);
+  EXPECT_LE(0.0, result.spread());
+}
+
+TEST(Benchmark, CompareLayouts) {
+  auto layoutResult = [](const std::vector<double>& medians) {
+    LayoutResult result;
+    for (double m : medians) {
+      Result run;
+      run.samples = std::vector<double>{ m };
+      run.statistics = computeStatistics(run.samples);
+      result.runs.push_back(run);
+    }
+    result.statistics = computeStatistics(medians);
+    return result;
+  };
+  const LayoutResult baseline =
+      layoutResult({ 100, 104, 98, 101, 103, 99, 102, 97 });
+  const LayoutResult noisy =
+      layoutResult({ 97, 101, 100, 96, 99, 102, 98, 103 });
+  const LayoutResult faster =
+      layoutResult({ 90, 92, 89, 91, 93, 88, 90, 91 });
+
+  // A 1% difference is within the spread of the layouts
+  const LayoutComparison same = compareLayouts(baseline, noisy);
+  EXPECT_FALSE(same.significant);
+  EXPECT_NEAR(0.99, same.ratio(), 0.01);
+
+  const LayoutComparison better = compareLayouts(baseline, faster);
+  EXPECT_TRUE(better.significant);
+  EXPECT_GT(0.0, better.z);
+  EXPECT_NEAR(0.9, better.ratio(), 0.01);
+  EXPECT_LT(0.0, compareLayouts(faster, baseline).z);
+}
+
+TEST(Benchmark, LayoutSeed) {
+  const char* saved = getenv("PISTIS_TESTING_LAYOUT_SEED");
+  const std::string savedValue(saved ? saved : "");
+
+  unsetenv("PISTIS_TESTING_LAYOUT_SEED");
+  EXPECT_EQ(1, layoutSeed());
+  setenv("PISTIS_TESTING_LAYOUT_SEED", "12345", 1);
+  EXPECT_EQ(12345, layoutSeed());
+
+  if (saved) {
+    setenv("PISTIS_TESTING_LAYOUT_SEED", savedValue.c_str(), 1);
+  } else {
+    unsetenv("PISTIS_TESTING_LAYOUT_SEED");
+  }
+}
+
+TEST(Benchmark, BenchmarkVectorSum) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  const std::vector<uint32_t> data(4096, 1);
+
+  const Result result = benchmark([&data]() {
+      doNotOptimize(std::accumulate(data.begin(), data.end(), uint32_t(0)));
+    });
+  EXPECT_LT(0.0, result.statistics.median);
+}
+
+TEST(Benchmark, BenchmarkVectorSumAcrossLayouts) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  Options options;
+  options.warmupTime = 10000000;
+  options.samples = 11;
+
+  const LayoutResult result = benchmarkAcrossLayouts(
+      currentTestName(),
+      []() -> std::function<void (uint64_t)> {
+	auto data = std::make_shared<std::vector<uint32_t>>(4096, 1);
+	return [data](uint64_t n) {
+	  for (uint64_t i = 0; i < n; ++i) {
+	    doNotOptimize(
+		std::accumulate(data->begin(), data->end(), uint32_t(0))
+	    );
+	  }
+	};
+      },
+      5, options
+  );
+  EXPECT_EQ(5u, result.runs.size());
+}
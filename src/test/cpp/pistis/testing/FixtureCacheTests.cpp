@@ -0,0 +1,208 @@
+/** @file FixtureCacheTests.cpp
+ *
+ *  Unit tests for FixtureCache
+ */
+#include <pistis/testing/FixtureCache.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pistis::testing;
+
+namespace {
+  std::string writeScratchFile(const std::string& name,
+			       const std::string& content) {
+    makeDirectories(getScratchDir());
+    const std::string path = getScratchFile(name);
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+    return path;
+  }
+
+  // Splits the resource into words and counts calls
+  struct WordParser {
+    int* calls;
+
+    std::vector<std::string> operator()(const ResourceView& r) const {
+      std::istringstream in(r.toString());
+      std::vector<std::string> words;
+      std::string word;
+      ++*calls;
+      while (in >> word) {
+	words.push_back(word);
+      }
+      return words;
+    }
+  };
+
+  size_t oneHundredBytes(const std::vector<std::string>&) { return 100; }
+
+  size_t countBytes(const ResourceView& r) { return r.size(); }
+
+  size_t countLines(const ResourceView& r) {
+    const std::string text = r.toString();
+    return std::count(text.begin(), text.end(), '\n');
+  }
+}
+
+TEST(FixtureCache, ParseOnce) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.ParseOnce", "a b c");
+  FixtureCache cache(1000);
+  int calls = 0;
+
+  auto first = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  auto second = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ((std::vector<std::string>{ "a", "b", "c" }), *first);
+  EXPECT_EQ(1u, cache.numFixtures());
+  EXPECT_EQ(5u, cache.bytesCached());
+  EXPECT_EQ(1u, cache.statistics().hits);
+  EXPECT_EQ(1u, cache.statistics().misses);
+  removeFile(path);
+}
+
+TEST(FixtureCache, ParsersHaveSeparateFixtures) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.ParsersHaveSeparateFixtures",
+		       "x y");
+  FixtureCache cache(1000);
+  int calls = 0;
+  auto count = [](const ResourceView& r) { return r.size(); };
+
+  auto words = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  auto size = cache.get<size_t>(path, count);
+
+  EXPECT_EQ(2u, words->size());
+  EXPECT_EQ(3u, *size);
+  EXPECT_EQ(2u, cache.numFixtures());
+  EXPECT_EQ(0u, cache.statistics().hits);
+  removeFile(path);
+}
+
+TEST(FixtureCache, FunctionsHaveSeparateFixtures) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.FunctionsHaveSeparateFixtures",
+		       "a\nb\n");
+  FixtureCache cache(1000);
+  const std::function<size_t (const ResourceView&)> wrappedBytes =
+      countBytes;
+  const std::function<size_t (const ResourceView&)> wrappedLines =
+      countLines;
+
+  EXPECT_EQ(4u, *cache.get<size_t>(path, countBytes));
+  EXPECT_EQ(2u, *cache.get<size_t>(path, countLines));
+  EXPECT_EQ(4u, *cache.get<size_t>(path, wrappedBytes));
+  EXPECT_EQ(2u, *cache.get<size_t>(path, wrappedLines));
+
+  // A std::function that wraps a function shares its fixture
+  EXPECT_EQ(2u, cache.numFixtures());
+  EXPECT_EQ(2u, cache.statistics().hits);
+  removeFile(path);
+}
+
+TEST(FixtureCache, ReparseChangedResources) {
+  const std::string name = "FixtureCacheTests.ReparseChangedResources";
+  const std::string path = writeScratchFile(name, "one");
+  FixtureCache cache(1000);
+  int calls = 0;
+
+  auto before = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  writeScratchFile(name, "one two");
+  auto after = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+
+  EXPECT_EQ(2, calls);
+  EXPECT_EQ(1u, before->size());
+  EXPECT_EQ(2u, after->size());
+  removeFile(path);
+}
+
+TEST(FixtureCache, EvictLeastRecentlyUsed) {
+  const std::string a = writeScratchFile("FixtureCacheTests.LruA", "a");
+  const std::string b = writeScratchFile("FixtureCacheTests.LruB", "b");
+  const std::string c = writeScratchFile("FixtureCacheTests.LruC", "c");
+  FixtureCache cache(250);
+  int calls = 0;
+  const WordParser parse{&calls};
+
+  auto fixtureA = cache.get<std::vector<std::string>>(a, parse,
+						      oneHundredBytes);
+  cache.get<std::vector<std::string>>(b, parse, oneHundredBytes);
+  cache.get<std::vector<std::string>>(a, parse, oneHundredBytes);
+  cache.get<std::vector<std::string>>(c, parse, oneHundredBytes);
+
+  // b was least recently used, so c replaced it
+  EXPECT_EQ(3, calls);
+  EXPECT_EQ(2u, cache.numFixtures());
+  EXPECT_EQ(200u, cache.bytesCached());
+  EXPECT_EQ(1u, cache.statistics().evictions);
+
+  cache.get<std::vector<std::string>>(a, parse, oneHundredBytes);
+  EXPECT_EQ(3, calls);
+  cache.get<std::vector<std::string>>(b, parse, oneHundredBytes);
+  EXPECT_EQ(4, calls);
+
+  // Evicted fixtures stay valid
+  cache.clear();
+  EXPECT_EQ("a", (*fixtureA)[0]);
+  EXPECT_EQ(0u, cache.numFixtures());
+  EXPECT_EQ(0u, cache.bytesCached());
+
+  removeFile(a);
+  removeFile(b);
+  removeFile(c);
+}
+
+TEST(FixtureCache, DoNotCacheFixturesLargerThanBudget) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.TooLarge", "0123456789");
+  FixtureCache cache(4);
+  int calls = 0;
+
+  auto fixture = cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  cache.get<std::vector<std::string>>(path, WordParser{&calls});
+
+  EXPECT_EQ(2, calls);
+  EXPECT_EQ("0123456789", (*fixture)[0]);
+  EXPECT_EQ(0u, cache.numFixtures());
+  removeFile(path);
+}
+
+TEST(FixtureCache, PrintStatistics) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.PrintStatistics", "a");
+  FixtureCache cache(1000);
+  int calls = 0;
+  std::ostringstream out;
+
+  cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  cache.get<std::vector<std::string>>(path, WordParser{&calls});
+  cache.printStatistics(out);
+
+  EXPECT_NE(std::string::npos, out.str().find("1 hits, 1 misses"));
+  EXPECT_NE(std::string::npos, out.str().find(path));
+  EXPECT_NE(std::string::npos, out.str().find("std::vector"));
+  removeFile(path);
+}
+
+TEST(FixtureCache, ProcessWideCache) {
+  const std::string path =
+      writeScratchFile("FixtureCacheTests.ProcessWideCache", "p q");
+  int calls = 0;
+
+  auto first = getCachedFixture<std::vector<std::string>>(path,
+							   WordParser{&calls});
+  auto second = getCachedFixture<std::vector<std::string>>(path,
+							    WordParser{&calls});
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(&FixtureCache::instance(), &FixtureCache::instance());
+  removeFile(path);
+}
@@ -0,0 +1,184 @@
+/** @file GeneratorsTests.cpp
+ *
+ *  Unit tests for the test data generators in Generators.hpp
+ */
+#include <pistis/testing/Generators.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <pistis/testing/TestScratch.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <set>
+
+using namespace pistis::testing;
+using namespace pistis::testing::generators;
+
+TEST(Generators, Deterministic) {
+  const UniformIntegers<uint32_t> g(0, 1000000, 42);
+  const auto first = generate(1000, g);
+  const auto second = generate(1000, g);
+  const auto other = generate(1000, UniformIntegers<uint32_t>(0, 1000000, 43));
+
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+
+  // Slices match the whole sequence
+  const auto slice = generate(100, g, 500);
+  EXPECT_TRUE(std::equal(slice.begin(), slice.end(), first.begin() + 500));
+}
+
+TEST(Generators, UniformIntegers) {
+  const auto values = generate(100000, UniformIntegers<int16_t>(-10, 10, 1));
+  std::vector<size_t> counts(21, 0);
+
+  for (int16_t x : values) {
+    ASSERT_LE(-10, x);
+    ASSERT_GE(10, x);
+    ++counts[x + 10];
+  }
+  for (size_t count : counts) {
+    EXPECT_NEAR(100000.0 / 21.0, double(count), 500.0);
+  }
+
+  // The full range of a 64-bit type
+  const UniformIntegers<uint64_t> full(0, ~uint64_t(0), 1);
+  EXPECT_NE(full(0), full(1));
+}
+
+TEST(Generators, NormalIntegers) {
+  const auto values = generate(100000, NormalIntegers<int32_t>(1000, 50, 7));
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+
+  for (int32_t x : values) {
+    sum += x;
+    sumOfSquares += double(x) * x;
+  }
+
+  const double mean = sum / values.size();
+  const double variance = sumOfSquares / values.size() - mean * mean;
+  EXPECT_NEAR(1000.0, mean, 1.0);
+  EXPECT_NEAR(50.0, std::sqrt(variance), 1.0);
+
+  // Clamped to the range of the type
+  const auto clamped = generate(1000, NormalIntegers<uint8_t>(250, 50, 7));
+  EXPECT_EQ(255, *std::max_element(clamped.begin(), clamped.end()));
+}
+
+TEST(Generators, ZipfIntegers) {
+  const auto values = generate(100000, ZipfIntegers<uint32_t>(1000, 1.0, 3));
+  const size_t ones = std::count(values.begin(), values.end(), 1u);
+  const size_t hundreds = std::count(values.begin(), values.end(), 100u);
+
+  EXPECT_EQ(1u, *std::min_element(values.begin(), values.end()));
+  EXPECT_GE(1000u, *std::max_element(values.begin(), values.end()));
+  EXPECT_LT(20 * hundreds, ones);
+}
+
+TEST(Generators, SortedIntegers) {
+  const auto values = generate(10000, SortedIntegers<uint64_t>(10, 5));
+  EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+  EXPECT_EQ(values.end(), std::adjacent_find(values.begin(), values.end()));
+  EXPECT_GT(100000u, values.back());
+
+  const auto dense = generate(100, SortedIntegers<int>(1, 5));
+  std::vector<int> truth(100);
+  std::iota(truth.begin(), truth.end(), 0);
+  EXPECT_EQ(truth, dense);
+}
+
+TEST(Generators, NearlySortedIntegers) {
+  const auto values =
+      generate(10000, NearlySortedIntegers<uint32_t>(0.1, 3, 11));
+  size_t displaced = 0;
+
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i] != i) {
+      ++displaced;
+      EXPECT_GE(3u, uint32_t(std::abs(int64_t(values[i]) - int64_t(i))));
+    }
+  }
+  EXPECT_LT(500u, displaced);
+  EXPECT_GT(1500u, displaced);
+}
+
+TEST(Generators, Patterns) {
+  EXPECT_EQ((std::vector<int>{ 4, 3, 2, 1, 0 }),
+	    generate(5, ReversedIntegers<int>(5)));
+  EXPECT_EQ((std::vector<int>{ 0, 1, 2, 2, 1, 0 }),
+	    generate(6, OrganPipeIntegers<int>(6)));
+  EXPECT_EQ((std::vector<int>{ 0, 1, 2, 0, 1, 2, 0 }),
+	    generate(7, SawtoothIntegers<int>(3)));
+
+  const auto few = generate(1000, FewUniqueIntegers<int>(4, 9));
+  EXPECT_EQ(4u, std::set<int>(few.begin(), few.end()).size());
+}
+
+TEST(Generators, RandomStrings) {
+  const RandomStrings g(3, 12, 17, "ab");
+  const auto strings = generate(1000, g);
+  std::set<size_t> lengths;
+
+  for (const std::string& s : strings) {
+    ASSERT_LE(3u, s.size());
+    ASSERT_GE(12u, s.size());
+    ASSERT_EQ(std::string::npos, s.find_first_not_of("ab"));
+    lengths.insert(s.size());
+  }
+  EXPECT_EQ(10u, lengths.size());
+  EXPECT_EQ(strings[10], g(10));
+}
+
+TEST(Generators, WriteBinaryFile) {
+  const UniformIntegers<uint32_t> g(0, 1000, 23);
+  const std::string path = getTestScratchFile("values.bin");
+
+  ASSERT_TRUE(writeBinaryFile(path, 1000, g, 64));
+
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::vector<uint32_t> values(1000);
+  in.read((char*)values.data(), values.size() * sizeof(uint32_t));
+  EXPECT_EQ(std::streamsize(values.size() * sizeof(uint32_t)), in.gcount());
+  EXPECT_EQ(generate(1000, g), values);
+}
+
+TEST(Generators, WriteTextFile) {
+  const RandomStrings g(1, 5, 29);
+  const std::string path = getTestScratchFile("strings.txt");
+
+  ASSERT_TRUE(writeTextFile(path, 100, g));
+
+  std::ifstream in(path.c_str());
+  const std::vector<std::string> lines{
+    std::istream_iterator<std::string>(in),
+    std::istream_iterator<std::string>()
+  };
+  EXPECT_EQ(generate(100, g), lines);
+}
+
+TEST(Generators, BenchmarkUniformIntegers) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  std::vector<uint32_t> values(1 << 20);
+  const UniformIntegers<uint32_t> g(0, 1000000, 1);
+  uint64_t first = 0;
+
+  bench::benchmark([&]() {
+      fill(values.data(), values.size(), g, first);
+      first += values.size();
+      doNotOptimize(values.data());
+    });
+}
+
+TEST(Generators, BenchmarkSortedIntegers) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  std::vector<uint64_t> values(1 << 20);
+  const SortedIntegers<uint64_t> g(16, 1);
+
+  bench::benchmark([&]() {
+      fill(values.data(), values.size(), g);
+      doNotOptimize(values.data());
+    });
+}
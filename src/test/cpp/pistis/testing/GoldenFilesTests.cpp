@@ -0,0 +1,139 @@
+/** @file GoldenFilesTests.cpp
+ *
+ *  Unit tests for compareFiles() and the golden-file assertions
+ */
+#include <pistis/testing/GoldenFileAssertions.hpp>
+#include <pistis/testing/LargeFiles.hpp>
+#include <pistis/testing/ResourceUsage.hpp>
+#include <pistis/testing/TestScratch.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace pistis::testing;
+
+namespace {
+  std::string writeFile(const std::string& name, const std::string& content) {
+    const std::string path = getTestScratchFile(name);
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+    return path;
+  }
+}
+
+TEST(GoldenFiles, IdenticalFiles) {
+  const std::string a = writeFile("a", "line 1\nline 2\n");
+  const std::string b = writeFile("b", "line 1\nline 2\n");
+  const FileComparison c = compareFiles(a, b);
+
+  EXPECT_TRUE(c.identical);
+  EXPECT_EQ(14u, c.actualSize);
+  EXPECT_EQ(14u, c.expectedSize);
+  EXPECT_EQ(14u, c.mismatchOffset);
+  EXPECT_EQ("", c.description);
+}
+
+TEST(GoldenFiles, EmptyFiles) {
+  const std::string a = writeFile("a", "");
+  const std::string b = writeFile("b", "");
+  const std::string c = writeFile("c", "x");
+
+  EXPECT_TRUE(compareFiles(a, b).identical);
+  EXPECT_FALSE(compareFiles(a, c).identical);
+  EXPECT_EQ(0u, compareFiles(c, a).mismatchOffset);
+}
+
+TEST(GoldenFiles, ReportFirstMismatch) {
+  const std::string actual = writeFile("actual", "abc\ndef\nghiXkl\n");
+  const std::string expected = writeFile("expected", "abc\ndef\nghijkl\n");
+  const FileComparison c = compareFiles(actual, expected, 4);
+
+  EXPECT_FALSE(c.identical);
+  EXPECT_EQ(11u, c.mismatchOffset);
+  EXPECT_EQ(3u, c.line);
+  EXPECT_EQ(4u, c.column);
+  EXPECT_NE(std::string::npos, c.description.find("offset 11"));
+  EXPECT_NE(std::string::npos, c.description.find("line 3, column 4"));
+  EXPECT_NE(std::string::npos, c.description.find("\"\\nghijkl\\n\""));
+  EXPECT_NE(std::string::npos, c.description.find("\"\\nghiXkl\\n\""));
+  EXPECT_NE(std::string::npos, c.description.find("[58]"));
+  EXPECT_NE(std::string::npos, c.description.find("[6a]"));
+}
+
+TEST(GoldenFiles, ReportTruncation) {
+  const std::string actual = writeFile("actual", "abc\nde");
+  const std::string expected = writeFile("expected", "abc\ndef\n");
+  const FileComparison c = compareFiles(actual, expected);
+
+  EXPECT_FALSE(c.identical);
+  EXPECT_EQ(6u, c.mismatchOffset);
+  EXPECT_EQ(2u, c.line);
+  EXPECT_EQ(3u, c.column);
+  EXPECT_NE(std::string::npos, c.description.find("actual file ends first"));
+}
+
+TEST(GoldenFiles, CompareLargeFiles) {
+  // Sparse, so they take no time to write.  The mismatch lies beyond
+  // several compare chunks and release blocks.
+  const uint64_t size = uint64_t(256) << 20;
+  const uint64_t offset = size - 1000;
+  const LargeFileInfo actual = createLargeFile(
+      getTestScratchFile("large.actual"), size, LargeFileAllocation::SPARSE,
+      { LargeFileRegion(offset, 3, "a\nb") }
+  );
+  const LargeFileInfo expected = createLargeFile(
+      getTestScratchFile("large.expected"), size, LargeFileAllocation::SPARSE,
+      { LargeFileRegion(offset, 3, "a\nc") }
+  );
+  const bool measurePeak = resetPeakRss();
+  const ResourceUsage start = ResourceUsage::current();
+  const FileComparison c = compareFiles(actual.path, expected.path);
+  const ResourceUsage usage =
+      ResourceUsage::difference(start, ResourceUsage::current());
+
+  EXPECT_FALSE(c.identical);
+  EXPECT_EQ(offset + 2, c.mismatchOffset);
+  EXPECT_EQ(2u, c.line);
+  EXPECT_EQ(1u, c.column);
+
+  // Each file keeps at most one 64 MiB release block resident.
+  // Counting lines must not fault the released pages back in.
+  if (measurePeak) {
+    EXPECT_GT(uint64_t(192) << 20, usage.peakRss);
+  }
+}
+
+TEST(GoldenFiles, CountLinesAcrossChunks) {
+  // Long enough to span several compare chunks
+  std::string text;
+  for (int i = 0; i < 100000; ++i) {
+    text += "line " + std::to_string(i) + "\n";
+  }
+  const std::string a = writeFile("a", text + "the end\n");
+  const std::string b = writeFile("b", text + "the END\n");
+  const FileComparison c = compareFiles(a, b);
+
+  EXPECT_FALSE(c.identical);
+  EXPECT_EQ(text.size() + 4, c.mismatchOffset);
+  EXPECT_EQ(100001u, c.line);
+  EXPECT_EQ(5u, c.column);
+}
+
+TEST(GoldenFiles, MissingFile) {
+  const std::string a = writeFile("a", "x");
+  EXPECT_THROW(compareFiles(a, getTestScratchFile("missing")),
+	       std::runtime_error);
+}
+
+TEST(GoldenFiles, Assertions) {
+  const std::string actual = writeFile("actual", "golden");
+  const std::string golden = writeFile("golden", "golden");
+  const std::string other = writeFile("other", "silver");
+
+  // Absolute paths pass through getScratchFile() and getResourcePath()
+  EXPECT_FILE_MATCHES_GOLDEN(actual, golden);
+  EXPECT_TRUE(checkFileMatchesGolden(actual, golden));
+  EXPECT_FALSE(checkFileMatchesGolden(actual, other));
+  EXPECT_FALSE(checkFileMatchesGolden(actual, getTestScratchFile("none")));
+}
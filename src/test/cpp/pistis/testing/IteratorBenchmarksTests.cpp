@@ -0,0 +1,112 @@
+/** @file IteratorBenchmarksTests.cpp
+ *
+ *  Unit tests for the functions in IteratorBenchmarks.hpp
+ */
+#include <pistis/testing/IteratorBenchmarks.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <gtest/gtest.h>
+#include <deque>
+#include <forward_list>
+#include <list>
+#include <sstream>
+#include <stdint.h>
+
+using namespace pistis::testing::iterators;
+
+namespace {
+  std::vector<std::string> operations(const IteratorBenchmarkResults& r) {
+    std::vector<std::string> names;
+    for (const auto& result : r) {
+      names.push_back(result.operation);
+    }
+    return names;
+  }
+
+  const IteratorBenchmarkOptions QUICK(1, false);
+}
+
+TEST(IteratorBenchmarks, ForwardIterator) {
+  const std::forward_list<uint32_t> data{ 1, 2, 3, 4, 5 };
+  const auto results = benchmarkForwardIterator(
+      [&data]() { return data.begin(); }, [&data]() { return data.end(); },
+      data, QUICK
+  );
+  const std::vector<std::string> truth{
+    "preincrement", "postincrement", "dereference", "traversal"
+  };
+
+  EXPECT_EQ(truth, operations(results));
+  for (const auto& r : results) {
+    EXPECT_LE(0.0, r.nsPerElement);
+    EXPECT_LE(0.0, r.baselineNsPerElement);
+  }
+}
+
+TEST(IteratorBenchmarks, BidirectionalIterator) {
+  const std::list<uint32_t> data{ 1, 2, 3, 4, 5 };
+  const auto results = benchmarkBidirectionalIterator(
+      [&data]() { return data.begin(); }, [&data]() { return data.end(); },
+      data, QUICK
+  );
+  const std::vector<std::string> truth{
+    "preincrement", "postincrement", "dereference", "traversal",
+    "predecrement", "postdecrement"
+  };
+
+  EXPECT_EQ(truth, operations(results));
+}
+
+TEST(IteratorBenchmarks, RandomAccessIterator) {
+  const std::deque<uint32_t> data(1000, 1);
+  const auto results = benchmarkRandomAccessIterator(
+      [&data]() { return data.begin(); }, [&data]() { return data.end(); },
+      data, QUICK
+  );
+  const std::vector<std::string> truth{
+    "preincrement", "postincrement", "dereference", "traversal",
+    "predecrement", "postdecrement", "randomJump"
+  };
+
+  EXPECT_EQ(truth, operations(results));
+}
+
+TEST(IteratorBenchmarks, ContiguousIterator) {
+  const std::vector<uint32_t> data(1000, 1);
+  const auto results = benchmarkContiguousIterator(
+      [&data]() { return data.begin(); }, [&data]() { return data.end(); },
+      data, QUICK
+  );
+  const std::vector<std::string> truth{
+    "preincrement", "postincrement", "dereference", "traversal",
+    "predecrement", "postdecrement", "randomJump", "reduction"
+  };
+
+  EXPECT_EQ(truth, operations(results));
+}
+
+TEST(IteratorBenchmarks, BenchmarkVectorIteratorReduction) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  const std::vector<uint32_t> data(1 << 16, 1);
+  const auto results = benchmarkContiguousIterator(
+      [&data]() { return data.begin(); }, [&data]() { return data.end(); },
+      data, IteratorBenchmarkOptions(100)
+  );
+
+#ifdef __OPTIMIZE__
+  // std::vector's iterators should compile down to pointers, so
+  // summing through them should vectorize just like the raw loop
+  EXPECT_GT(1.5, results.back().ratio());
+#endif
+}
+
+TEST(IteratorBenchmarks, PrintResults) {
+  IteratorBenchmarkResults results{
+    IteratorBenchmarkResult{ "traversal", 2.0, 1.0 }
+  };
+  std::ostringstream out;
+
+  printIteratorBenchmarkResults(out, results);
+  EXPECT_NE(std::string::npos, out.str().find("traversal"));
+  EXPECT_NE(std::string::npos, out.str().find("2.00"));
+  EXPECT_DOUBLE_EQ(2.0, results[0].ratio());
+}
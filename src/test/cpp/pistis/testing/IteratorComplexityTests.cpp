@@ -0,0 +1,193 @@
+/** @file IteratorComplexityTests.cpp
+ *
+ *  Unit tests for pistis::testing::CountingIterator and the functions
+ *  in IteratorComplexity.hpp
+ */
+#include <pistis/testing/IteratorComplexity.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <list>
+#include <vector>
+#include <stdint.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::iterators;
+
+namespace {
+  typedef CountingIterator<std::vector<uint32_t>::const_iterator>
+      CountingVectorIterator;
+
+  // A random access iterator whose operator+= steps through the
+  // sequence one element at a time
+  class SlowJumpIterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef uint32_t value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const uint32_t* pointer;
+    typedef const uint32_t& reference;
+
+  public:
+    SlowJumpIterator(CountingVectorIterator it): it_(it) { }
+
+    reference operator*() const { return *it_; }
+    reference operator[](difference_type n) const { return it_[n]; }
+    SlowJumpIterator& operator++() { ++it_; return *this; }
+    SlowJumpIterator& operator--() { --it_; return *this; }
+    SlowJumpIterator& operator+=(difference_type n) {
+      for (difference_type i = 0; i < n; ++i) {
+	++it_;
+      }
+      return *this;
+    }
+    SlowJumpIterator& operator-=(difference_type n) {
+      it_ -= n;
+      return *this;
+    }
+    SlowJumpIterator operator+(difference_type n) const {
+      return SlowJumpIterator(it_ + n);
+    }
+    SlowJumpIterator operator-(difference_type n) const {
+      return SlowJumpIterator(it_ - n);
+    }
+    difference_type operator-(const SlowJumpIterator& other) const {
+      return it_ - other.it_;
+    }
+    bool operator==(const SlowJumpIterator& other) const {
+      return it_ == other.it_;
+    }
+    bool operator!=(const SlowJumpIterator& other) const {
+      return it_ != other.it_;
+    }
+    bool operator<(const SlowJumpIterator& other) const {
+      return it_ < other.it_;
+    }
+
+  private:
+    CountingVectorIterator it_;
+  };
+
+  class SlowJumpRange {
+  public:
+    SlowJumpRange(size_t n, IteratorOperationCounts& counts):
+	data_(n, 1), counts_(&counts) {
+    }
+
+    SlowJumpIterator begin() const {
+      return SlowJumpIterator(makeCountingIterator(data_.cbegin(), *counts_));
+    }
+
+    SlowJumpIterator end() const {
+      return SlowJumpIterator(makeCountingIterator(data_.cend(), *counts_));
+    }
+
+  private:
+    std::vector<uint32_t> data_;
+    IteratorOperationCounts* counts_;
+  };
+
+  const ComplexityOptions SMALL_SIZES({ 16, 256, 4096 }, 8.0);
+
+  static void testSlowJumpIterator() {
+    IteratorOperationCounts counts;
+    testRandomAccessIteratorComplexity(
+	[&counts](size_t n) { return SlowJumpRange(n, counts); },
+	SMALL_SIZES, OperationCountMeter(counts)
+    );
+  }
+}
+
+TEST(CountingIterator, CountOperations) {
+  std::vector<uint32_t> v{ 1, 2, 3, 4, 5 };
+  IteratorOperationCounts counts;
+  auto start = makeCountingIterator(v.begin(), counts);
+  auto end = makeCountingIterator(v.end(), counts);
+  uint32_t total = 0;
+
+  for (auto i = start; i != end; ++i) {
+    total += *i;
+  }
+  EXPECT_EQ(15, total);
+  EXPECT_EQ(5, counts.increments);
+  EXPECT_EQ(5, counts.dereferences);
+  EXPECT_EQ(6, counts.comparisons);
+
+  counts.reset();
+  auto i = start + 4;
+  i -= 2;
+  --i;
+  EXPECT_EQ(5, end - start);
+  EXPECT_EQ(4, i[2]);
+  EXPECT_TRUE(start < i);
+  EXPECT_EQ(2, counts.jumps);
+  EXPECT_EQ(1, counts.decrements);
+  EXPECT_EQ(1, counts.differences);
+  EXPECT_EQ(1, counts.dereferences);
+  EXPECT_EQ(1, counts.comparisons);
+  EXPECT_EQ(6, counts.total());
+}
+
+TEST(IteratorComplexity, CheckCostGrowth) {
+  const std::vector<size_t> sizes{ 10, 100, 1000 };
+
+  EXPECT_TRUE(checkCostGrowth("op", sizes, { 5.0, 6.0, 7.0 }, false, 2.0));
+  EXPECT_FALSE(checkCostGrowth("op", sizes, { 5.0, 50.0, 500.0 }, false,
+			       2.0));
+  EXPECT_TRUE(checkCostGrowth("op", sizes, { 5.0, 50.0, 500.0 }, true,
+			      2.0));
+  EXPECT_FALSE(checkCostGrowth("op", sizes, { 10.0, 1000.0, 100000.0 },
+			       true, 2.0));
+}
+
+// Timed with ElapsedTimeMeter, so too noisy for "make test".
+// CountOperationsOnUnderlyingSequence counts operations instead.
+TEST(IteratorComplexity, BenchmarkVectorIterator) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  testRandomAccessIteratorComplexity([](size_t n) {
+    return std::vector<uint32_t>(n, 1);
+  }, SMALL_SIZES);
+}
+
+TEST(IteratorComplexity, BenchmarkListIterator) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  testBidirectionalIteratorComplexity([](size_t n) {
+    return std::list<uint32_t>(n, 1);
+  }, SMALL_SIZES);
+}
+
+TEST(IteratorComplexity, CountOperationsOnUnderlyingSequence) {
+  typedef CountingIterator<std::vector<uint32_t>::iterator> Iterator;
+  typedef CountingIterator<std::list<uint32_t>::iterator> ListIterator;
+  IteratorOperationCounts counts;
+  std::vector<uint32_t> v;
+  std::list<uint32_t> l;
+
+  struct Range {
+    Iterator start;
+    Iterator finish;
+    Iterator begin() const { return start; }
+    Iterator end() const { return finish; }
+  };
+  testRandomAccessIteratorComplexity([&](size_t n) {
+    v.assign(n, 1);
+    return Range{ makeCountingIterator(v.begin(), counts),
+		  makeCountingIterator(v.end(), counts) };
+  }, SMALL_SIZES, OperationCountMeter(counts));
+
+  struct ListRange {
+    ListIterator start;
+    ListIterator finish;
+    ListIterator begin() const { return start; }
+    ListIterator end() const { return finish; }
+  };
+  testBidirectionalIteratorComplexity([&](size_t n) {
+    l.assign(n, 1);
+    return ListRange{ makeCountingIterator(l.begin(), counts),
+		      makeCountingIterator(l.end(), counts) };
+  }, SMALL_SIZES, OperationCountMeter(counts));
+}
+
+TEST(IteratorComplexity, DetectLinearTimeJump) {
+  EXPECT_NONFATAL_FAILURE(testSlowJumpIterator(), "Cost of it += n grew");
+}
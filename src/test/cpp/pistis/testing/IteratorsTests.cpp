@@ -0,0 +1,185 @@
+/** @file IteratorsTests.cpp
+ *
+ *  Unit tests for the functions in Iterators.hpp and the views in
+ *  SequenceViews.hpp
+ */
+#include <pistis/testing/Iterators.hpp>
+#include <pistis/testing/AllocationAssertions.hpp>
+#include <pistis/testing/Generators.hpp>
+#include <pistis/testing/Tracked.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <vector>
+#include <stdint.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::iterators;
+
+namespace {
+  uint64_t triple(uint64_t i) { return 3 * i; }
+
+  // Returns a copy of the element from operator* instead of a
+  // reference to it
+  class ByValueIterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Tracked<int> value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Tracked<int>* pointer;
+    typedef Tracked<int> reference;
+
+  public:
+    explicit ByValueIterator(std::vector< Tracked<int> >::const_iterator p):
+	p_(p) {
+    }
+
+    Tracked<int> operator*() const { return *p_; }
+    ByValueIterator& operator++() { ++p_; return *this; }
+    ByValueIterator operator++(int) {
+      ByValueIterator tmp(*this);
+      ++p_;
+      return tmp;
+    }
+    bool operator==(const ByValueIterator& other) const {
+      return p_ == other.p_;
+    }
+    bool operator!=(const ByValueIterator& other) const {
+      return p_ != other.p_;
+    }
+
+  private:
+    std::vector< Tracked<int> >::const_iterator p_;
+  };
+
+  void testByValueIteratorDoesNotCopy() {
+    static const std::vector< Tracked<int> > data{ 1, 2, 3 };
+    testDereferenceDoesNotCopy(ByValueIterator(data.begin()),
+			       ByValueIterator(data.end()));
+  }
+
+  void testDequeIsContiguous() {
+    // Large enough to span several of the deque's blocks
+    const std::deque<uint32_t> data(10000, 1);
+    testContiguousAddresses(data.begin(), data.end());
+  }
+}
+
+TEST(Iterators, GeneratedSequence) {
+  const auto s = generatedSequence(5, triple);
+  const std::vector<uint64_t> forward(s.begin(), s.end());
+  const std::vector<uint64_t> backward(s.rbegin(), s.rend());
+
+  EXPECT_EQ(5, s.size());
+  EXPECT_FALSE(s.empty());
+  EXPECT_EQ(12, s[4]);
+  EXPECT_EQ(5, s.end() - s.begin());
+  EXPECT_EQ(6, s.begin()[2]);
+  EXPECT_EQ(std::vector<uint64_t>({ 0, 3, 6, 9, 12 }), forward);
+  EXPECT_EQ(std::vector<uint64_t>({ 12, 9, 6, 3, 0 }), backward);
+}
+
+TEST(Iterators, ReversedSequence) {
+  const std::vector<int> v{ 1, 2, 3, 4 };
+  const auto r = reversed(v);
+  const std::vector<int> backward(r.begin(), r.end());
+  const std::vector<int> forward(r.rbegin(), r.rend());
+
+  EXPECT_EQ(std::vector<int>({ 4, 3, 2, 1 }), backward);
+  EXPECT_EQ(v, forward);
+  EXPECT_EQ(4, r.size());
+  EXPECT_EQ(4, r[0]);
+  EXPECT_EQ(1, r[3]);
+}
+
+TEST(Iterators, TestStandardContainerIterators) {
+  const std::vector<int> v{ 2, 3, 5, 7, 11, 13 };
+  const std::list<int> l(v.begin(), v.end());
+
+  testRandomAccessIterator([&v]() { return v.begin(); },
+			   [&v]() { return v.end(); }, v);
+  testBidirectionalIterator([&l]() { return l.begin(); },
+			    [&l]() { return l.end(); }, l);
+}
+
+TEST(Iterators, IteratorAddress) {
+  std::vector<int> v{ 1, 2, 3 };
+  int* p = v.data();
+
+  EXPECT_EQ(p, iteratorAddress(p));
+  EXPECT_EQ(p + 1, iteratorAddress(v.begin() + 1));
+  EXPECT_EQ(p + 2, iteratorAddress(v.cbegin() + 2));
+}
+
+TEST(Iterators, TestContiguousIterator) {
+  const std::vector<uint32_t> v{ 2, 3, 5, 7, 11, 13 };
+  const uint32_t a[] = { 2, 3, 5, 7, 11, 13 };
+
+  testContiguousIterator([&v]() { return v.begin(); },
+			 [&v]() { return v.end(); }, v);
+  testContiguousIterator([&a]() { return std::begin(a); },
+			 [&a]() { return std::end(a); }, v);
+}
+
+TEST(Iterators, DequeIteratorIsNotContiguous) {
+  EXPECT_FATAL_FAILURE(testDequeIsContiguous(), "is not contiguous");
+}
+
+TEST(Iterators, DereferenceDoesNotCopy) {
+  const std::vector< Tracked<int> > v{ 2, 3, 5, 7 };
+
+  testDereferenceDoesNotCopy(v.begin(), v.end());
+  testForwardIterator([&v]() { return v.begin(); },
+		      [&v]() { return v.end(); }, v);
+}
+
+TEST(Iterators, DereferenceByValueCopies) {
+  EXPECT_FATAL_FAILURE(testByValueIteratorDoesNotCopy(),
+		       "does operator* return by value?");
+}
+
+TEST(Iterators, TestAgainstGeneratedTruth) {
+  // Neither the sequence under test nor the truth sequence is ever
+  // materialized, so testing an iterator over a million elements
+  // should allocate no more than gtest's bookkeeping
+  const uint64_t n = 1000000;
+  const auto s =
+      generatedSequence(n, generators::ReversedIntegers<uint32_t>(n));
+  const auto truth = [n](uint64_t i) { return uint32_t(n - 1 - i); };
+
+  EXPECT_ALLOCATED_BYTES_AT_MOST(4096, {
+    testRandomAccessIterator([&s]() { return s.begin(); },
+			     [&s]() { return s.end(); }, n, truth);
+  });
+}
+
+TEST(Iterators, InputIteratorIsSinglePass) {
+  std::istringstream input("1 2 3 4 5");
+  int starts = 0;
+  auto createIteratorAtStart = [&input, &starts]() {
+    ++starts;
+    return std::istream_iterator<int>(input);
+  };
+  auto createIteratorAtEnd = []() { return std::istream_iterator<int>(); };
+
+  testInputIterator(createIteratorAtStart, createIteratorAtEnd,
+		    std::vector<int>{ 1, 2, 3, 4, 5 });
+  EXPECT_EQ(1, starts);
+}
+
+TEST(Iterators, InputIteratorDetectsExtraElements) {
+  std::istringstream input("0 1 2 3 4");
+  auto createIteratorAtStart = [&input]() {
+    return std::istream_iterator<int>(input);
+  };
+  auto createIteratorAtEnd = []() { return std::istream_iterator<int>(); };
+
+  EXPECT_NONFATAL_FAILURE(
+      testInputIterator(createIteratorAtStart, createIteratorAtEnd, 4,
+			[](uint64_t i) { return int(i); }),
+      "did not reach the end after 4 elements"
+  );
+}
@@ -0,0 +1,103 @@
+/** @file LargeFilesTests.cpp
+ *
+ *  Unit tests for createLargeFile()
+ */
+#include <pistis/testing/LargeFiles.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <pistis/testing/TestScratch.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+using namespace pistis::testing;
+
+namespace {
+  static const uint64_t FOUR_GB = uint64_t(4) << 30;
+
+  std::string readAt(const std::string& path, uint64_t offset, size_t n) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::string data(n, '?');
+    in.seekg(std::streamoff(offset));
+    in.read(&data[0], n);
+    data.resize(size_t(in.gcount()));
+    return data;
+  }
+
+  uint64_t fileSize(const std::string& path) {
+    struct stat info;
+    return ::stat(path.c_str(), &info) ? 0 : uint64_t(info.st_size);
+  }
+}
+
+TEST(LargeFiles, CreateSparseFile) {
+  const std::vector<LargeFileRegion> regions{
+    LargeFileRegion(0, 10, "abc"),
+    LargeFileRegion(FOUR_GB - 6, 6, "xy")
+  };
+  const LargeFileInfo info = createLargeFile(
+      getTestScratchFile("sparse"), FOUR_GB, LargeFileAllocation::SPARSE,
+      regions
+  );
+
+  EXPECT_EQ(getTestScratchFile("sparse"), info.path);
+  EXPECT_EQ(FOUR_GB, info.size);
+  EXPECT_EQ(FOUR_GB, fileSize(info.path));
+  EXPECT_EQ(LargeFileAllocation::SPARSE, info.allocation);
+  EXPECT_EQ(info.honored, info.bytesAllocated < FOUR_GB);
+
+  EXPECT_EQ("abcabcabca", readAt(info.path, 0, 10));
+  EXPECT_EQ(std::string(4, '\0'), readAt(info.path, 10, 4));
+  EXPECT_EQ(std::string(4, '\0'), readAt(info.path, FOUR_GB / 2, 4));
+  EXPECT_EQ("xyxyxy", readAt(info.path, FOUR_GB - 6, 10));
+}
+
+TEST(LargeFiles, CreatePreallocatedFile) {
+  const uint64_t size = 64 * 1024 * 1024;
+  const LargeFileInfo info = createLargeFile(
+      getTestScratchFile("preallocated"), size,
+      LargeFileAllocation::PREALLOCATED
+  );
+
+  EXPECT_EQ(size, fileSize(info.path));
+  EXPECT_EQ(LargeFileAllocation::PREALLOCATED, info.allocation);
+  if (info.honored) {
+    EXPECT_LE(size, info.bytesAllocated);
+  }
+  EXPECT_EQ(std::string(8, '\0'), readAt(info.path, size - 8, 8));
+}
+
+TEST(LargeFiles, FillLargeRegion) {
+  // Larger than the fill buffer, with a pattern that does not divide it
+  const uint64_t length = 3 * 1024 * 1024 + 5;
+  const std::string pattern = "0123456";
+  const LargeFileInfo info = createLargeFile(
+      getTestScratchFile("filled"), length + 100,
+      LargeFileAllocation::SPARSE,
+      { LargeFileRegion(100, length, pattern) }
+  );
+  const std::string data = readAt(info.path, 100, size_t(length));
+
+  ASSERT_EQ(length, data.size());
+  for (size_t i = 0; i < data.size(); i += 4099) {
+    ASSERT_EQ(pattern[i % pattern.size()], data[i]) << "at " << i;
+  }
+  EXPECT_EQ(pattern[(length - 1) % pattern.size()], data.back());
+}
+
+TEST(LargeFiles, RemoveWithRemoveFile) {
+  const LargeFileInfo info = createLargeFile("LargeFilesTests.remove", 4096);
+
+  EXPECT_EQ(getScratchFile("LargeFilesTests.remove"), info.path);
+  EXPECT_EQ(4096u, fileSize(info.path));
+  removeFile("LargeFilesTests.remove");
+  EXPECT_EQ(0u, fileSize(info.path));
+}
+
+TEST(LargeFiles, RegionOutsideFile) {
+  EXPECT_THROW(createLargeFile(getTestScratchFile("bad"), 100,
+			       LargeFileAllocation::SPARSE,
+			       { LargeFileRegion(90, 11, "x") }),
+	       std::runtime_error);
+}
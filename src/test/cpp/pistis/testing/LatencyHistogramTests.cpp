@@ -0,0 +1,214 @@
+/** @file LatencyHistogramTests.cpp
+ *
+ *  Unit tests for pistis::testing::LatencyHistogram and the assertions
+ *  in LatencyAssertions.hpp
+ */
+#include <pistis/testing/LatencyAssertions.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace pistis::testing;
+
+TEST(LatencyHistogram, BucketsCoverAllValues) {
+  const LatencyHistogram h;
+  const uint64_t largest = std::numeric_limits<uint64_t>::max();
+
+  EXPECT_EQ(0, h.bucketLowerBound(0));
+  EXPECT_EQ(largest, h.bucketUpperBound(h.numBuckets() - 1));
+  for (size_t i = 1; i < h.numBuckets(); ++i) {
+    ASSERT_EQ(h.bucketUpperBound(i - 1) + 1, h.bucketLowerBound(i))
+	<< "Gap or overlap between buckets " << (i - 1) << " and " << i;
+  }
+}
+
+TEST(LatencyHistogram, BucketPrecision) {
+  const LatencyHistogram h;
+  std::vector<uint64_t> values{ 0, 1, 127, 128, 129, 1000, 123456789,
+				std::numeric_limits<uint64_t>::max() };
+  for (unsigned b = 1; b < 64; ++b) {
+    values.push_back((uint64_t(1) << b) - 1);
+    values.push_back(uint64_t(1) << b);
+  }
+
+  for (uint64_t v : values) {
+    const size_t i = h.bucketIndex(v);
+    ASSERT_LT(i, h.numBuckets()) << "for " << v;
+    EXPECT_LE(h.bucketLowerBound(i), v);
+    EXPECT_GE(h.bucketUpperBound(i), v);
+    EXPECT_LE(double(h.bucketUpperBound(i) - h.bucketLowerBound(i)),
+	      double(v) / 64.0) << "for " << v;
+  }
+}
+
+TEST(LatencyHistogram, InvalidPrecision) {
+  EXPECT_THROW(LatencyHistogram(1), std::invalid_argument);
+  EXPECT_THROW(LatencyHistogram(17), std::invalid_argument);
+}
+
+TEST(LatencyHistogram, Percentiles) {
+  LatencyHistogram h;
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    h.record(v);
+  }
+
+  EXPECT_EQ(10000, h.count());
+  EXPECT_EQ(1, h.min());
+  EXPECT_EQ(10000, h.max());
+  EXPECT_DOUBLE_EQ(5000.5, h.mean());
+  EXPECT_EQ(1, h.percentile(0.0));
+  EXPECT_NEAR(5000.0, double(h.percentile(50.0)), 5000.0 / 64.0);
+  EXPECT_LE(5000, h.percentile(50.0));
+  EXPECT_NEAR(9900.0, double(h.percentile(99.0)), 9900.0 / 64.0);
+  EXPECT_EQ(10000, h.percentile(100.0));
+}
+
+TEST(LatencyHistogram, EmptyHistogram) {
+  const LatencyHistogram h;
+
+  EXPECT_TRUE(h.empty());
+  EXPECT_EQ(0, h.min());
+  EXPECT_EQ(0, h.max());
+  EXPECT_EQ(0, h.percentile(99.0));
+  EXPECT_NONFATAL_FAILURE(EXPECT_PERCENTILE_AT_MOST(h, 99.0, 100),
+			  "No latencies were recorded");
+}
+
+TEST(LatencyHistogram, RecordMultiple) {
+  LatencyHistogram h;
+  h.record(100, 99);
+  h.record(5000, 1);
+  h.record(7, 0);
+
+  EXPECT_EQ(100, h.count());
+  EXPECT_EQ(100, h.min());
+  EXPECT_EQ(100, h.percentile(99.0));
+  EXPECT_EQ(5000, h.percentile(99.9));
+}
+
+TEST(LatencyHistogram, Merge) {
+  LatencyHistogram whole;
+  LatencyHistogram low;
+  LatencyHistogram high;
+  for (uint64_t v = 0; v < 2000; ++v) {
+    whole.record(v * 17);
+    ((v < 1000) ? low : high).record(v * 17);
+  }
+  low.merge(high);
+
+  EXPECT_EQ(whole.count(), low.count());
+  EXPECT_EQ(whole.min(), low.min());
+  EXPECT_EQ(whole.max(), low.max());
+  EXPECT_DOUBLE_EQ(whole.mean(), low.mean());
+  for (size_t i = 0; i < whole.numBuckets(); ++i) {
+    ASSERT_EQ(whole.bucketCount(i), low.bucketCount(i));
+  }
+
+  LatencyHistogram coarse(4);
+  EXPECT_THROW(low.merge(coarse), std::invalid_argument);
+}
+
+TEST(LatencyHistogram, Reset) {
+  LatencyHistogram h;
+  h.record(10);
+  h.reset();
+
+  EXPECT_TRUE(h.empty());
+  EXPECT_EQ(0, h.bucketCount(10));
+  h.record(20);
+  EXPECT_EQ(20, h.min());
+}
+
+TEST(LatencyHistogram, RecordTime) {
+  LatencyHistogram h;
+  for (int i = 0; i < 100; ++i) {
+    h.recordTime([]() { clobberMemory(); });
+  }
+
+  EXPECT_EQ(100, h.count());
+  EXPECT_GT(1000000, h.percentile(50.0));
+}
+
+TEST(LatencyHistogram, PercentileAssertion) {
+  // One spike in a thousand, like a rehash
+  LatencyHistogram h;
+  h.record(100, 999);
+  h.record(50000, 1);
+
+  EXPECT_PERCENTILE_AT_MOST(h, 99.0, 200);
+  EXPECT_NONFATAL_FAILURE(EXPECT_PERCENTILE_AT_MOST(h, 99.95, 2000),
+			  "exceeds the limit of 2000");
+}
+
+TEST(LatencyHistogram, PercentileRankIsExact) {
+  // 99.9% of 1000 samples is the 999th, which is not the spike, even
+  // though 99.9 / 100 * 1000 is slightly more than 999 in floating point
+  LatencyHistogram h;
+  h.record(100, 999);
+  h.record(50000, 1);
+
+  EXPECT_EQ(100, h.percentile(99.9));
+  EXPECT_PERCENTILE_AT_MOST(h, 99.9, 200);
+
+  // The 10 largest of 10000 samples are beyond the 99.9th percentile
+  LatencyHistogram tenSpikes;
+  tenSpikes.record(100, 9990);
+  tenSpikes.record(50000, 10);
+  EXPECT_EQ(100, tenSpikes.percentile(99.9));
+  EXPECT_EQ(50000, tenSpikes.percentile(99.91));
+}
+
+TEST(LatencyHistogram, WriteSummary) {
+  LatencyHistogram h;
+  h.record(10, 10);
+  std::ostringstream out;
+
+  out << h;
+  EXPECT_EQ("count=10 min=10 p50=10 p90=10 p99=10 p99.9=10 max=10 mean=10",
+	    out.str());
+}
+
+TEST(LatencyHistogram, SaveDistribution) {
+  LatencyHistogram h;
+  for (uint64_t v = 1; v <= 1000; ++v) {
+    h.record(v);
+  }
+
+  const std::string path = saveLatencyHistogram("Latency/Test", h);
+  ASSERT_EQ(getLatencyHistogramDir() + "/Latency_Test.hgrm", path);
+
+  std::ifstream in(path.c_str());
+  std::string header;
+  std::string line;
+  std::string last;
+  size_t rows = 0;
+  ASSERT_TRUE(std::getline(in, header));
+  EXPECT_NE(std::string::npos, header.find("Percentile"));
+  while (std::getline(in, line)) {
+    if (!line.empty() && (line[0] != '#')) {
+      ++rows;
+      last = line;
+    }
+  }
+  EXPECT_LT(10, rows);
+  EXPECT_NE(std::string::npos, last.find("1000.000"));
+  EXPECT_NE(std::string::npos, last.find("1.000000000000"));
+}
+
+TEST(LatencyHistogram, BenchmarkRecord) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+  LatencyHistogram h;
+  uint64_t value = 1;
+
+  bench::benchmark([&]() {
+      h.record(value);
+      value = value * 6364136223846793005ull + 1442695040888963407ull;
+      value >>= 40;
+    });
+  doNotOptimize(h.count());
+}
@@ -0,0 +1,153 @@
+/** @file PerfBaselineTests.cpp
+ *
+ *  Unit tests for comparing benchmark results against baselines
+ */
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <pistis/testing/PerfBaseline.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include <stdlib.h>
+
+using namespace pistis::testing;
+using namespace pistis::testing::bench;
+
+namespace {
+  Result createResult(const std::string& name,
+		      const std::vector<double>& samples) {
+    Result result;
+    result.name = name;
+    result.clock = ClockType::TSC;
+    result.iterationsPerSample = 1000;
+    result.samples = samples;
+    result.statistics = computeStatistics(samples);
+    return result;
+  }
+}
+
+TEST(PerfBaseline, ReadJson) {
+  const Result truth = createResult("a \"b\"\tc", { 1.5, 2.25, 3.0, 2.5 });
+  std::stringstream json;
+  Result result;
+
+  writeJson(json, truth);
+  ASSERT_TRUE(readJson(json, result));
+  EXPECT_EQ(truth.name, result.name);
+  EXPECT_EQ(truth.clock, result.clock);
+  EXPECT_EQ(truth.iterationsPerSample, result.iterationsPerSample);
+  EXPECT_EQ(truth.samples, result.samples);
+  EXPECT_EQ(truth.statistics.count, result.statistics.count);
+  EXPECT_DOUBLE_EQ(truth.statistics.median, result.statistics.median);
+  EXPECT_DOUBLE_EQ(truth.statistics.mad, result.statistics.mad);
+  EXPECT_DOUBLE_EQ(truth.statistics.medianHigh,
+		   result.statistics.medianHigh);
+}
+
+TEST(PerfBaseline, ReadJsonIgnoresUnknownKeysAndRecomputesStatistics) {
+  std::istringstream json(
+      "{ \"version\": [1, {\"x\": null}], \"name\": \"n\","
+      " \"samples\": [3, 1, 2], \"extra\": true }"
+  );
+  Result result;
+
+  ASSERT_TRUE(readJson(json, result));
+  EXPECT_EQ("n", result.name);
+  EXPECT_EQ(3u, result.statistics.count);
+  EXPECT_DOUBLE_EQ(2.0, result.statistics.median);
+}
+
+TEST(PerfBaseline, ReadJsonRejectsMalformedInput) {
+  std::istringstream truncated("{ \"name\": \"n\", \"samples\": [1, 2");
+  std::istringstream noSamples("{ \"name\": \"n\" }");
+  std::istringstream notAnObject("[1, 2, 3]");
+  Result result;
+
+  EXPECT_FALSE(readJson(truncated, result));
+  EXPECT_FALSE(readJson(noSamples, result));
+  EXPECT_FALSE(readJson(notAnObject, result));
+}
+
+TEST(PerfBaseline, CompareWithBaseline) {
+  // Without noise, the threshold is minSlowdown times the baseline
+  const Result baseline = createResult("b", { 100.0, 100.0, 100.0 });
+  const Result same = createResult("b", { 101.0, 101.0, 101.0 });
+  const Result slower = createResult("b", { 106.0, 106.0, 106.0 });
+  const Result faster = createResult("b", { 50.0, 50.0, 50.0 });
+  const PerfCheckOptions options(0.05, 3.0);
+
+  const BaselineComparison c1 = compareWithBaseline(baseline, same, options);
+  EXPECT_FALSE(c1.regressed);
+  EXPECT_DOUBLE_EQ(5.0, c1.threshold);
+  EXPECT_DOUBLE_EQ(1.01, c1.ratio());
+
+  EXPECT_TRUE(compareWithBaseline(baseline, slower, options).regressed);
+  EXPECT_FALSE(compareWithBaseline(baseline, faster, options).regressed);
+}
+
+TEST(PerfBaseline, ThresholdGrowsWithNoise) {
+  const Result baseline = createResult("b", { 60.0, 100.0, 140.0 });
+  const Result slower = createResult("b", { 80.0, 120.0, 160.0 });
+  const BaselineComparison c =
+      compareWithBaseline(baseline, slower, PerfCheckOptions(0.05, 3.0));
+
+  // MAD is 40 on both sides, so the noise is about 84 ns
+  EXPECT_NEAR(3.0 * 1.4826 * 40.0 * 1.41421356, c.threshold, 1e-3);
+  EXPECT_FALSE(c.regressed);
+}
+
+TEST(PerfBaseline, BaselineMode) {
+  const char* saved = getenv("PISTIS_TESTING_PERF_CHECK");
+  const std::string previous(saved ? saved : "");
+
+  unsetenv("PISTIS_TESTING_PERF_CHECK");
+  EXPECT_EQ(BaselineMode::OFF, baselineMode());
+  setenv("PISTIS_TESTING_PERF_CHECK", "0", 1);
+  EXPECT_EQ(BaselineMode::OFF, baselineMode());
+  setenv("PISTIS_TESTING_PERF_CHECK", "1", 1);
+  EXPECT_EQ(BaselineMode::CHECK, baselineMode());
+  setenv("PISTIS_TESTING_PERF_CHECK", "update", 1);
+  EXPECT_EQ(BaselineMode::UPDATE, baselineMode());
+
+  if (saved) {
+    setenv("PISTIS_TESTING_PERF_CHECK", previous.c_str(), 1);
+  } else {
+    unsetenv("PISTIS_TESTING_PERF_CHECK");
+  }
+}
+
+TEST(PerfBaseline, SaveAndLoadBaseline) {
+  const Result truth = createResult("PerfBaselineTests.SaveAndLoad",
+				    { 1.0, 2.0, 3.0 });
+  Result baseline;
+
+  EXPECT_EQ(getResourceDir() + "/benchmarks", getBaselineDir());
+  EXPECT_FALSE(loadBaseline("PerfBaselineTests.DoesNotExist", baseline));
+
+  const std::string path = saveBaseline(truth);
+  ASSERT_FALSE(path.empty());
+  EXPECT_TRUE(loadBaseline(truth.name, baseline));
+  EXPECT_EQ(truth.samples, baseline.samples);
+  removeFile(path);
+}
+
+TEST(PerfBaseline, NoteMissingBaseline) {
+  const char* saved = getenv("PISTIS_TESTING_PERF_CHECK");
+  const std::string previous(saved ? saved : "");
+  const Result result = createResult("PerfBaselineTests.DoesNotExist",
+				     { 1.0, 2.0, 3.0 });
+
+  setenv("PISTIS_TESTING_PERF_CHECK", "1", 1);
+  ::testing::internal::CaptureStdout();
+  EXPECT_TRUE(checkBaseline(result));
+  const std::string output = ::testing::internal::GetCapturedStdout();
+  EXPECT_NE(std::string::npos,
+	    output.find("NOTE: PerfBaselineTests.DoesNotExist has no "
+			"baseline"));
+
+  if (saved) {
+    setenv("PISTIS_TESTING_PERF_CHECK", previous.c_str(), 1);
+  } else {
+    unsetenv("PISTIS_TESTING_PERF_CHECK");
+  }
+}
@@ -0,0 +1,145 @@
+/** @file PerfCountersTests.cpp
+ *
+ *  Unit tests for PerfCounterScope and the assertions in
+ *  PerfCounterAssertions.hpp
+ */
+#include <pistis/testing/PerfCounterAssertions.hpp>
+#include <pistis/testing/Timing.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <sstream>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace pistis::testing;
+
+namespace {
+  // Touches each page of a fresh mapping, causing one page fault each
+  static void touchPages(size_t numPages) {
+    const size_t pageSize = 4096;
+    char* p = (char*)::mmap(nullptr, numPages * pageSize,
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, (void*)p);
+    for (size_t i = 0; i < numPages; ++i) {
+      p[i * pageSize] = 1;
+    }
+    clobberMemory();
+    ::munmap(p, numPages * pageSize);
+  }
+
+  static void spin(uint64_t nanoseconds) {
+    const uint64_t start = monotonicNanoseconds();
+    while ((monotonicNanoseconds() - start) < nanoseconds) {
+    }
+  }
+}
+
+TEST(PerfCounters, EventNames) {
+  EXPECT_STREQ("instructions", perfEventName(PerfEvent::INSTRUCTIONS));
+  EXPECT_STREQ("page-faults", perfEventName(PerfEvent::PAGE_FAULTS));
+  EXPECT_STREQ("getrusage",
+	       perfCounterSourceName(PerfCounterSource::RUSAGE));
+}
+
+TEST(PerfCounters, CountPageFaults) {
+  PerfCounterScope scope(false);
+  ASSERT_NE(PerfCounterSource::UNAVAILABLE,
+	    scope.source(PerfEvent::PAGE_FAULTS));
+
+  scope.start();
+  EXPECT_TRUE(scope.running());
+  touchPages(64);
+  scope.stop();
+  EXPECT_FALSE(scope.running());
+
+  const PerfCounts counts = scope.counts();
+  EXPECT_LE(64u, counts[PerfEvent::PAGE_FAULTS]);
+  EXPECT_GT(1000u, counts[PerfEvent::PAGE_FAULTS]);
+
+  // Counts do not change once stopped
+  touchPages(16);
+  EXPECT_EQ(counts[PerfEvent::PAGE_FAULTS],
+	    scope.counts()[PerfEvent::PAGE_FAULTS]);
+}
+
+TEST(PerfCounters, FallBackToRusage) {
+  setenv("PISTIS_TESTING_DISABLE_PERF_EVENTS", "1", 1);
+  PerfCounterScope scope;
+  unsetenv("PISTIS_TESTING_DISABLE_PERF_EVENTS");
+
+  EXPECT_EQ(PerfCounterSource::UNAVAILABLE,
+	    scope.source(PerfEvent::INSTRUCTIONS));
+  EXPECT_EQ(PerfCounterSource::RUSAGE, scope.source(PerfEvent::PAGE_FAULTS));
+  EXPECT_EQ(PerfCounterSource::RUSAGE, scope.source(PerfEvent::TASK_CLOCK));
+
+  touchPages(64);
+  spin(20000000);
+  scope.stop();
+
+  const PerfCounts counts = scope.counts();
+  EXPECT_FALSE(counts.available(PerfEvent::INSTRUCTIONS));
+  EXPECT_EQ(0u, counts[PerfEvent::INSTRUCTIONS]);
+  EXPECT_LE(64u, counts[PerfEvent::PAGE_FAULTS]);
+  EXPECT_LT(0u, counts[PerfEvent::TASK_CLOCK]);
+}
+
+TEST(PerfCounters, CountInstructions) {
+  PISTIS_SKIP_UNLESS_PERF_EVENT(PerfEvent::INSTRUCTIONS);
+  std::vector<uint64_t> data(100000, 1);
+  PerfCounterScope scope;
+  uint64_t sum = 0;
+
+  for (uint64_t x : data) {
+    sum += x;
+    doNotOptimize(sum);
+  }
+  scope.stop();
+  EXPECT_LE(100000u, scope.counts()[PerfEvent::INSTRUCTIONS]);
+  EXPECT_LT(0u, scope.counts()[PerfEvent::CYCLES]);
+}
+
+TEST(PerfCounters, PrintCounts) {
+  PerfCounts counts;
+  std::ostringstream out;
+
+  counts.set(PerfEvent::PAGE_FAULTS, 12, PerfCounterSource::SOFTWARE);
+  counts.set(PerfEvent::CYCLES, 34, PerfCounterSource::HARDWARE);
+  out << counts;
+  EXPECT_EQ("cycles=34 page-faults=12", out.str());
+  EXPECT_DOUBLE_EQ(3.0, counts.perElement(PerfEvent::PAGE_FAULTS, 4));
+}
+
+TEST(PerfCounters, CheckPerElement) {
+  PerfCounts counts;
+  counts.set(PerfEvent::L1D_MISSES, 100, PerfCounterSource::HARDWARE);
+
+  EXPECT_TRUE(checkPerfCountPerElementAtMost(counts, PerfEvent::L1D_MISSES,
+					     1000, 0.1));
+  EXPECT_FALSE(checkPerfCountPerElementAtMost(counts, PerfEvent::L1D_MISSES,
+					      1000, 0.05));
+  EXPECT_TRUE(checkPerfCountAtMost(counts, PerfEvent::L1D_MISSES, 100));
+  EXPECT_FALSE(checkPerfCountAtMost(counts, PerfEvent::L1D_MISSES, 99));
+
+  // Unavailable events pass
+  EXPECT_TRUE(checkPerfCountAtMost(counts, PerfEvent::INSTRUCTIONS, 0));
+}
+
+TEST(PerfCounters, Macros) {
+  EXPECT_PERF_COUNT_PER_ELEMENT_AT_MOST(PerfEvent::PAGE_FAULTS, 64, 8.0,
+					touchPages(64));
+  EXPECT_PERF_COUNT_AT_MOST(PerfEvent::INSTRUCTIONS, 1000000, {
+      int x = 0;
+      doNotOptimize(x);
+    });
+}
+
+TEST(PerfCounters, MacrosReportFailures) {
+  EXPECT_NONFATAL_FAILURE(
+      EXPECT_PERF_COUNT_AT_MOST(PerfEvent::PAGE_FAULTS, 1, touchPages(64)),
+      "page-faults"
+  );
+}
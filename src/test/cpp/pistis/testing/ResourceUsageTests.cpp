@@ -0,0 +1,162 @@
+/** @file ResourceUsageTests.cpp
+ *
+ *  Unit tests for the functions in ResourceUsage.hpp and
+ *  ResourceUsageListener.hpp
+ */
+#include <pistis/testing/ResourceUsageListener.hpp>
+#include <pistis/testing/Timing.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+using namespace pistis::testing;
+
+// "make resource-report" runs the unit tests with the listener
+PISTIS_TESTING_REGISTER_RESOURCE_USAGE_LISTENER();
+
+namespace {
+  TestResourceUsage testUsage(const std::string& name, uint64_t wallTime,
+			      uint64_t peakRss) {
+    TestResourceUsage t;
+    t.suite = "Suite";
+    t.name = name;
+    t.passed = true;
+    t.usage.wallTime = wallTime;
+    t.usage.peakRss = peakRss;
+    t.usage.majorFaults = 1;
+    return t;
+  }
+}
+
+TEST(ResourceUsage, Current) {
+  const ResourceUsage start = ResourceUsage::current();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const ResourceUsage end = ResourceUsage::current();
+  const ResourceUsage used = ResourceUsage::difference(start, end);
+
+  EXPECT_LT(0, start.rss);
+  EXPECT_LE(start.rss, start.peakRss);
+  EXPECT_LE(10000000, used.wallTime);
+  EXPECT_LE(start.minorFaults, end.minorFaults);
+}
+
+TEST(ResourceUsage, PeakRssAndFaults) {
+  if (!resetPeakRss()) {
+    GTEST_SKIP() << "Cannot reset the peak resident set size";
+  }
+
+  const size_t size = 32 << 20;
+  const ResourceUsage start = ResourceUsage::current();
+  {
+    std::unique_ptr<char[]> buffer(new char[size]);
+    memset(buffer.get(), 1, size);
+    doNotOptimize(buffer[size - 1]);
+  }
+  const ResourceUsage used =
+      ResourceUsage::difference(start, ResourceUsage::current());
+
+  EXPECT_LE(size / 2, used.peakRss);
+  EXPECT_LE(size / 2 / 4096, used.minorFaults);
+}
+
+TEST(ResourceUsage, RssDeltaIsSigned) {
+  ResourceUsage start;
+  ResourceUsage end;
+  start.rss = 3 << 20;
+  start.peakRssReset = true;
+  end.rss = 1 << 20;
+  end.peakRss = 4 << 20;
+
+  const ResourceUsage used = ResourceUsage::difference(start, end);
+  EXPECT_EQ(1 << 20, used.rss);
+  EXPECT_EQ(-(2 << 20), used.rssDelta);
+  EXPECT_EQ(1 << 20, used.peakRss);
+  EXPECT_TRUE(used.peakRssReset);
+}
+
+TEST(ResourceUsage, CountAllocations) {
+  hooks::enableGlobalAllocationCounting();
+  const ResourceUsage start = ResourceUsage::current();
+  std::vector<std::unique_ptr<int>> values;
+  values.reserve(10);
+  for (int i = 0; i < 10; ++i) {
+    values.emplace_back(new int(i));
+  }
+  const ResourceUsage end = ResourceUsage::current();
+  hooks::disableGlobalAllocationCounting();
+
+  const ResourceUsage used = ResourceUsage::difference(start, end);
+  EXPECT_TRUE(used.allocationsCounted);
+  EXPECT_LE(11, used.allocations);
+  EXPECT_LE(10 * sizeof(int), used.bytesAllocated);
+}
+
+TEST(ResourceUsage, ReportJson) {
+  ResourceUsageReport report;
+  report.add(testUsage("Fast", 1000, 0));
+  report.add(testUsage("Slow\"Test", 5000000, 1 << 20));
+  std::ostringstream out;
+
+  report.writeJson(out);
+  const std::string json = out.str();
+  EXPECT_NE(std::string::npos, json.find("\"name\": \"Slow\\\"Test\""));
+  EXPECT_NE(std::string::npos, json.find("\"peakRssDelta\": 1048576"));
+  EXPECT_NE(std::string::npos, json.find("\"peakRssReset\": false"));
+  EXPECT_NE(std::string::npos, json.find("\"rssDelta\": 0"));
+  EXPECT_NE(std::string::npos, json.find("\"total\": {"));
+  EXPECT_NE(std::string::npos, json.find("\"wallTime\": 5001000"));
+  EXPECT_EQ(std::string::npos, json.find("allocations"));
+
+  EXPECT_EQ(2, report.total().majorFaults);
+  report.clear();
+  EXPECT_TRUE(report.tests().empty());
+}
+
+TEST(ResourceUsage, ReportSummary) {
+  ResourceUsageReport report;
+  report.add(testUsage("A", 2000000, 3 << 20));
+  report.add(testUsage("B", 9000000, 1 << 20));
+  report.add(testUsage("C", 5000000, 2 << 20));
+  std::ostringstream out;
+
+  report.writeSummary(out, 2);
+  const std::string summary = out.str();
+  const size_t slowest = summary.find("Slowest tests");
+  const size_t largest = summary.find("Largest peak memory");
+  ASSERT_NE(std::string::npos, slowest);
+  ASSERT_NE(std::string::npos, largest);
+
+  // B, then C, are the slowest; A, then C, use the most memory
+  const std::string slow = summary.substr(slowest, largest - slowest);
+  const std::string hungry = summary.substr(largest);
+  EXPECT_LT(slow.find("Suite.B"), slow.find("Suite.C"));
+  EXPECT_EQ(std::string::npos, slow.find("Suite.A"));
+  EXPECT_LT(hungry.find("Suite.A"), hungry.find("Suite.C"));
+  EXPECT_EQ(std::string::npos, hungry.find("Suite.B"));
+  EXPECT_NE(std::string::npos, summary.find("9.000 ms"));
+}
+
+TEST(ResourceUsage, Listener) {
+  const ::testing::TestInfo* info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  ResourceUsageListener listener("", true, 0);
+
+  listener.OnTestStart(*info);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  std::unique_ptr<int> p(new int(1));
+  listener.OnTestEnd(*info);
+  const bool canResetPeakRss = resetPeakRss();
+
+  ASSERT_EQ(1, listener.report().tests().size());
+  const TestResourceUsage& t = listener.report().tests()[0];
+  EXPECT_EQ("ResourceUsage.Listener", t.fullName());
+  EXPECT_TRUE(t.passed);
+  EXPECT_LE(2000000, t.usage.wallTime);
+  EXPECT_EQ(canResetPeakRss, t.usage.peakRssReset);
+  EXPECT_TRUE(t.usage.allocationsCounted);
+  EXPECT_LE(1, t.usage.allocations);
+}
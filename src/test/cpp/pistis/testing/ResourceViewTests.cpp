@@ -0,0 +1,94 @@
+/** @file ResourceViewTests.cpp
+ *
+ *  Unit tests for ResourceView
+ */
+#include <pistis/testing/ResourceView.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace pistis::testing;
+
+namespace {
+  std::string writeScratchFile(const std::string& name,
+			       const std::string& content) {
+    makeDirectories(getScratchDir());
+    const std::string path = getScratchFile(name);
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+    return path;
+  }
+}
+
+TEST(ResourceView, EmptyView) {
+  ResourceView view;
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(0u, view.size());
+  EXPECT_EQ(view.begin(), view.end());
+  EXPECT_EQ("", view.path());
+}
+
+TEST(ResourceView, MapResource) {
+  const std::string path =
+      writeScratchFile("ResourceViewTests.MapResource", "Hello, world!");
+  const ResourceView view = mapResource(path, ResourceAccess::SEQUENTIAL);
+
+  ASSERT_EQ(13u, view.size());
+  EXPECT_FALSE(view.empty());
+  EXPECT_EQ("Hello, world!", view.toString());
+  EXPECT_EQ('H', view[0]);
+  EXPECT_EQ(std::string(view.begin(), view.end()), view.toString());
+  view.advise(ResourceAccess::RANDOM);
+  removeFile(path);
+}
+
+TEST(ResourceView, ViewsShareMappings) {
+  const std::string path =
+      writeScratchFile("ResourceViewTests.ViewsShareMappings", "abcdef");
+  const size_t mappingsAtStart = ResourceView::numMappings();
+
+  {
+    ResourceView first(path);
+    ResourceView second(path, ResourceAccess::RANDOM);
+    ResourceView copy(first);
+
+    EXPECT_EQ(first.data(), second.data());
+    EXPECT_EQ(first.data(), copy.data());
+    EXPECT_EQ(mappingsAtStart + 1, ResourceView::numMappings());
+  }
+
+  EXPECT_EQ(mappingsAtStart, ResourceView::numMappings());
+  removeFile(path);
+}
+
+TEST(ResourceView, RemapChangedFiles) {
+  const std::string path =
+      writeScratchFile("ResourceViewTests.RemapChangedFiles", "old");
+  const ResourceView before(path);
+
+  writeScratchFile("ResourceViewTests.RemapChangedFiles", "longer");
+  const ResourceView after(path);
+
+  EXPECT_EQ("longer", after.toString());
+  EXPECT_NE(before.data(), after.data());
+  removeFile(path);
+}
+
+TEST(ResourceView, MapEmptyFile) {
+  const std::string path =
+      writeScratchFile("ResourceViewTests.MapEmptyFile", "");
+  const ResourceView view(path);
+
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ("", view.toString());
+  EXPECT_NE("", view.path());
+  removeFile(path);
+}
+
+TEST(ResourceView, MissingResource) {
+  EXPECT_THROW(ResourceView("ResourceViewTests/does-not-exist"),
+	       std::runtime_error);
+}
@@ -0,0 +1,211 @@
+/** @file StressTests.cpp
+ *
+ *  Unit tests for the stress test driver in Stress.hpp and the
+ *  assertions in StressAssertions.hpp
+ */
+#include <pistis/testing/StressAssertions.hpp>
+#include <pistis/testing/BenchmarkTest.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace pistis::testing;
+using namespace pistis::testing::stress;
+
+namespace {
+  StressResult syntheticResult(const std::vector<uint64_t>& operations,
+			       uint64_t elapsed) {
+    StressResult result;
+    result.operationNames.push_back("op");
+    result.elapsed = elapsed;
+    for (uint64_t n : operations) {
+      ThreadResult t;
+      t.operations = n;
+      t.operationCounts.push_back(n);
+      t.elapsed = elapsed;
+      t.cpu = -1;
+      result.threads.push_back(t);
+    }
+    return result;
+  }
+}
+
+TEST(Stress, SpinBarrierReleasesAllThreads) {
+  const size_t numThreads = 4;
+  const int rounds = 100;
+  SpinBarrier barrier(numThreads);
+  std::atomic<int> arrived(0);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < numThreads; ++i) {
+    threads.emplace_back([&]() {
+      for (int r = 0; r < rounds; ++r) {
+	arrived.fetch_add(1);
+	barrier.wait();
+	if (arrived.load() < int(numThreads) * (r + 1)) {
+	  errors.fetch_add(1);
+	}
+	barrier.wait();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(int(numThreads) * rounds, arrived.load());
+  EXPECT_EQ(0, errors.load());
+}
+
+TEST(Stress, RunFixedOperationCount) {
+  std::atomic<uint64_t> reads(0);
+  std::atomic<uint64_t> writes(0);
+  const std::vector<Operation> operations{
+    Operation("read", 9, [&reads](size_t) { reads.fetch_add(1); }),
+    Operation("write", 1, [&writes](size_t) { writes.fetch_add(1); })
+  };
+  StressOptions options;
+  options.threads = 3;
+  options.operationsPerThread = 10000;
+
+  const StressResult result = run(operations, options);
+  ASSERT_EQ(3, result.threads.size());
+  EXPECT_EQ(std::vector<std::string>({ "read", "write" }),
+	    result.operationNames);
+  EXPECT_EQ(30000, result.totalOperations());
+  EXPECT_EQ(reads.load(), result.operationCount(0));
+  EXPECT_EQ(writes.load(), result.operationCount(1));
+  EXPECT_NEAR(0.9, double(reads.load()) / 30000.0, 0.02);
+  for (const auto& t : result.threads) {
+    EXPECT_EQ(10000, t.operations);
+    EXPECT_EQ(-1, t.cpu);
+  }
+  EXPECT_LT(0.0, result.throughput());
+
+  // The same seed runs the same mix of operations on each thread
+  const StressResult again = run(operations, options);
+  for (size_t i = 0; i < result.threads.size(); ++i) {
+    EXPECT_EQ(result.threads[i].operationCounts,
+	      again.threads[i].operationCounts);
+  }
+}
+
+TEST(Stress, RunForDuration) {
+  std::atomic<uint64_t> count(0);
+  StressOptions options;
+  options.threads = 2;
+  options.duration = 20000000;
+
+  const StressResult result = run(
+      { Operation("count", 1, [&count](size_t) { count.fetch_add(1); }) },
+      options
+  );
+  EXPECT_LE(options.duration, result.elapsed);
+  EXPECT_EQ(count.load(), result.totalOperations());
+  EXPECT_LT(0, result.totalOperations());
+}
+
+TEST(Stress, PinThreads) {
+  StressOptions options;
+  options.threads = 2;
+  options.operationsPerThread = 10;
+  options.pinThreads = true;
+
+  const StressResult result = run({ Operation("nop", 1, [](size_t) { }) },
+				  options);
+  for (const auto& t : result.threads) {
+    EXPECT_LE(0, t.cpu);
+  }
+}
+
+TEST(Stress, RethrowsOperationFailure) {
+  std::atomic<int> calls(0);
+  StressOptions options;
+  options.threads = 2;
+  options.duration = 10000000000ull;
+  const std::vector<Operation> operations{
+    Operation("fail", 1, [&calls](size_t) {
+      if (calls.fetch_add(1) == 100) {
+	throw std::runtime_error("operation failed");
+      }
+    })
+  };
+
+  EXPECT_THROW(run(operations, options), std::runtime_error);
+}
+
+TEST(Stress, RejectsInvalidMix) {
+  const auto nop = [](size_t) { };
+
+  EXPECT_THROW(run({ }), std::invalid_argument);
+  EXPECT_THROW(run({ Operation("a", -1, nop) }), std::invalid_argument);
+  EXPECT_THROW(run({ Operation("a", 0, nop), Operation("b", 0, nop) }),
+	       std::invalid_argument);
+}
+
+TEST(Stress, FairnessAndScaling) {
+  const StressResult one = syntheticResult({ 1000 }, 1000000000);
+  const StressResult even = syntheticResult({ 1000, 1000 }, 1000000000);
+  const StressResult skewed = syntheticResult({ 1500, 0, 0 }, 1000000000);
+
+  EXPECT_DOUBLE_EQ(1.0, even.fairness());
+  EXPECT_DOUBLE_EQ(1.0 / 3.0, skewed.fairness());
+  EXPECT_DOUBLE_EQ(2000.0, even.throughput());
+  EXPECT_DOUBLE_EQ(1.0, scalingEfficiency(one, even));
+  EXPECT_DOUBLE_EQ(0.5, scalingEfficiency(one, skewed));
+
+  EXPECT_FAIRNESS_AT_LEAST(even, 0.99);
+  EXPECT_NONFATAL_FAILURE(EXPECT_FAIRNESS_AT_LEAST(skewed, 0.5),
+			  "Fairness");
+}
+
+TEST(Stress, ScalingCheckSkipsOversubscribedRuns) {
+  // More threads than any test machine has processors
+  const std::vector<uint64_t> perThread(4096, 1);
+  const std::vector<StressResult> results{
+    syntheticResult({ 1000 }, 1000000000),
+    syntheticResult(perThread, 1000000000)
+  };
+
+  EXPECT_SCALING_EFFICIENCY_AT_LEAST(results, 0.9);
+}
+
+TEST(Stress, PrintResult) {
+  const StressResult result = syntheticResult({ 1000, 3000 }, 1000000000);
+  std::ostringstream out;
+
+  printStressResult(out, result);
+  EXPECT_NE(std::string::npos, out.str().find("4000 operations"));
+  EXPECT_NE(std::string::npos, out.str().find("fairness 0.800"));
+}
+
+TEST(Stress, BenchmarkIndependentCounters) {
+  PISTIS_SKIP_UNLESS_BENCHMARKING();
+
+  // Threads that share nothing should scale almost linearly
+  struct alignas(128) Counter { uint64_t value; };
+  std::vector<Counter> counters(64);
+  std::vector<size_t> threadCounts;
+  for (size_t n = 1; n <= std::min(availableProcessors(), size_t(8)); n *= 2) {
+    threadCounts.push_back(n);
+  }
+
+  StressOptions options;
+  options.pinThreads = true;
+  const auto results = runScaling(
+      { Operation("increment", 1, [&counters](size_t thread) {
+	  doNotOptimize(++counters[thread].value);
+	}) },
+      threadCounts, options
+  );
+  for (const auto& r : results) {
+    reportStressResult("IndependentCounters", r);
+  }
+  EXPECT_SCALING_EFFICIENCY_AT_LEAST(results, 0.5);
+  EXPECT_FAIRNESS_AT_LEAST(results.back(), 0.8);
+}
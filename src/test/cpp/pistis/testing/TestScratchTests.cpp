@@ -0,0 +1,151 @@
+/** @file TestScratchTests.cpp
+ *
+ *  Unit tests for per-test scratch directories and removeTree()
+ */
+#include <pistis/testing/TestScratch.hpp>
+#include <pistis/testing/Resources.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pistis::testing;
+
+namespace {
+  bool exists(const std::string& path) {
+    struct stat info;
+    return !::lstat(path.c_str(), &info);
+  }
+
+  void writeFile(const std::string& path) {
+    std::ofstream out(path.c_str());
+    out << path;
+  }
+
+  // Set by CreateScratchDir, checked by RemoveScratchDirAtTestEnd
+  std::string previousTestScratchDir;
+}
+
+TEST(TestScratch, CreateScratchDir) {
+  const std::string dir = getTestScratchDir();
+  const std::string expected = getScratchDir() + "/" +
+      std::to_string(::getpid()) + "/TestScratch.CreateScratchDir";
+
+  EXPECT_EQ(expected, dir);
+  EXPECT_TRUE(exists(dir));
+  EXPECT_EQ(dir, getTestScratchDir());
+  EXPECT_EQ(dir + "/data.txt", getTestScratchFile("data.txt"));
+  EXPECT_EQ("/abs/path", getTestScratchFile("/abs/path"));
+
+  writeFile(getTestScratchFile("data.txt"));
+  EXPECT_TRUE(exists(dir + "/data.txt"));
+  previousTestScratchDir = dir;
+}
+
+TEST(TestScratch, RemoveScratchDirAtTestEnd) {
+  if (previousTestScratchDir.empty()) {
+    GTEST_SKIP() << "Run with TestScratch.CreateScratchDir";
+  }
+  EXPECT_FALSE(exists(previousTestScratchDir));
+}
+
+namespace {
+  // Writes a file outside of any test, which both of its tests read
+  class TestScratchSuite : public ::testing::Test {
+  protected:
+    static std::string suiteFile;
+
+    static void SetUpTestSuite() {
+      suiteFile = getTestScratchFile("suite.txt");
+      writeFile(suiteFile);
+    }
+  };
+
+  std::string TestScratchSuite::suiteFile;
+}
+
+TEST_F(TestScratchSuite, FirstTestSeesSuiteFile) {
+  EXPECT_NE(std::string::npos, suiteFile.find("/_no_test/"));
+  EXPECT_TRUE(exists(suiteFile));
+}
+
+TEST_F(TestScratchSuite, SecondTestSeesSuiteFile) {
+  EXPECT_TRUE(exists(suiteFile));
+}
+
+TEST(TestScratch, TmpfsScratchDir) {
+  const std::string dir = getTestScratchDir(ScratchStorage::TMPFS);
+
+  EXPECT_EQ(0u, dir.find(getTmpfsScratchDir() + "/"));
+  EXPECT_NE(std::string::npos, dir.find("TestScratch.TmpfsScratchDir"));
+  EXPECT_TRUE(exists(dir));
+  EXPECT_NE(dir, getTestScratchDir(ScratchStorage::DISK));
+}
+
+TEST(TestScratch, RemoveTree) {
+  const std::string root = getTestScratchFile("tree");
+  const std::string outside = getTestScratchFile("outside");
+
+  ASSERT_TRUE(makeDirectories(root + "/a/b/c"));
+  ASSERT_TRUE(makeDirectories(root + "/d"));
+  ASSERT_TRUE(makeDirectories(outside));
+  for (int i = 0; i < 100; ++i) {
+    writeFile(root + "/a/b/c/" + std::to_string(i));
+    writeFile(root + "/d/" + std::to_string(i));
+  }
+  writeFile(root + "/top");
+  writeFile(outside + "/keep");
+  ASSERT_EQ(0, ::symlink(outside.c_str(), (root + "/link").c_str()));
+
+  EXPECT_TRUE(removeTree(root));
+  EXPECT_FALSE(exists(root));
+
+  // Symbolic links are removed, not followed
+  EXPECT_TRUE(exists(outside + "/keep"));
+
+  // Removing something that does not exist succeeds
+  EXPECT_TRUE(removeTree(root));
+}
+
+TEST(TestScratch, RemoveTreeRemovesFiles) {
+  const std::string file = getTestScratchFile("file");
+  writeFile(file);
+
+  EXPECT_TRUE(removeTree(file));
+  EXPECT_FALSE(exists(file));
+}
+
+TEST(TestScratch, RemoveTreeRejectsRoots) {
+  const std::string dir = getTestScratchDir();
+
+  EXPECT_THROW(removeTree(""), std::invalid_argument);
+  EXPECT_THROW(removeTree("."), std::invalid_argument);
+  EXPECT_THROW(removeTree("a/.."), std::invalid_argument);
+  EXPECT_THROW(removeTree("/"), std::invalid_argument);
+  EXPECT_THROW(removeTree("//./"), std::invalid_argument);
+  EXPECT_THROW(removeTree("/tmp/../.."), std::invalid_argument);
+  EXPECT_THROW(removeTree(".."), std::invalid_argument);
+  EXPECT_THROW(removeTree(getScratchDir()), std::invalid_argument);
+  EXPECT_THROW(removeTree(getScratchDir() + "/"), std::invalid_argument);
+  EXPECT_THROW(removeTree(getScratchDir() + "/a/../."),
+	       std::invalid_argument);
+  EXPECT_THROW(removeTree(getScratchDir() + "/.."), std::invalid_argument);
+  EXPECT_TRUE(exists(dir));
+  EXPECT_TRUE(exists(getScratchDir()));
+}
+
+TEST(TestScratch, TmpfsScratchDirIsPrivate) {
+  struct stat info;
+  const std::string dir = getTmpfsScratchDir();
+
+  if (dir.find("/dev/shm/")) {
+    GTEST_SKIP() << "The tmpfs scratch directory is not in /dev/shm";
+  }
+  ASSERT_EQ(0, ::lstat(dir.c_str(), &info));
+  EXPECT_TRUE(S_ISDIR(info.st_mode));
+  EXPECT_EQ(::getuid(), info.st_uid);
+  EXPECT_EQ(0, info.st_mode & (S_IWGRP | S_IWOTH));
+}
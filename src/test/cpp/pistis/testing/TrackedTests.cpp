@@ -0,0 +1,193 @@
+/** @file TrackedTests.cpp
+ *
+ *  Unit tests for pistis::testing::Tracked and the assertions in
+ *  TrackedAssertions.hpp
+ */
+#include <pistis/testing/Tracked.hpp>
+#include <pistis/testing/TrackedAssertions.hpp>
+#include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace pistis::testing;
+
+namespace {
+  // Its move constructor may throw, so std::vector copies it when it
+  // grows instead of moving it
+  struct ThrowingMove {
+    int value;
+
+    ThrowingMove(int v): value(v) { }
+    ThrowingMove(const ThrowingMove& other): value(other.value) { }
+    ThrowingMove(ThrowingMove&& other): value(other.value) { }
+    ThrowingMove& operator=(const ThrowingMove&) = default;
+  };
+
+  std::vector< Tracked<std::string> > makeNames(size_t n) {
+    std::vector< Tracked<std::string> > names;
+    names.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      names.emplace_back("name-" + std::to_string((i * 7919) % n));
+    }
+    return names;
+  }
+
+  void copyTwice() {
+    static const Tracked<int> original(1);
+    ASSERT_COPIES_AT_MOST(1, {
+      Tracked<int> first(original);
+      Tracked<int> second(original);
+    });
+  }
+}
+
+TEST(Tracked, CountSpecialMembers) {
+  const std::shared_ptr<TrackedLedger> ledger =
+      std::make_shared<TrackedLedger>();
+  {
+    Tracked<int> a(1, ledger);
+    Tracked<int> b(a);
+    Tracked<int> c(std::move(a));
+    Tracked<int> d(4, ledger);
+
+    d = b;
+    d = std::move(c);
+    EXPECT_EQ(1, *d);
+    EXPECT_EQ(4, ledger->counts().live());
+  }
+
+  const TrackedCounts counts = ledger->counts();
+  EXPECT_EQ(2, counts.constructions);
+  EXPECT_EQ(1, counts.copyConstructions);
+  EXPECT_EQ(1, counts.moveConstructions);
+  EXPECT_EQ(1, counts.copyAssignments);
+  EXPECT_EQ(1, counts.moveAssignments);
+  EXPECT_EQ(4, counts.destructions);
+  EXPECT_EQ(2, counts.copies());
+  EXPECT_EQ(2, counts.moves());
+  EXPECT_EQ(0, counts.live());
+
+  ledger->reset();
+  EXPECT_EQ(0, ledger->counts().constructions);
+  EXPECT_EQ(0, ledger->counts().destructions);
+}
+
+TEST(Tracked, CopiesShareLedger) {
+  const std::shared_ptr<TrackedLedger> ledger =
+      std::make_shared<TrackedLedger>();
+  Tracked<int> a(1, ledger);
+  Tracked<int> b(a);
+  Tracked<int> c;
+
+  EXPECT_EQ(ledger, b.ledger());
+  EXPECT_EQ(TrackedLedger::global(), c.ledger());
+
+  // Assignment keeps the target's ledger
+  c = b;
+  EXPECT_EQ(TrackedLedger::global(), c.ledger());
+  EXPECT_EQ(0, ledger->counts().copyAssignments);
+}
+
+TEST(Tracked, MovedFrom) {
+  Tracked<std::string> a(std::string("value"));
+  Tracked<std::string> b(std::move(a));
+
+  EXPECT_TRUE(a.movedFrom());
+  EXPECT_FALSE(b.movedFrom());
+  EXPECT_EQ("value", b.value());
+
+  a = b;
+  EXPECT_FALSE(a.movedFrom());
+  b = std::move(a);
+  EXPECT_TRUE(a.movedFrom());
+}
+
+TEST(Tracked, CompareAndWrite) {
+  std::ostringstream out;
+
+  EXPECT_TRUE(track(1) < track(2));
+  EXPECT_TRUE(track(2) == track(2));
+  EXPECT_TRUE(track(2) != track(3));
+  EXPECT_TRUE(track(3) >= track(2));
+
+  out << track(std::string("abc"));
+  EXPECT_EQ("abc", out.str());
+}
+
+TEST(Tracked, WriteCounts) {
+  TrackedCounts counts;
+  std::ostringstream out;
+
+  counts.constructions = 1;
+  counts.copyConstructions = 2;
+  counts.moveConstructions = 0;
+  counts.copyAssignments = 1;
+  counts.moveAssignments = 3;
+  counts.destructions = 2;
+  out << counts;
+  EXPECT_EQ("1 construction, 2 copy constructions, 0 move constructions, "
+	    "1 copy assignment, 3 move assignments, 2 destructions",
+	    out.str());
+}
+
+TEST(Tracked, VectorGrowthMoves) {
+  std::vector< Tracked<std::string> > v;
+
+  EXPECT_NO_COPIES({
+    for (int i = 0; i < 100; ++i) {
+      v.push_back(track(std::to_string(i)));
+    }
+  });
+  EXPECT_MOVES_AT_MOST(v.size(), v.reserve(2 * v.capacity()));
+  EXPECT_NO_COPIES(v.resize(10));
+}
+
+TEST(Tracked, VectorGrowthCopiesThrowingMoves) {
+  std::vector< Tracked<ThrowingMove> > v;
+
+  v.push_back(track(ThrowingMove(1)));
+  v.push_back(track(ThrowingMove(2)));
+  EXPECT_NONFATAL_FAILURE(EXPECT_NO_COPIES(v.reserve(2 * v.capacity())),
+			  "2 copies exceeds the budget of 0 copies");
+}
+
+TEST(Tracked, SortDoesNotCopy) {
+  std::vector< Tracked<std::string> > names = makeNames(1000);
+
+  EXPECT_NO_COPIES(std::sort(names.begin(), names.end()));
+  EXPECT_TRUE(std::is_sorted(names.begin(), names.end()));
+  EXPECT_NO_COPIES({
+    for (const auto& name : names) {
+      EXPECT_FALSE(name->empty());
+    }
+  });
+  EXPECT_NONFATAL_FAILURE(
+      EXPECT_NO_COPIES({
+	for (auto name : names) {
+	  EXPECT_FALSE(name->empty());
+	}
+      }),
+      "1000 copies exceeds the budget of 0 copies"
+  );
+}
+
+TEST(Tracked, FailingAssertions) {
+  const Tracked<int> original(1);
+  Tracked<int> source(2);
+
+  EXPECT_NONFATAL_FAILURE(EXPECT_COPIES_AT_MOST(1, {
+			    Tracked<int> first(original);
+			    Tracked<int> second(original);
+			  }),
+			  "2 copies exceeds the budget of 1 copies");
+  EXPECT_NONFATAL_FAILURE(
+      EXPECT_MOVES_AT_MOST(0, Tracked<int> moved(std::move(source))),
+      "exceeds the budget of 0 moves"
+  );
+  EXPECT_FATAL_FAILURE(copyTwice(), "2 copies exceeds the budget of 1 copies");
+}
@@ -0,0 +1,241 @@
+/** @file replay_allocation_trace.cpp
+ *
+ *  Replays allocation traces written by AllocationTraceWriter against
+ *  one or more allocation strategies and reports the throughput and
+ *  fragmentation of each.
+ *
+ *  A shared library can supply its own strategy by exporting
+ *
+ *  @code
+ *  extern "C" pistis::testing::AllocationStrategy*
+ *      pistis_testing_create_allocation_strategy();
+ *  @endcode
+ *
+ *  which returns a new strategy allocated with operator new.  The
+ *  function is called once per replay pass.  If it returns null, the
+ *  replay against that library fails.
+ */
+#include <pistis/testing/AllocationStrategy.hpp>
+#include <pistis/testing/AllocationTrace.hpp>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <string.h>
+
+using namespace pistis::testing;
+
+namespace {
+  typedef std::function<std::shared_ptr<AllocationStrategy> ()>
+      StrategyFactory;
+
+  typedef AllocationStrategy* (*LibraryFactory)();
+
+  struct NamedStrategy {
+    std::string name;
+    StrategyFactory create;
+  };
+
+  static const char LIBRARY_FACTORY_NAME[] =
+      "pistis_testing_create_allocation_strategy";
+
+  static void usage(std::ostream& out) {
+    out << "Usage: replay_allocation_trace [options] <trace> [<trace> ...]\n"
+	<< "\n"
+	<< "Options:\n"
+	<< "  -a, --allocator <name>  Replay against a built-in allocator.\n"
+	<< "                          One of malloc, arena, aligned,\n"
+	<< "                          misaligned, hugepage or randomized.\n"
+	<< "                          May be repeated.\n"
+	<< "  -l, --library <path>    Replay against the allocator a shared\n"
+	<< "                          library creates with\n"
+	<< "                          " << LIBRARY_FACTORY_NAME << "().\n"
+	<< "                          May be repeated.\n"
+	<< "  -h, --help              Print this message\n"
+	<< "\n"
+	<< "Replays against malloc and arena if no allocator is given."
+	<< std::endl;
+  }
+
+  static bool builtInStrategy(const std::string& name,
+			      NamedStrategy& strategy) {
+    strategy.name = name;
+    if (name == "malloc") {
+      strategy.create = []() {
+	return std::make_shared<SystemAllocation>();
+      };
+    } else if (name == "arena") {
+      strategy.create = []() {
+	return std::make_shared<ArenaAllocation>();
+      };
+    } else if (name == "aligned") {
+      strategy.create = []() {
+	return std::make_shared<AlignedAllocation>();
+      };
+    } else if (name == "misaligned") {
+      strategy.create = []() {
+	return std::make_shared<MisalignedAllocation>();
+      };
+    } else if (name == "hugepage") {
+      strategy.create = []() {
+	return std::make_shared<HugePageAllocation>();
+      };
+    } else if (name == "randomized") {
+      strategy.create = []() {
+	return std::make_shared<RandomizedAllocation>(1);
+      };
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static bool libraryStrategy(const std::string& path,
+			      NamedStrategy& strategy) {
+    // The library stays loaded until the program exits
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+      std::cerr << "Cannot load " << path << ": " << dlerror() << std::endl;
+      return false;
+    }
+
+    LibraryFactory factory = reinterpret_cast<LibraryFactory>(
+	dlsym(library, LIBRARY_FACTORY_NAME)
+    );
+    if (!factory) {
+      std::cerr << path << " does not export " << LIBRARY_FACTORY_NAME
+		<< "()" << std::endl;
+      return false;
+    }
+
+    strategy.name = path;
+    strategy.create = [factory]() {
+      AllocationStrategy* s = factory();
+      if (!s) {
+	throw std::runtime_error(
+	    std::string(LIBRARY_FACTORY_NAME) + "() returned null"
+	);
+      }
+      return std::shared_ptr<AllocationStrategy>(s);
+    };
+    return true;
+  }
+
+  static void printSummary(const std::string& filename,
+			   const std::vector<AllocationEvent>& events) {
+    std::set<uint32_t> threads;
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t callSites = 0;
+
+    for (const AllocationEvent& e : events) {
+      if (e.type == AllocationEventType::ALLOCATE) {
+	++allocations;
+	threads.insert(e.thread);
+      } else if (e.type == AllocationEventType::DEALLOCATE) {
+	++deallocations;
+	threads.insert(e.thread);
+      } else {
+	++callSites;
+      }
+    }
+    std::cout << filename << ": " << allocations << " allocations, "
+	      << deallocations << " deallocations, " << callSites
+	      << " call sites, " << threads.size() << " threads"
+	      << std::endl;
+  }
+
+  static void printResult(const std::string& name,
+			  const AllocationReplayResult& result) {
+    std::cout << std::setw(24) << std::left << name << std::right
+	      << std::fixed << std::setprecision(0) << std::setw(14)
+	      << result.operationsPerSecond() << std::setprecision(1)
+	      << std::setw(12) << (result.time / 1e6) << std::setprecision(3)
+	      << std::setw(16) << (result.peakLiveBytes / 1048576.0)
+	      << std::setw(16) << (result.peakFootprint / 1048576.0)
+	      << std::setprecision(1) << std::setw(10)
+	      << (100.0 * result.fragmentation()) << "%" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::vector<NamedStrategy> strategies;
+  std::vector<std::string> traces;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      usage(std::cout);
+      return 0;
+    } else if ((arg == "-a") || (arg == "--allocator") ||
+	       (arg == "-l") || (arg == "--library")) {
+      if (++i >= argc) {
+	std::cerr << arg << " requires an argument" << std::endl;
+	usage(std::cerr);
+	return 2;
+      }
+
+      NamedStrategy strategy;
+      const bool builtIn = (arg == "-a") || (arg == "--allocator");
+      if (builtIn && !builtInStrategy(argv[i], strategy)) {
+	std::cerr << "Unknown allocator " << argv[i] << std::endl;
+	usage(std::cerr);
+	return 2;
+      } else if (!builtIn && !libraryStrategy(argv[i], strategy)) {
+	return 1;
+      }
+      strategies.push_back(strategy);
+    } else if (!arg.empty() && (arg[0] == '-')) {
+      std::cerr << "Unknown option " << arg << std::endl;
+      usage(std::cerr);
+      return 2;
+    } else {
+      traces.push_back(arg);
+    }
+  }
+
+  if (traces.empty()) {
+    usage(std::cerr);
+    return 2;
+  }
+  if (strategies.empty()) {
+    for (const char* name : { "malloc", "arena" }) {
+      NamedStrategy strategy;
+      builtInStrategy(name, strategy);
+      strategies.push_back(strategy);
+    }
+  }
+
+  int status = 0;
+  for (const std::string& filename : traces) {
+    std::vector<AllocationEvent> events;
+    if (!readAllocationTrace(filename, events)) {
+      std::cerr << "Cannot read allocation trace " << filename << std::endl;
+      status = 1;
+      continue;
+    }
+
+    printSummary(filename, events);
+    std::cout << std::setw(24) << std::left << "Allocator" << std::right
+	      << std::setw(14) << "Ops/s" << std::setw(12) << "Time (ms)"
+	      << std::setw(16) << "Live (MiB)" << std::setw(16)
+	      << "Peak RSS (MiB)" << std::setw(11) << "Frag." << std::endl;
+    for (const NamedStrategy& strategy : strategies) {
+      try {
+	printResult(strategy.name,
+		    replayAllocationTrace(events, strategy.create));
+      } catch(const std::exception& e) {
+	std::cerr << strategy.name << " failed: " << e.what() << std::endl;
+	status = 1;
+      }
+    }
+    std::cout << std::endl;
+  }
+  return status;
+}